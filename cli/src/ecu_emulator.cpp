@@ -0,0 +1,158 @@
+#include "openconsult/src/common.h"
+#include "openconsult/src/consult_engine_parameters.h"
+#include "openconsult/src/pty_emulator.h"
+#include "openconsult/src/simulated_ecu.h"
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/flags/usage_config.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace openconsult;
+
+#define APP_NAME "openconsult_ecu_emulator"
+#define APP_VERSION "0.1.0"
+#define APP_DESCRIPTION "Command line utility for emulating a Consult ECU on a pseudo-terminal."
+// Keep USAGE to < 100 characters per line, including the newline.
+#define APP_USAGE "usage: " APP_NAME " [--help] [--version] [--latency_us us] [--virtual]\n" \
+                  "       " APP_NAME " [--param id=value[,...]] [--register addr=value[,...]]"
+
+ABSL_FLAG(uint32_t, latency_us, 0,
+          "The time the ECU takes to act upon each byte it receives, in "
+          "microseconds.");
+ABSL_FLAG(bool, virtual, false,
+          "Simulate time rather than pacing bytes at the Consult baud rate. "
+          "Streams are then sent as fast as the terminal accepts them, so "
+          "throughput may be measured.");
+ABSL_FLAG(std::vector<std::string>, param, {},
+          "Engine parameters to report, as id=value, or as id=min:max:period "
+          "to sweep sinusoidally between min and max every period seconds. "
+          "Ids are as listed by engineParameterId(...), such as "
+          "'engine_speed_rpm'.");
+ABSL_FLAG(std::vector<std::string>, register, {},
+          "Raw registers to report, as addr=value, both in hex. Applied after "
+          "--param.");
+
+void reportUsageError(std::string error) {
+    std::cerr << APP_USAGE << "\n";
+    std::cerr << "ERROR: " << error << "\n";
+    std::exit(2);
+}
+
+EngineParameter parseEngineParameterId(const std::string& id) {
+    for (std::size_t i = 0; i < ENGINE_PARAMETER_COUNT; i++) {
+        EngineParameter parameter = static_cast<EngineParameter>(i);
+        if (engineParameterId(parameter) == id) {
+            return parameter;
+        }
+    }
+    reportUsageError(cmn::pformat("Unknown engine parameter: %s", id.c_str()));
+    return EngineParameter::ENGINE_RPM;
+}
+
+ParameterWaveform parseParameterWaveform(const std::string& spec) {
+    std::vector<double> values;
+    std::size_t begin = 0;
+    while (true) {
+        std::size_t end = spec.find(':', begin);
+        try {
+            std::size_t parsed;
+            std::string value = spec.substr(begin, end == std::string::npos ? end : end - begin);
+            values.push_back(std::stod(value, &parsed));
+            if (parsed != value.size()) {
+                throw std::invalid_argument(value);
+            }
+        } catch (const std::exception&) {
+            reportUsageError(cmn::pformat("Invalid parameter value: %s", spec.c_str()));
+        }
+        if (end == std::string::npos) {
+            break;
+        }
+        begin = end + 1;
+    }
+
+    if (values.size() == 1) {
+        double value = values[0];
+        return [value](uint64_t) { return value; };
+    } else if (values.size() != 3 || values[2] <= 0) {
+        reportUsageError(cmn::pformat("Invalid parameter sweep: %s", spec.c_str()));
+    }
+    double mid = (values[0] + values[1]) / 2;
+    double amplitude = (values[1] - values[0]) / 2;
+    double period_ns = values[2] * 1e9;
+    return [mid, amplitude, period_ns](uint64_t time) {
+        return mid + amplitude * std::sin(2 * M_PI * static_cast<double>(time) / period_ns);
+    };
+}
+
+uint8_t parseHexByte(const std::string& value) {
+    try {
+        std::size_t parsed;
+        unsigned long byte = std::stoul(value, &parsed, 16);
+        if (parsed == value.size() && byte <= 0xFF) {
+            return static_cast<uint8_t>(byte);
+        }
+    } catch (const std::exception&) {
+    }
+    reportUsageError(cmn::pformat("Invalid hex byte: %s", value.c_str()));
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    // Configure Abseil flags.
+    absl::FlagsUsageConfig flag_config;
+    flag_config.version_string = [](){ return APP_NAME " " APP_VERSION "\n"; };
+    absl::SetFlagsUsageConfig(flag_config);
+    absl::SetProgramUsageMessage(APP_DESCRIPTION "\n" APP_USAGE);
+
+    // Parse command line.
+    auto positional_args = absl::ParseCommandLine(argc, argv);
+    uint32_t latency_us = absl::GetFlag(FLAGS_latency_us);
+    SimulatedTiming timing = absl::GetFlag(FLAGS_virtual) ? SimulatedTiming::VIRTUAL : SimulatedTiming::REAL_TIME;
+    std::vector<std::string> params = absl::GetFlag(FLAGS_param);
+    std::vector<std::string> registers = absl::GetFlag(FLAGS_register);
+
+    // Validate command line.
+    if (positional_args.size() > 1) {
+        reportUsageError("Too many positional arguments supplied");
+    }
+
+    // Construct the simulated ECU.
+    std::unique_ptr<SimulatedECU> ecu(new SimulatedECU(timing));
+    ecu->setLatency(std::chrono::microseconds(latency_us));
+    for (const auto& param : params) {
+        std::size_t split = param.find('=');
+        if (split == std::string::npos) {
+            reportUsageError(cmn::pformat("Expected id=value: %s", param.c_str()));
+        }
+        ecu->setParameter(parseEngineParameterId(param.substr(0, split)),
+                          parseParameterWaveform(param.substr(split + 1)));
+    }
+    for (const auto& reg : registers) {
+        std::size_t split = reg.find('=');
+        if (split == std::string::npos) {
+            reportUsageError(cmn::pformat("Expected addr=value: %s", reg.c_str()));
+        }
+        uint8_t value = parseHexByte(reg.substr(split + 1));
+        ecu->setRegister(parseHexByte(reg.substr(0, split)), [value](uint64_t) { return value; });
+    }
+
+    // Serve it until interrupted.
+    try {
+        PtyEmulator emulator(std::move(ecu));
+        std::cout << emulator.devicePath() << std::endl;
+        emulator.wait();
+    } catch (const std::exception& e) {
+        std::cerr << "ERROR: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,316 @@
+#include "openconsult/src/common.h"
+#include "openconsult/src/log_columns.h"
+#include "openconsult/src/log_format.h"
+#include "openconsult/src/log_index.h"
+#include "openconsult/src/log_query.h"
+#include "openconsult/src/log_sessions.h"
+#include "openconsult/src/mapped_file.h"
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/flags/usage_config.h"
+
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace openconsult;
+
+#define APP_NAME "openconsult_log"
+#define APP_VERSION "0.1.0"
+#define APP_DESCRIPTION "Command line utility for converting, indexing, segmenting, decoding and querying Consult transaction logs."
+// Keep USAGE to < 100 characters per line, including the newline.
+#define APP_USAGE "usage: " APP_NAME " [--help] [--version] [--to format] input output\n" \
+                  "       " APP_NAME " --index input [output]\n" \
+                  "       " APP_NAME " --sessions [--threads n] input [output]\n" \
+                  "       " APP_NAME " --decode [--threads n] [--block_rows n] input [output]\n" \
+                  "       " APP_NAME " --query query input [input...]"
+
+ABSL_FLAG(std::string, to, "",
+          "Format to convert the log to: 'text' or 'binary'. Defaults to the "
+          "opposite of the input log's format, which is detected automatically.");
+ABSL_FLAG(bool, index, false,
+          "Build a seek index for the input log instead of converting it. The "
+          "index is written to output, which defaults to the input path with an "
+          "'.idx' suffix: the sidecar file LogReplay looks for when seeking.");
+ABSL_FLAG(uint64_t, index_interval, LogIndex::DEFAULT_INTERVAL,
+          "The number of records, and of frames, between indexed positions.");
+ABSL_FLAG(bool, sessions, false,
+          "Split the input log into sessions and transactions instead of "
+          "converting it. A summary of each session is printed, and a CSV table "
+          "of the transactions is written to output, which defaults to the "
+          "input path with a '.sessions.csv' suffix.");
+ABSL_FLAG(bool, decode, false,
+          "Decode the engine parameters streamed in the input log into a "
+          "columnar time-series file instead of converting it. The file is "
+          "written to output, which defaults to the input path with a "
+          "'.columns' suffix. The input's '.idx' sidecar index is used if "
+          "present and up to date.");
+ABSL_FLAG(uint32_t, block_rows, ColumnarLog::DEFAULT_BLOCK_ROWS,
+          "The number of rows in each block of a decoded log.");
+ABSL_FLAG(std::string, query, "",
+          "Query one or more decoded logs, written by --decode, instead of "
+          "converting a log. Matching rows are written to stdout as CSV. For "
+          "example: \"coolant_temp_degc and engine_speed_rpm where "
+          "engine_speed_rpm > 6000 between 60s and 10min\".");
+ABSL_FLAG(uint32_t, threads, 0,
+          "The number of threads to segment or decode with. Defaults to one "
+          "per core.");
+
+void reportUsageError(std::string error) {
+    std::cerr << APP_USAGE << "\n";
+    std::cerr << "ERROR: " << error << "\n";
+    std::exit(2);
+}
+
+/**
+ * @brief Runs a command over a log mapped into memory, writing to an output
+ *      file. The input is opened and mapped before the output is opened, so a
+ *      bad input leaves any existing output untouched.
+ *
+ * @param input_path Path of the log to read.
+ * @param output_path Path of the file to write.
+ * @param command The command to run, given the mapped log, its format and
+ *      the output file.
+ * @return The process exit code.
+ */
+int runOnLog(const std::string& input_path, const std::string& output_path,
+             const std::function<void(const MappedFile&, LogFormat, std::ostream&)>& command) {
+    std::ifstream input_file(input_path, std::ios_base::in | std::ios_base::binary);
+    if (!input_file.good()) {
+        reportUsageError(cmn::pformat("Failed to open %s", input_path.c_str()));
+    }
+    LogFormat format = detectLogFormat(input_file);
+    input_file.close();
+
+    try {
+        MappedFile log(input_path);
+        std::ofstream output_file(output_path, std::ios_base::out | std::ios_base::binary);
+        if (!output_file.good()) {
+            reportUsageError(cmn::pformat("Failed to open %s", output_path.c_str()));
+        }
+        command(log, format, output_file);
+    } catch (const std::exception& e) {
+        std::cerr << "ERROR: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+int buildIndex(const std::string& input_path, const std::string& output_path, uint64_t interval) {
+    return runOnLog(input_path, output_path, [interval](const MappedFile& log, LogFormat format,
+                                                        std::ostream& output_file) {
+        LogIndex index(log.data(), log.size(), format, interval);
+        index.write(output_file);
+        std::cout << "Indexed " << index.records() << " records, " << index.frames()
+                  << " frames at " << index.size() << " positions\n";
+    });
+}
+
+int segmentSessions(const std::string& input_path, const std::string& output_path, unsigned threads) {
+    return runOnLog(input_path, output_path, [threads](const MappedFile& log, LogFormat format,
+                                                       std::ostream& output_file) {
+        SessionTable table = segmentLog(log.data(), log.size(), format, threads);
+        writeSessionTable(table, output_file);
+        for (std::size_t i = 0; i < table.sessions.size(); i++) {
+            const auto& session = table.sessions[i];
+            std::cout << cmn::pformat("Session %zu: records %llu-%llu, %llu transactions, %llu frames%s\n",
+                                      i,
+                                      static_cast<unsigned long long>(session.first_record),
+                                      static_cast<unsigned long long>(session.first_record + session.records),
+                                      static_cast<unsigned long long>(session.transactions),
+                                      static_cast<unsigned long long>(session.frames),
+                                      session.handshake ? "" : " (no handshake)");
+        }
+    });
+}
+
+int decodeColumns(const std::string& input_path, const std::string& output_path, unsigned threads,
+                  uint32_t block_rows) {
+    return runOnLog(input_path, output_path, [&input_path, threads, block_rows](const MappedFile& log,
+                                                                                LogFormat format,
+                                                                                std::ostream& output_file) {
+        std::unique_ptr<LogIndex> index;
+        try {
+            index.reset(new LogIndex(input_path + ".idx"));
+            if (!index->matches(log.data(), log.size(), format)) {
+                index.reset();
+            }
+        } catch (const std::exception&) {
+            // No usable sidecar index.
+        }
+        if (!index) {
+            index.reset(new LogIndex(log.data(), log.size(), format));
+        }
+        ColumnarLogSummary summary = decodeLog(log.data(), log.size(), format, *index, output_file,
+                                               threads, block_rows);
+        std::cout << "Decoded " << summary.rows << " frames of " << summary.parameters.size()
+                  << " parameters into " << summary.blocks << " blocks\n";
+        if (summary.skipped_frames > 0) {
+            std::cout << "Skipped " << summary.skipped_frames << " malformed frames\n";
+        }
+    });
+}
+
+int queryColumns(const std::vector<std::string>& input_paths, const std::string& text) {
+    try {
+        LogQuery query = parseLogQuery(text);
+        bool named = input_paths.size() > 1;
+        std::cout << (named ? "log,time_ns" : "time_ns");
+        for (auto parameter : query.columns) {
+            std::cout << ',' << engineParameterId(parameter);
+        }
+        std::cout << '\n';
+
+        uint64_t rows = 0;
+        uint64_t blocks_read = 0;
+        uint64_t blocks = 0;
+        for (const auto& input_path : input_paths) {
+            ColumnarLog log(input_path);
+            LogQueryResult result = runLogQuery(log, query);
+            for (std::size_t row = 0; row < result.times.size(); row++) {
+                if (named) {
+                    std::cout << input_path << ',';
+                }
+                std::cout << result.times[row];
+                for (const auto& column : result.values) {
+                    std::cout << ',';
+                    if (!std::isnan(column[row])) {
+                        std::cout << column[row];
+                    }
+                }
+                std::cout << '\n';
+            }
+            rows += result.times.size();
+            blocks_read += result.blocks_read;
+            blocks += log.blocks();
+        }
+        std::cerr << "Matched " << rows << " rows, reading " << blocks_read << " of " << blocks << " blocks\n";
+    } catch (const std::exception& e) {
+        std::cerr << "ERROR: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    // Configure Abseil flags.
+    absl::FlagsUsageConfig flag_config;
+    flag_config.version_string = [](){ return APP_NAME " " APP_VERSION "\n"; };
+    absl::SetFlagsUsageConfig(flag_config);
+    absl::SetProgramUsageMessage(APP_DESCRIPTION "\n" APP_USAGE);
+
+    // Parse command line.
+    auto positional_args = absl::ParseCommandLine(argc, argv);
+    std::string to = absl::GetFlag(FLAGS_to);
+    bool index = absl::GetFlag(FLAGS_index);
+    uint64_t index_interval = absl::GetFlag(FLAGS_index_interval);
+    bool sessions = absl::GetFlag(FLAGS_sessions);
+    bool decode = absl::GetFlag(FLAGS_decode);
+    uint32_t block_rows = absl::GetFlag(FLAGS_block_rows);
+    std::string query = absl::GetFlag(FLAGS_query);
+    unsigned threads = absl::GetFlag(FLAGS_threads);
+
+    // Validate command line.
+    if (index + sessions + decode + !query.empty() > 1) {
+        reportUsageError("Only one of --index, --sessions, --decode and --query may be used");
+    }
+    if (!query.empty()) {
+        if (positional_args.size() < 2) {
+            reportUsageError("The following arguments are required: input");
+        }
+        if (!to.empty()) {
+            reportUsageError("--to cannot be used with --query");
+        }
+        return queryColumns({positional_args.begin() + 1, positional_args.end()}, query);
+    }
+    if (decode) {
+        if (positional_args.size() < 2) {
+            reportUsageError("The following arguments are required: input");
+        } else if (positional_args.size() > 3) {
+            reportUsageError("Too many positional arguments supplied");
+        }
+        if (!to.empty()) {
+            reportUsageError("--to cannot be used with --decode");
+        }
+        if (block_rows == 0) {
+            reportUsageError("--block_rows must be greater than zero");
+        }
+        std::string input_path = positional_args[1];
+        std::string output_path = positional_args.size() == 3 ? positional_args[2] : input_path + ".columns";
+        return decodeColumns(input_path, output_path, threads, block_rows);
+    }
+    if (sessions) {
+        if (positional_args.size() < 2) {
+            reportUsageError("The following arguments are required: input");
+        } else if (positional_args.size() > 3) {
+            reportUsageError("Too many positional arguments supplied");
+        }
+        if (!to.empty()) {
+            reportUsageError("--to cannot be used with --sessions");
+        }
+        std::string input_path = positional_args[1];
+        std::string output_path = positional_args.size() == 3 ? positional_args[2] : input_path + ".sessions.csv";
+        return segmentSessions(input_path, output_path, threads);
+    }
+    if (index) {
+        if (positional_args.size() < 2) {
+            reportUsageError("The following arguments are required: input");
+        } else if (positional_args.size() > 3) {
+            reportUsageError("Too many positional arguments supplied");
+        }
+        if (!to.empty()) {
+            reportUsageError("--to cannot be used with --index");
+        }
+        if (index_interval == 0) {
+            reportUsageError("--index_interval must be greater than zero");
+        }
+        std::string input_path = positional_args[1];
+        std::string output_path = positional_args.size() == 3 ? positional_args[2] : input_path + ".idx";
+        return buildIndex(input_path, output_path, index_interval);
+    }
+    if (positional_args.size() < 3) {
+        reportUsageError("The following arguments are required: input output");
+    } else if (positional_args.size() > 3) {
+        reportUsageError("Too many positional arguments supplied");
+    }
+    if (!to.empty() && to != "text" && to != "binary") {
+        reportUsageError(cmn::pformat("Unknown log format: %s", to.c_str()));
+    }
+
+    std::string input_path = positional_args[1];
+    std::string output_path = positional_args[2];
+
+    std::ifstream input_file(input_path, std::ios_base::in | std::ios_base::binary);
+    if (!input_file.good()) {
+        reportUsageError(cmn::pformat("Failed to open %s", input_path.c_str()));
+    }
+    LogFormat input_format = detectLogFormat(input_file);
+    LogFormat output_format;
+    if (to.empty()) {
+        output_format = input_format == LogFormat::TEXT ? LogFormat::BINARY : LogFormat::TEXT;
+    } else {
+        output_format = to == "text" ? LogFormat::TEXT : LogFormat::BINARY;
+    }
+
+    std::ofstream output_file(output_path, std::ios_base::out | std::ios_base::binary);
+    if (!output_file.good()) {
+        reportUsageError(cmn::pformat("Failed to open %s", output_path.c_str()));
+    }
+
+    try {
+        uint64_t count = convertLog(input_file, input_format, output_file, output_format);
+        std::cout << "Converted " << count << " records\n";
+    } catch (const std::invalid_argument& e) {
+        std::cerr << "ERROR: " << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
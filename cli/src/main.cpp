@@ -19,16 +19,27 @@ using namespace openconsult;
 #define APP_VERSION "0.1.0"
 #define APP_DESCRIPTION "Command line utility for reading from a Consult device."
 // Keep USAGE to < 100 characters per line, including the newline.
-#define APP_USAGE "usage: " APP_NAME " [--help] [--version] [--log path] [--replay]\n"\
-              "           [--replay_wrap] [--print_ecu] [--print_faults] device"
+#define APP_USAGE "usage: " APP_NAME " [--help] [--version] [--log path] [--binary_log]\n"\
+              "           [--async_log] [--replay] [--replay_wrap] [--replay_speed n]\n"\
+              "           [--print_ecu] [--print_faults] device"
 
 ABSL_FLAG(std::string, log, "",
           "Path to log all Consult transactions to. This log may be subsequently "
           "'replayed' using the --replay flag.");
+ABSL_FLAG(bool, binary_log, false,
+          "Write the --log in the compact, timestamped binary format rather than "
+          "as text.");
+ABSL_FLAG(bool, async_log, false,
+          "Write the --log from a background thread, so slow storage cannot stall "
+          "communication with the device.");
 ABSL_FLAG(bool, replay, false,
-          "Interpret the passed device as a log to replay transactions from.");
+          "Interpret the passed device as a log to replay transactions from. "
+          "The log's format is detected automatically.");
 ABSL_FLAG(bool, replay_wrap, false,
           "When replaying a log, wrap at the end of the log.");
+ABSL_FLAG(double, replay_speed, 0,
+          "When replaying a log, pace the replay to this multiple of real time. "
+          "0 replays as fast as possible.");
 ABSL_FLAG(bool, print_ecu, false,
           "Print metadata about the ECU.");
 ABSL_FLAG(bool, print_faults, false,
@@ -51,7 +62,11 @@ int main(int argc, char** argv) {
     auto positional_args = absl::ParseCommandLine(argc, argv);
     bool replay = absl::GetFlag(FLAGS_replay);
     bool wrap = absl::GetFlag(FLAGS_replay_wrap);
+    double replay_speed = absl::GetFlag(FLAGS_replay_speed);
     std::string log_path = absl::GetFlag(FLAGS_log);
+    LogFormat log_format = absl::GetFlag(FLAGS_binary_log) ? LogFormat::BINARY : LogFormat::TEXT;
+    LogRecorderOptions log_options;
+    log_options.async = absl::GetFlag(FLAGS_async_log);
     bool print_ecu = absl::GetFlag(FLAGS_print_ecu);
     bool print_faults = absl::GetFlag(FLAGS_print_faults);
 
@@ -60,28 +75,36 @@ int main(int argc, char** argv) {
         reportUsageError("The following arguments are required: device");
     } else if (positional_args.size() > 2) {
         reportUsageError("Too many positional arguments supplied");
+    } else if (replay_speed < 0) {
+        reportUsageError("--replay_speed must not be negative");
     }
 
     std::string device_id = positional_args[1];
 
     // Construct the device to perform Consult transactions with.
     std::unique_ptr<ByteInterface> device;
-    std::ifstream replay_file;
     std::ofstream log_file;
     if (replay) {
-        replay_file = std::ifstream(device_id, std::ios_base::in);
+        std::ifstream replay_file(device_id, std::ios_base::in | std::ios_base::binary);
         if (!replay_file.good()) {
             reportUsageError(cmn::pformat("Failed to open %s", device_id.c_str()));
         }
-        device = std::unique_ptr<ByteInterface>(new LogReplay(replay_file, wrap));
+        LogFormat replay_format = detectLogFormat(replay_file);
+        replay_file.close();
+        // Replay from the file directly, rather than the stream, so the log is
+        // mapped and parsed on demand rather than read up front.
+        std::unique_ptr<LogReplay> log_replay(new LogReplay(device_id, wrap, replay_format));
+        log_replay->setPacing(replay_speed);
+        device = std::move(log_replay);
     } else {
         device = std::unique_ptr<ByteInterface>(new SerialPort(device_id, 9600));
         if (!log_path.empty()) {
-            log_file = std::ofstream(log_path, std::ios_base::out);
+            log_file = std::ofstream(log_path, std::ios_base::out | std::ios_base::binary);
             if (!log_file.good()) {
                 reportUsageError(cmn::pformat("Failed to open %s", log_path.c_str()));
             }
-            device = std::unique_ptr<ByteInterface>(new LogRecorder(std::move(device), log_file));
+            device = std::unique_ptr<ByteInterface>(new LogRecorder(std::move(device), log_file,
+                                                                    log_format, log_options));
         }
     }
 
@@ -0,0 +1,201 @@
+#include "openconsult/src/common.h"
+#include "openconsult/src/consult_engine_parameters.internal.h"
+#include "openconsult/src/consult_interface.h"
+#include "openconsult/src/consult_interface.internal.h"
+#include "openconsult/src/simulated_ecu.h"
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <random>
+
+using namespace openconsult;
+
+
+/**
+ * @brief The first \c count engine parameters, wrapping to repeat them if
+ *      more are requested than exist.
+ */
+static std::vector<EngineParameter> firstParameters(std::size_t count) {
+    std::vector<EngineParameter> parameters;
+    for (std::size_t i = 0; i < count; i++) {
+        parameters.push_back(static_cast<EngineParameter>(i % ENGINE_PARAMETER_COUNT));
+    }
+    return parameters;
+}
+
+/**
+ * @brief A random response frame for a set of engine parameters.
+ */
+static std::vector<uint8_t> randomFrame(const std::vector<EngineParameter>& parameters) {
+    std::mt19937 rng(parameters.size());
+    std::vector<uint8_t> frame;
+    for (auto parameter : parameters) {
+        for (std::size_t i = 0; i < engineParameterDecoder(parameter).width; i++) {
+            frame.push_back(static_cast<uint8_t>(rng()));
+        }
+    }
+    return frame;
+}
+
+
+static void BM_EngineParameterDecode(benchmark::State& state) {
+    // Decode every parameter in turn from a frame holding them all.
+    auto parameters = firstParameters(ENGINE_PARAMETER_COUNT);
+    const auto frame = randomFrame(parameters);
+    for (auto _ : state) {
+        auto data = cmn::make_range(frame);
+        for (auto parameter : parameters) {
+            benchmark::DoNotOptimize(engineParameterDecode(parameter, data));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * parameters.size());
+}
+BENCHMARK(BM_EngineParameterDecode);
+
+static void BM_EngineParametersConstruct(benchmark::State& state) {
+    auto parameters = firstParameters(state.range(0));
+    auto frame = randomFrame(parameters);
+    for (auto _ : state) {
+        EngineParameters values(parameters, frame);
+        benchmark::DoNotOptimize(values);
+    }
+    state.SetItemsProcessed(state.iterations() * parameters.size());
+}
+BENCHMARK(BM_EngineParametersConstruct)->Arg(1)->Arg(8)->Arg(ENGINE_PARAMETER_COUNT);
+
+static void BM_EngineParametersToJSON(benchmark::State& state) {
+    auto parameters = firstParameters(state.range(0));
+    EngineParameters values(parameters, randomFrame(parameters));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(values.toJSON());
+    }
+    state.SetItemsProcessed(state.iterations() * parameters.size());
+}
+BENCHMARK(BM_EngineParametersToJSON)->Arg(1)->Arg(8)->Arg(ENGINE_PARAMETER_COUNT);
+
+static void BM_StreamPlanDecode(benchmark::State& state) {
+    // Decoding through a precompiled plan, as streams do for each frame.
+    auto parameters = firstParameters(state.range(0));
+    auto frame = randomFrame(parameters);
+    StreamPlan plan(parameters);
+    EngineParameters values;
+    for (auto _ : state) {
+        plan.decode(frame.data(), frame.size(), values);
+        benchmark::DoNotOptimize(values);
+    }
+    state.SetItemsProcessed(state.iterations() * parameters.size());
+}
+BENCHMARK(BM_StreamPlanDecode)->Arg(1)->Arg(8)->Arg(ENGINE_PARAMETER_COUNT);
+
+/**
+ * @brief A fault codes response holding \c count codes.
+ */
+static std::vector<uint8_t> faultCodesFrame(std::size_t count) {
+    const uint8_t ids[] = {11, 13, 21, 34, 45, 51};
+    std::vector<uint8_t> frame;
+    for (std::size_t i = 0; i < count; i++) {
+        frame.push_back(ids[i % sizeof(ids)]);
+        frame.push_back(static_cast<uint8_t>(i));
+    }
+    return frame;
+}
+
+static void BM_FaultCodesParse(benchmark::State& state) {
+    auto frame = faultCodesFrame(state.range(0));
+    for (auto _ : state) {
+        FaultCodes codes(frame);
+        benchmark::DoNotOptimize(codes);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FaultCodesParse)->Arg(1)->Arg(6)->Arg(32);
+
+static void BM_FaultCodesToJSON(benchmark::State& state) {
+    FaultCodes codes(faultCodesFrame(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(codes.toJSON());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FaultCodesToJSON)->Arg(1)->Arg(6)->Arg(32);
+
+static void BM_CalculateExpectedResponse(benchmark::State& state) {
+    // Register reads, as sent to start a stream: one command byte followed by
+    // one data byte, repeated.
+    auto parameters = firstParameters(state.range(0));
+    std::vector<uint8_t> request;
+    for (auto parameter : parameters) {
+        auto command = engineParameterCommand(parameter);
+        request.insert(request.end(), command.begin(), command.end());
+    }
+    std::vector<uint8_t> response;
+    for (auto _ : state) {
+        calculateExpectedResponse(request, response, 1, 1);
+        benchmark::DoNotOptimize(response.data());
+    }
+    state.SetBytesProcessed(state.iterations() * request.size());
+}
+BENCHMARK(BM_CalculateExpectedResponse)->Arg(1)->Arg(8)->Arg(ENGINE_PARAMETER_COUNT);
+
+static void BM_StreamPlanConstruct(benchmark::State& state) {
+    auto parameters = firstParameters(state.range(0));
+    for (auto _ : state) {
+        StreamPlan plan(parameters);
+        benchmark::DoNotOptimize(plan);
+    }
+    state.SetItemsProcessed(state.iterations() * parameters.size());
+}
+BENCHMARK(BM_StreamPlanConstruct)->Arg(1)->Arg(8)->Arg(ENGINE_PARAMETER_COUNT);
+
+/**
+ * @brief Connects to a simulated ECU whose engine speed, coolant temperature
+ *      and battery voltage vary over time.
+ */
+static ConsultInterface connectSimulated(SimulatedECU*& ecu) {
+    ecu = new SimulatedECU();
+    ecu->setParameter(EngineParameter::ENGINE_RPM, [](uint64_t time) {
+        return 800.0 + time / 1000000 % 6000;
+    });
+    ecu->setParameter(EngineParameter::COOLANT_TEMPERATURE, [](uint64_t time) {
+        return 20.0 + time / 1000000000 % 70;
+    });
+    ecu->setParameter(EngineParameter::BATTERY_VOLTAGE, [](uint64_t) {
+        return 14.4;
+    });
+    return ConsultInterface(std::unique_ptr<ByteInterface>(ecu), std::chrono::milliseconds(1000));
+}
+
+static const std::vector<EngineParameter> SIMULATED_PARAMETERS {{EngineParameter::ENGINE_RPM,
+                                                                 EngineParameter::COOLANT_TEMPERATURE,
+                                                                 EngineParameter::BATTERY_VOLTAGE}};
+
+static void BM_SimulatedStream(benchmark::State& state) {
+    // End to end streaming from a simulated ECU in virtual time, so the
+    // library's overhead per frame is measured without waiting on the wire.
+    SimulatedECU* ecu;
+    ConsultInterface consult = connectSimulated(ecu);
+    StreamOptions options;
+    options.background = state.range(0) != 0;
+    auto stream = consult.streamEngineParameters(SIMULATED_PARAMETERS, options);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(stream.getFrame());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SimulatedStream)->Arg(0)->Arg(1);
+
+static void BM_SimulatedRead(benchmark::State& state) {
+    // Single reads, each a full request, frame and stop. The simulated time
+    // each took on the wire is reported as its latency.
+    SimulatedECU* ecu;
+    ConsultInterface consult = connectSimulated(ecu);
+    StreamPlan plan(SIMULATED_PARAMETERS);
+    uint64_t start = ecu->time();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(consult.readEngineParameters(plan));
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["wire_latency_ms"] = (ecu->time() - start) / 1e6 / state.iterations();
+}
+BENCHMARK(BM_SimulatedRead);
@@ -0,0 +1,98 @@
+#include "openconsult/src/common.h"
+#include "openconsult/src/log_format.h"
+
+#include <benchmark/benchmark.h>
+
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+using namespace openconsult;
+
+
+static std::vector<uint8_t> randomBytes(std::size_t size) {
+    std::mt19937 rng(size);
+    std::vector<uint8_t> bytes(size);
+    for (auto& b : bytes) {
+        b = static_cast<uint8_t>(rng());
+    }
+    return bytes;
+}
+
+/**
+ * @brief The iostream-based formatting previously used by format_bytes, kept
+ *      as a baseline.
+ */
+static std::string formatBytesStream(const uint8_t* bytes, std::size_t size) {
+    std::stringstream ss;
+    ss << std::hex << std::setfill('0');
+    for (std::size_t i = 0; i < size; i++) {
+        ss << std::setw(2) << static_cast<int>(bytes[i]);
+    }
+    return ss.str();
+}
+
+static void BM_HexEncode(benchmark::State& state) {
+    auto bytes = randomBytes(state.range(0));
+    std::string hex(2 * bytes.size(), '\0');
+    for (auto _ : state) {
+        cmn::hex_encode(bytes.data(), bytes.size(), &hex[0]);
+        benchmark::DoNotOptimize(hex.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_HexEncode)->Arg(8)->Arg(64)->Arg(4096)->Arg(1 << 20);
+
+static void BM_HexEncodeStream(benchmark::State& state) {
+    auto bytes = randomBytes(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(formatBytesStream(bytes.data(), bytes.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_HexEncodeStream)->Arg(8)->Arg(64)->Arg(4096);
+
+static void BM_HexDecode(benchmark::State& state) {
+    auto bytes = randomBytes(state.range(0));
+    std::string hex = cmn::format_bytes(bytes);
+    std::vector<uint8_t> decoded(bytes.size());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cmn::hex_decode(hex.data(), decoded.size(), decoded.data()));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * hex.size());
+}
+BENCHMARK(BM_HexDecode)->Arg(8)->Arg(64)->Arg(4096)->Arg(1 << 20);
+
+static void BM_HexDecodeStrtoul(benchmark::State& state) {
+    // The substr/strtoul parsing previously used by the text log reader.
+    auto bytes = randomBytes(state.range(0));
+    std::string hex = cmn::format_bytes(bytes);
+    std::vector<uint8_t> decoded(bytes.size());
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < decoded.size(); i++) {
+            decoded[i] = static_cast<uint8_t>(std::strtoul(hex.substr(2 * i, 2).c_str(), nullptr, 16));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * hex.size());
+}
+BENCHMARK(BM_HexDecodeStrtoul)->Arg(8)->Arg(64)->Arg(4096);
+
+static void BM_TextLogRoundTrip(benchmark::State& state) {
+    // Convert a text log to binary, as when converting an archive.
+    std::string text;
+    auto bytes = randomBytes(state.range(0));
+    for (int i = 0; i < 1000; i++) {
+        text += (i % 2 ? "R " : "W ") + cmn::format_bytes(bytes) + "\n";
+    }
+    for (auto _ : state) {
+        std::istringstream in(text);
+        std::ostringstream out;
+        convertLog(in, LogFormat::TEXT, out, LogFormat::BINARY);
+        benchmark::DoNotOptimize(out);
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_TextLogRoundTrip)->Arg(8)->Arg(64)->Arg(1024);
@@ -0,0 +1,194 @@
+#include "openconsult/src/byte_interface.h"
+#include "openconsult/src/common.h"
+#include "openconsult/src/consult_interface.h"
+#include "openconsult/src/log_format.h"
+#include "openconsult/src/log_recorder.h"
+#include "openconsult/src/log_replay.h"
+
+#include <benchmark/benchmark.h>
+
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <streambuf>
+
+using namespace openconsult;
+
+
+static std::vector<uint8_t> randomBytes(std::size_t size) {
+    std::mt19937 rng(size);
+    std::vector<uint8_t> bytes(size);
+    for (auto& b : bytes) {
+        b = static_cast<uint8_t>(rng());
+    }
+    return bytes;
+}
+
+/**
+ * @brief A text log of alternating write and read records, each of \c size
+ *      random bytes, in the given format.
+ */
+static std::string transactionLog(std::size_t size, LogFormat format) {
+    std::string text;
+    for (int i = 0; i < 1000; i++) {
+        text += (i % 2 ? "R " : "W ") + cmn::format_bytes(randomBytes(size + i % 2)) + "\n";
+    }
+    if (format == LogFormat::TEXT) {
+        return text;
+    }
+    std::istringstream input(text);
+    std::ostringstream output;
+    convertLog(input, LogFormat::TEXT, output, format);
+    return output.str();
+}
+
+/**
+ * @brief \c ByteInterface which returns zeros when read from and discards
+ *      writes, so only the cost of whatever wraps it is measured.
+ */
+class NullByteInterface : public ByteInterface {
+public:
+    std::vector<uint8_t> read(std::size_t size) override {
+        return std::vector<uint8_t>(size);
+    }
+
+    void readInto(uint8_t* dst, std::size_t size) override {
+        std::fill(dst, dst + size, 0);
+    }
+
+    void write(const std::vector<uint8_t>&) override {
+    }
+};
+
+/**
+ * @brief Stream buffer which discards everything written to it.
+ */
+class NullBuffer : public std::streambuf {
+protected:
+    std::streamsize xsputn(const char*, std::streamsize size) override {
+        return size;
+    }
+
+    int overflow(int c) override {
+        return traits_type::not_eof(c);
+    }
+};
+
+
+static void BM_LogBufferParse(benchmark::State& state) {
+    LogFormat format = static_cast<LogFormat>(state.range(0));
+    std::string log = transactionLog(state.range(1), format);
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(log.data());
+    for (auto _ : state) {
+        LogBufferParser parser(data, log.size(), format);
+        LogRecordView record;
+        while (parser.next(record)) {
+            benchmark::DoNotOptimize(record);
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * log.size());
+}
+BENCHMARK(BM_LogBufferParse)->ArgsProduct({{static_cast<int>(LogFormat::TEXT),
+                                            static_cast<int>(LogFormat::BINARY)},
+                                           {4, 64, 1024}});
+
+static void BM_LogReaderRead(benchmark::State& state) {
+    // Parsing records into owned LogRecords from a stream.
+    LogFormat format = static_cast<LogFormat>(state.range(0));
+    std::string log = transactionLog(state.range(1), format);
+    for (auto _ : state) {
+        std::istringstream input(log);
+        auto reader = LogReader::create(input, format);
+        LogRecord record;
+        while (reader->read(record)) {
+            benchmark::DoNotOptimize(record.data.data());
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * log.size());
+}
+BENCHMARK(BM_LogReaderRead)->ArgsProduct({{static_cast<int>(LogFormat::TEXT),
+                                           static_cast<int>(LogFormat::BINARY)},
+                                          {4, 64, 1024}});
+
+static void BM_LogReplayRead(benchmark::State& state) {
+    // Reads of a fixed size, spanning records, from a wrapping replay.
+    std::istringstream input(transactionLog(64, LogFormat::TEXT));
+    LogReplay replay(input, true);
+    std::vector<uint8_t> buffer(state.range(0));
+    for (auto _ : state) {
+        replay.readInto(buffer.data(), buffer.size());
+        benchmark::DoNotOptimize(buffer.data());
+    }
+    state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_LogReplayRead)->Arg(1)->Arg(16)->Arg(256);
+
+static void BM_LogReplayWrite(benchmark::State& state) {
+    // Writes matched against the log's write records, as a stream's requests
+    // are.
+    std::string text;
+    auto request = randomBytes(state.range(0));
+    for (int i = 0; i < 1000; i++) {
+        text += "W " + cmn::format_bytes(request) + "\n";
+    }
+    std::istringstream input(text);
+    LogReplay replay(input, true);
+    for (auto _ : state) {
+        replay.write(request);
+    }
+    state.SetBytesProcessed(state.iterations() * request.size());
+}
+BENCHMARK(BM_LogReplayWrite)->Arg(1)->Arg(16)->Arg(256);
+
+static void BM_LogRecorder(benchmark::State& state) {
+    // Transactions of a stream: a short request followed by frames.
+    LogFormat format = static_cast<LogFormat>(state.range(0));
+    LogRecorderOptions options;
+    options.async = state.range(1) != 0;
+    std::vector<uint8_t> request {{0x5A, 0x0B}};
+    std::size_t frame_size = state.range(2);
+    NullBuffer buffer;
+    std::ostream output(&buffer);
+    LogRecorder recorder(std::unique_ptr<ByteInterface>(new NullByteInterface), output, format, options);
+    for (auto _ : state) {
+        recorder.write(request);
+        for (int i = 0; i < 8; i++) {
+            benchmark::DoNotOptimize(recorder.read(frame_size));
+        }
+    }
+    recorder.close();
+    state.SetBytesProcessed(state.iterations() * (request.size() + 8 * frame_size));
+}
+BENCHMARK(BM_LogRecorder)->ArgsProduct({{static_cast<int>(LogFormat::TEXT),
+                                         static_cast<int>(LogFormat::BINARY)},
+                                        {0, 1},
+                                        {8, 64}});
+
+static void BM_ReplayStream(benchmark::State& state) {
+    // End to end: connect to a replayed ECU, stream frames of engine speed,
+    // coolant temperature and battery voltage, and stop the stream.
+    std::size_t frames = state.range(0);
+    std::string log = "W ffffef\nR 10\nW 5a005a015a085a0c\nR a500a501a508a50c\nW f0\n";
+    std::mt19937 rng(42);
+    for (std::size_t i = 0; i < frames; i++) {
+        std::vector<uint8_t> frame {{0xFF, 0x04}};
+        for (int j = 0; j < 4; j++) {
+            frame.push_back(static_cast<uint8_t>(rng()));
+        }
+        log += "R " + cmn::format_bytes(frame) + "\n";
+    }
+    log += "W 30\nR cf\n";
+    std::vector<EngineParameter> parameters {{EngineParameter::ENGINE_RPM,
+                                              EngineParameter::COOLANT_TEMPERATURE,
+                                              EngineParameter::BATTERY_VOLTAGE}};
+    for (auto _ : state) {
+        std::istringstream input(log);
+        ConsultInterface consult(std::unique_ptr<ByteInterface>(new LogReplay(input)));
+        auto stream = consult.streamEngineParameters(parameters);
+        for (std::size_t i = 0; i < frames; i++) {
+            benchmark::DoNotOptimize(stream.getFrame());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * frames);
+}
+BENCHMARK(BM_ReplayStream)->Arg(100)->Arg(10000);
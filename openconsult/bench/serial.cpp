@@ -0,0 +1,67 @@
+#include "openconsult/src/consult_interface.h"
+#include "openconsult/src/pty_emulator.h"
+#include "openconsult/src/serial.h"
+#include "openconsult/src/simulated_ecu.h"
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+
+using namespace openconsult;
+
+
+static const std::vector<EngineParameter> SERIAL_PARAMETERS {{EngineParameter::ENGINE_RPM,
+                                                              EngineParameter::COOLANT_TEMPERATURE,
+                                                              EngineParameter::BATTERY_VOLTAGE}};
+
+/**
+ * @brief Serves a simulated ECU on a pseudo-terminal, whose engine speed
+ *      varies over time.
+ */
+static std::unique_ptr<PtyEmulator> emulate(SimulatedTiming timing, std::chrono::microseconds latency) {
+    SimulatedECU* ecu = new SimulatedECU(timing);
+    ecu->setLatency(latency);
+    ecu->setParameter(EngineParameter::ENGINE_RPM, [](uint64_t time) {
+        return 800.0 + time / 1000000 % 6000;
+    });
+    return std::unique_ptr<PtyEmulator>(new PtyEmulator(std::unique_ptr<ByteInterface>(ecu)));
+}
+
+static ConsultInterface connect(const PtyEmulator& emulator) {
+    return ConsultInterface(std::unique_ptr<ByteInterface>(new SerialPort(emulator.devicePath(), 9600)),
+                            std::chrono::milliseconds(1000));
+}
+
+
+static void BM_SerialStream(benchmark::State& state) {
+    // Streaming through the terminal from an ECU in virtual time, which sends
+    // frames as fast as the terminal accepts them, so the throughput of the
+    // termios path and the coalescing of reads is measured.
+    auto emulator = emulate(SimulatedTiming::VIRTUAL, std::chrono::microseconds(0));
+    ConsultInterface consult = connect(*emulator);
+    StreamOptions options;
+    options.background = state.range(0) != 0;
+    auto stream = consult.streamEngineParameters(SERIAL_PARAMETERS, options);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(stream.getFrame());
+    }
+    state.SetItemsProcessed(state.iterations());
+    auto statistics = stream.statistics();
+    state.counters["jitter_us"] = statistics.jitter.count() / 1e3;
+    state.counters["resyncs"] = statistics.resyncs;
+}
+BENCHMARK(BM_SerialStream)->Arg(0)->Arg(1)->UseRealTime();
+
+static void BM_SerialRead(benchmark::State& state) {
+    // Single reads from an ECU paced at the Consult baud rate, each a full
+    // request, frame and stop, with the ECU taking the given number of
+    // microseconds to act upon each byte.
+    auto emulator = emulate(SimulatedTiming::REAL_TIME, std::chrono::microseconds(state.range(0)));
+    ConsultInterface consult = connect(*emulator);
+    StreamPlan plan(SERIAL_PARAMETERS);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(consult.readEngineParameters(plan));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SerialRead)->Arg(0)->Arg(1000)->Unit(benchmark::kMillisecond)->UseRealTime();
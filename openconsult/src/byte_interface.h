@@ -1,18 +1,54 @@
 #ifndef OPENCONSULT_LIB_BYTE_INTERFACE
 #define OPENCONSULT_LIB_BYTE_INTERFACE
 
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
 namespace openconsult {
 
 
+/**
+ * @brief Exception type thrown when a read from a \c ByteInterface does not
+ *      complete within its timeout or before its deadline.
+ *
+ * This is thrown with a fixed message so that it is cheap to construct, and
+ * may be caught separately from other failures to recover from a stalled
+ * device.
+ */
+class timeout_error : public std::runtime_error {
+public:
+    timeout_error() :
+        std::runtime_error("Timed out waiting for data") {
+    }
+};
+
+/**
+ * @brief Exception type thrown to indicate an unhandled error coming from an
+ * Operating System call.
+ */
+class os_error : public std::runtime_error {
+public:
+    os_error(const char* message) :
+        std::runtime_error(message) {
+    }
+
+    os_error(const std::string& message) :
+        std::runtime_error(message) {
+    }
+};
+
 /**
  * @brief Basic interface for communicating on a generic bytewise interface.
  */
 class ByteInterface {
 public:
+    /// @brief The clock used to measure timeouts and deadlines.
+    using clock = std::chrono::steady_clock;
+
     virtual ~ByteInterface() = default;
 
     /**
@@ -22,18 +58,133 @@ public:
      *      than this are available to read. May be zero to read all currently
      *      available bytes (which may be zero).
      * @return Vector containing the read bytes.
+     * @throws timeout_error if the read does not complete within the timeout
+     *      or before the deadline, if either are set.
      */
     virtual std::vector<uint8_t> read(std::size_t size = 0) = 0;
 
+    /**
+     * @brief Performs a blocking read of data from the interface into a
+     *      caller-provided buffer, avoiding any allocation.
+     *
+     * The default implementation forwards to \c read(std::size_t) .
+     * Implementations should override it to read directly into \c dst .
+     *
+     * @param dst Buffer to read into. Must have space for \c size bytes.
+     * @param size Number of bytes to read. The read will block until exactly
+     *      this many bytes have been read.
+     * @throws timeout_error if the read does not complete within the timeout
+     *      or before the deadline, if either are set.
+     */
+    virtual void readInto(uint8_t* dst, std::size_t size) {
+        if (size > 0) {
+            auto bytes = read(size);
+            std::copy(bytes.begin(), bytes.end(), dst);
+        }
+    }
+
     /**
      * @brief Writes data to the interface.
      *
      * @param bytes Vector containing zero or more bytes to write.
      */
     virtual void write(const std::vector<uint8_t>& bytes) = 0;
+
+    /**
+     * @brief Writes data to the interface from a caller-provided buffer,
+     *      avoiding any allocation.
+     *
+     * The default implementation forwards to
+     * \c write(const std::vector<uint8_t>&) . Implementations should override
+     * it to write directly from \c bytes .
+     *
+     * @param bytes Buffer holding the bytes to write.
+     * @param size Number of bytes in \c bytes . May be zero.
+     */
+    virtual void write(const uint8_t* bytes, std::size_t size) {
+        write(std::vector<uint8_t>(bytes, bytes + size));
+    }
+
+    /**
+     * @brief Sets the maximum time a single call to \c read(...) may block for
+     *      while waiting for data.
+     *
+     * Interfaces which never block may ignore this.
+     *
+     * @param timeout The maximum time to wait, or zero to wait indefinitely
+     *      (the default).
+     */
+    virtual void setTimeout(std::chrono::milliseconds) {
+    }
+
+    /**
+     * @brief Sets an absolute time by which all subsequent reads must complete.
+     *      Unlike \c setTimeout(...) this spans multiple calls, so may be used
+     *      to bound an entire transaction.
+     *
+     * Interfaces which never block may ignore this.
+     *
+     * @param deadline The deadline to apply, or \c clock::time_point::max() to
+     *      clear the deadline (the default).
+     */
+    virtual void setDeadline(clock::time_point) {
+    }
+
+    /**
+     * @brief The time at which the last byte returned by the most recent read
+     *      was received from the device.
+     *
+     * Interfaces which read ahead of their callers should override this, as
+     * a read may return bytes received well before it was called. The default
+     * implementation returns the current time, so is only accurate when
+     * called straight after a read.
+     *
+     * @return The time the byte was received.
+     */
+    virtual clock::time_point lastReadTime() const {
+        return clock::now();
+    }
+};
+
+
+/**
+ * @brief RAII helper which applies a deadline to a \c ByteInterface for the
+ *      duration of its lifetime.
+ */
+class ScopedDeadline {
+public:
+    /**
+     * @brief Construct a new \c ScopedDeadline .
+     *
+     * @param byte_interface The interface to apply the deadline to.
+     * @param timeout Time from now until the deadline. May be zero to not
+     *      apply any deadline.
+     */
+    ScopedDeadline(ByteInterface& byte_interface, std::chrono::milliseconds timeout)
+            : byte_interface(timeout.count() > 0 ? &byte_interface : nullptr) {
+        if (this->byte_interface) {
+            this->byte_interface->setDeadline(ByteInterface::clock::now() + timeout);
+        }
+    }
+
+    // ScopedDeadline is neither copyable nor movable.
+    ScopedDeadline(const ScopedDeadline&) = delete;
+    ScopedDeadline& operator=(const ScopedDeadline&) = delete;
+
+    /**
+     * @brief Destroy the \c ScopedDeadline , clearing the deadline.
+     */
+    ~ScopedDeadline() {
+        if (byte_interface) {
+            byte_interface->setDeadline(ByteInterface::clock::time_point::max());
+        }
+    }
+
+private:
+    ByteInterface* byte_interface;
 };
 
 
 }
 
-#endif
\ No newline at end of file
+#endif
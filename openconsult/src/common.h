@@ -1,14 +1,24 @@
 #ifndef OPENCONSULT_LIB_COMMON
 #define OPENCONSULT_LIB_COMMON
 
+#include <chrono>
+#include <cstdint>
 #include <iomanip>
 #include <iterator>
 #include <memory>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 namespace cmn {
 
 
@@ -37,6 +47,212 @@ inline std::string pformat(const std::string& format, Args&&... args) {
 
 
 
+/**
+ * @brief Lookup tables for the scalar hex codec.
+ */
+struct hex_tables {
+    /// @brief The two lowercase hex digits of each byte value.
+    char encode[512];
+    /// @brief The value of each hex digit character, or -1 for non-digits.
+    int8_t decode[256];
+
+    constexpr hex_tables() : encode(), decode() {
+        for (int i = 0; i < 256; i++) {
+            encode[2 * i]     = "0123456789abcdef"[i >> 4];
+            encode[2 * i + 1] = "0123456789abcdef"[i & 0xF];
+            decode[i] = -1;
+        }
+        for (int i = 0; i < 10; i++) {
+            decode['0' + i] = static_cast<int8_t>(i);
+        }
+        for (int i = 0; i < 6; i++) {
+            decode['a' + i] = static_cast<int8_t>(10 + i);
+            decode['A' + i] = static_cast<int8_t>(10 + i);
+        }
+    }
+};
+
+/**
+ * @brief Accesses the lookup tables for the scalar hex codec.
+ *
+ * @return The tables, which are constant-initialised.
+ */
+inline const hex_tables& get_hex_tables() {
+    static constexpr hex_tables tables{};
+    return tables;
+}
+
+#if defined(__SSE2__)
+/**
+ * @brief Converts sixteen nibbles to lowercase hex digits.
+ */
+inline __m128i hex_encode_nibbles(__m128i nibbles) {
+    // '0' + n, plus the gap between '9' and 'a' for n > 9.
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10));
+    return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+}
+
+/**
+ * @brief Converts sixteen hex digits, in either case, to their values.
+ *
+ * @param chars The digits.
+ * @param invalid Accumulates a mask of any characters that are not digits.
+ * @return The values of the digits.
+ */
+inline __m128i hex_decode_digits(__m128i chars, __m128i& invalid) {
+    // Signed comparisons are fine: non-ASCII characters are negative, so fail
+    // every range check.
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)),
+                                  _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+    __m128i lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+    __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                   _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+    invalid = _mm_or_si128(invalid, _mm_xor_si128(_mm_or_si128(digit, letter), _mm_set1_epi8(-1)));
+    return _mm_or_si128(_mm_and_si128(digit, _mm_sub_epi8(chars, _mm_set1_epi8('0'))),
+                        _mm_and_si128(letter, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+}
+
+/**
+ * @brief Combines sixteen digit values, in (high, low) pairs, into eight
+ *      bytes, each held in the low half of a 16-bit lane.
+ */
+inline __m128i hex_combine_digits(__m128i values) {
+    // Each little-endian lane holds high | low << 8.
+    __m128i high = _mm_slli_epi16(_mm_and_si128(values, _mm_set1_epi16(0x00FF)), 4);
+    __m128i low = _mm_srli_epi16(values, 8);
+    return _mm_or_si128(high, low);
+}
+#endif
+
+/**
+ * @brief Encodes bytes as lowercase hex, two digits per byte. Uses SIMD where
+ *      available.
+ *
+ * @param src The bytes to encode.
+ * @param size The number of bytes to encode.
+ * @param dst Buffer to write the digits to. Must have space for \c 2*size
+ *      characters. No terminator is written.
+ */
+inline void hex_encode(const uint8_t* src, std::size_t size, char* dst) {
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 32 <= size; i += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i mask = _mm256_set1_epi8(0x0F);
+        __m256i high = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), mask);
+        __m256i low = _mm256_and_si256(bytes, mask);
+        __m256i nine = _mm256_set1_epi8(9);
+        __m256i gap = _mm256_set1_epi8('a' - '0' - 10);
+        __m256i zero = _mm256_set1_epi8('0');
+        high = _mm256_add_epi8(_mm256_add_epi8(high, zero), _mm256_and_si256(_mm256_cmpgt_epi8(high, nine), gap));
+        low = _mm256_add_epi8(_mm256_add_epi8(low, zero), _mm256_and_si256(_mm256_cmpgt_epi8(low, nine), gap));
+        // Unpacking works within 128-bit lanes, so reorder the lanes after.
+        __m256i first = _mm256_unpacklo_epi8(high, low);
+        __m256i second = _mm256_unpackhi_epi8(high, low);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 2 * i),
+                            _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 2 * i + 32),
+                            _mm256_permute2x128_si256(first, second, 0x31));
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i + 16 <= size; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i mask = _mm_set1_epi8(0x0F);
+        __m128i high = hex_encode_nibbles(_mm_and_si128(_mm_srli_epi16(bytes, 4), mask));
+        __m128i low = hex_encode_nibbles(_mm_and_si128(bytes, mask));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i), _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i + 16), _mm_unpackhi_epi8(high, low));
+    }
+#endif
+    // Other architectures (e.g. NEON) may add a vectorised block above. The
+    // scalar path handles the remainder.
+    const char* table = get_hex_tables().encode;
+    for (; i < size; i++) {
+        dst[2 * i]     = table[2 * src[i]];
+        dst[2 * i + 1] = table[2 * src[i] + 1];
+    }
+}
+
+/**
+ * @brief Decodes hex digits, in either case, to bytes. Uses SIMD where
+ *      available.
+ *
+ * @param src The digits to decode, two per byte.
+ * @param size The number of bytes to decode.
+ * @param dst Buffer to write the bytes to. Must have space for \c size bytes.
+ *      Its contents are unspecified if decoding fails.
+ * @return \c true if successful, \c false if \c src contains a character that
+ *      is not a hex digit.
+ */
+inline bool hex_decode(const char* src, std::size_t size, uint8_t* dst) {
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    __m128i invalid = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16) {
+        __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+        __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i + 16));
+        first = hex_combine_digits(hex_decode_digits(first, invalid));
+        second = hex_combine_digits(hex_decode_digits(second, invalid));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(first, second));
+    }
+    if (_mm_movemask_epi8(invalid)) {
+        return false;
+    }
+#endif
+    const int8_t* table = get_hex_tables().decode;
+    int8_t check = 0;
+    for (; i < size; i++) {
+        int8_t high = table[static_cast<uint8_t>(src[2 * i])];
+        int8_t low = table[static_cast<uint8_t>(src[2 * i + 1])];
+        check |= high | low;
+        dst[i] = static_cast<uint8_t>(static_cast<uint8_t>(high) << 4 | (low & 0xF));
+    }
+    // Any invalid digit sets the sign bit.
+    return check >= 0;
+}
+
+/**
+ * @brief Determines whether characters are all hex digits, in either case.
+ *      Uses SIMD where available.
+ *
+ * @param src The characters to check.
+ * @param length The number of characters to check.
+ * @return \c true if every character is a hex digit.
+ */
+inline bool is_hex(const char* src, std::size_t length) {
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    __m128i invalid = _mm_setzero_si128();
+    for (; i + 16 <= length; i += 16) {
+        hex_decode_digits(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), invalid);
+    }
+    if (_mm_movemask_epi8(invalid)) {
+        return false;
+    }
+#endif
+    const int8_t* table = get_hex_tables().decode;
+    int8_t check = 0;
+    for (; i < length; i++) {
+        check |= table[static_cast<uint8_t>(src[i])];
+    }
+    return check >= 0;
+}
+
+/**
+ * @brief Formats \c bytes into a string with the numeric values represented in
+ * zero-padded hex, with no separator between bytes.
+ *
+ * @param bytes Pointer to the bytes to format.
+ * @param size Number of bytes to format.
+ * @return Formatted string representing the bytes.
+ */
+inline std::string format_bytes(const uint8_t* bytes, std::size_t size) {
+    std::string result(2 * size, '\0');
+    hex_encode(bytes, size, &result[0]);
+    return result;
+}
+
 /**
  * @brief Formats \c bytes into a string with the numeric values represented in
  * zero-padded hex, with no separator between bytes.
@@ -45,12 +261,59 @@ inline std::string pformat(const std::string& format, Args&&... args) {
  * @return Formatted string representing the bytes.
  */
 inline std::string format_bytes(const std::vector<uint8_t>& bytes) {
-    std::ostringstream sstream;
-    sstream << std::hex << std::setfill('0');
-    for (const uint8_t& byte : bytes) {
-        sstream << std::setw(2) << static_cast<uint32_t>(byte);
+    return format_bytes(bytes.data(), bytes.size());
+}
+
+
+
+/**
+ * @brief Encodes an unsigned integer as little-endian bytes, as used by the
+ * binary log, index and columnar file formats.
+ *
+ * @param value The value to encode.
+ * @param size The number of bytes to encode it in, at most 8. Higher bytes of
+ *      \c value are discarded.
+ * @param dst Pointer to at least \c size bytes to write to.
+ */
+inline void encode_uint(uint64_t value, std::size_t size, uint8_t* dst) {
+    for (std::size_t i = 0; i < size; i++) {
+        dst[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+/**
+ * @brief Decodes an unsigned integer from little-endian bytes.
+ *
+ * @param src Pointer to the bytes to decode.
+ * @param size The number of bytes to decode, at most 8.
+ * @return The decoded value.
+ */
+inline uint64_t decode_uint(const uint8_t* src, std::size_t size) {
+    uint64_t value = 0;
+    for (std::size_t i = 0; i < size; i++) {
+        value |= static_cast<uint64_t>(src[i]) << (8 * i);
+    }
+    return value;
+}
+
+
+
+/**
+ * @brief Blocks until a time point, more precisely than \c
+ * std::this_thread::sleep_until alone. Sleeps for the bulk of the wait, then
+ * spins for the remainder, as the OS may oversleep by tens of microseconds.
+ *
+ * @param target The time point to wait until.
+ */
+template<class Clock, class Duration>
+inline void sleep_until_precise(const std::chrono::time_point<Clock, Duration>& target) {
+    static const auto SPIN_TIME = std::chrono::microseconds(200);
+    if (target - Clock::now() > SPIN_TIME) {
+        std::this_thread::sleep_until(target - SPIN_TIME);
+    }
+    while (Clock::now() < target) {
+        std::this_thread::yield();
     }
-    return sstream.str();
 }
 
 
@@ -258,6 +521,24 @@ range<iterator, value_type> make_range(Container& container) {
 }
 
 
+}
+
+
+namespace openconsult {
+
+
+/// @brief The time taken to transfer a byte at the Consult baud rate of 9600
+///     baud, 8N1 (ten bits per byte), in nanoseconds.
+static const uint64_t BYTE_TIME_NS = 10ULL * 1000000000ULL / 9600;
+
+/// @brief The command byte selecting a register to stream.
+static const uint8_t REGISTER_SELECT = 0x5A;
+/// @brief The command byte requesting the ECU start streaming.
+static const uint8_t GO_AHEAD = 0xF0;
+/// @brief The command byte requesting the ECU stop streaming.
+static const uint8_t HALT = 0x30;
+
+
 }
 
 #endif
\ No newline at end of file
@@ -1,7 +1,13 @@
 #ifndef OPENCONSULT_LIB_CONSULT_ENGINE_PARAMETERS
 #define OPENCONSULT_LIB_CONSULT_ENGINE_PARAMETERS
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
 #include <string>
+#include <utility>
 
 namespace openconsult {
 
@@ -46,6 +52,329 @@ enum class EngineParameter {
     DIGITAL_BIT_REGISTER3,
 };
 
+/// @brief The number of distinct \c EngineParameter s.
+constexpr std::size_t ENGINE_PARAMETER_COUNT =
+        static_cast<std::size_t>(EngineParameter::DIGITAL_BIT_REGISTER3) + 1;
+
+/**
+ * @brief Set of values for some or all \c EngineParameter s.
+ *
+ * Values are held in a fixed array indexed by parameter, alongside a bitmask
+ * recording which parameters are present, so no allocations are made and
+ * lookups are a single index. The interface mirrors that of
+ * \c std::map<EngineParameter, double> : iteration visits the present
+ * parameters in enum order, yielding pairs of parameter and value. Iterators
+ * are read-only, so values are modified through \c operator[] or \c at() .
+ */
+class EngineParameterValues {
+public:
+    /// @brief The type yielded by iteration.
+    using value_type = std::pair<EngineParameter, double>;
+
+    /**
+     * @brief Iterator over the present parameters, in enum order.
+     */
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = EngineParameterValues::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        const_iterator(const EngineParameterValues* values, std::size_t index)
+                : values(values)
+                , index(index) {
+            skipAbsent();
+        }
+
+        reference operator*() const {
+            return current;
+        }
+
+        pointer operator->() const {
+            return &current;
+        }
+
+        const_iterator& operator++() {
+            ++index;
+            skipAbsent();
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator prev = *this;
+            ++(*this);
+            return prev;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return index == other.index;
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return index != other.index;
+        }
+
+    private:
+        void skipAbsent() {
+            while (index < ENGINE_PARAMETER_COUNT && !(values->present & (1ull << index))) {
+                ++index;
+            }
+            if (index < ENGINE_PARAMETER_COUNT) {
+                current = value_type(static_cast<EngineParameter>(index), values->values[index]);
+            }
+        }
+
+        const EngineParameterValues* values;
+        std::size_t index;
+        /// @brief A copy of the pair at \c index , so it may be referenced.
+        value_type current;
+    };
+
+    /**
+     * @brief Accesses the value of a parameter, inserting a zero value if it
+     *      is not present.
+     *
+     * @param parameter The \c EngineParameter to access.
+     * @return Reference to the parameter's value.
+     * @throws std::out_of_range if \c parameter is not valid.
+     */
+    double& operator[](EngineParameter parameter) {
+        std::size_t i = checkedIndex(parameter);
+        if (!(present & (1ull << i))) {
+            present |= 1ull << i;
+            values[i] = 0.0;
+        }
+        return values[i];
+    }
+
+    /**
+     * @brief Accesses the value of a present parameter.
+     *
+     * @param parameter The \c EngineParameter to access.
+     * @return Reference to the parameter's value.
+     * @throws std::out_of_range if \c parameter is not present.
+     */
+    double& at(EngineParameter parameter) {
+        return values[presentIndex(parameter)];
+    }
+
+    /// @copydoc at(EngineParameter)
+    const double& at(EngineParameter parameter) const {
+        return values[presentIndex(parameter)];
+    }
+
+    /**
+     * @brief Counts the occurrences of a parameter.
+     *
+     * @param parameter The \c EngineParameter to look-up.
+     * @return 1 if \c parameter is present, 0 otherwise.
+     */
+    std::size_t count(EngineParameter parameter) const {
+        std::size_t i = static_cast<std::size_t>(parameter);
+        return i < ENGINE_PARAMETER_COUNT && (present & (1ull << i)) ? 1 : 0;
+    }
+
+    /**
+     * @brief Finds a parameter.
+     *
+     * @param parameter The \c EngineParameter to look-up.
+     * @return Iterator to the parameter if it is present, \c end() otherwise.
+     */
+    const_iterator find(EngineParameter parameter) const {
+        return count(parameter) ? const_iterator(this, static_cast<std::size_t>(parameter)) : end();
+    }
+
+    /**
+     * @brief The number of present parameters.
+     *
+     * @return The number of parameters with a value.
+     */
+    std::size_t size() const {
+        std::size_t n = 0;
+        for (uint64_t mask = present; mask; mask &= mask - 1) {
+            n++;
+        }
+        return n;
+    }
+
+    /**
+     * @brief Determines if no parameters are present.
+     *
+     * @return \c true if there are no values, \c false otherwise.
+     */
+    bool empty() const {
+        return present == 0;
+    }
+
+    /**
+     * @brief Removes all values.
+     */
+    void clear() {
+        present = 0;
+    }
+
+    const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, ENGINE_PARAMETER_COUNT);
+    }
+
+    /**
+     * @brief Compares two sets of values, as \c std::map does.
+     *
+     * @return \c true if the same parameters are present, with equal values.
+     */
+    bool operator==(const EngineParameterValues& other) const {
+        if (present != other.present) {
+            return false;
+        }
+        for (std::size_t i = 0; i < ENGINE_PARAMETER_COUNT; i++) {
+            if ((present & (1ull << i)) && values[i] != other.values[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool operator!=(const EngineParameterValues& other) const {
+        return !(*this == other);
+    }
+
+private:
+    static_assert(ENGINE_PARAMETER_COUNT <= 64, "Presence mask is too small");
+
+    static std::size_t checkedIndex(EngineParameter parameter) {
+        std::size_t i = static_cast<std::size_t>(parameter);
+        if (i >= ENGINE_PARAMETER_COUNT) {
+            throw std::out_of_range("Unknown engine parameter");
+        }
+        return i;
+    }
+
+    std::size_t presentIndex(EngineParameter parameter) const {
+        if (!count(parameter)) {
+            throw std::out_of_range("Engine parameter not present");
+        }
+        return static_cast<std::size_t>(parameter);
+    }
+
+    std::array<double, ENGINE_PARAMETER_COUNT> values {};
+    /// @brief Bit \c n is set if parameter \c n has a value.
+    uint64_t present = 0;
+};
+
+/**
+ * @brief Describes how the value of an \c EngineParameter is encoded in the
+ *      ECU's response.
+ *
+ * The response holds an unsigned big-endian integer of \c width bytes, from
+ * which the value is calculated as ((raw * multiplier) * scale) + offset .
+ * Keeping the multiplier and scale separate, rather than folding them into a
+ * single factor, keeps the decoded values identical to the ECU documentation's
+ * formulas.
+ *
+ * Encodings are available at compile time, which typed streams use to decode
+ * frames without any look-ups.
+ */
+struct EngineParameterEncoding {
+    /// @brief The number of bytes in the response, either 1 or 2.
+    std::size_t width;
+    double multiplier;
+    double scale;
+    double offset;
+
+    /**
+     * @brief Decodes a parameter's value from its raw bytes.
+     *
+     * @param data Pointer to the \c width bytes to decode.
+     * @return Parameter value, in the unit described by the parameter.
+     */
+    constexpr double decode(const uint8_t* data) const {
+        return decode(width == 2 ? (data[0] << 8) | data[1] : data[0]);
+    }
+
+    /**
+     * @brief Decodes a parameter's value from its raw integer.
+     *
+     * @param raw The big-endian integer held by the response.
+     * @return Parameter value, in the unit described by the parameter.
+     */
+    constexpr double decode(uint32_t raw) const {
+        return ((raw * multiplier) * scale) + offset;
+    }
+};
+
+/**
+ * @brief Retrieves the encoding of a given \c EngineParameter in the ECU's
+ *      response.
+ *
+ * @param parameter The \c EngineParameter to look-up.
+ * @return The parameter's encoding.
+ * @throws std::invalid_argument if \c parameter is not valid.
+ */
+constexpr EngineParameterEncoding engineParameterEncoding(EngineParameter parameter) {
+    switch (parameter) {
+        case EngineParameter::ENGINE_RPM:               // RPM
+            return {2, 12.5, 1.0, 0.0};
+        case EngineParameter::LH_MAF_VOLTAGE:           // V
+        case EngineParameter::RH_MAF_VOLTAGE:
+            return {2, 5.0, 0.001, 0.0};
+        case EngineParameter::COOLANT_TEMPERATURE:      // deg C
+        case EngineParameter::FUEL_TEMPERATURE:
+        case EngineParameter::INTAKE_AIR_TEMPERATURE:
+        case EngineParameter::TANK_FUEL_TEMPERATURE:
+            return {1, 1.0, 1.0, -50.0};
+        case EngineParameter::LH_O2_SENSOR_VOLTAGE:     // V
+        case EngineParameter::RH_O2_SENSOR_VOLTAGE:
+            return {1, 10.0, 0.001, 0.0};
+        case EngineParameter::VEHICLE_SPEED:            // KM/H
+            return {1, 2.0, 1.0, 0.0};
+        case EngineParameter::BATTERY_VOLTAGE:          // V
+            return {1, 80.0, 0.001, 0.0};
+        case EngineParameter::THROTTLE_POSITION:        // V
+        case EngineParameter::EXHAUST_GAS_TEMPERATURE:
+            return {1, 20.0, 0.001, 0.0};
+        case EngineParameter::LH_INJECTION_TIMING:      // S
+        case EngineParameter::RH_INJECTION_TIMING:
+            return {2, 0.01, 0.001, 0.0};
+        case EngineParameter::IGNITION_TIMING:          // deg BTDC
+            return {1, -1.0, 1.0, 110.0};
+        case EngineParameter::AAC_VALVE:                // %
+            return {1, 0.5, 1.0, 0.0};
+        case EngineParameter::LH_AIR_FUEL_ALPHA:        // %
+        case EngineParameter::RH_AIR_FUEL_ALPHA:
+        case EngineParameter::LH_AIR_FUEL_ALPHA_SELF_LEARN:
+        case EngineParameter::RH_AIR_FUEL_ALPHA_SELF_LEARN:
+        case EngineParameter::WASTE_GATE_SOLENOID:
+            return {1, 1.0, 1.0, 0.0};
+        case EngineParameter::MR_FC_MNT:                // RICH/LEAN
+            return {1, 1.0, 1.0, 0.0};
+        case EngineParameter::TURBO_BOOST_SENSOR:       // V
+        case EngineParameter::FPCM_DR_VOLTAGE:
+        case EngineParameter::FUEL_GAUGE_VOLTAGE:
+            // TODO: All these voltages have unknown scaling. It's likely x20
+            // based on the other single-byte mV register scalings, but this is
+            // a guess.
+            return {1, 20.0, 0.001, 0.0};
+        case EngineParameter::ENGINE_MOUNT:             // ??
+        case EngineParameter::POSITION_COUNTER:
+        case EngineParameter::PURGE_CONTROL_VALVE:
+            // TODO: All these parameters track an unknown quantity.
+            return {1, 1.0, 1.0, 0.0};
+        case EngineParameter::DIGITAL_BIT_REGISTER1:    // bit regs
+        case EngineParameter::DIGITAL_BIT_REGISTER2:
+        case EngineParameter::DIGITAL_BIT_REGISTER3:
+            // TODO: The bit registers really need breaking out separately.
+            return {1, 1.0, 1.0, 0.0};
+        default:
+            throw std::invalid_argument("Unknown engine parameter");
+    };
+}
+
 /**
  * @brief Retrieves a string identifier for an \c EngineParameter .
  *
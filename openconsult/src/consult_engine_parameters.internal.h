@@ -4,7 +4,9 @@
 #include "common.h"
 #include "consult_engine_parameters.h"
 
+#include <array>
 #include <cstdint>
+#include <stdexcept>
 #include <vector>
 
 namespace openconsult {
@@ -21,6 +23,55 @@ namespace openconsult {
  */
 std::vector<uint8_t> engineParameterCommand(EngineParameter parameter);
 
+/**
+ * @brief Precomputed lookup tables decoding a single \c EngineParameter .
+ *
+ * Single-byte parameters are decoded by one table read. Two-byte parameters
+ * sum the contributions of their MSB and LSB from two tables, then apply the
+ * remaining scaling. Where the encoding's multiplier can be folded into the
+ * tables without changing any decoded value it is; otherwise the tables hold
+ * the raw integer contributions and the multiplier is applied after summing.
+ * Either way decoded values are bit-identical to
+ * \c EngineParameterEncoding::decode .
+ */
+struct EngineParameterDecoder {
+    /// @brief The number of bytes in the response, either 1 or 2.
+    std::size_t width;
+    /// @brief For single-byte parameters, the value of each byte. For two-byte
+    ///     parameters, the contribution of each MSB.
+    std::array<double, 256> high;
+    /// @brief For two-byte parameters, the contribution of each LSB.
+    std::array<double, 256> low;
+    /// @brief Scaling applied to the summed contributions of two-byte
+    ///     parameters.
+    double multiplier;
+    double scale;
+    double offset;
+
+    /**
+     * @brief Decodes a parameter's value from its raw bytes.
+     *
+     * @param data Pointer to the \c width bytes to decode.
+     * @return Parameter value, in the unit described by the parameter.
+     */
+    double decode(const uint8_t* data) const {
+        if (width == 1) {
+            return high[data[0]];
+        }
+        return (((high[data[0]] + low[data[1]]) * multiplier) * scale) + offset;
+    }
+};
+
+/**
+ * @brief Retrieves the lookup tables decoding a given \c EngineParameter . The
+ *      tables for all parameters are built on first use and shared.
+ *
+ * @param parameter The \c EngineParameter to look-up.
+ * @return The parameter's decoder.
+ * @throws std::invalid_argument if \c parameter is not valid.
+ */
+const EngineParameterDecoder& engineParameterDecoder(EngineParameter parameter);
+
 /**
  * @brief Decodes a byte sequence, as returned when querying the ECU, into a
  *      real value for a particular \c EngineParameter . Some parameters may
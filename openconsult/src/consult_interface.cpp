@@ -1,8 +1,19 @@
 #include "consult_interface.h"
+#include "consult_interface.internal.h"
 #include "common.h"
 #include "consult_engine_parameters.internal.h"
 #include "consult_fault_codes.internal.h"
+#include "frame_parser.h"
+#include "frame_ring.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <mutex>
 #include <sstream>
+#include <thread>
 
 namespace openconsult {
 
@@ -111,14 +122,18 @@ std::string FaultCodes::toJSON() const {
 
 EngineParameters::EngineParameters(const std::vector<EngineParameter>& params,
                                    const std::vector<uint8_t>& frame) {
-    if (frame.size() < params.size()) {
-        throw std::invalid_argument("Invalid engine parameters response");
-    }
-    auto range = cmn::make_range(frame);
+    // Decode straight from the shared decoders, rather than building a plan
+    // for a single frame.
+    std::size_t offset = 0;
     for (auto param : params) {
-        parameters[param] = engineParameterDecode(param, range);
+        const EngineParameterDecoder& decoder = engineParameterDecoder(param);
+        if (offset + decoder.width > frame.size()) {
+            throw std::invalid_argument("Invalid engine parameters response");
+        }
+        parameters[param] = decoder.decode(frame.data() + offset);
+        offset += decoder.width;
     }
-    if (!range.empty()) {
+    if (offset != frame.size()) {
         throw std::invalid_argument("Invalid engine parameters response");
     }
 }
@@ -139,14 +154,104 @@ std::string EngineParameters::toJSON() const {
 
 
 
+//
+// StreamPlan
+//
+
+void calculateExpectedResponse(const std::vector<uint8_t>& request,
+                               std::vector<uint8_t>& response,
+                               int command_width, int data_width) {
+    if (command_width < 0) {
+        command_width = request.size();
+    }
+    if (data_width < 0) {
+        data_width = request.size() - command_width;
+    }
+    bool is_command_byte = command_width > 0;
+    int parsed_command_width = 0;
+    int parsed_data_width = 0;
+    response = request;
+    for (uint8_t& byte : response) {
+        if (is_command_byte) {
+            byte = ~byte;
+            if (++parsed_command_width >= command_width) {
+                is_command_byte = data_width == 0;
+                parsed_command_width = 0;
+            }
+        } else {
+            if (++parsed_data_width >= data_width) {
+                is_command_byte = command_width > 0;
+                parsed_data_width = 0;
+            }
+        }
+    }
+}
+
+
+
+struct StreamPlan::impl {
+    /**
+     * @brief Where a single parameter lies within a response frame, and how
+     *      it is encoded.
+     */
+    struct Field {
+        EngineParameter parameter;
+        std::size_t offset;
+        const EngineParameterDecoder* decoder;
+    };
+
+    std::vector<EngineParameter> parameters;
+    std::vector<uint8_t> request;
+    std::vector<uint8_t> expected_response;
+    std::vector<Field> fields;
+    std::size_t frame_size;
+};
+
+StreamPlan::StreamPlan(const std::vector<EngineParameter>& parameters) {
+    std::shared_ptr<impl> plan = std::make_shared<impl>();
+    plan->parameters = parameters;
+    plan->frame_size = 0;
+    for (auto parameter : parameters) {
+        auto command = engineParameterCommand(parameter);
+        plan->request.insert(plan->request.end(), command.begin(), command.end());
+        const EngineParameterDecoder& decoder = engineParameterDecoder(parameter);
+        plan->fields.push_back({parameter, plan->frame_size, &decoder});
+        plan->frame_size += decoder.width;
+    }
+    calculateExpectedResponse(plan->request, plan->expected_response, 1, 1);
+    pimpl = std::move(plan);
+}
+
+const std::vector<EngineParameter>& StreamPlan::parameters() const {
+    return pimpl->parameters;
+}
+
+std::size_t StreamPlan::frameSize() const {
+    return pimpl->frame_size;
+}
+
+void StreamPlan::decode(const uint8_t* frame, std::size_t size, EngineParameters& result) const {
+    if (size != pimpl->frame_size) {
+        throw std::invalid_argument("Invalid engine parameters response");
+    }
+    result.parameters.clear();
+    for (const auto& field : pimpl->fields) {
+        result.parameters[field.parameter] = field.decoder->decode(frame + field.offset);
+    }
+}
+
+
+
 //
 // ConsultInterface::impl
 //
 
 struct ConsultInterface::impl {
-    impl(std::unique_ptr<ByteInterface> _byte_interface)
-            : byte_interface(std::move(_byte_interface)) {
+    impl(std::unique_ptr<ByteInterface> _byte_interface, std::chrono::milliseconds _timeout)
+            : byte_interface(std::move(_byte_interface))
+            , timeout(_timeout) {
         // Connect to the underlying Consult device.
+        ScopedDeadline deadline(*byte_interface, timeout);
         byte_interface->write({{0xFF, 0xFF, 0xEF}});
         while (byte_interface->read(1)[0] != 0x10) {
             // Spin.
@@ -159,86 +264,81 @@ struct ConsultInterface::impl {
 
     // Movable.
     impl(impl&& other)
-            : byte_interface(std::move(other.byte_interface)) {
+            : byte_interface(std::move(other.byte_interface))
+            , timeout(other.timeout) {
     }
     impl& operator=(impl&& other) {
         byte_interface = std::move(other.byte_interface);
+        timeout = other.timeout;
         return *this;
     }
 
-    std::vector<uint8_t> calculateExpectedResponse(const std::vector<uint8_t>& request,
-                                                   int command_width = 1, int data_width = -1) {
-        if (command_width < 0) {
-            command_width = request.size();
-        }
-        if (data_width < 0) {
-            data_width = request.size() - command_width;
-        }
-        bool is_command_byte = command_width > 0;
-        int parsed_command_width = 0;
-        int parsed_data_width = 0;
-        std::vector<uint8_t> response = request;
-        for (uint8_t& byte : response) {
-            if (is_command_byte) {
-                byte = ~byte;
-                if (++parsed_command_width >= command_width) {
-                    is_command_byte = data_width == 0;
-                    parsed_command_width = 0;
-                }
-            } else {
-                if (++parsed_data_width >= data_width) {
-                    is_command_byte = command_width > 0;
-                    parsed_data_width = 0;
-                }
-            }
-        }
-        return response;
+    void execute(const std::vector<uint8_t>& request,
+                 int command_width = 1, int data_width = -1) {
+        calculateExpectedResponse(request, expected_buffer, command_width, data_width);
+        execute(request, expected_buffer);
     }
 
-    void execute(const std::vector<uint8_t>& request,
-                 int command_width = 1, int data_width = -1, bool verify = true) {
+    void execute(const std::vector<uint8_t>& request, const std::vector<uint8_t>& expected_response) {
         // Send the request and receive the response.
-        if (verify) {
-            auto expected_response = calculateExpectedResponse(request, command_width, data_width);
-            byte_interface->write(request);
-            auto response = byte_interface->read(expected_response.size());
-            if (response != expected_response) {
-                throw std::runtime_error("Unexpected response received");
-            }
-        } else {
-            byte_interface->write(request);
-            byte_interface->read(request.size());
+        byte_interface->write(request.data(), request.size());
+        response_buffer.resize(request.size());
+        byte_interface->readInto(response_buffer.data(), response_buffer.size());
+        if (std::memcmp(response_buffer.data(), expected_response.data(), response_buffer.size()) != 0) {
+            throw std::runtime_error("Unexpected response received");
         }
         // Send go-ahead and return a frame reader.
-        std::vector<uint8_t> go_ahead{0xF0};
-        byte_interface->write(go_ahead);
+        byte_interface->write(&GO_AHEAD, 1);
     }
 
-    std::vector<uint8_t> readFrame() {
-        auto response = byte_interface->read(2);
-        if (response[0] != 0xFF) {
-            throw std::runtime_error("Frame header did not start with start byte");
-        }
-        std::size_t data_bytes = response[1]; // Data bytes to follow.
-        return byte_interface->read(data_bytes);
+    const std::vector<uint8_t>& readFrame() {
+        // Read exactly as much as the parser needs, so nothing beyond the
+        // frame is consumed from the device.
+        do {
+            std::size_t size = parser.needed();
+            read_buffer.resize(size);
+            byte_interface->readInto(read_buffer.data(), size);
+            parser.push(read_buffer.data(), size);
+        } while (!parser.hasFrame());
+        // The interface may have received the frame well before it was read,
+        // if it reads ahead.
+        frame_timestamp = byte_interface->lastReadTime();
+        return parser.frame();
     }
 
     void halt() {
-        byte_interface->write({0x30});
-        auto response = byte_interface->read(1);
-        while (response[0] != 0xCF) {
-            // There's another frame coming - read it then look for another
-            // stop-ack afterwards.
-            if (response[0] != 0xFF) {
-                throw std::runtime_error("Frame header did not start with start byte");
+        byte_interface->write(&HALT, 1);
+        // Frames already in flight are read and discarded until the stop is
+        // acknowledged between frames.
+        while (true) {
+            if (parser.atBoundary()) {
+                uint8_t response;
+                byte_interface->readInto(&response, 1);
+                if (response == 0xCF) {
+                    return;
+                }
+                parser.push(&response, 1);
+            } else {
+                std::size_t size = parser.needed();
+                read_buffer.resize(size);
+                byte_interface->readInto(read_buffer.data(), size);
+                parser.push(read_buffer.data(), size);
             }
-            std::size_t data_bytes = byte_interface->read(1)[0];
-            byte_interface->read(data_bytes);
-            response = byte_interface->read(1);
         }
     }
 
     std::unique_ptr<ByteInterface> byte_interface;
+    std::chrono::milliseconds timeout;
+    /// @brief Parses the frames of the current transaction.
+    FrameParser parser;
+    /// @brief When the last byte of the most recent frame was read.
+    ByteInterface::clock::time_point frame_timestamp;
+    /// @brief Scratch buffers, reused between transactions to avoid
+    ///     allocating on every frame.
+    std::vector<uint8_t> read_buffer;
+    std::vector<uint8_t> result_buffer;
+    std::vector<uint8_t> response_buffer;
+    std::vector<uint8_t> expected_buffer;
 };
 
 
@@ -247,34 +347,353 @@ struct ConsultInterface::impl {
 // EngineParametersStream
 //
 
+/// @brief The largest frame the Consult protocol can describe, in bytes.
+static constexpr std::size_t MAX_FRAME_SIZE = 0xFF;
+
+/// @brief The size of the capture time and sequence number a background
+///     stream stores ahead of each frame in its ring.
+static constexpr std::size_t FRAME_STAMP_SIZE = 2 * sizeof(uint64_t);
+
+/**
+ * @brief Records when each frame of a stream was read, numbering them and
+ *      accumulating \c StreamStatistics . Frames may be recorded on one thread
+ *      while statistics are taken on another.
+ */
+class ConsultResponseStream<EngineParameters>::Monitor {
+public:
+    Monitor()
+            : frames(0)
+            , mean_interval_ns(0)
+            , interval_m2(0)
+            , interval_histogram{} {
+    }
+
+    /**
+     * @brief Records a frame.
+     *
+     * @param timestamp When the frame was read.
+     * @return The frame's sequence number.
+     */
+    uint64_t record(ByteInterface::clock::time_point timestamp) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (frames == 0) {
+            first_timestamp = timestamp;
+        } else {
+            auto interval = std::chrono::duration_cast<std::chrono::nanoseconds>(timestamp - last_timestamp);
+            // Welford's method, so the variance is accumulated stably.
+            double interval_ns = static_cast<double>(interval.count());
+            double delta = interval_ns - mean_interval_ns;
+            mean_interval_ns += delta / static_cast<double>(frames);
+            interval_m2 += delta * (interval_ns - mean_interval_ns);
+            interval_histogram[intervalBucket(interval)]++;
+        }
+        last_timestamp = timestamp;
+        return frames++;
+    }
+
+    StreamStatistics snapshot() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        StreamStatistics statistics;
+        statistics.frames = frames;
+        if (frames > 1) {
+            std::chrono::duration<double> elapsed = last_timestamp - first_timestamp;
+            if (elapsed.count() > 0) {
+                statistics.frame_rate = static_cast<double>(frames - 1) / elapsed.count();
+            }
+            statistics.mean_interval = std::chrono::nanoseconds(static_cast<int64_t>(mean_interval_ns));
+            statistics.jitter = std::chrono::nanoseconds(
+                static_cast<int64_t>(std::sqrt(interval_m2 / static_cast<double>(frames - 1))));
+        }
+        statistics.interval_histogram = interval_histogram;
+        return statistics;
+    }
+
+private:
+    static std::size_t intervalBucket(std::chrono::nanoseconds interval) {
+        uint64_t us = static_cast<uint64_t>(std::max<int64_t>(interval.count() / 1000, 1));
+        std::size_t bucket = 0;
+        while (us >>= 1) {
+            bucket++;
+        }
+        return std::min(bucket, STREAM_INTERVAL_BUCKETS - 1);
+    }
+
+    /// @brief Guards all of the below.
+    mutable std::mutex mutex;
+    uint64_t frames;
+    ByteInterface::clock::time_point first_timestamp;
+    ByteInterface::clock::time_point last_timestamp;
+    double mean_interval_ns;
+    /// @brief The sum of squared deviations from the mean interval.
+    double interval_m2;
+    std::array<uint64_t, STREAM_INTERVAL_BUCKETS> interval_histogram;
+};
+
+/**
+ * @brief A stream being read from the device on a dedicated thread. The thread
+ *      pushes raw frames into a lock-free ring, each preceded by its capture
+ *      time and sequence number, from which the consumer pops and decodes
+ *      them.
+ */
+struct ConsultResponseStream<EngineParameters>::Acquisition {
+    Acquisition(ConsultInterface::impl* pimpl, Monitor* monitor, const StreamOptions& options)
+            : ring(options.buffer_frames, FRAME_STAMP_SIZE + MAX_FRAME_SIZE)
+            , overflow_policy(options.overflow_policy)
+            , push_buffer(FRAME_STAMP_SIZE + MAX_FRAME_SIZE)
+            , pop_buffer(FRAME_STAMP_SIZE + MAX_FRAME_SIZE)
+            , frame_buffer(MAX_FRAME_SIZE)
+            , sequence(0)
+            , dropped_frames(0)
+            , resyncs(0)
+            , stopping(false)
+            , finished(false)
+            , thread(&Acquisition::run, this, pimpl, monitor) {
+    }
+
+    // Non-copyable and non-movable, as the thread refers to this object.
+    Acquisition(const Acquisition&) = delete;
+    Acquisition& operator=(const Acquisition&) = delete;
+
+    ~Acquisition() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        space_available.notify_all();
+        // The thread will stop once it has read the frame currently in flight.
+        thread.join();
+    }
+
+    void run(ConsultInterface::impl* pimpl, Monitor* monitor) {
+        try {
+            while (!stopping) {
+                ScopedDeadline deadline(*pimpl->byte_interface, pimpl->timeout);
+                const std::vector<uint8_t>& frame = pimpl->readFrame();
+                uint64_t stamp[2] = {static_cast<uint64_t>(pimpl->frame_timestamp.time_since_epoch().count()),
+                                     monitor->record(pimpl->frame_timestamp)};
+                resyncs = pimpl->parser.resyncs();
+                std::memcpy(push_buffer.data(), stamp, FRAME_STAMP_SIZE);
+                std::memcpy(push_buffer.data() + FRAME_STAMP_SIZE, frame.data(), frame.size());
+                push(push_buffer.data(), FRAME_STAMP_SIZE + frame.size());
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished = true;
+        }
+        frame_available.notify_all();
+    }
+
+    void push(const uint8_t* frame, std::size_t size) {
+        switch (overflow_policy) {
+            case OverflowPolicy::DROP_OLDEST:
+                if (ring.pushOverwrite(frame, size)) {
+                    dropped_frames++;
+                }
+                break;
+            case OverflowPolicy::DROP_NEWEST:
+                if (!ring.tryPush(frame, size)) {
+                    dropped_frames++;
+                    return;
+                }
+                break;
+            case OverflowPolicy::BLOCK:
+                while (!ring.tryPush(frame, size)) {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    space_available.wait(lock, [this]() { return stopping || !ring.full(); });
+                    if (stopping) {
+                        return;
+                    }
+                }
+                break;
+        }
+        // The lock is only taken to avoid a lost wake-up; the ring itself is
+        // lock-free.
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+        }
+        frame_available.notify_one();
+    }
+
+    bool tryPop() {
+        std::size_t size = 0;
+        if (!ring.tryPop(pop_buffer.data(), size)) {
+            return false;
+        }
+        uint64_t stamp[2];
+        std::memcpy(stamp, pop_buffer.data(), FRAME_STAMP_SIZE);
+        timestamp = ByteInterface::clock::time_point(
+            ByteInterface::clock::duration(static_cast<ByteInterface::clock::rep>(stamp[0])));
+        sequence = stamp[1];
+        frame_buffer.assign(pop_buffer.begin() + FRAME_STAMP_SIZE, pop_buffer.begin() + size);
+        if (overflow_policy == OverflowPolicy::BLOCK) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+            }
+            space_available.notify_one();
+        }
+        return true;
+    }
+
+    bool tryPopOrRethrow() {
+        if (tryPop()) {
+            return true;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        // Check again in case the thread pushed its last frame and then failed.
+        if (finished && ring.empty()) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            throw std::runtime_error("Stream is no longer being read");
+        }
+        return false;
+    }
+
+    void waitForFrame() {
+        std::unique_lock<std::mutex> lock(mutex);
+        frame_available.wait(lock, [this]() { return finished || !ring.empty(); });
+    }
+
+    FrameRing ring;
+    OverflowPolicy overflow_policy;
+    /// @brief Producer-side buffer for the stamped frame being pushed.
+    std::vector<uint8_t> push_buffer;
+    /// @brief Consumer-side buffers for the most recently popped stamped
+    ///     frame, and for the frame itself.
+    std::vector<uint8_t> pop_buffer;
+    std::vector<uint8_t> frame_buffer;
+    /// @brief The capture time and sequence number of the most recently
+    ///     popped frame.
+    ByteInterface::clock::time_point timestamp;
+    uint64_t sequence;
+    std::atomic<uint64_t> dropped_frames;
+    /// @brief The parser's resync count, published by the thread after each
+    ///     frame.
+    std::atomic<uint64_t> resyncs;
+    /// @brief Guards \c stopping and \c finished , and is used to sleep on
+    ///     the condition variables.
+    std::mutex mutex;
+    std::condition_variable frame_available;
+    std::condition_variable space_available;
+    std::atomic<bool> stopping;
+    bool finished;
+    std::exception_ptr error;
+    std::thread thread;
+};
+
 ConsultResponseStream<EngineParameters>::ConsultResponseStream(ConsultInterface::impl* _pimpl,
-        const std::vector<EngineParameter>& _parameters)
+        const StreamPlan& _plan, const StreamOptions& options)
         : pimpl(_pimpl)
-        , parameters(_parameters) {
+        , plan(_plan)
+        , monitor(new Monitor)
+        , frame_sequence(0) {
+    if (options.background) {
+        acquisition.reset(new Acquisition(pimpl, monitor.get(), options));
+    }
 }
 
 ConsultResponseStream<EngineParameters>::ConsultResponseStream(ConsultResponseStream<EngineParameters>&& other)
         : pimpl(other.pimpl)
-        , parameters(std::move(other.parameters)) {
+        , plan(other.plan)
+        , monitor(std::move(other.monitor))
+        , acquisition(std::move(other.acquisition))
+        , frame_timestamp(other.frame_timestamp)
+        , frame_sequence(other.frame_sequence) {
     other.pimpl = nullptr;
 }
 
 ConsultResponseStream<EngineParameters>& ConsultResponseStream<EngineParameters>::operator=(ConsultResponseStream<EngineParameters>&& other) {
     pimpl = other.pimpl;
-    parameters = std::move(other.parameters);
+    plan = other.plan;
+    monitor = std::move(other.monitor);
+    acquisition = std::move(other.acquisition);
+    frame_timestamp = other.frame_timestamp;
+    frame_sequence = other.frame_sequence;
     other.pimpl = nullptr;
     return *this;
 }
 
 ConsultResponseStream<EngineParameters>::~ConsultResponseStream() {
+    // Stop the background thread, if any, before halting on this thread.
+    acquisition.reset();
     if (pimpl) {
-        pimpl->halt();
+        try {
+            ScopedDeadline deadline(*pimpl->byte_interface, pimpl->timeout);
+            pimpl->halt();
+        } catch (const timeout_error&) {
+            // The device has gone quiet, so there is nothing left to halt.
+        }
     }
 }
 
 EngineParameters ConsultResponseStream<EngineParameters>::getFrame() {
-    auto frame = pimpl->readFrame();
-    return EngineParameters(parameters, frame);
+    const std::vector<uint8_t>& frame = getRawFrame();
+    EngineParameters result;
+    plan.decode(frame.data(), frame.size(), result);
+    result.timestamp = frame_timestamp;
+    result.sequence = frame_sequence;
+    return result;
+}
+
+bool ConsultResponseStream<EngineParameters>::tryGetFrame(EngineParameters& frame) {
+    const std::vector<uint8_t>* raw_frame = tryGetRawFrame();
+    if (!raw_frame) {
+        return false;
+    }
+    plan.decode(raw_frame->data(), raw_frame->size(), frame);
+    frame.timestamp = frame_timestamp;
+    frame.sequence = frame_sequence;
+    return true;
+}
+
+const std::vector<uint8_t>& ConsultResponseStream<EngineParameters>::getRawFrame() {
+    if (acquisition) {
+        while (!acquisition->tryPopOrRethrow()) {
+            acquisition->waitForFrame();
+        }
+        frame_timestamp = acquisition->timestamp;
+        frame_sequence = acquisition->sequence;
+        return acquisition->frame_buffer;
+    }
+    ScopedDeadline deadline(*pimpl->byte_interface, pimpl->timeout);
+    const std::vector<uint8_t>& frame = pimpl->readFrame();
+    frame_timestamp = pimpl->frame_timestamp;
+    frame_sequence = monitor->record(frame_timestamp);
+    return frame;
+}
+
+const std::vector<uint8_t>* ConsultResponseStream<EngineParameters>::tryGetRawFrame() {
+    if (!acquisition) {
+        throw std::logic_error("tryGetFrame() requires a background stream");
+    }
+    if (!acquisition->tryPopOrRethrow()) {
+        return nullptr;
+    }
+    frame_timestamp = acquisition->timestamp;
+    frame_sequence = acquisition->sequence;
+    return &acquisition->frame_buffer;
+}
+
+uint64_t ConsultResponseStream<EngineParameters>::droppedFrames() const {
+    return acquisition ? acquisition->dropped_frames.load() : 0;
+}
+
+uint64_t ConsultResponseStream<EngineParameters>::resyncs() const {
+    return acquisition ? acquisition->resyncs.load() : pimpl->parser.resyncs();
+}
+
+StreamStatistics ConsultResponseStream<EngineParameters>::statistics() const {
+    StreamStatistics statistics = monitor->snapshot();
+    statistics.dropped_frames = droppedFrames();
+    statistics.resyncs = resyncs();
+    return statistics;
+}
+
+std::chrono::milliseconds ConsultResponseStream<EngineParameters>::timeout() const {
+    return pimpl ? pimpl->timeout : std::chrono::milliseconds(0);
 }
 
 
@@ -283,8 +702,9 @@ EngineParameters ConsultResponseStream<EngineParameters>::getFrame() {
 // ConsultInterface
 //
 
-ConsultInterface::ConsultInterface(std::unique_ptr<ByteInterface> byte_interface)
-        : pimpl(new impl(std::move(byte_interface))) {
+ConsultInterface::ConsultInterface(std::unique_ptr<ByteInterface> byte_interface,
+                                   std::chrono::milliseconds timeout)
+        : pimpl(new impl(std::move(byte_interface), timeout)) {
 }
 
 ConsultInterface::ConsultInterface(ConsultInterface&& other)
@@ -300,42 +720,69 @@ ConsultInterface::~ConsultInterface() {
 }
 
 ECUMetadata ConsultInterface::readECUMetadata() {
+    ScopedDeadline deadline(*pimpl->byte_interface, pimpl->timeout);
     std::vector<uint8_t> request{0xD0};
     pimpl->execute(request);
+    pimpl->parser.reset();
+    // Copy the frame, as halting reuses the frame buffer.
     auto frame = pimpl->readFrame();
     pimpl->halt();
     return ECUMetadata(frame);
 }
 
 FaultCodes ConsultInterface::readFaultCodes() {
+    ScopedDeadline deadline(*pimpl->byte_interface, pimpl->timeout);
     std::vector<uint8_t> request{0xD1};
     pimpl->execute(request);
+    pimpl->parser.reset();
+    // Copy the frame, as halting reuses the frame buffer.
     auto frame = pimpl->readFrame();
     pimpl->halt();
     return FaultCodes(frame);
 }
 
 EngineParameters ConsultInterface::readEngineParameters(const std::vector<EngineParameter>& params) {
-    std::vector<uint8_t> request;
-    for (auto param : params) {
-        auto command = engineParameterCommand(param);
-        request.insert(request.end(), command.begin(), command.end());
-    }
-    pimpl->execute(request, 1, 1);
-    auto frame = pimpl->readFrame();
+    return readEngineParameters(StreamPlan(params));
+}
+
+EngineParameters ConsultInterface::readEngineParameters(const StreamPlan& plan) {
+    const auto& frame = readEngineParametersFrame(plan);
+    EngineParameters result;
+    plan.decode(frame.data(), frame.size(), result);
+    result.timestamp = pimpl->frame_timestamp;
+    return result;
+}
+
+const std::vector<uint8_t>& ConsultInterface::readEngineParametersFrame(const StreamPlan& plan) {
+    ScopedDeadline deadline(*pimpl->byte_interface, pimpl->timeout);
+    pimpl->execute(plan.pimpl->request, plan.pimpl->expected_response);
+    pimpl->parser.reset(plan.frameSize());
+    // Copy the frame, as halting reuses the frame buffer.
+    pimpl->result_buffer = pimpl->readFrame();
     pimpl->halt();
-    return EngineParameters(params, frame);
+    return pimpl->result_buffer;
 }
 
-EngineParametersStream ConsultInterface::streamEngineParameters(const std::vector<EngineParameter>& params) {
-    std::vector<uint8_t> request;
-    for (auto param : params) {
-        auto command = engineParameterCommand(param);
-        request.insert(request.end(), command.begin(), command.end());
-    }
-    pimpl->execute(request, 1, 1);
-    return EngineParametersStream(pimpl.get(), params);
+ByteInterface::clock::time_point ConsultInterface::frameTimestamp() const {
+    return pimpl->frame_timestamp;
 }
 
+EngineParametersStream ConsultInterface::streamEngineParameters(const std::vector<EngineParameter>& params,
+                                                                const StreamOptions& options) {
+    return streamEngineParameters(StreamPlan(params), options);
+}
+
+EngineParametersStream ConsultInterface::streamEngineParameters(const StreamPlan& plan,
+                                                                const StreamOptions& options) {
+    if (options.background && pimpl->timeout.count() == 0) {
+        // The reading thread could otherwise block forever on a quiet device,
+        // so the stream could never be stopped.
+        throw std::invalid_argument("Background streams require a timeout");
+    }
+    ScopedDeadline deadline(*pimpl->byte_interface, pimpl->timeout);
+    pimpl->execute(plan.pimpl->request, plan.pimpl->expected_response);
+    pimpl->parser.reset(plan.frameSize());
+    return EngineParametersStream(pimpl.get(), plan, options);
+}
 
 }
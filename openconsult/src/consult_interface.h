@@ -5,10 +5,13 @@
 #include "consult_engine_parameters.h"
 #include "consult_fault_codes.h"
 
+#include <array>
+#include <chrono>
 #include <cstdint>
-#include <map>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace openconsult {
@@ -95,13 +98,71 @@ struct FaultCodes : public ConsultResponse {
  * @brief A response holding the current value of one or more engine parameters.
  */
 struct EngineParameters : public ConsultResponse {
+    EngineParameters() = default;
     EngineParameters(const std::vector<EngineParameter>& parameters,
                      const std::vector<uint8_t>& frame);
 
     std::string toJSON() const override;
 
-    /// @brief Map of \c EngineParameter to their current value.
-    std::map<EngineParameter, double> parameters;
+    /// @brief The current value of each \c EngineParameter in the response.
+    EngineParameterValues parameters;
+    /// @brief When the frame was captured: when its last byte was received,
+    ///     as reported by \c ByteInterface::lastReadTime() .
+    ByteInterface::clock::time_point timestamp;
+    /// @brief The frame's position in its stream, counting from zero. Frames
+    ///     a background stream discards leave gaps. Zero for single reads.
+    uint64_t sequence = 0;
+};
+
+/**
+ * @brief A pre-compiled request for one or more engine parameters.
+ *
+ * Building a plan works out, once, the request to send to the ECU, the echo
+ * it is expected to reply with, and where each parameter lies within the
+ * response frames. Reusing a plan across many reads or streams of the same
+ * parameters then avoids repeating that work. Plans are immutable and cheap
+ * to copy.
+ */
+class StreamPlan {
+public:
+    /**
+     * @brief Construct a new \c StreamPlan .
+     *
+     * @param parameters The \c EngineParameter s to request, in the order they
+     *      will appear in each frame.
+     * @throws std::invalid_argument if any parameter is not valid.
+     */
+    StreamPlan(const std::vector<EngineParameter>& parameters);
+
+    /**
+     * @brief The parameters requested by this plan.
+     *
+     * @return The \c EngineParameter s, in frame order.
+     */
+    const std::vector<EngineParameter>& parameters() const;
+
+    /**
+     * @brief The size of each response frame.
+     *
+     * @return The number of data bytes in each frame.
+     */
+    std::size_t frameSize() const;
+
+    /**
+     * @brief Decodes a response frame.
+     *
+     * @param frame Pointer to the frame's data bytes.
+     * @param size The number of data bytes in the frame.
+     * @param result Set to the decoded values. Any existing values are
+     *      replaced.
+     * @throws std::invalid_argument if \c size does not match this plan.
+     */
+    void decode(const uint8_t* frame, std::size_t size, EngineParameters& result) const;
+
+private:
+    friend class ConsultInterface;
+    struct impl;
+    std::shared_ptr<const impl> pimpl;
 };
 
 /**
@@ -111,6 +172,189 @@ struct EngineParameters : public ConsultResponse {
 using EngineParametersStream = ConsultResponseStream<EngineParameters>;
 
 
+/**
+ * @brief A response holding the current value of a set of engine parameters
+ *      fixed at compile time.
+ *
+ * The frame layout and each parameter's decoding are resolved at compile time
+ * from \c engineParameterEncoding , so decoding a frame is a handful of
+ * arithmetic instructions per parameter with no look-ups.
+ *
+ * @tparam Parameters The \c EngineParameter s held, in frame order.
+ */
+template <EngineParameter... Parameters>
+struct TypedEngineParameters : public ConsultResponse {
+    static_assert(sizeof...(Parameters) > 0, "At least one engine parameter is required");
+
+    TypedEngineParameters()
+            : values() {
+    }
+
+    /**
+     * @brief Decode a response frame.
+     *
+     * @param frame Pointer to the frame's data bytes.
+     * @param size The number of data bytes in the frame.
+     * @throws std::invalid_argument if \c size does not match the parameters.
+     */
+    TypedEngineParameters(const uint8_t* frame, std::size_t size) {
+        if (size != frameSize()) {
+            throw std::invalid_argument("Invalid engine parameters response");
+        }
+        decode(frame, std::make_index_sequence<sizeof...(Parameters)>());
+    }
+
+    std::string toJSON() const override {
+        EngineParameters untyped;
+        for (std::size_t i = 0; i < sizeof...(Parameters); i++) {
+            untyped.parameters[parameter(i)] = values[i];
+        }
+        return untyped.toJSON();
+    }
+
+    /**
+     * @brief Retrieves the value of a single parameter.
+     *
+     * @tparam Parameter The \c EngineParameter to retrieve. Must be one of
+     *      \c Parameters .
+     * @return The parameter's value.
+     */
+    template <EngineParameter Parameter>
+    double get() const {
+        static_assert(index(Parameter) < sizeof...(Parameters), "Engine parameter is not in this response");
+        return values[index(Parameter)];
+    }
+
+    /**
+     * @brief The parameter at a given position in the frame.
+     *
+     * @param i The parameter's position.
+     * @return The \c EngineParameter at position \c i .
+     */
+    static constexpr EngineParameter parameter(std::size_t i) {
+        EngineParameter parameters[] = {Parameters...};
+        return parameters[i];
+    }
+
+    /**
+     * @brief The size of each response frame.
+     *
+     * @return The number of data bytes in each frame.
+     */
+    static constexpr std::size_t frameSize() {
+        return offset(sizeof...(Parameters));
+    }
+
+    /// @brief The value of each parameter, in frame order.
+    std::array<double, sizeof...(Parameters)> values;
+    /// @copydoc EngineParameters::timestamp
+    ByteInterface::clock::time_point timestamp;
+    /// @copydoc EngineParameters::sequence
+    uint64_t sequence = 0;
+
+private:
+    static constexpr std::size_t index(EngineParameter parameter) {
+        EngineParameter parameters[] = {Parameters...};
+        for (std::size_t i = 0; i < sizeof...(Parameters); i++) {
+            if (parameters[i] == parameter) {
+                return i;
+            }
+        }
+        return sizeof...(Parameters);
+    }
+
+    static constexpr std::size_t offset(std::size_t i) {
+        std::size_t offset = 0;
+        for (std::size_t j = 0; j < i; j++) {
+            offset += engineParameterEncoding(parameter(j)).width;
+        }
+        return offset;
+    }
+
+    template <std::size_t I>
+    static double decodeField(const uint8_t* frame) {
+        constexpr EngineParameterEncoding encoding = engineParameterEncoding(parameter(I));
+        constexpr std::size_t field_offset = offset(I);
+        return encoding.decode(frame + field_offset);
+    }
+
+    template <std::size_t... I>
+    void decode(const uint8_t* frame, std::index_sequence<I...>) {
+        using expand = int[];
+        (void) expand{0, (values[I] = decodeField<I>(frame), 0)...};
+    }
+};
+
+/**
+ * @brief A stream of responses describing the live value of a set of engine
+ *      parameters fixed at compile time.
+ */
+template <EngineParameter... Parameters>
+using TypedEngineParametersStream = ConsultResponseStream<TypedEngineParameters<Parameters...>>;
+
+
+/**
+ * @brief What a background stream does with a new frame when its buffer is
+ *      full because the consumer has fallen behind.
+ */
+enum class OverflowPolicy {
+    /// @brief Discard the oldest buffered frame to make room.
+    DROP_OLDEST,
+    /// @brief Discard the new frame.
+    DROP_NEWEST,
+    /// @brief Stop reading from the device until there is room. The device's
+    ///     own buffers may then overflow instead.
+    BLOCK,
+};
+
+
+/// @brief The number of buckets in \c StreamStatistics::interval_histogram .
+constexpr std::size_t STREAM_INTERVAL_BUCKETS = 24;
+
+/**
+ * @brief Statistics describing how well a stream is keeping up with the
+ *      device.
+ */
+struct StreamStatistics {
+    /// @brief The number of frames read from the device.
+    uint64_t frames = 0;
+    /// @brief The number of frames a background stream discarded because its
+    ///     buffer was full.
+    uint64_t dropped_frames = 0;
+    /// @brief The number of times frame alignment was lost and regained.
+    uint64_t resyncs = 0;
+    /// @brief The frames read per second, between the first frame and the
+    ///     most recent.
+    double frame_rate = 0;
+    /// @brief The mean interval between consecutive frames.
+    std::chrono::nanoseconds mean_interval{0};
+    /// @brief The standard deviation of the interval between consecutive
+    ///     frames.
+    std::chrono::nanoseconds jitter{0};
+    /// @brief The intervals between consecutive frames. Bucket \c i counts
+    ///     intervals from 2^i up to 2^(i+1) microseconds. The first bucket
+    ///     also counts shorter intervals, and the last longer ones.
+    std::array<uint64_t, STREAM_INTERVAL_BUCKETS> interval_histogram{};
+};
+
+
+/**
+ * @brief Options controlling how a stream is read.
+ */
+struct StreamOptions {
+    /// @brief \c true to read frames from the device on a dedicated thread,
+    ///     buffering them until they are retrieved. \c false to read each
+    ///     frame on the caller's thread as it is retrieved. Background
+    ///     streams require the \c ConsultInterface to have a timeout, so the
+    ///     thread can always be stopped.
+    bool background = false;
+    /// @brief The number of frames a background stream can buffer.
+    std::size_t buffer_frames = 64;
+    /// @brief What a background stream does when its buffer is full.
+    OverflowPolicy overflow_policy = OverflowPolicy::DROP_OLDEST;
+};
+
+
 /**
  * @brief RAII class for communicating with a Consult device.
  */
@@ -122,8 +366,13 @@ public:
      *
      * @param byte_interface The interface with which to communicate with the
      *      Consult device.
+     * @param timeout The maximum time each transaction with the Consult device
+     *      (connecting, each read, or each streamed frame) may take, or zero to
+     *      wait indefinitely. Transactions which take longer raise
+     *      \c timeout_error .
      */
-    ConsultInterface(std::unique_ptr<ByteInterface> byte_interface);
+    ConsultInterface(std::unique_ptr<ByteInterface> byte_interface,
+                     std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
 
     // ConsultInterface is not copyable.
     ConsultInterface(const ConsultInterface&) = delete;
@@ -161,6 +410,27 @@ public:
      */
     EngineParameters readEngineParameters(const std::vector<EngineParameter>& params);
 
+    /**
+     * @brief Read the current value of the engine parameters in a pre-compiled
+     *      \c StreamPlan from the ECU.
+     *
+     * @param plan The plan describing the parameters to read.
+     * @return EngineParameters describing the current value of each of the
+     *      planned parameters.
+     */
+    EngineParameters readEngineParameters(const StreamPlan& plan);
+
+    /**
+     * @brief Read the current value of a set of \c EngineParameter s fixed at
+     *      compile time from the ECU.
+     *
+     * @tparam Parameters The \c EngineParameter s to read.
+     * @return TypedEngineParameters holding the current value of each of the
+     *      requested parameters.
+     */
+    template <EngineParameter... Parameters>
+    TypedEngineParameters<Parameters...> readEngineParameters();
+
     /**
      * @brief Request a stream of the live value of one or more \c
      *      EngineParameter s from the ECU.
@@ -171,13 +441,58 @@ public:
      * may be called on this interface.
      *
      * @param params The \c EngineParameter s to stream.
+     * @param options Options controlling how the stream is read.
      * @return EngineParametersStream object representing the streamed data.
      *      This RAII object will continue streaming data until disposed of, at
      *      which point it will halt the streamed data.
+     * @throws std::invalid_argument if \c options requests a background
+     *      stream and this interface has no timeout.
      */
-    EngineParametersStream streamEngineParameters(const std::vector<EngineParameter>& params);
+    EngineParametersStream streamEngineParameters(const std::vector<EngineParameter>& params,
+                                                  const StreamOptions& options = StreamOptions());
+
+    /**
+     * @brief Request a stream of the live value of the engine parameters in a
+     *      pre-compiled \c StreamPlan from the ECU. Otherwise identical to
+     *      \c streamEngineParameters(const std::vector<EngineParameter>&, const StreamOptions&) .
+     *
+     * @param plan The plan describing the parameters to stream.
+     * @param options Options controlling how the stream is read.
+     * @return EngineParametersStream object representing the streamed data.
+     */
+    EngineParametersStream streamEngineParameters(const StreamPlan& plan,
+                                                  const StreamOptions& options = StreamOptions());
+
+    /**
+     * @brief Request a stream of the live value of a set of
+     *      \c EngineParameter s fixed at compile time from the ECU. Otherwise
+     *      identical to
+     *      \c streamEngineParameters(const std::vector<EngineParameter>&, const StreamOptions&) .
+     *
+     * @tparam Parameters The \c EngineParameter s to stream.
+     * @param options Options controlling how the stream is read.
+     * @return TypedEngineParametersStream object representing the streamed
+     *      data.
+     */
+    template <EngineParameter... Parameters>
+    TypedEngineParametersStream<Parameters...> streamEngineParameters(const StreamOptions& options = StreamOptions());
 
 private:
+    /**
+     * @brief Read a single frame of engine parameters from the ECU.
+     *
+     * @param plan The plan describing the parameters to read.
+     * @return The frame's data bytes. Valid until the next call.
+     */
+    const std::vector<uint8_t>& readEngineParametersFrame(const StreamPlan& plan);
+
+    /**
+     * @brief When the most recently read frame was captured.
+     *
+     * @return The time its last byte was read from the device.
+     */
+    ByteInterface::clock::time_point frameTimestamp() const;
+
     friend class ConsultResponseStream<EngineParameters>;
     class impl;
     std::unique_ptr<impl> pimpl;
@@ -187,7 +502,8 @@ private:
 template <>
 class ConsultResponseStream<EngineParameters> {
 public:
-    ConsultResponseStream(ConsultInterface::impl* pimpl, const std::vector<EngineParameter>& parameters);
+    ConsultResponseStream(ConsultInterface::impl* pimpl, const StreamPlan& plan,
+                          const StreamOptions& options = StreamOptions());
 
     // As the stream uses RAII, it is not copyable.
     ConsultResponseStream(const ConsultResponseStream<EngineParameters>&) = delete;
@@ -202,12 +518,150 @@ public:
     /// @copydoc ConsultResponseStream::getFrame()
     EngineParameters getFrame();
 
+    /**
+     * @brief Non-blocking call to retrieve a single frame from a background
+     *      stream, if one is available.
+     *
+     * @param frame Set to the next frame in the stream, if one is available.
+     *      Otherwise left unmodified.
+     * @return \c true if a frame was retrieved, \c false otherwise.
+     * @throws std::logic_error if the stream was not started in the background.
+     */
+    bool tryGetFrame(EngineParameters& frame);
+
+    /**
+     * @brief The number of frames a background stream has discarded because
+     *      its buffer was full.
+     *
+     * @return The number of discarded frames. Always zero for streams not
+     *      started in the background.
+     */
+    uint64_t droppedFrames() const;
+
+    /**
+     * @brief The number of times the stream has lost and regained frame
+     *      alignment, such as when a byte was corrupted or dropped on the
+     *      wire. Bytes are discarded until the next plausible frame header,
+     *      rather than the stream failing.
+     *
+     * @return The number of resyncs. For background streams, as of the most
+     *      recently read frame.
+     */
+    uint64_t resyncs() const;
+
+    /**
+     * @brief Statistics describing the frames read so far.
+     *
+     * @return A snapshot of the statistics. For background streams, frames
+     *      are counted as they are read from the device rather than when they
+     *      are retrieved.
+     */
+    StreamStatistics statistics() const;
+
+    /**
+     * @brief The maximum time the stream may take to read each frame.
+     *
+     * @return The timeout of the \c ConsultInterface the stream was started
+     *      on, or zero if reads may block indefinitely.
+     */
+    std::chrono::milliseconds timeout() const;
+
 private:
+    template <class> friend class ConsultResponseStream;
+    struct Acquisition;
+    class Monitor;
+
+    /**
+     * @brief Blocking call to retrieve a single undecoded frame.
+     *
+     * @return The frame's data bytes. Valid until the next frame is retrieved.
+     */
+    const std::vector<uint8_t>& getRawFrame();
+
+    /**
+     * @brief Non-blocking call to retrieve a single undecoded frame from a
+     *      background stream, if one is available.
+     *
+     * @return Pointer to the frame's data bytes, or \c nullptr if no frame was
+     *      available. Valid until the next frame is retrieved.
+     */
+    const std::vector<uint8_t>* tryGetRawFrame();
+
     ConsultInterface::impl* pimpl;
-    std::vector<EngineParameter> parameters;
+    StreamPlan plan;
+    std::unique_ptr<Monitor> monitor;
+    std::unique_ptr<Acquisition> acquisition;
+    /// @brief The capture time and sequence number of the most recently
+    ///     retrieved frame.
+    ByteInterface::clock::time_point frame_timestamp;
+    uint64_t frame_sequence;
 };
 
 
+template <EngineParameter... Parameters>
+class ConsultResponseStream<TypedEngineParameters<Parameters...>> {
+public:
+    ConsultResponseStream(EngineParametersStream&& _stream)
+            : stream(std::move(_stream)) {
+    }
+
+    /// @copydoc ConsultResponseStream::getFrame()
+    TypedEngineParameters<Parameters...> getFrame() {
+        const std::vector<uint8_t>& frame = stream.getRawFrame();
+        TypedEngineParameters<Parameters...> result(frame.data(), frame.size());
+        result.timestamp = stream.frame_timestamp;
+        result.sequence = stream.frame_sequence;
+        return result;
+    }
+
+    /// @copydoc ConsultResponseStream<EngineParameters>::tryGetFrame(EngineParameters&)
+    bool tryGetFrame(TypedEngineParameters<Parameters...>& frame) {
+        const std::vector<uint8_t>* raw_frame = stream.tryGetRawFrame();
+        if (!raw_frame) {
+            return false;
+        }
+        frame = TypedEngineParameters<Parameters...>(raw_frame->data(), raw_frame->size());
+        frame.timestamp = stream.frame_timestamp;
+        frame.sequence = stream.frame_sequence;
+        return true;
+    }
+
+    /// @copydoc ConsultResponseStream<EngineParameters>::droppedFrames()
+    uint64_t droppedFrames() const {
+        return stream.droppedFrames();
+    }
+
+    /// @copydoc ConsultResponseStream<EngineParameters>::resyncs()
+    uint64_t resyncs() const {
+        return stream.resyncs();
+    }
+
+    /// @copydoc ConsultResponseStream<EngineParameters>::statistics()
+    StreamStatistics statistics() const {
+        return stream.statistics();
+    }
+
+private:
+    EngineParametersStream stream;
+};
+
+
+template <EngineParameter... Parameters>
+TypedEngineParameters<Parameters...> ConsultInterface::readEngineParameters() {
+    static const StreamPlan plan({Parameters...});
+    const std::vector<uint8_t>& frame = readEngineParametersFrame(plan);
+    TypedEngineParameters<Parameters...> result(frame.data(), frame.size());
+    result.timestamp = frameTimestamp();
+    return result;
+}
+
+template <EngineParameter... Parameters>
+TypedEngineParametersStream<Parameters...> ConsultInterface::streamEngineParameters(const StreamOptions& options) {
+    static const StreamPlan plan({Parameters...});
+    return TypedEngineParametersStream<Parameters...>(streamEngineParameters(plan, options));
+}
+
+
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,30 @@
+#ifndef OPENCONSULT_LIB_CONSULT_INTERFACE_INTERNAL
+#define OPENCONSULT_LIB_CONSULT_INTERFACE_INTERNAL
+
+#include <cstdint>
+#include <vector>
+
+namespace openconsult {
+
+
+/**
+ * @brief Calculates the echo the Consult device replies to a request with.
+ *
+ * The device replies to each command byte with its complement, and repeats
+ * each data byte.
+ *
+ * @param request The request sent to the device.
+ * @param response Set to the expected reply.
+ * @param command_width The number of command bytes in each command, or -1 if
+ *      the whole request is command bytes.
+ * @param data_width The number of data bytes following each command, or -1 if
+ *      the remainder of the request is data bytes.
+ */
+void calculateExpectedResponse(const std::vector<uint8_t>& request,
+                               std::vector<uint8_t>& response,
+                               int command_width = 1, int data_width = -1);
+
+
+}
+
+#endif
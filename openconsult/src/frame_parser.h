@@ -0,0 +1,237 @@
+#ifndef OPENCONSULT_LIB_FRAME_PARSER
+#define OPENCONSULT_LIB_FRAME_PARSER
+
+#include <cstdint>
+#include <vector>
+
+namespace openconsult {
+
+
+/**
+ * @brief Incremental parser for the frames a Consult device sends, each a FF
+ *      start byte, a length byte and that many data bytes.
+ *
+ * Bytes are pushed in chunks of any size, and each frame is available as soon
+ * as its last byte has been pushed. Bytes which cannot start a frame are
+ * discarded rather than treated as fatal: on a corrupt start byte, or a length
+ * other than the one expected, the parser scans forward for the next FF
+ * followed by a plausible length. Each run of discarded bytes between good
+ * frames is counted as one resync.
+ *
+ * A corrupted byte within a frame's data cannot be detected, but a dropped or
+ * inserted byte desynchronises the following header, which is then recovered.
+ */
+class FrameParser {
+public:
+    /**
+     * @brief Construct a new \c FrameParser which accepts frames of any
+     *      length.
+     */
+    FrameParser() {
+        frame_buffer.reserve(0xFF);
+        reset();
+    }
+
+    /**
+     * @brief Construct a new \c FrameParser which accepts only frames of a
+     *      given length.
+     *
+     * @param frame_size The number of data bytes in each frame.
+     */
+    FrameParser(std::size_t frame_size) {
+        frame_buffer.reserve(0xFF);
+        reset(frame_size);
+    }
+
+    /**
+     * @brief Discards any partial frame and zeroes the counters, then accepts
+     *      frames of any length.
+     */
+    void reset() {
+        reset(0);
+        any_size = true;
+    }
+
+    /**
+     * @brief Discards any partial frame and zeroes the counters, then accepts
+     *      only frames of a given length.
+     *
+     * @param frame_size The number of data bytes in each frame.
+     */
+    void reset(std::size_t frame_size) {
+        expected_size = frame_size;
+        any_size = false;
+        state = State::START;
+        synced = true;
+        ready = false;
+        data_size = 0;
+        frame_buffer.clear();
+        resync_count = 0;
+        discarded_count = 0;
+    }
+
+    /**
+     * @brief Pushes bytes, stopping early if they complete a frame.
+     *
+     * @param bytes The bytes received.
+     * @param size The number of bytes received.
+     * @return The number of bytes consumed. If fewer than \c size , the
+     *      remainder should be pushed once the frame has been retrieved.
+     */
+    std::size_t push(const uint8_t* bytes, std::size_t size) {
+        ready = false;
+        for (std::size_t i = 0; i < size; i++) {
+            if (step(bytes[i])) {
+                return i + 1;
+            }
+        }
+        return size;
+    }
+
+    /**
+     * @brief Whether the last \c push(...) completed a frame.
+     *
+     * @return \c true if \c frame() holds a complete frame.
+     */
+    bool hasFrame() const {
+        return ready;
+    }
+
+    /**
+     * @brief The data bytes of the frame the last \c push(...) completed.
+     *
+     * @return The frame's data bytes. Valid until the next \c push(...) .
+     */
+    const std::vector<uint8_t>& frame() const {
+        return frame_buffer;
+    }
+
+    /**
+     * @brief The number of bytes to push next: the rest of the header, or
+     *      the rest of the frame's data. Reading exactly this many bytes at a
+     *      time never reads beyond the end of a frame.
+     *
+     * @return The number of bytes.
+     */
+    std::size_t needed() const {
+        switch (state) {
+            case State::START:
+                return 2;
+            case State::LENGTH:
+                return 1;
+            case State::DATA:
+                return data_size - frame_buffer.size();
+        }
+        return 1;
+    }
+
+    /**
+     * @brief Whether the parser is between frames, with no partial frame
+     *      pushed.
+     *
+     * @return \c true if the next byte pushed would be a start byte.
+     */
+    bool atBoundary() const {
+        return state == State::START;
+    }
+
+    /**
+     * @brief The number of times corruption has been recovered from.
+     *
+     * @return The number of resyncs since construction or the last reset.
+     */
+    uint64_t resyncs() const {
+        return resync_count;
+    }
+
+    /**
+     * @brief The number of bytes discarded while resynchronising.
+     *
+     * @return The number of bytes since construction or the last reset.
+     */
+    uint64_t discardedBytes() const {
+        return discarded_count;
+    }
+
+private:
+    enum class State {
+        START,
+        LENGTH,
+        DATA,
+    };
+
+    /**
+     * @brief Consumes a single byte.
+     *
+     * @return \c true if it completed a frame.
+     */
+    bool step(uint8_t byte) {
+        switch (state) {
+            case State::START:
+                if (byte == 0xFF) {
+                    state = State::LENGTH;
+                } else {
+                    discard(1);
+                }
+                return false;
+            case State::LENGTH:
+                if (!any_size && byte != expected_size) {
+                    // The start byte was not one. This byte may be, though.
+                    if (byte == 0xFF) {
+                        discard(1);
+                    } else {
+                        discard(2);
+                        state = State::START;
+                    }
+                    return false;
+                }
+                data_size = byte;
+                frame_buffer.clear();
+                if (data_size > 0) {
+                    state = State::DATA;
+                    return false;
+                }
+                return complete();
+            case State::DATA:
+                frame_buffer.push_back(byte);
+                if (frame_buffer.size() < data_size) {
+                    return false;
+                }
+                return complete();
+        }
+        return false;
+    }
+
+    bool complete() {
+        state = State::START;
+        synced = true;
+        ready = true;
+        return true;
+    }
+
+    void discard(std::size_t bytes) {
+        if (synced) {
+            resync_count++;
+            synced = false;
+        }
+        discarded_count += bytes;
+    }
+
+    std::size_t expected_size;
+    bool any_size;
+    State state;
+    /// @brief \c false from the first byte discarded until the next frame.
+    bool synced;
+    bool ready;
+    std::size_t data_size;
+    /// @brief The frame in progress. Its capacity is reserved for the largest
+    ///     frame, so no allocations are made while parsing.
+    std::vector<uint8_t> frame_buffer;
+    uint64_t resync_count;
+    uint64_t discarded_count;
+};
+
+
+}
+
+#endif
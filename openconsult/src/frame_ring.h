@@ -0,0 +1,205 @@
+#ifndef OPENCONSULT_LIB_FRAME_RING
+#define OPENCONSULT_LIB_FRAME_RING
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+namespace openconsult {
+
+
+/**
+ * @brief Bounded, lock-free, single-producer single-consumer queue of frames.
+ *
+ * Each slot holds a single frame of up to a fixed maximum size. Exactly one
+ * thread may push and exactly one (other) thread may pop.
+ *
+ * Unlike a classic SPSC ring the producer may also discard the oldest frame
+ * when the ring is full (see \c pushOverwrite(...) ). To allow this without
+ * locks, the consumer claims each frame by compare-and-swap after copying it
+ * out, retrying if the producer discarded it in the meantime. Frame contents
+ * are stored as atomic words so such a discarded copy is never a data race.
+ */
+class FrameRing {
+public:
+    /**
+     * @brief Construct a new \c FrameRing .
+     *
+     * @param capacity The maximum number of frames held at once. Must be
+     *      greater than zero.
+     * @param max_frame_size The largest frame, in bytes, that may be pushed.
+     * @throws std::invalid_argument if \c capacity is zero.
+     */
+    FrameRing(std::size_t capacity, std::size_t max_frame_size)
+            : capacity(capacity)
+            , slot_count(capacity + 1)
+            , words_per_slot((max_frame_size + sizeof(uint64_t) - 1) / sizeof(uint64_t))
+            , max_frame_size(max_frame_size)
+            , sizes(new std::atomic<std::size_t>[slot_count])
+            , words(new std::atomic<uint64_t>[slot_count * words_per_slot])
+            , head(0)
+            , tail(0) {
+        if (capacity == 0) {
+            throw std::invalid_argument("Frame ring capacity must be non-zero");
+        }
+    }
+
+    // FrameRing is neither copyable nor movable.
+    FrameRing(const FrameRing&) = delete;
+    FrameRing& operator=(const FrameRing&) = delete;
+
+    /**
+     * @brief Pushes a frame if there is space for it. Producer only.
+     *
+     * @param frame The frame's bytes.
+     * @param size The frame's size. Must not exceed the maximum frame size.
+     * @return \c true if the frame was pushed, \c false if the ring was full.
+     * @throws std::invalid_argument if \c size exceeds the maximum frame size.
+     */
+    bool tryPush(const uint8_t* frame, std::size_t size) {
+        checkSize(size);
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) >= capacity) {
+            return false;
+        }
+        store(t, frame, size);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Pushes a frame, discarding the oldest frame if the ring is full.
+     *      Producer only.
+     *
+     * @param frame The frame's bytes.
+     * @param size The frame's size. Must not exceed the maximum frame size.
+     * @return \c true if a frame was discarded to make room, \c false
+     *      otherwise.
+     * @throws std::invalid_argument if \c size exceeds the maximum frame size.
+     */
+    bool pushOverwrite(const uint8_t* frame, std::size_t size) {
+        checkSize(size);
+        bool discarded = false;
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        uint64_t h = head.load(std::memory_order_acquire);
+        if (t - h >= capacity) {
+            // If this fails the consumer has just popped the oldest frame, so
+            // there is now room anyway.
+            discarded = head.compare_exchange_strong(h, h + 1, std::memory_order_acq_rel);
+        }
+        // There is always one more slot than the capacity, so the slot written
+        // here is never the one a consumer is about to successfully claim.
+        store(t, frame, size);
+        tail.store(t + 1, std::memory_order_release);
+        return discarded;
+    }
+
+    /**
+     * @brief Pops the oldest frame, if there is one. Consumer only.
+     *
+     * @param dst Buffer to copy the frame to. Must have space for the maximum
+     *      frame size.
+     * @param size Set to the size of the popped frame.
+     * @return \c true if a frame was popped, \c false if the ring was empty.
+     */
+    bool tryPop(uint8_t* dst, std::size_t& size) {
+        uint64_t h = head.load(std::memory_order_acquire);
+        while (h != tail.load(std::memory_order_acquire)) {
+            size = load(h, dst);
+            if (head.compare_exchange_strong(h, h + 1, std::memory_order_acq_rel)) {
+                return true;
+            }
+            // The producer discarded the frame while we copied it. h has been
+            // updated to the new oldest frame, so try again.
+        }
+        return false;
+    }
+
+    /**
+     * @brief Determines if the ring is empty. The result is only a snapshot
+     *      if the other thread is active.
+     *
+     * @return \c true if there are no frames in the ring.
+     */
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Determines if the ring is full. The result is only a snapshot if
+     *      the other thread is active.
+     *
+     * @return \c true if no more frames can be pushed without discarding.
+     */
+    bool full() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire) >= capacity;
+    }
+
+    /**
+     * @brief The largest frame that may be pushed.
+     *
+     * @return The maximum frame size, in bytes.
+     */
+    std::size_t maxFrameSize() const {
+        return max_frame_size;
+    }
+
+private:
+    static constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+    void checkSize(std::size_t size) const {
+        if (size > max_frame_size) {
+            throw std::invalid_argument("Frame exceeds the ring's maximum frame size");
+        }
+    }
+
+    void store(uint64_t index, const uint8_t* frame, std::size_t size) {
+        std::size_t slot = index % slot_count;
+        std::atomic<uint64_t>* dst = &words[slot * words_per_slot];
+        for (std::size_t offset = 0; offset < size; offset += sizeof(uint64_t)) {
+            uint64_t word = 0;
+            std::memcpy(&word, frame + offset, std::min(sizeof(uint64_t), size - offset));
+            (dst++)->store(word, std::memory_order_relaxed);
+        }
+        sizes[slot].store(size, std::memory_order_relaxed);
+    }
+
+    std::size_t load(uint64_t index, uint8_t* frame) const {
+        std::size_t slot = index % slot_count;
+        // Bound the size in case the slot is being concurrently rewritten; the
+        // copy will be discarded in that case anyway.
+        std::size_t size = std::min(sizes[slot].load(std::memory_order_relaxed), max_frame_size);
+        const std::atomic<uint64_t>* src = &words[slot * words_per_slot];
+        for (std::size_t offset = 0; offset < size; offset += sizeof(uint64_t)) {
+            uint64_t word = (src++)->load(std::memory_order_relaxed);
+            std::memcpy(frame + offset, &word, std::min(sizeof(uint64_t), size - offset));
+        }
+        return size;
+    }
+
+    const std::size_t capacity;
+    const std::size_t slot_count;
+    const std::size_t words_per_slot;
+    const std::size_t max_frame_size;
+    std::unique_ptr<std::atomic<std::size_t>[]> sizes;
+    std::unique_ptr<std::atomic<uint64_t>[]> words;
+    // The indices are padded onto separate cache lines so the two threads do
+    // not contend on them. Padding is used rather than alignas as the ring is
+    // heap-allocated, and operator new need not honour over-alignment.
+    char pad0[CACHE_LINE_SIZE];
+    /// @brief Index of the oldest frame. Advanced by the consumer, and by the
+    ///     producer when discarding.
+    std::atomic<uint64_t> head;
+    char pad1[CACHE_LINE_SIZE - sizeof(std::atomic<uint64_t>)];
+    /// @brief Index of the next frame to be pushed. Advanced by the producer.
+    std::atomic<uint64_t> tail;
+    char pad2[CACHE_LINE_SIZE - sizeof(std::atomic<uint64_t>)];
+};
+
+
+}
+
+#endif
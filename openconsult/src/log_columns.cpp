@@ -0,0 +1,651 @@
+#include "log_columns.h"
+#include "common.h"
+#include "consult_engine_parameters.internal.h"
+#include "log_sessions.h"
+#include "mapped_file.h"
+#include "task_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace openconsult {
+
+
+/// @brief The magic and version starting each columnar log file.
+static const uint8_t COLUMNS_MAGIC[5] = {'O', 'C', 'L', 'C', 0x01};
+/// @brief The size of the fixed part of a columnar log file's header, before
+///     the column parameters.
+static const std::size_t COLUMNS_HEADER_SIZE = 16;
+/// @brief The size of a columnar log file's trailer, in bytes.
+static const std::size_t COLUMNS_TRAILER_SIZE = 24;
+/// @brief The size of each block's directory entry, excluding its zone map.
+static const std::size_t DIRECTORY_ENTRY_SIZE = 32;
+
+// Offsets of the fields in a columnar log file's header.
+static const std::size_t HEADER_BLOCK_ROWS = 8;
+static const std::size_t HEADER_COLUMNS = 12;
+
+/// @brief The smallest stretch of log worth decoding as a task, in bytes.
+static const std::size_t TASK_SIZE = 256 << 10;
+/// @brief The number of tasks decoded per thread before their rows are
+///     written, bounding the rows held in memory.
+static const std::size_t TASKS_PER_THREAD = 4;
+
+
+static void encodeDouble(double value, uint8_t* dst) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    cmn::encode_uint(bits, sizeof(bits), dst);
+}
+
+static double decodeDouble(const uint8_t* src) {
+    uint64_t bits = cmn::decode_uint(src, sizeof(bits));
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/**
+ * @brief Column data is accessed in place, so must already be in the host's
+ *      byte order.
+ */
+static void checkHostByteOrder() {
+    const uint16_t probe = 1;
+    uint8_t low;
+    std::memcpy(&low, &probe, 1);
+    if (low != 1) {
+        throw std::invalid_argument("Columnar logs require a little-endian host");
+    }
+}
+
+static std::size_t headerSize(std::size_t columns) {
+    return COLUMNS_HEADER_SIZE + (columns + 7) / 8 * 8;
+}
+
+static std::size_t directoryEntrySize(std::size_t columns) {
+    return DIRECTORY_ENTRY_SIZE + 2 * sizeof(double) * columns;
+}
+
+
+/**
+ * @brief The registers read to query an \c EngineParameter .
+ */
+struct ParameterRegisters {
+    EngineParameter parameter;
+    std::vector<uint8_t> registers;
+};
+
+/**
+ * @brief The registers of every \c EngineParameter , those with the most
+ *      registers first.
+ */
+static const std::vector<ParameterRegisters>& parameterRegisters() {
+    static const std::vector<ParameterRegisters> table = [](){
+        std::vector<ParameterRegisters> parameters;
+        for (std::size_t i = 0; i < ENGINE_PARAMETER_COUNT; i++) {
+            EngineParameter parameter = static_cast<EngineParameter>(i);
+            std::vector<uint8_t> command = engineParameterCommand(parameter);
+            ParameterRegisters entry {parameter, {}};
+            for (std::size_t j = 1; j < command.size(); j += 2) {
+                entry.registers.push_back(command[j]);
+            }
+            parameters.push_back(entry);
+        }
+        std::stable_sort(parameters.begin(), parameters.end(),
+                         [](const ParameterRegisters& a, const ParameterRegisters& b) {
+                             return a.registers.size() > b.registers.size();
+                         });
+        return parameters;
+    }();
+    return table;
+}
+
+
+/**
+ * @brief A parameter's place in a stream's frames.
+ */
+struct StreamField {
+    /// @brief The offset of the parameter's bytes in each frame.
+    std::size_t offset;
+    EngineParameter parameter;
+    /// @brief The parameter's column. Set once all streams are known.
+    std::size_t column;
+    const EngineParameterDecoder* decoder;
+};
+
+/**
+ * @brief The layout of the frames streamed in a transaction.
+ */
+struct StreamLayout {
+    /// @brief The number of data bytes in each frame, or zero if the
+    ///     transaction did not stream registers.
+    std::size_t frame_size;
+    /// @brief The index of the record holding the go-ahead. Frames are read
+    ///     after it.
+    uint64_t go_ahead_record;
+    std::vector<StreamField> fields;
+};
+
+/**
+ * @brief Reconstructs the layout of a transaction's frames from its register
+ *      selection commands.
+ */
+static StreamLayout layoutOf(const LogBufferParser& log, const LogTransaction& transaction) {
+    StreamLayout layout {0, 0, {}};
+    if (transaction.type != TransactionType::REGISTER_SELECT) {
+        return layout;
+    }
+
+    // Read the selected registers, up to the go-ahead.
+    LogBufferParser parser(log);
+    parser.seek(transaction.offset, 0);
+    std::vector<uint8_t> registers;
+    bool selecting = false;
+    bool started = false;
+    LogRecordView record;
+    for (uint64_t i = 0; i < transaction.records && !started && parser.next(record); i++) {
+        if (record.type != LogRecordType::WRITE) {
+            continue;
+        }
+        for (std::size_t j = 0; j < record.size && !started; j++) {
+            if (selecting) {
+                registers.push_back(record[j]);
+                selecting = false;
+            } else if (record[j] == REGISTER_SELECT) {
+                selecting = true;
+            } else if (record[j] == GO_AHEAD) {
+                layout.go_ahead_record = transaction.first_record + i;
+                started = true;
+            } else {
+                // Not a register stream.
+                return layout;
+            }
+        }
+    }
+    if (!started || registers.empty()) {
+        return layout;
+    }
+
+    // Match the registers to parameters. Each register reads one frame byte.
+    const auto& parameters = parameterRegisters();
+    for (std::size_t i = 0; i < registers.size();) {
+        auto match = std::find_if(parameters.begin(), parameters.end(),
+                                  [&](const ParameterRegisters& entry) {
+                                      return entry.registers.size() <= registers.size() - i &&
+                                             std::equal(entry.registers.begin(), entry.registers.end(),
+                                                        registers.begin() + i);
+                                  });
+        if (match == parameters.end()) {
+            i++;
+            continue;
+        }
+        layout.fields.push_back({i, match->parameter, 0, &engineParameterDecoder(match->parameter)});
+        i += match->registers.size();
+    }
+    layout.frame_size = registers.size();
+    return layout;
+}
+
+
+/**
+ * @brief The rows decoded by a task.
+ */
+struct DecodedRows {
+    std::vector<uint64_t> times;
+    /// @brief The values of each column.
+    std::vector<std::vector<double>> columns;
+    uint64_t skipped_frames;
+};
+
+/**
+ * @brief The streams in a log, by transaction.
+ */
+struct LogStreams {
+    std::vector<LogTransaction> transactions;
+    /// @brief The layout of each transaction's frames.
+    std::vector<StreamLayout> layouts;
+    std::size_t columns;
+};
+
+/**
+ * @brief Decodes the frames starting between two positions in a log. Both
+ *      positions must lie outside of frames.
+ */
+static void decodeRange(const LogBufferParser& log, const LogPosition& from, const LogPosition& to,
+                        const LogStreams& streams, DecodedRows& rows) {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    rows.columns.resize(streams.columns);
+    rows.skipped_frames = 0;
+
+    // Find the transaction holding the first record.
+    const auto& transactions = streams.transactions;
+    std::size_t next = std::upper_bound(transactions.begin(), transactions.end(), from.record,
+                                        [](uint64_t record, const LogTransaction& transaction) {
+                                            return record < transaction.first_record;
+                                        }) - transactions.begin();
+    const StreamLayout* layout = nullptr;
+    if (next > 0) {
+        layout = &streams.layouts[next - 1];
+    }
+
+    LogBufferParser parser(log);
+    parser.seek(from.offset, from.timestamp);
+    uint64_t line_time = from.line_time;
+    uint64_t index = from.record;
+    std::size_t first_byte = from.byte;
+
+    FrameCounter counter;
+    std::vector<uint8_t> frame;
+    const StreamLayout* frame_layout = nullptr;
+    bool in_frame = false;
+    bool awaiting_length = false;
+
+    LogRecordView record;
+    while (index < to.record || (index == to.record && to.byte > 0)) {
+        if (!parser.next(record)) {
+            break;
+        }
+        uint64_t record_time = recordStartTime(record.timestamp, line_time);
+        line_time = record_time + record.size * BYTE_TIME_NS;
+        while (next < transactions.size() && transactions[next].first_record <= index) {
+            layout = &streams.layouts[next++];
+        }
+        bool streaming = layout != nullptr && layout->frame_size > 0 && index > layout->go_ahead_record;
+
+        std::size_t end = index == to.record ? to.byte : record.size;
+        for (std::size_t i = first_byte; record.type == LogRecordType::READ && i < end; i++) {
+            if (counter.feed(record[i])) {
+                frame_layout = streaming ? layout : nullptr;
+                if (frame_layout != nullptr) {
+                    rows.times.push_back(record_time + i * BYTE_TIME_NS);
+                }
+                frame.clear();
+                in_frame = true;
+                awaiting_length = true;
+                continue;
+            }
+            if (!in_frame) {
+                continue;
+            }
+            if (awaiting_length) {
+                awaiting_length = false;
+            } else {
+                frame.push_back(record[i]);
+            }
+            if (counter.state() != 0) {
+                continue;
+            }
+
+            // The frame is complete.
+            in_frame = false;
+            if (frame_layout == nullptr) {
+                continue;
+            }
+            if (frame.size() != frame_layout->frame_size) {
+                rows.times.pop_back();
+                rows.skipped_frames++;
+                continue;
+            }
+            for (auto& column : rows.columns) {
+                column.push_back(nan);
+            }
+            for (const auto& field : frame_layout->fields) {
+                rows.columns[field.column].back() = field.decoder->decode(frame.data() + field.offset);
+            }
+        }
+        first_byte = 0;
+        index++;
+    }
+
+    // A frame cut short by the end of the log.
+    if (in_frame && frame_layout != nullptr) {
+        rows.times.pop_back();
+        rows.skipped_frames++;
+    }
+}
+
+
+/**
+ * @brief Writes a columnar log file, a block at a time.
+ */
+class BlockWriter {
+public:
+    BlockWriter(std::ostream& output_stream, const std::vector<EngineParameter>& parameters,
+                uint32_t block_rows)
+            : stream(output_stream)
+            , block_rows(block_rows)
+            , columns(parameters.size())
+            , rows(0)
+            , blocks(0)
+            , position(0) {
+        std::vector<uint8_t> header(headerSize(parameters.size()), 0);
+        std::memcpy(header.data(), COLUMNS_MAGIC, sizeof(COLUMNS_MAGIC));
+        cmn::encode_uint(block_rows,        4, header.data() + HEADER_BLOCK_ROWS);
+        cmn::encode_uint(parameters.size(), 4, header.data() + HEADER_COLUMNS);
+        for (std::size_t i = 0; i < parameters.size(); i++) {
+            header[COLUMNS_HEADER_SIZE + i] = static_cast<uint8_t>(parameters[i]);
+        }
+        write(header.data(), header.size());
+        for (auto& column : columns) {
+            column.reserve(block_rows);
+        }
+        times.reserve(block_rows);
+    }
+
+    /**
+     * @brief Appends rows, writing each block as it fills.
+     */
+    void append(const DecodedRows& decoded) {
+        for (std::size_t row = 0; row < decoded.times.size();) {
+            std::size_t count = std::min<std::size_t>(block_rows - times.size(), decoded.times.size() - row);
+            times.insert(times.end(), decoded.times.begin() + row, decoded.times.begin() + row + count);
+            for (std::size_t i = 0; i < columns.size(); i++) {
+                const auto& values = decoded.columns[i];
+                columns[i].insert(columns[i].end(), values.begin() + row, values.begin() + row + count);
+            }
+            row += count;
+            if (times.size() == block_rows) {
+                flush();
+            }
+        }
+    }
+
+    /**
+     * @brief Writes any partial block, then the block directory and trailer.
+     */
+    void finish() {
+        flush();
+        uint64_t directory_offset = position;
+        write(directory.data(), directory.size());
+        uint8_t trailer[COLUMNS_TRAILER_SIZE];
+        cmn::encode_uint(directory_offset, 8, trailer);
+        cmn::encode_uint(rows,             8, trailer + 8);
+        cmn::encode_uint(blocks,           8, trailer + 16);
+        write(trailer, sizeof(trailer));
+    }
+
+    uint64_t rowCount() const {
+        return rows;
+    }
+
+    uint64_t blockCount() const {
+        return blocks;
+    }
+
+private:
+    void flush() {
+        if (times.empty()) {
+            return;
+        }
+        std::size_t entry = directory.size();
+        directory.resize(entry + directoryEntrySize(columns.size()));
+        uint8_t* dst = directory.data() + entry;
+        cmn::encode_uint(position,      8, dst);
+        cmn::encode_uint(times.size(),  8, dst + 8);
+        cmn::encode_uint(times.front(), 8, dst + 16);
+        cmn::encode_uint(times.back(),  8, dst + 24);
+        dst += DIRECTORY_ENTRY_SIZE;
+
+        write(times.data(), times.size() * sizeof(uint64_t));
+        for (auto& column : columns) {
+            double minimum = std::numeric_limits<double>::infinity();
+            double maximum = -minimum;
+            for (double value : column) {
+                // NaN compares false, so is ignored.
+                minimum = value < minimum ? value : minimum;
+                maximum = value > maximum ? value : maximum;
+            }
+            if (minimum > maximum) {
+                minimum = maximum = std::numeric_limits<double>::quiet_NaN();
+            }
+            encodeDouble(minimum, dst);
+            encodeDouble(maximum, dst + sizeof(double));
+            dst += 2 * sizeof(double);
+            write(column.data(), column.size() * sizeof(double));
+            column.clear();
+        }
+        rows += times.size();
+        blocks++;
+        times.clear();
+    }
+
+    void write(const void* data, std::size_t size) {
+        stream.write(static_cast<const char*>(data), size);
+        position += size;
+    }
+
+    std::ostream& stream;
+    const std::size_t block_rows;
+    /// @brief The rows of the block being filled.
+    std::vector<uint64_t> times;
+    std::vector<std::vector<double>> columns;
+    /// @brief The directory entries of the blocks written.
+    std::vector<uint8_t> directory;
+    uint64_t rows;
+    uint64_t blocks;
+    /// @brief The number of bytes written.
+    uint64_t position;
+};
+
+
+class ColumnarLog::impl {
+public:
+    impl(const std::string& path)
+            : file(path) {
+        checkHostByteOrder();
+        data = file.data();
+        size = file.size();
+        if (size < COLUMNS_HEADER_SIZE + COLUMNS_TRAILER_SIZE ||
+                std::memcmp(data, COLUMNS_MAGIC, sizeof(COLUMNS_MAGIC)) != 0) {
+            throw std::invalid_argument("Invalid columnar log header");
+        }
+        block_rows = static_cast<uint32_t>(cmn::decode_uint(data + HEADER_BLOCK_ROWS, 4));
+        std::size_t columns = cmn::decode_uint(data + HEADER_COLUMNS, 4);
+        if (block_rows == 0 || columns > ENGINE_PARAMETER_COUNT ||
+                headerSize(columns) + COLUMNS_TRAILER_SIZE > size) {
+            throw std::invalid_argument("Invalid columnar log header");
+        }
+        for (std::size_t i = 0; i < columns; i++) {
+            uint8_t parameter = data[COLUMNS_HEADER_SIZE + i];
+            if (parameter >= ENGINE_PARAMETER_COUNT) {
+                std::string error = cmn::pformat("Unknown engine parameter: %d", parameter);
+                throw std::invalid_argument(error);
+            }
+            parameters.push_back(static_cast<EngineParameter>(parameter));
+        }
+
+        const uint8_t* trailer = data + size - COLUMNS_TRAILER_SIZE;
+        uint64_t directory_offset = cmn::decode_uint(trailer, 8);
+        rows = cmn::decode_uint(trailer + 8, 8);
+        blocks = cmn::decode_uint(trailer + 16, 8);
+        entry_size = directoryEntrySize(columns);
+        if (directory_offset < headerSize(columns) ||
+                directory_offset > size - COLUMNS_TRAILER_SIZE ||
+                (size - COLUMNS_TRAILER_SIZE - directory_offset) / entry_size != blocks ||
+                (size - COLUMNS_TRAILER_SIZE - directory_offset) % entry_size != 0) {
+            throw std::invalid_argument("Columnar log is truncated");
+        }
+        directory = data + directory_offset;
+
+        uint64_t total = 0;
+        for (std::size_t i = 0; i < blocks; i++) {
+            uint64_t offset = cmn::decode_uint(entry(i), 8);
+            uint64_t count = cmn::decode_uint(entry(i) + 8, 8);
+            if (count == 0 || count > block_rows || offset % 8 != 0 || offset > directory_offset ||
+                    count * (columns + 1) * 8 > directory_offset - offset) {
+                throw std::invalid_argument("Invalid columnar log block");
+            }
+            total += count;
+        }
+        if (total != rows) {
+            throw std::invalid_argument("Invalid columnar log block");
+        }
+    }
+
+    const uint8_t* entry(std::size_t block) const {
+        return directory + block * entry_size;
+    }
+
+    const uint8_t* blockData(std::size_t block) const {
+        return data + cmn::decode_uint(entry(block), 8);
+    }
+
+    std::size_t blockSize(std::size_t block) const {
+        return cmn::decode_uint(entry(block) + 8, 8);
+    }
+
+    double zone(std::size_t block, std::size_t column, std::size_t bound) const {
+        return decodeDouble(entry(block) + DIRECTORY_ENTRY_SIZE + (2 * column + bound) * sizeof(double));
+    }
+
+    MappedFile file;
+    const uint8_t* data;
+    std::size_t size;
+    std::vector<EngineParameter> parameters;
+    uint32_t block_rows;
+    uint64_t rows;
+    uint64_t blocks;
+    const uint8_t* directory;
+    std::size_t entry_size;
+};
+
+
+const uint32_t ColumnarLog::DEFAULT_BLOCK_ROWS;
+
+ColumnarLog::ColumnarLog(const std::string& path)
+        : pimpl(new impl(path)) {
+}
+
+ColumnarLog::~ColumnarLog() = default;
+
+const std::vector<EngineParameter>& ColumnarLog::parameters() const {
+    return pimpl->parameters;
+}
+
+std::size_t ColumnarLog::column(EngineParameter parameter) const {
+    auto it = std::find(pimpl->parameters.begin(), pimpl->parameters.end(), parameter);
+    if (it == pimpl->parameters.end()) {
+        std::string error = cmn::pformat("Columnar log has no column for %s",
+                                         engineParameterId(parameter).c_str());
+        throw std::invalid_argument(error);
+    }
+    return it - pimpl->parameters.begin();
+}
+
+uint32_t ColumnarLog::blockRows() const {
+    return pimpl->block_rows;
+}
+
+uint64_t ColumnarLog::rows() const {
+    return pimpl->rows;
+}
+
+std::size_t ColumnarLog::blocks() const {
+    return pimpl->blocks;
+}
+
+std::size_t ColumnarLog::blockSize(std::size_t block) const {
+    return pimpl->blockSize(block);
+}
+
+uint64_t ColumnarLog::startTime(std::size_t block) const {
+    return cmn::decode_uint(pimpl->entry(block) + 16, 8);
+}
+
+uint64_t ColumnarLog::endTime(std::size_t block) const {
+    return cmn::decode_uint(pimpl->entry(block) + 24, 8);
+}
+
+double ColumnarLog::minimum(std::size_t block, std::size_t column) const {
+    return pimpl->zone(block, column, 0);
+}
+
+double ColumnarLog::maximum(std::size_t block, std::size_t column) const {
+    return pimpl->zone(block, column, 1);
+}
+
+const uint64_t* ColumnarLog::times(std::size_t block) const {
+    return reinterpret_cast<const uint64_t*>(pimpl->blockData(block));
+}
+
+const double* ColumnarLog::values(std::size_t block, std::size_t column) const {
+    std::size_t rows = pimpl->blockSize(block);
+    return reinterpret_cast<const double*>(pimpl->blockData(block) + (column + 1) * rows * sizeof(double));
+}
+
+
+ColumnarLogSummary decodeLog(const uint8_t* data, std::size_t size, LogFormat format,
+                             const LogIndex& index, std::ostream& output_stream,
+                             unsigned threads, uint32_t block_rows) {
+    checkHostByteOrder();
+    if (block_rows == 0) {
+        throw std::invalid_argument("Columnar log blocks must hold at least one row");
+    }
+    if (!index.matches(data, size, format)) {
+        throw std::invalid_argument("Log index does not match the log");
+    }
+    LogBufferParser log(data, size, format);
+    TaskPool pool(threads);
+
+    // Find the streams, and the parameters each holds.
+    LogStreams streams;
+    streams.transactions = segmentLog(data, size, format, pool.size()).transactions;
+    std::vector<bool> present(ENGINE_PARAMETER_COUNT, false);
+    for (const auto& transaction : streams.transactions) {
+        streams.layouts.push_back(layoutOf(log, transaction));
+        for (const auto& field : streams.layouts.back().fields) {
+            present[static_cast<std::size_t>(field.parameter)] = true;
+        }
+    }
+    ColumnarLogSummary summary {0, 0, 0, {}};
+    std::vector<std::size_t> columns(ENGINE_PARAMETER_COUNT);
+    for (std::size_t i = 0; i < ENGINE_PARAMETER_COUNT; i++) {
+        if (present[i]) {
+            columns[i] = summary.parameters.size();
+            summary.parameters.push_back(static_cast<EngineParameter>(i));
+        }
+    }
+    for (auto& layout : streams.layouts) {
+        for (auto& field : layout.fields) {
+            field.column = columns[static_cast<std::size_t>(field.parameter)];
+        }
+    }
+    streams.columns = summary.parameters.size();
+
+    // Split the log into tasks at indexed positions outside of frames.
+    std::vector<LogPosition> bounds {index[0]};
+    for (std::size_t i = 1; i < index.size(); i++) {
+        LogPosition position = index[i];
+        if (position.frame_state == 0 && position.offset - bounds.back().offset >= TASK_SIZE) {
+            bounds.push_back(position);
+        }
+    }
+    LogPosition end = {size, 0, 0, 0, index.records(), 0, 0, 0};
+    bounds.push_back(end);
+
+    // Decode the tasks a batch at a time, writing each batch in order.
+    BlockWriter writer(output_stream, summary.parameters, block_rows);
+    std::size_t tasks = bounds.size() - 1;
+    std::size_t batch_size = pool.size() * TASKS_PER_THREAD;
+    for (std::size_t first = 0; first < tasks; first += batch_size) {
+        std::size_t count = std::min(batch_size, tasks - first);
+        std::vector<DecodedRows> batch(count);
+        pool.run(count, [&](std::size_t i) {
+            decodeRange(log, bounds[first + i], bounds[first + i + 1], streams, batch[i]);
+        });
+        for (const auto& rows : batch) {
+            writer.append(rows);
+            summary.skipped_frames += rows.skipped_frames;
+        }
+    }
+    writer.finish();
+    summary.rows = writer.rowCount();
+    summary.blocks = writer.blockCount();
+    return summary;
+}
+
+
+}
@@ -0,0 +1,215 @@
+#ifndef OPENCONSULT_LIB_LOG_COLUMNS
+#define OPENCONSULT_LIB_LOG_COLUMNS
+
+#include "consult_engine_parameters.h"
+#include "log_format.h"
+#include "log_index.h"
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace openconsult {
+
+
+/**
+ * @brief A summary of a log decoded by \c decodeLog(...) .
+ */
+struct ColumnarLogSummary {
+    /// @brief The number of rows written: one per decoded frame.
+    uint64_t rows;
+    /// @brief The number of blocks the rows were written in.
+    uint64_t blocks;
+    /// @brief The number of frames streamed in response to register
+    ///     selections which could not be decoded as their length did not
+    ///     match the number of registers selected.
+    uint64_t skipped_frames;
+    /// @brief The parameters decoded, one per column, in column order.
+    std::vector<EngineParameter> parameters;
+};
+
+
+/**
+ * @brief A columnar log: the engine parameters streamed in a log, decoded into
+ *      a time-series file for analysis. Written by \c decodeLog(...) .
+ *
+ * Each row holds a decoded frame: its log time (see \c recordStartTime(...) )
+ * and the value of each parameter. Each parameter streamed anywhere in the
+ * log has a column, in \c EngineParameter order. Parameters not streamed in
+ * a row's frame are NaN.
+ *
+ * Rows are stored in blocks of a fixed number of rows, only the last block
+ * being shorter. Within a block each column is contiguous, so reading one
+ * column touches none of the others' data. Each block records the minimum and
+ * maximum of each column (a zone map), so blocks holding no values of interest
+ * can be skipped without reading them.
+ *
+ * The file is laid out as follows. Integers and values are little-endian;
+ * values are IEEE 754 doubles.
+ * - A header: the magic "OCLC", a version byte (1), and three zero bytes;
+ *   then, each as a uint32, the number of rows per block and the number of
+ *   parameter columns; then the \c EngineParameter of each column as a byte,
+ *   zero padded to a multiple of eight bytes.
+ * - The blocks: the block's log times as uint64s, then each column's values.
+ * - The block directory: for each block, as uint64s, its offset, its number
+ *   of rows and its first and last log times; then the minimum and maximum of
+ *   each column, NaN if the column holds no values in the block.
+ * - A 24 byte trailer: as uint64s, the offset of the block directory, the
+ *   number of rows and the number of blocks.
+ *
+ * The file is accessed in place when opened, so is memory mapped rather than
+ * read. Column data is returned as pointers into the mapping.
+ */
+class ColumnarLog {
+public:
+    /// @brief The default number of rows in each block.
+    static const uint32_t DEFAULT_BLOCK_ROWS = 4096;
+
+    /**
+     * @brief Construct a new \c ColumnarLog by mapping a columnar log file into
+     *      memory.
+     *
+     * @param path Path of the file.
+     * @throws os_error if the file cannot be opened or mapped.
+     * @throws std::invalid_argument if the file is not a valid columnar log.
+     */
+    explicit ColumnarLog(const std::string& path);
+
+    /**
+     * @brief Destroy the \c ColumnarLog .
+     */
+    ~ColumnarLog();
+
+    /**
+     * @brief The parameters held, one per column, in column order.
+     */
+    const std::vector<EngineParameter>& parameters() const;
+
+    /**
+     * @brief Finds the column holding a parameter.
+     *
+     * @param parameter The parameter.
+     * @return The index of the parameter's column.
+     * @throws std::invalid_argument if the parameter was not decoded.
+     */
+    std::size_t column(EngineParameter parameter) const;
+
+    /**
+     * @brief The number of rows in each block, other than the last.
+     */
+    uint32_t blockRows() const;
+
+    /**
+     * @brief The total number of rows.
+     */
+    uint64_t rows() const;
+
+    /**
+     * @brief The number of blocks.
+     */
+    std::size_t blocks() const;
+
+    /**
+     * @brief The number of rows in a block.
+     *
+     * @param block The index of the block. Must be less than \c blocks() .
+     */
+    std::size_t blockSize(std::size_t block) const;
+
+    /**
+     * @brief The log time of a block's first row, in nanoseconds.
+     *
+     * @param block The index of the block. Must be less than \c blocks() .
+     */
+    uint64_t startTime(std::size_t block) const;
+
+    /**
+     * @brief The log time of a block's last row, in nanoseconds.
+     *
+     * @param block The index of the block. Must be less than \c blocks() .
+     */
+    uint64_t endTime(std::size_t block) const;
+
+    /**
+     * @brief The smallest value in a block's column.
+     *
+     * @param block The index of the block. Must be less than \c blocks() .
+     * @param column The index of the column. Must be less than
+     *      \c parameters().size() .
+     * @return The value, or NaN if the column holds no values in the block.
+     */
+    double minimum(std::size_t block, std::size_t column) const;
+
+    /**
+     * @brief The largest value in a block's column.
+     *
+     * @param block The index of the block. Must be less than \c blocks() .
+     * @param column The index of the column. Must be less than
+     *      \c parameters().size() .
+     * @return The value, or NaN if the column holds no values in the block.
+     */
+    double maximum(std::size_t block, std::size_t column) const;
+
+    /**
+     * @brief Accesses the log times of a block's rows.
+     *
+     * @param block The index of the block. Must be less than \c blocks() .
+     * @return Pointer to \c blockSize(block) log times, in nanoseconds. Valid
+     *      for the lifetime of this object.
+     */
+    const uint64_t* times(std::size_t block) const;
+
+    /**
+     * @brief Accesses the values of a block's column.
+     *
+     * @param block The index of the block. Must be less than \c blocks() .
+     * @param column The index of the column. Must be less than
+     *      \c parameters().size() .
+     * @return Pointer to \c blockSize(block) values. Valid for the lifetime of
+     *      this object.
+     */
+    const double* values(std::size_t block, std::size_t column) const;
+
+private:
+    class impl;
+    std::unique_ptr<impl> pimpl;
+};
+
+
+/**
+ * @brief Decodes the engine parameters streamed in a log into a
+ *      \c ColumnarLog .
+ *
+ * Streams are found by segmenting the log with \c segmentLog(...) . The
+ * parameters each stream requested are reconstructed from the register
+ * selection (5A xx) commands before its go-ahead, and every frame streamed in
+ * response is decoded as those parameters. Registers which are not part of
+ * any \c EngineParameter are skipped.
+ *
+ * Decoding is split into tasks between the log's indexed positions, so each
+ * may be decoded without parsing what precedes it, and run on a
+ * \c TaskPool . Tasks run in batches, each written before the next is decoded,
+ * so memory use is bounded regardless of the log's size.
+ *
+ * @param data Pointer to the log.
+ * @param size The size of the log, in bytes.
+ * @param format The format the log is in.
+ * @param index An index of the log.
+ * @param output_stream Stream to write the columnar log file to.
+ * @param threads The number of threads to use, or zero to use one per core.
+ * @param block_rows The number of rows in each block.
+ * @return A summary of the decoded log.
+ * @throws std::invalid_argument if the log is poorly formatted, \c index is
+ *      not an index of the log, or \c block_rows is zero.
+ */
+ColumnarLogSummary decodeLog(const uint8_t* data, std::size_t size, LogFormat format,
+                             const LogIndex& index, std::ostream& output_stream,
+                             unsigned threads = 0,
+                             uint32_t block_rows = ColumnarLog::DEFAULT_BLOCK_ROWS);
+
+
+}
+
+#endif
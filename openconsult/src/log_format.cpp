@@ -0,0 +1,524 @@
+#include "log_format.h"
+#include "common.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace openconsult {
+
+
+/// @brief The file header starting each binary log.
+static const uint8_t BINARY_HEADER[8] = {'O', 'C', 'L', 'G', 0x01, 0x00, 0x00, 0x00};
+/// @brief The pattern starting each sync marker in a binary log.
+static const uint8_t BINARY_SYNC[8] = {'S', 'Y', 'N', 'C', 0xA5, 0x5A, 0xC3, 0x3C};
+/// @brief The number of records between sync markers in a binary log.
+static const uint64_t BINARY_SYNC_INTERVAL = 1024;
+/// @brief The largest encoded varint, in bytes.
+static const std::size_t MAX_VARINT_SIZE = 10;
+
+
+//
+// Text format
+//
+
+class TextLogWriter : public LogWriter {
+public:
+    TextLogWriter(std::ostream& stream)
+        : stream(stream) {
+    }
+
+    void write(LogRecordType type, uint64_t /*timestamp*/, const uint8_t* data, std::size_t size) override {
+        // The text format cannot represent empty records, but as they hold no
+        // data there is nothing to replay from them either.
+        if (size == 0) {
+            return;
+        }
+        // Build the whole line in a reused buffer so each record costs a
+        // single write to the stream.
+        line.resize(2 * size + 3);
+        line[0] = type == LogRecordType::READ ? 'R' : 'W';
+        line[1] = ' ';
+        cmn::hex_encode(data, size, &line[2]);
+        line.back() = '\n';
+        stream.write(line.data(), line.size());
+    }
+
+private:
+    std::ostream& stream;
+    std::string line;
+};
+
+
+class TextLogReader : public LogReader {
+public:
+    TextLogReader(std::istream& stream)
+        : stream(stream) {
+    }
+
+    bool read(LogRecord& record) override {
+        if (!std::getline(stream, line)) {
+            return false;
+        }
+        // Tolerate CRLF line endings, as the stream may be opened in binary
+        // mode.
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        // The line format is as follows:
+        // (R|W) [0-9a-fA-F]{2}+
+        // Where,
+        // - the first character denotes the record type (read or write).
+        // - the second character is always a space
+        // - the rest of the line is made up of one or more bytes of hex data.
+        // This means the line must have an even length.
+        // Sanity check the provided line before we go any further.
+        if (line.length() < 4 || line.length() % 2) {
+            throwParseError();
+        }
+
+        // Parse type.
+        switch (line[0]) {
+            case 'R': record.type = LogRecordType::READ; break;
+            case 'W': record.type = LogRecordType::WRITE; break;
+            default: throwParseError();
+        }
+
+        // Ensure separator is present.
+        if (line[1] != ' ') {
+            throwParseError();
+        }
+
+        // Read data.
+        record.timestamp = 0;
+        record.data.resize((line.length() - 2) / 2);
+        if (!cmn::hex_decode(line.data() + 2, record.data.size(), record.data.data())) {
+            throwParseError();
+        }
+        return true;
+    }
+
+private:
+    [[noreturn]] void throwParseError() const {
+        std::string error = cmn::pformat("Failed to parse line: %s", line.c_str());
+        throw std::invalid_argument(error);
+    }
+
+    std::istream& stream;
+    /// @brief The most recently read line, reused to avoid allocating.
+    std::string line;
+};
+
+
+
+//
+// Binary format
+//
+
+/**
+ * @brief Encodes an unsigned LEB128 varint.
+ *
+ * @param value The value to encode.
+ * @param dst Buffer to encode to. Must have space for \c MAX_VARINT_SIZE bytes.
+ * @return The number of bytes written.
+ */
+static std::size_t encodeVarint(uint64_t value, uint8_t* dst) {
+    std::size_t size = 0;
+    while (value >= 0x80) {
+        dst[size++] = static_cast<uint8_t>(value) | 0x80;
+        value >>= 7;
+    }
+    dst[size++] = static_cast<uint8_t>(value);
+    return size;
+}
+
+class BinaryLogWriter : public LogWriter {
+public:
+    BinaryLogWriter(std::ostream& stream)
+            : stream(stream)
+            , last_timestamp(0)
+            , record_count(0) {
+        stream.write(reinterpret_cast<const char*>(BINARY_HEADER), sizeof(BINARY_HEADER));
+        writeSync(0);
+    }
+
+    void write(LogRecordType type, uint64_t timestamp, const uint8_t* data, std::size_t size) override {
+        if (timestamp < last_timestamp) {
+            throw std::invalid_argument("Log record timestamps must not decrease");
+        }
+        if (record_count > 0 && record_count % BINARY_SYNC_INTERVAL == 0) {
+            writeSync(timestamp);
+        }
+        uint8_t header[1 + 2 * MAX_VARINT_SIZE];
+        std::size_t header_size = 0;
+        header[header_size++] = type == LogRecordType::READ ? 'R' : 'W';
+        header_size += encodeVarint(timestamp - last_timestamp, header + header_size);
+        header_size += encodeVarint(size, header + header_size);
+        stream.write(reinterpret_cast<const char*>(header), header_size);
+        stream.write(reinterpret_cast<const char*>(data), size);
+        last_timestamp = timestamp;
+        record_count++;
+    }
+
+private:
+    void writeSync(uint64_t timestamp) {
+        uint8_t sync[sizeof(BINARY_SYNC) + 2 * sizeof(uint64_t)];
+        std::memcpy(sync, BINARY_SYNC, sizeof(BINARY_SYNC));
+        cmn::encode_uint(timestamp, sizeof(uint64_t), sync + sizeof(BINARY_SYNC));
+        cmn::encode_uint(record_count, sizeof(uint64_t), sync + sizeof(BINARY_SYNC) + sizeof(uint64_t));
+        stream.write(reinterpret_cast<const char*>(sync), sizeof(sync));
+        last_timestamp = timestamp;
+    }
+
+    std::ostream& stream;
+    uint64_t last_timestamp;
+    uint64_t record_count;
+};
+
+
+class BinaryLogReader : public LogReader {
+public:
+    BinaryLogReader(std::istream& stream)
+            : stream(stream)
+            , timestamp(0) {
+        // An empty stream is an empty log. Otherwise it must start with a
+        // header.
+        if (stream.peek() != std::char_traits<char>::eof()) {
+            if (stream.get() != BINARY_HEADER[0]) {
+                throw std::invalid_argument("Binary log is missing its header");
+            }
+            readHeader();
+        }
+    }
+
+    bool read(LogRecord& record) override {
+        while (true) {
+            int tag = stream.get();
+            switch (tag) {
+                case std::char_traits<char>::eof():
+                    return false;
+                case 'R':
+                case 'W': {
+                    record.type = tag == 'R' ? LogRecordType::READ : LogRecordType::WRITE;
+                    timestamp += readVarint();
+                    record.timestamp = timestamp;
+                    readData(record.data, readVarint());
+                    return true;
+                }
+                case 'S': {
+                    uint8_t sync[sizeof(BINARY_SYNC) - 1 + 2 * sizeof(uint64_t)];
+                    readExactly(sync, sizeof(sync));
+                    if (std::memcmp(sync, BINARY_SYNC + 1, sizeof(BINARY_SYNC) - 1) != 0) {
+                        throw std::invalid_argument("Invalid binary log sync marker");
+                    }
+                    timestamp = cmn::decode_uint(sync + sizeof(BINARY_SYNC) - 1, sizeof(uint64_t));
+                    break;
+                }
+                case 'O':
+                    // A concatenated log.
+                    readHeader();
+                    timestamp = 0;
+                    break;
+                default:
+                    std::string error = cmn::pformat("Invalid binary log entry: %02x", tag);
+                    throw std::invalid_argument(error);
+            }
+        }
+    }
+
+private:
+    void readHeader() {
+        uint8_t header[sizeof(BINARY_HEADER) - 1];
+        readExactly(header, sizeof(header));
+        if (std::memcmp(header, BINARY_HEADER + 1, sizeof(header)) != 0) {
+            throw std::invalid_argument("Invalid binary log header");
+        }
+    }
+
+    void readExactly(uint8_t* dst, std::size_t size) {
+        stream.read(reinterpret_cast<char*>(dst), size);
+        if (static_cast<std::size_t>(stream.gcount()) != size) {
+            throw std::invalid_argument("Binary log is truncated");
+        }
+    }
+
+    uint64_t readVarint() {
+        uint64_t value = 0;
+        for (std::size_t i = 0; i < MAX_VARINT_SIZE; i++) {
+            int byte = stream.get();
+            if (byte == std::char_traits<char>::eof()) {
+                throw std::invalid_argument("Binary log is truncated");
+            }
+            value |= static_cast<uint64_t>(byte & 0x7F) << (7 * i);
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        throw std::invalid_argument("Invalid binary log varint");
+    }
+
+    void readData(std::vector<uint8_t>& data, uint64_t size) {
+        // Grow the buffer as data arrives rather than trusting the length up
+        // front, so a corrupt length cannot trigger a huge allocation.
+        static const std::size_t CHUNK_SIZE = 64 * 1024;
+        data.clear();
+        while (data.size() < size) {
+            std::size_t offset = data.size();
+            std::size_t chunk = static_cast<std::size_t>(std::min<uint64_t>(size - offset, CHUNK_SIZE));
+            data.resize(offset + chunk);
+            readExactly(data.data() + offset, chunk);
+        }
+    }
+
+    std::istream& stream;
+    /// @brief The timestamp of the most recent record or sync marker.
+    uint64_t timestamp;
+};
+
+
+
+//
+// In-memory parsing
+//
+
+LogBufferParser::LogBufferParser()
+        : origin(nullptr)
+        , begin(nullptr)
+        , end(nullptr)
+        , cursor(nullptr)
+        , format(LogFormat::TEXT)
+        , timestamp(0) {
+}
+
+LogBufferParser::LogBufferParser(const uint8_t* data, std::size_t size, LogFormat format)
+        : origin(data)
+        , begin(data)
+        , end(data + size)
+        , cursor(data)
+        , format(format)
+        , timestamp(0) {
+    if (format == LogFormat::BINARY && size > 0) {
+        if (size < sizeof(BINARY_HEADER) ||
+                std::memcmp(data, BINARY_HEADER, sizeof(BINARY_HEADER)) != 0) {
+            throw std::invalid_argument("Invalid binary log header");
+        }
+        // Skip the header.
+        begin += sizeof(BINARY_HEADER);
+        cursor = begin;
+    } else if (format != LogFormat::TEXT && format != LogFormat::BINARY) {
+        std::string error = cmn::pformat("Unknown log format: %d", format);
+        throw std::invalid_argument(error);
+    }
+}
+
+bool LogBufferParser::next(LogRecordView& record) {
+    if (format == LogFormat::TEXT) {
+        return nextText(record);
+    } else {
+        return nextBinary(record);
+    }
+}
+
+std::size_t LogBufferParser::position() const {
+    return static_cast<std::size_t>(cursor - origin);
+}
+
+uint64_t LogBufferParser::lastTimestamp() const {
+    return timestamp;
+}
+
+void LogBufferParser::seek(std::size_t position, uint64_t timestamp) {
+    if (position < static_cast<std::size_t>(begin - origin) ||
+            position > static_cast<std::size_t>(end - origin)) {
+        std::string error = cmn::pformat("Invalid log position: %zu", position);
+        throw std::invalid_argument(error);
+    }
+    cursor = origin + position;
+    this->timestamp = timestamp;
+}
+
+void LogBufferParser::rewind() {
+    cursor = begin;
+    timestamp = 0;
+}
+
+bool LogBufferParser::nextText(LogRecordView& record) {
+    if (cursor == end) {
+        return false;
+    }
+    const uint8_t* line = cursor;
+    const uint8_t* line_end = static_cast<const uint8_t*>(std::memchr(line, '\n', end - line));
+    if (line_end) {
+        cursor = line_end + 1;
+    } else {
+        line_end = end;
+        cursor = end;
+    }
+    // Tolerate CRLF line endings.
+    if (line_end != line && line_end[-1] == '\r') {
+        line_end--;
+    }
+
+    // See TextLogReader::read(...) for the line format.
+    std::size_t length = line_end - line;
+    bool valid = length >= 4 && length % 2 == 0 && (line[0] == 'R' || line[0] == 'W') &&
+                 line[1] == ' ' &&
+                 cmn::is_hex(reinterpret_cast<const char*>(line) + 2, length - 2);
+    if (!valid) {
+        std::string text(reinterpret_cast<const char*>(line), length);
+        std::string error = cmn::pformat("Failed to parse line: %s", text.c_str());
+        throw std::invalid_argument(error);
+    }
+
+    record.type = line[0] == 'R' ? LogRecordType::READ : LogRecordType::WRITE;
+    record.timestamp = 0;
+    record.data = line + 2;
+    record.size = (length - 2) / 2;
+    record.hex = true;
+    return true;
+}
+
+/**
+ * @brief Decodes an unsigned LEB128 varint from memory.
+ *
+ * @param cursor Pointer to the varint. Advanced past it.
+ * @param end Pointer to the end of the buffer.
+ * @return The decoded value.
+ * @throws std::invalid_argument if the varint is truncated or too long.
+ */
+static uint64_t decodeVarint(const uint8_t*& cursor, const uint8_t* end) {
+    uint64_t value = 0;
+    for (std::size_t i = 0; i < MAX_VARINT_SIZE; i++) {
+        if (cursor == end) {
+            throw std::invalid_argument("Binary log is truncated");
+        }
+        uint8_t byte = *(cursor++);
+        value |= static_cast<uint64_t>(byte & 0x7F) << (7 * i);
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    throw std::invalid_argument("Invalid binary log varint");
+}
+
+bool LogBufferParser::nextBinary(LogRecordView& record) {
+    while (cursor != end) {
+        uint8_t tag = *cursor;
+        std::size_t remaining = end - cursor;
+        switch (tag) {
+            case 'R':
+            case 'W': {
+                const uint8_t* pos = cursor + 1;
+                uint64_t delta = decodeVarint(pos, end);
+                uint64_t size = decodeVarint(pos, end);
+                if (size > static_cast<uint64_t>(end - pos)) {
+                    throw std::invalid_argument("Binary log is truncated");
+                }
+                timestamp += delta;
+                record.type = tag == 'R' ? LogRecordType::READ : LogRecordType::WRITE;
+                record.timestamp = timestamp;
+                record.data = pos;
+                record.size = static_cast<std::size_t>(size);
+                record.hex = false;
+                cursor = pos + size;
+                return true;
+            }
+            case 'S': {
+                std::size_t sync_size = sizeof(BINARY_SYNC) + 2 * sizeof(uint64_t);
+                if (remaining < sync_size) {
+                    throw std::invalid_argument("Binary log is truncated");
+                }
+                if (std::memcmp(cursor, BINARY_SYNC, sizeof(BINARY_SYNC)) != 0) {
+                    throw std::invalid_argument("Invalid binary log sync marker");
+                }
+                timestamp = cmn::decode_uint(cursor + sizeof(BINARY_SYNC), sizeof(uint64_t));
+                cursor += sync_size;
+                break;
+            }
+            case 'O':
+                // A concatenated log.
+                if (remaining < sizeof(BINARY_HEADER)) {
+                    throw std::invalid_argument("Binary log is truncated");
+                }
+                if (std::memcmp(cursor, BINARY_HEADER, sizeof(BINARY_HEADER)) != 0) {
+                    throw std::invalid_argument("Invalid binary log header");
+                }
+                timestamp = 0;
+                cursor += sizeof(BINARY_HEADER);
+                break;
+            default:
+                std::string error = cmn::pformat("Invalid binary log entry: %02x", tag);
+                throw std::invalid_argument(error);
+        }
+    }
+    return false;
+}
+
+
+
+//
+// Public API
+//
+
+std::unique_ptr<LogWriter> LogWriter::create(std::ostream& output_stream, LogFormat format) {
+    switch (format) {
+        case LogFormat::TEXT:
+            return std::unique_ptr<LogWriter>(new TextLogWriter(output_stream));
+        case LogFormat::BINARY:
+            return std::unique_ptr<LogWriter>(new BinaryLogWriter(output_stream));
+        default:
+            std::string error = cmn::pformat("Unknown log format: %d", format);
+            throw std::invalid_argument(error);
+    }
+}
+
+std::unique_ptr<LogReader> LogReader::create(std::istream& input_stream, LogFormat format) {
+    switch (format) {
+        case LogFormat::TEXT:
+            return std::unique_ptr<LogReader>(new TextLogReader(input_stream));
+        case LogFormat::BINARY:
+            return std::unique_ptr<LogReader>(new BinaryLogReader(input_stream));
+        default:
+            std::string error = cmn::pformat("Unknown log format: %d", format);
+            throw std::invalid_argument(error);
+    }
+}
+
+LogFormat detectLogFormat(std::istream& input_stream) {
+    // Text logs always start with a record type character, which is never the
+    // first character of the binary header.
+    if (input_stream.peek() == BINARY_HEADER[0]) {
+        return LogFormat::BINARY;
+    }
+    return LogFormat::TEXT;
+}
+
+std::size_t findResumePosition(const uint8_t* data, std::size_t size, LogFormat format, std::size_t from) {
+    if (from == 0 || from >= size) {
+        return std::min(from, size);
+    }
+    if (format == LogFormat::TEXT) {
+        // Find the end of the line holding the byte before from.
+        const void* newline = std::memchr(data + from - 1, '\n', size - from + 1);
+        return newline ? static_cast<const uint8_t*>(newline) - data + 1 : size;
+    }
+    from = std::max(from, sizeof(BINARY_HEADER));
+    return std::search(data + from, data + size, BINARY_SYNC, BINARY_SYNC + sizeof(BINARY_SYNC)) - data;
+}
+
+uint64_t convertLog(std::istream& input_stream, LogFormat input_format,
+                    std::ostream& output_stream, LogFormat output_format) {
+    auto reader = LogReader::create(input_stream, input_format);
+    auto writer = LogWriter::create(output_stream, output_format);
+    LogRecord record;
+    uint64_t count = 0;
+    while (reader->read(record)) {
+        writer->write(record);
+        count++;
+    }
+    return count;
+}
+
+
+}
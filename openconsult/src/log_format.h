@@ -0,0 +1,322 @@
+#ifndef OPENCONSULT_LIB_LOG_FORMAT
+#define OPENCONSULT_LIB_LOG_FORMAT
+
+#include "common.h"
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace openconsult {
+
+
+/**
+ * @brief The on-disk format of a transaction log, as written by a
+ *      \c LogRecorder and read by a \c LogReplay .
+ *
+ * TEXT logs hold one record per line: a record type character ('R' or 'W'), a
+ * space, then the record's bytes in hex. They carry no timestamps.
+ *
+ * BINARY logs are laid out as follows. All multi-byte integers are
+ * little-endian. Varints are unsigned LEB128.
+ * - An 8 byte file header: the magic "OCLG", a version byte (1) and three zero
+ *   bytes.
+ * - A sequence of entries, each starting with a tag byte:
+ *   - 'R' or 'W': a read or write record. Followed by a varint timestamp,
+ *     in nanoseconds since the previous record or sync marker; a varint data
+ *     length; then the data.
+ *   - 'S': a sync marker. Followed by the seven bytes "YNC" A5 5A C3 3C
+ *     (completing an eight byte pattern that can be searched for), the
+ *     absolute timestamp in nanoseconds as a uint64, and the number of records
+ *     preceding the marker in the log as a uint64. Written at the start of the
+ *     log and periodically thereafter, so a reader can start from any marker.
+ *   - 'O': a further file header, as produced by concatenating logs. Followed
+ *     by the remaining seven bytes of the header.
+ */
+enum class LogFormat {
+    TEXT,
+    BINARY,
+};
+
+
+/**
+ * @brief The type of transaction described by a \c LogRecord .
+ */
+enum class LogRecordType {
+    READ,
+    WRITE,
+};
+
+
+/**
+ * @brief A single entry in a transaction log: one or more consecutive bytes
+ *      transferred in the same direction.
+ */
+struct LogRecord {
+    /// @brief The \c LogRecordType represented by this record.
+    LogRecordType type;
+    /// @brief The monotonic time at which the record began, in nanoseconds
+    ///     since the start of the log. Zero for logs without timestamps.
+    uint64_t timestamp;
+    /// @brief The data that is in this record.
+    std::vector<uint8_t> data;
+};
+
+
+/**
+ * @brief Calculates when a record began transferring, in log time.
+ *
+ * A record cannot begin before the previous record finished transferring. So
+ * logs without timestamps are timed as a continuous transfer at the Consult
+ * baud rate, and logs with timestamps gain no time from concatenation. Log
+ * time therefore never decreases.
+ *
+ * @param timestamp The record's timestamp.
+ * @param line_time The time the previous record finished transferring.
+ * @return The time the record began transferring, in nanoseconds.
+ */
+inline uint64_t recordStartTime(uint64_t timestamp, uint64_t line_time) {
+    return timestamp > line_time ? timestamp : line_time;
+}
+
+
+/**
+ * @brief Writes \c LogRecord s to a stream in a given \c LogFormat .
+ */
+class LogWriter {
+public:
+    /**
+     * @brief Construct a new \c LogWriter . Any file header is written
+     *      immediately.
+     *
+     * @param output_stream Stream to write the log to.
+     * @param format The format to write the log in.
+     * @return The constructed writer.
+     */
+    static std::unique_ptr<LogWriter> create(std::ostream& output_stream, LogFormat format);
+
+    virtual ~LogWriter() = default;
+
+    /**
+     * @brief Writes a single record.
+     *
+     * @param type The type of the record.
+     * @param timestamp The record's timestamp, in nanoseconds since the start
+     *      of the log. Must not decrease between records.
+     * @param data Pointer to the record's data.
+     * @param size The number of bytes of data.
+     */
+    virtual void write(LogRecordType type, uint64_t timestamp, const uint8_t* data, std::size_t size) = 0;
+
+    /**
+     * @brief Writes a single record.
+     *
+     * @param record The record to write.
+     */
+    void write(const LogRecord& record) {
+        write(record.type, record.timestamp, record.data.data(), record.data.size());
+    }
+};
+
+
+/**
+ * @brief Reads \c LogRecord s from a stream in a given \c LogFormat .
+ */
+class LogReader {
+public:
+    /**
+     * @brief Construct a new \c LogReader .
+     *
+     * @param input_stream Stream to read the log from.
+     * @param format The format the log is in.
+     * @return The constructed reader.
+     */
+    static std::unique_ptr<LogReader> create(std::istream& input_stream, LogFormat format);
+
+    virtual ~LogReader() = default;
+
+    /**
+     * @brief Reads the next record.
+     *
+     * @param record Set to the next record. The record's existing storage is
+     *      reused where possible.
+     * @return \c true if a record was read, \c false if the log has ended.
+     * @throws std::invalid_argument if the log is poorly formatted.
+     */
+    virtual bool read(LogRecord& record) = 0;
+};
+
+
+/**
+ * @brief A record parsed in place from a log held in memory. Refers to, rather
+ *      than copies, the record's data, so is only valid while the log is.
+ */
+struct LogRecordView {
+    /// @brief The \c LogRecordType represented by this record.
+    LogRecordType type;
+    /// @brief The monotonic time at which the record began, in nanoseconds
+    ///     since the start of the log. Zero for logs without timestamps.
+    uint64_t timestamp;
+    /// @brief Pointer to the record's data. For TEXT logs this is the hex
+    ///     encoded data, two characters per byte.
+    const uint8_t* data;
+    /// @brief The number of bytes of data in this record.
+    std::size_t size;
+    /// @brief Whether \c data is hex encoded.
+    bool hex;
+
+    /**
+     * @brief Accesses a byte of the record's data, decoding it if necessary.
+     *
+     * @param i The index of the byte. Must be less than \c size .
+     * @return The byte.
+     */
+    uint8_t operator[](std::size_t i) const {
+        if (!hex) {
+            return data[i];
+        }
+        // The digits were validated when the record was parsed. Setting bit 6
+        // distinguishes letters, in either case, from numerals.
+        uint8_t high = data[2 * i];
+        uint8_t low = data[2 * i + 1];
+        return static_cast<uint8_t>(((high & 0xF) + 9 * (high >> 6)) << 4 |
+                                    ((low & 0xF) + 9 * (low >> 6)));
+    }
+};
+
+
+/**
+ * @brief Parses \c LogRecordView s in place from a log held in memory, such as
+ *      a \c MappedFile .
+ *
+ * Records are parsed one at a time, on demand, so construction is cheap
+ * regardless of the log's size. The parser is a small value type: copies may
+ * be taken to remember, and later resume from, a position in the log.
+ */
+class LogBufferParser {
+public:
+    /**
+     * @brief Construct a new \c LogBufferParser over an empty log.
+     */
+    LogBufferParser();
+
+    /**
+     * @brief Construct a new \c LogBufferParser . Only the log's file header,
+     *      if any, is checked.
+     *
+     * @param data Pointer to the log. Must outlive this parser.
+     * @param size The size of the log, in bytes.
+     * @param format The format the log is in.
+     * @throws std::invalid_argument if the log's file header is invalid.
+     */
+    LogBufferParser(const uint8_t* data, std::size_t size, LogFormat format);
+
+    /**
+     * @brief Parses the next record.
+     *
+     * @param record Set to the next record.
+     * @return \c true if a record was parsed, \c false if the log has ended.
+     * @throws std::invalid_argument if the record is poorly formatted.
+     */
+    bool next(LogRecordView& record);
+
+    /**
+     * @brief The current position in the log.
+     *
+     * @return The offset, in bytes from the start of the log, of the first
+     *      byte not yet parsed.
+     */
+    std::size_t position() const;
+
+    /**
+     * @brief The timestamp that the next record's timestamp is relative to.
+     *      Together with \c position() this is all the state needed to resume
+     *      parsing with \c seek(...) .
+     *
+     * @return The timestamp of the most recent record or sync marker, in
+     *      nanoseconds.
+     */
+    uint64_t lastTimestamp() const;
+
+    /**
+     * @brief Moves the parser to a position previously reached by parsing the
+     *      same log.
+     *
+     * @param position The position, as returned by \c position() .
+     * @param timestamp The timestamp at that position, as returned by
+     *      \c lastTimestamp() .
+     * @throws std::invalid_argument if \c position lies outside the log.
+     */
+    void seek(std::size_t position, uint64_t timestamp);
+
+    /**
+     * @brief Returns the parser to the start of the log.
+     */
+    void rewind();
+
+private:
+    bool nextText(LogRecordView& record);
+    bool nextBinary(LogRecordView& record);
+
+    /// @brief The start of the log, including any file header.
+    const uint8_t* origin;
+    /// @brief The first record of the log, after any file header.
+    const uint8_t* begin;
+    const uint8_t* end;
+    const uint8_t* cursor;
+    LogFormat format;
+    /// @brief The timestamp of the most recent record or sync marker.
+    uint64_t timestamp;
+};
+
+
+/**
+ * @brief Determines the format of a log by inspecting its first bytes. The
+ *      stream's position is left unchanged.
+ *
+ * @param input_stream Stream holding the log.
+ * @return \c LogFormat::BINARY if the log starts with a binary file header,
+ *      \c LogFormat::TEXT otherwise.
+ */
+LogFormat detectLogFormat(std::istream& input_stream);
+
+/**
+ * @brief Finds a position from which a log held in memory can be parsed
+ *      without parsing what precedes it. Used to split a log into chunks.
+ *
+ * Such positions are the start of a line in TEXT logs, and sync markers in
+ * BINARY logs. A \c LogBufferParser may be moved to them with a timestamp of
+ * zero, as sync markers carry their own. Sync markers are found by their byte
+ * pattern, so in the unlikely case that a record's data contains the pattern
+ * parsing from the returned position may fail.
+ *
+ * @param data Pointer to the log.
+ * @param size The size of the log, in bytes.
+ * @param format The format the log is in.
+ * @param from The offset to search from.
+ * @return The first such position at or after \c from , or \c size if there
+ *      is none.
+ */
+std::size_t findResumePosition(const uint8_t* data, std::size_t size, LogFormat format, std::size_t from);
+
+/**
+ * @brief Converts a log from one format to another. Records are preserved
+ *      one-to-one. Converting to TEXT discards timestamps. Converting from
+ *      TEXT produces zero timestamps.
+ *
+ * @param input_stream Stream to read the log from.
+ * @param input_format The format of the input log.
+ * @param output_stream Stream to write the converted log to.
+ * @param output_format The format to convert the log to.
+ * @return The number of records converted.
+ * @throws std::invalid_argument if the input log is poorly formatted.
+ */
+uint64_t convertLog(std::istream& input_stream, LogFormat input_format,
+                    std::ostream& output_stream, LogFormat output_format);
+
+
+}
+
+#endif
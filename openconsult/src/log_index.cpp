@@ -0,0 +1,394 @@
+#include "log_index.h"
+#include "common.h"
+#include "mapped_file.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace openconsult {
+
+
+/// @brief The magic and version starting each index file.
+static const uint8_t INDEX_MAGIC[5] = {'O', 'C', 'L', 'X', 0x02};
+/// @brief The size of an index file's header, in bytes.
+static const std::size_t INDEX_HEADER_SIZE = 56;
+/// @brief The size of each position in an index file, in bytes.
+static const std::size_t INDEX_POSITION_SIZE = 56;
+
+// Offsets of the fields in an index file's header.
+static const std::size_t HEADER_FORMAT = 5;
+static const std::size_t HEADER_LOG_SIZE = 8;
+static const std::size_t HEADER_RECORDS = 16;
+static const std::size_t HEADER_FRAMES = 24;
+static const std::size_t HEADER_DURATION = 32;
+static const std::size_t HEADER_POSITIONS = 40;
+static const std::size_t HEADER_CHECKSUM = 48;
+
+/// @brief The number of bytes at each end of a log covered by its checksum.
+static const std::size_t CHECKSUM_SPAN = 4096;
+
+
+/**
+ * @brief Checksums the first and last \c CHECKSUM_SPAN bytes of a log, with
+ *      64-bit FNV-1a, so a log rewritten since it was indexed is detected
+ *      without reading all of it.
+ */
+static uint64_t logChecksum(const uint8_t* data, std::size_t size) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    auto mix = [&hash](const uint8_t* begin, const uint8_t* end) {
+        for (; begin < end; begin++) {
+            hash = (hash ^ *begin) * 0x100000001B3ULL;
+        }
+    };
+    if (size <= 2 * CHECKSUM_SPAN) {
+        mix(data, data + size);
+    } else {
+        mix(data, data + CHECKSUM_SPAN);
+        mix(data + size - CHECKSUM_SPAN, data + size);
+    }
+    return hash;
+}
+
+
+/**
+ * @brief Parses a log forward from a \c LogPosition , stopping at the start of
+ *      each record and of each frame.
+ */
+class PositionWalker {
+public:
+    /**
+     * @brief Construct a new \c PositionWalker .
+     *
+     * @param log Parser over the log.
+     * @param from The position to start from. Its record is parsed
+     *      immediately if the position lies within it.
+     */
+    PositionWalker(const LogBufferParser& log, const LogPosition& from)
+            : parser(log)
+            , current(from)
+            , counter(from.frame_state)
+            , record()
+            , record_time(0)
+            , scan(0)
+            , in_record(false)
+            , at_frame(false) {
+        parser.seek(from.offset, from.timestamp);
+        if (from.byte > 0) {
+            if (!parser.next(record) || from.byte > record.size) {
+                throw std::invalid_argument("Invalid log position");
+            }
+            record_time = recordStartTime(record.timestamp, from.line_time);
+            scan = from.byte;
+            in_record = true;
+        }
+    }
+
+    /**
+     * @brief Advances to the start of the next record or frame.
+     *
+     * @return \c true if one was found, \c false if the log has ended.
+     * @throws std::invalid_argument if the log is poorly formatted.
+     */
+    bool next() {
+        if (at_frame) {
+            current.frame++;
+            at_frame = false;
+        }
+        if (in_record) {
+            if (record.type == LogRecordType::READ) {
+                while (scan < record.size) {
+                    uint32_t state = counter.state();
+                    std::size_t byte = scan++;
+                    if (counter.feed(record[byte])) {
+                        current.time = record_time + byte * BYTE_TIME_NS;
+                        current.byte = static_cast<uint32_t>(byte);
+                        current.frame_state = state;
+                        at_frame = true;
+                        return true;
+                    }
+                }
+            }
+            // Move past the record.
+            current.offset = parser.position();
+            current.timestamp = parser.lastTimestamp();
+            current.line_time = record_time + record.size * BYTE_TIME_NS;
+            current.record++;
+            current.byte = 0;
+            current.frame_state = counter.state();
+            in_record = false;
+        }
+        if (!parser.next(record)) {
+            return false;
+        }
+        record_time = recordStartTime(record.timestamp, current.line_time);
+        current.time = record_time;
+        scan = 0;
+        in_record = true;
+        return true;
+    }
+
+    /**
+     * @brief The current position.
+     */
+    const LogPosition& position() const {
+        return current;
+    }
+
+    /**
+     * @brief Whether the current position is the start of a frame, rather
+     *      than of a record. A position may be both, in which case it is
+     *      reached twice: first as a record, then as a frame.
+     */
+    bool atFrame() const {
+        return at_frame;
+    }
+
+private:
+    LogBufferParser parser;
+    LogPosition current;
+    FrameCounter counter;
+    /// @brief The record holding the current position.
+    LogRecordView record;
+    /// @brief The log time at which \c record began transferring.
+    uint64_t record_time;
+    /// @brief The offset within \c record of the next byte to count frames in.
+    std::size_t scan;
+    bool in_record;
+    bool at_frame;
+};
+
+
+/**
+ * @brief The position at the start of a log.
+ */
+static LogPosition startOf(const LogBufferParser& log) {
+    LogBufferParser start = log;
+    start.rewind();
+    return LogPosition{start.position(), 0, 0, 0, 0, 0, 0, 0};
+}
+
+static void encodePosition(const LogPosition& position, uint8_t* dst) {
+    cmn::encode_uint(position.offset,      8, dst);
+    cmn::encode_uint(position.timestamp,   8, dst + 8);
+    cmn::encode_uint(position.line_time,   8, dst + 16);
+    cmn::encode_uint(position.time,        8, dst + 24);
+    cmn::encode_uint(position.record,      8, dst + 32);
+    cmn::encode_uint(position.frame,       8, dst + 40);
+    cmn::encode_uint(position.byte,        4, dst + 48);
+    cmn::encode_uint(position.frame_state, 4, dst + 52);
+}
+
+static LogPosition decodePosition(const uint8_t* src) {
+    LogPosition position;
+    position.offset      = cmn::decode_uint(src,      8);
+    position.timestamp   = cmn::decode_uint(src + 8,  8);
+    position.line_time   = cmn::decode_uint(src + 16, 8);
+    position.time        = cmn::decode_uint(src + 24, 8);
+    position.record      = cmn::decode_uint(src + 32, 8);
+    position.frame       = cmn::decode_uint(src + 40, 8);
+    position.byte        = static_cast<uint32_t>(cmn::decode_uint(src + 48, 4));
+    position.frame_state = static_cast<uint32_t>(cmn::decode_uint(src + 52, 4));
+    return position;
+}
+
+
+class LogIndex::impl {
+public:
+    /// @brief The index file.
+    const uint8_t* data;
+    std::size_t size;
+
+    impl(const uint8_t* log_data, std::size_t log_size, LogFormat format, uint64_t interval)
+            : data(nullptr)
+            , size(0)
+            , bytes(INDEX_HEADER_SIZE) {
+        if (interval == 0) {
+            throw std::invalid_argument("Log index interval must be non-zero");
+        }
+        LogBufferParser log(log_data, log_size, format);
+        LogPosition start = startOf(log);
+        append(start);
+        LogPosition last = start;
+        uint64_t count = 1;
+
+        PositionWalker walker(log, start);
+        while (walker.next()) {
+            const LogPosition& position = walker.position();
+            bool indexed = walker.atFrame() ?
+                    position.frame > 0 && position.frame % interval == 0 :
+                    position.record > 0 && position.record % interval == 0;
+            // A record may start with a frame, so don't index it twice.
+            if (indexed && (position.record != last.record || position.byte != last.byte)) {
+                append(position);
+                last = position;
+                count++;
+            }
+        }
+
+        const LogPosition& end = walker.position();
+        std::memcpy(bytes.data(), INDEX_MAGIC, sizeof(INDEX_MAGIC));
+        bytes[HEADER_FORMAT] = static_cast<uint8_t>(format);
+        cmn::encode_uint(log_size,      8, bytes.data() + HEADER_LOG_SIZE);
+        cmn::encode_uint(end.record,    8, bytes.data() + HEADER_RECORDS);
+        cmn::encode_uint(end.frame,     8, bytes.data() + HEADER_FRAMES);
+        cmn::encode_uint(end.line_time, 8, bytes.data() + HEADER_DURATION);
+        cmn::encode_uint(count,         8, bytes.data() + HEADER_POSITIONS);
+        cmn::encode_uint(logChecksum(log_data, log_size), 8, bytes.data() + HEADER_CHECKSUM);
+        data = bytes.data();
+        size = bytes.size();
+    }
+
+    impl(const std::string& path)
+            : file(new MappedFile(path)) {
+        data = file->data();
+        size = file->size();
+        if (size < INDEX_HEADER_SIZE || std::memcmp(data, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) {
+            throw std::invalid_argument("Invalid log index header");
+        }
+        if (data[HEADER_FORMAT] > static_cast<uint8_t>(LogFormat::BINARY)) {
+            std::string error = cmn::pformat("Unknown log format: %d", data[HEADER_FORMAT]);
+            throw std::invalid_argument(error);
+        }
+        uint64_t count = header(HEADER_POSITIONS);
+        if (count == 0 || count != (size - INDEX_HEADER_SIZE) / INDEX_POSITION_SIZE ||
+                (size - INDEX_HEADER_SIZE) % INDEX_POSITION_SIZE != 0) {
+            throw std::invalid_argument("Log index is truncated");
+        }
+    }
+
+    uint64_t header(std::size_t offset) const {
+        return cmn::decode_uint(data + offset, 8);
+    }
+
+    std::size_t positions() const {
+        return static_cast<std::size_t>(header(HEADER_POSITIONS));
+    }
+
+    LogPosition position(std::size_t i) const {
+        return decodePosition(data + INDEX_HEADER_SIZE + i * INDEX_POSITION_SIZE);
+    }
+
+    /**
+     * @brief Finds the last indexed position strictly before a position. As
+     *      each unit never decreases through the log, this lies before every
+     *      position matching \c value .
+     *
+     * @return The index of the position, or zero if there is none.
+     */
+    std::size_t findBefore(LogSeekUnit unit, uint64_t value) const {
+        std::size_t low = 0;
+        std::size_t high = positions();
+        while (high - low > 1) {
+            std::size_t mid = low + (high - low) / 2;
+            const uint8_t* entry = data + INDEX_HEADER_SIZE + mid * INDEX_POSITION_SIZE;
+            uint64_t key = 0;
+            switch (unit) {
+                case LogSeekUnit::RECORD: key = cmn::decode_uint(entry + 32, 8); break;
+                case LogSeekUnit::FRAME:  key = cmn::decode_uint(entry + 40, 8); break;
+                case LogSeekUnit::TIME:   key = cmn::decode_uint(entry + 24, 8); break;
+            }
+            if (key < value) {
+                low = mid;
+            } else {
+                high = mid;
+            }
+        }
+        return low;
+    }
+
+private:
+    void append(const LogPosition& position) {
+        std::size_t offset = bytes.size();
+        bytes.resize(offset + INDEX_POSITION_SIZE);
+        encodePosition(position, bytes.data() + offset);
+    }
+
+    /// @brief The index file, when built rather than opened.
+    std::vector<uint8_t> bytes;
+    /// @brief The index file, when opened rather than built.
+    std::unique_ptr<MappedFile> file;
+};
+
+
+const uint64_t LogIndex::DEFAULT_INTERVAL;
+
+LogIndex::LogIndex(const uint8_t* data, std::size_t size, LogFormat format, uint64_t interval)
+        : pimpl(new impl(data, size, format, interval)) {
+}
+
+LogIndex::LogIndex(const std::string& path)
+        : pimpl(new impl(path)) {
+}
+
+LogIndex::~LogIndex() = default;
+
+void LogIndex::write(std::ostream& output_stream) const {
+    output_stream.write(reinterpret_cast<const char*>(pimpl->data), pimpl->size);
+}
+
+LogFormat LogIndex::format() const {
+    return static_cast<LogFormat>(pimpl->data[HEADER_FORMAT]);
+}
+
+uint64_t LogIndex::logSize() const {
+    return pimpl->header(HEADER_LOG_SIZE);
+}
+
+bool LogIndex::matches(const uint8_t* data, std::size_t size, LogFormat format) const {
+    return size == logSize() && format == this->format() &&
+           logChecksum(data, size) == pimpl->header(HEADER_CHECKSUM);
+}
+
+uint64_t LogIndex::records() const {
+    return pimpl->header(HEADER_RECORDS);
+}
+
+uint64_t LogIndex::frames() const {
+    return pimpl->header(HEADER_FRAMES);
+}
+
+uint64_t LogIndex::duration() const {
+    return pimpl->header(HEADER_DURATION);
+}
+
+std::size_t LogIndex::size() const {
+    return pimpl->positions();
+}
+
+LogPosition LogIndex::operator[](std::size_t i) const {
+    return pimpl->position(i);
+}
+
+LogPosition LogIndex::locate(const LogBufferParser& log, LogSeekUnit unit, uint64_t value) const {
+    if ((unit == LogSeekUnit::RECORD && value >= records()) ||
+            (unit == LogSeekUnit::FRAME && value >= frames())) {
+        throw std::invalid_argument("Seek position is beyond the end of the log");
+    }
+    PositionWalker walker(log, pimpl->position(pimpl->findBefore(unit, value)));
+    while (walker.next()) {
+        const LogPosition& position = walker.position();
+        switch (unit) {
+            case LogSeekUnit::RECORD:
+                if (!walker.atFrame() && position.record == value) {
+                    return position;
+                }
+                break;
+            case LogSeekUnit::FRAME:
+                if (walker.atFrame() && position.frame == value) {
+                    return position;
+                }
+                break;
+            case LogSeekUnit::TIME:
+                if (!walker.atFrame() && position.time >= value) {
+                    return position;
+                }
+                break;
+        }
+    }
+    throw std::invalid_argument("Seek position is beyond the end of the log");
+}
+
+
+}
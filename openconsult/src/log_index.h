@@ -0,0 +1,252 @@
+#ifndef OPENCONSULT_LIB_LOG_INDEX
+#define OPENCONSULT_LIB_LOG_INDEX
+
+#include "log_format.h"
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+
+namespace openconsult {
+
+
+/**
+ * @brief The units in which a position in a log may be given.
+ */
+enum class LogSeekUnit {
+    /// @brief The index of a record (transaction) in the log, from zero.
+    RECORD,
+    /// @brief The index of a Consult frame in the log's read data, from zero.
+    ///     See \c FrameCounter .
+    FRAME,
+    /// @brief A log time, in nanoseconds. See \c recordStartTime(...) .
+    TIME,
+};
+
+
+/**
+ * @brief Counts the Consult frames in a log's read data.
+ *
+ * Frames are found as the Consult protocol frames them: a 0xFF start byte, a
+ * length byte, then that many data bytes. Bytes outside of frames, such as
+ * command echoes, are skipped. As logs do not delimit frames this is a
+ * heuristic: a skipped byte of 0xFF is taken to start a frame.
+ */
+class FrameCounter {
+public:
+    /**
+     * @brief Construct a new \c FrameCounter .
+     *
+     * @param state The state to resume from, as returned by \c state() , or
+     *      zero to start outside of a frame.
+     */
+    explicit FrameCounter(uint32_t state = 0)
+            : remaining(state) {
+    }
+
+    /**
+     * @brief Consumes a byte of read data.
+     *
+     * @param byte The byte.
+     * @return \c true if the byte starts a frame.
+     */
+    bool feed(uint8_t byte) {
+        if (remaining == 0) {
+            if (byte == 0xFF) {
+                remaining = AWAITING_LENGTH;
+                return true;
+            }
+        } else if (remaining == AWAITING_LENGTH) {
+            remaining = byte;
+        } else {
+            remaining--;
+        }
+        return false;
+    }
+
+    /**
+     * @brief The counter's state, from which a new counter may resume.
+     *
+     * @return The state.
+     */
+    uint32_t state() const {
+        return remaining;
+    }
+
+private:
+    /// @brief The state between a start byte and its length byte. Lengths are
+    ///     a single byte so this cannot clash with a count of data bytes.
+    static const uint32_t AWAITING_LENGTH = 0x100;
+
+    /// @brief The number of data bytes remaining in the current frame, or
+    ///     \c AWAITING_LENGTH .
+    uint32_t remaining;
+};
+
+
+/**
+ * @brief A position in a log, with all the state needed to resume parsing
+ *      from it.
+ */
+struct LogPosition {
+    /// @brief The \c LogBufferParser::position() of the record holding this
+    ///     position.
+    uint64_t offset;
+    /// @brief The \c LogBufferParser::lastTimestamp() at \c offset .
+    uint64_t timestamp;
+    /// @brief The log time at which the record before \c offset finished
+    ///     transferring.
+    uint64_t line_time;
+    /// @brief The log time of this position.
+    uint64_t time;
+    /// @brief The index of the record holding this position.
+    uint64_t record;
+    /// @brief The number of frames started before this position.
+    uint64_t frame;
+    /// @brief The offset of this position within its record's data.
+    uint32_t byte;
+    /// @brief The \c FrameCounter::state() at this position.
+    uint32_t frame_state;
+};
+
+
+/**
+ * @brief A sparse index of a log, for seeking to a record, frame or time
+ *      without parsing the log from its start.
+ *
+ * Positions are recorded at regular intervals of records and of frames, so
+ * locating any position only parses a bounded stretch of the log.
+ *
+ * An index can be saved alongside its log as a sidecar file, conventionally
+ * named after the log with an ".idx" suffix. The file is laid out as follows.
+ * All integers are little-endian.
+ * - A 56 byte header: the magic "OCLX", a version byte (2), the indexed log's
+ *   \c LogFormat as a byte, and two zero bytes; then, each as a uint64, the
+ *   size of the indexed log in bytes, its number of records, its number of
+ *   frames, its duration in nanoseconds of log time, the number of positions,
+ *   and a 64-bit FNV-1a hash of the log's first and last 4 KiB (or of all of
+ *   it, if smaller than 8 KiB).
+ * - The positions: 56 bytes each, holding the fields of \c LogPosition in
+ *   order. The final two fields are uint32s, the rest uint64s.
+ *
+ * The file is accessed in place when opened, so is memory mapped rather than
+ * read.
+ */
+class LogIndex {
+public:
+    /// @brief The default number of records, and of frames, between indexed
+    ///     positions.
+    static const uint64_t DEFAULT_INTERVAL = 1024;
+
+    /**
+     * @brief Construct a new \c LogIndex by parsing a log in a single pass.
+     *
+     * @param data Pointer to the log.
+     * @param size The size of the log, in bytes.
+     * @param format The format the log is in.
+     * @param interval The number of records, and of frames, between indexed
+     *      positions.
+     * @throws std::invalid_argument if the log is poorly formatted or
+     *      \c interval is zero.
+     */
+    LogIndex(const uint8_t* data, std::size_t size, LogFormat format,
+             uint64_t interval = DEFAULT_INTERVAL);
+
+    /**
+     * @brief Construct a new \c LogIndex by mapping a previously saved index
+     *      file into memory.
+     *
+     * @param path Path of the index file.
+     * @throws os_error if the file cannot be opened or mapped.
+     * @throws std::invalid_argument if the file is not a valid index.
+     */
+    explicit LogIndex(const std::string& path);
+
+    /**
+     * @brief Destroy the \c LogIndex .
+     */
+    ~LogIndex();
+
+    /**
+     * @brief Saves the index.
+     *
+     * @param output_stream Stream to write the index file to.
+     */
+    void write(std::ostream& output_stream) const;
+
+    /**
+     * @brief The format of the indexed log.
+     */
+    LogFormat format() const;
+
+    /**
+     * @brief The size of the indexed log, in bytes.
+     */
+    uint64_t logSize() const;
+
+    /**
+     * @brief Checks that an index file is not stale: that the index was built
+     *      from a given log, going by its size, format and a checksum of its
+     *      first and last few KiB.
+     *
+     * @param data Pointer to the log.
+     * @param size The size of the log, in bytes.
+     * @param format The format the log is in.
+     * @return \c true if the index matches the log.
+     */
+    bool matches(const uint8_t* data, std::size_t size, LogFormat format) const;
+
+    /**
+     * @brief The number of records in the indexed log.
+     */
+    uint64_t records() const;
+
+    /**
+     * @brief The number of frames in the indexed log.
+     */
+    uint64_t frames() const;
+
+    /**
+     * @brief The log time at which the indexed log ends, in nanoseconds.
+     */
+    uint64_t duration() const;
+
+    /**
+     * @brief The number of indexed positions.
+     */
+    std::size_t size() const;
+
+    /**
+     * @brief Accesses an indexed position.
+     *
+     * @param i The index of the position. Must be less than \c size() .
+     * @return The position.
+     */
+    LogPosition operator[](std::size_t i) const;
+
+    /**
+     * @brief Locates a position in the indexed log, parsing forward from the
+     *      nearest indexed position before it.
+     *
+     * Records and times resolve to the start of the first record at or after
+     * them. Frames resolve to the frame's start byte.
+     *
+     * @param log Parser over the indexed log.
+     * @param unit The unit \c value is given in.
+     * @param value The position to locate.
+     * @return The located position.
+     * @throws std::invalid_argument if the position is beyond the end of the
+     *      log, or the log is poorly formatted.
+     */
+    LogPosition locate(const LogBufferParser& log, LogSeekUnit unit, uint64_t value) const;
+
+private:
+    class impl;
+    std::unique_ptr<impl> pimpl;
+};
+
+
+}
+
+#endif
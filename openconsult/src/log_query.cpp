@@ -0,0 +1,450 @@
+#include "log_query.h"
+#include "common.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+namespace openconsult {
+
+
+/**
+ * @brief Splits a query into tokens: words, numbers, comparison operators and
+ *      commas.
+ */
+static std::vector<std::string> tokenize(const std::string& text) {
+    std::vector<std::string> tokens;
+    std::size_t i = 0;
+    while (i < text.size()) {
+        char c = text[i];
+        bool sign = (c == '-' || c == '+') && i + 1 < text.size() &&
+                    (std::isdigit(static_cast<unsigned char>(text[i + 1])) || text[i + 1] == '.');
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            i++;
+        } else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+            std::size_t end = i;
+            while (end < text.size() && (std::isalnum(static_cast<unsigned char>(text[end])) || text[end] == '_')) {
+                end++;
+            }
+            tokens.push_back(text.substr(i, end - i));
+            i = end;
+        } else if (std::isdigit(static_cast<unsigned char>(c)) || c == '.' || sign) {
+            char* end;
+            std::strtod(text.c_str() + i, &end);
+            std::size_t length = end - (text.c_str() + i);
+            if (length == 0) {
+                std::string error = cmn::pformat("Invalid number in query: %s", text.substr(i).c_str());
+                throw std::invalid_argument(error);
+            }
+            tokens.push_back(text.substr(i, length));
+            i += length;
+        } else if (c == '<' || c == '>' || c == '=' || c == '!') {
+            std::size_t length = i + 1 < text.size() && text[i + 1] == '=' ? 2 : 1;
+            tokens.push_back(text.substr(i, length));
+            i += length;
+        } else if (c == ',') {
+            tokens.push_back(",");
+            i++;
+        } else {
+            std::string error = cmn::pformat("Unexpected character in query: '%c'", c);
+            throw std::invalid_argument(error);
+        }
+    }
+    return tokens;
+}
+
+static bool isNumber(const std::string& token) {
+    return !token.empty() && !std::isalpha(static_cast<unsigned char>(token[0])) && token[0] != '_' &&
+           token != "," && token.find_first_of("<>=!") == std::string::npos;
+}
+
+
+/**
+ * @brief Parses a tokenized query.
+ */
+class QueryParser {
+public:
+    QueryParser(const std::string& text)
+            : tokens(tokenize(text))
+            , next(0) {
+    }
+
+    LogQuery parse() {
+        LogQuery query {{}, {}, 0, std::numeric_limits<uint64_t>::max()};
+        do {
+            query.columns.push_back(parseColumn());
+        } while (accept(",") || accept("and"));
+
+        if (accept("where")) {
+            do {
+                query.predicates.push_back(parsePredicate());
+            } while (accept("and"));
+        }
+
+        if (accept("between")) {
+            query.start_time = parseTime();
+            expect("and");
+            query.end_time = parseTime();
+            if (query.start_time > query.end_time) {
+                throw std::invalid_argument("Query time range ends before it starts");
+            }
+        }
+
+        if (next < tokens.size()) {
+            std::string error = cmn::pformat("Unexpected '%s' in query", tokens[next].c_str());
+            throw std::invalid_argument(error);
+        }
+        return query;
+    }
+
+private:
+    const std::string& peek(const char* expected) {
+        if (next == tokens.size()) {
+            std::string error = cmn::pformat("Query ended early, expected %s", expected);
+            throw std::invalid_argument(error);
+        }
+        return tokens[next];
+    }
+
+    bool accept(const std::string& keyword) {
+        if (next == tokens.size() || tokens[next].size() != keyword.size()) {
+            return false;
+        }
+        for (std::size_t i = 0; i < keyword.size(); i++) {
+            if (std::tolower(static_cast<unsigned char>(tokens[next][i])) != keyword[i]) {
+                return false;
+            }
+        }
+        next++;
+        return true;
+    }
+
+    void expect(const std::string& keyword) {
+        const std::string& token = peek(keyword.c_str());
+        if (!accept(keyword)) {
+            std::string error = cmn::pformat("Expected %s in query, found '%s'",
+                                             keyword.c_str(), token.c_str());
+            throw std::invalid_argument(error);
+        }
+    }
+
+    EngineParameter parseColumn() {
+        const std::string& token = peek("a column");
+        for (std::size_t i = 0; i < ENGINE_PARAMETER_COUNT; i++) {
+            EngineParameter parameter = static_cast<EngineParameter>(i);
+            if (engineParameterId(parameter) == token) {
+                next++;
+                return parameter;
+            }
+        }
+        std::string error = cmn::pformat("Unknown column in query: %s", token.c_str());
+        throw std::invalid_argument(error);
+    }
+
+    double parseNumber() {
+        const std::string& token = peek("a number");
+        if (!isNumber(token)) {
+            std::string error = cmn::pformat("Expected a number in query, found '%s'", token.c_str());
+            throw std::invalid_argument(error);
+        }
+        next++;
+        return std::strtod(token.c_str(), nullptr);
+    }
+
+    QueryPredicate parsePredicate() {
+        QueryPredicate predicate;
+        predicate.parameter = parseColumn();
+        const std::string& token = peek("a comparison");
+        if (token == "<") {
+            predicate.comparison = QueryComparison::LESS;
+        } else if (token == "<=") {
+            predicate.comparison = QueryComparison::LESS_EQUAL;
+        } else if (token == ">") {
+            predicate.comparison = QueryComparison::GREATER;
+        } else if (token == ">=") {
+            predicate.comparison = QueryComparison::GREATER_EQUAL;
+        } else if (token == "=" || token == "==") {
+            predicate.comparison = QueryComparison::EQUAL;
+        } else if (token == "!=") {
+            predicate.comparison = QueryComparison::NOT_EQUAL;
+        } else {
+            std::string error = cmn::pformat("Expected a comparison in query, found '%s'", token.c_str());
+            throw std::invalid_argument(error);
+        }
+        next++;
+        predicate.value = parseNumber();
+        return predicate;
+    }
+
+    uint64_t parseTime() {
+        double value = parseNumber();
+        double scale = 1e9;
+        if (accept("ns")) {
+            scale = 1;
+        } else if (accept("us")) {
+            scale = 1e3;
+        } else if (accept("ms")) {
+            scale = 1e6;
+        } else if (accept("s")) {
+            scale = 1e9;
+        } else if (accept("min")) {
+            scale = 60e9;
+        } else if (accept("h")) {
+            scale = 3600e9;
+        }
+        double time = std::round(value * scale);
+        if (!(time >= 0) || time >= 18446744073709551616.0) {
+            throw std::invalid_argument("Query time is out of range");
+        }
+        return static_cast<uint64_t>(time);
+    }
+
+    std::vector<std::string> tokens;
+    std::size_t next;
+};
+
+
+// Comparisons, in scalar and SIMD forms. NaN fails them all.
+
+struct Less {
+    static bool test(double a, double b) { return a < b; }
+#if defined(__AVX__)
+    static __m256d test(__m256d a, __m256d b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+#endif
+#if defined(__SSE2__)
+    static __m128d test(__m128d a, __m128d b) { return _mm_cmplt_pd(a, b); }
+#endif
+};
+
+struct LessEqual {
+    static bool test(double a, double b) { return a <= b; }
+#if defined(__AVX__)
+    static __m256d test(__m256d a, __m256d b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+#endif
+#if defined(__SSE2__)
+    static __m128d test(__m128d a, __m128d b) { return _mm_cmple_pd(a, b); }
+#endif
+};
+
+struct Greater {
+    static bool test(double a, double b) { return a > b; }
+#if defined(__AVX__)
+    static __m256d test(__m256d a, __m256d b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+#endif
+#if defined(__SSE2__)
+    static __m128d test(__m128d a, __m128d b) { return _mm_cmpgt_pd(a, b); }
+#endif
+};
+
+struct GreaterEqual {
+    static bool test(double a, double b) { return a >= b; }
+#if defined(__AVX__)
+    static __m256d test(__m256d a, __m256d b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+#endif
+#if defined(__SSE2__)
+    static __m128d test(__m128d a, __m128d b) { return _mm_cmpge_pd(a, b); }
+#endif
+};
+
+struct Equal {
+    static bool test(double a, double b) { return a == b; }
+#if defined(__AVX__)
+    static __m256d test(__m256d a, __m256d b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+#endif
+#if defined(__SSE2__)
+    static __m128d test(__m128d a, __m128d b) { return _mm_cmpeq_pd(a, b); }
+#endif
+};
+
+struct NotEqual {
+    static bool test(double a, double b) { return a < b || a > b; }
+#if defined(__AVX__)
+    static __m256d test(__m256d a, __m256d b) { return _mm256_cmp_pd(a, b, _CMP_NEQ_OQ); }
+#endif
+#if defined(__SSE2__)
+    // _mm_cmpneq_pd is unordered, so holds for NaN.
+    static __m128d test(__m128d a, __m128d b) { return _mm_or_pd(_mm_cmplt_pd(a, b), _mm_cmpgt_pd(a, b)); }
+#endif
+};
+
+template <typename Compare>
+static void filterWith(const double* values, std::size_t size, double operand, uint64_t* mask) {
+#if defined(__AVX__)
+    const __m256d wide_operand = _mm256_set1_pd(operand);
+#elif defined(__SSE2__)
+    const __m128d wide_operand = _mm_set1_pd(operand);
+#endif
+    for (std::size_t word = 0; word * 64 < size; word++) {
+        if (mask[word] == 0) {
+            // Already filtered out by an earlier predicate.
+            continue;
+        }
+        const double* chunk = values + word * 64;
+        std::size_t count = std::min<std::size_t>(64, size - word * 64);
+        uint64_t bits = 0;
+        std::size_t i = 0;
+#if defined(__AVX__)
+        for (; i + 4 <= count; i += 4) {
+            __m256d matches = Compare::test(_mm256_loadu_pd(chunk + i), wide_operand);
+            bits |= static_cast<uint64_t>(_mm256_movemask_pd(matches)) << i;
+        }
+#elif defined(__SSE2__)
+        for (; i + 2 <= count; i += 2) {
+            __m128d matches = Compare::test(_mm_loadu_pd(chunk + i), wide_operand);
+            bits |= static_cast<uint64_t>(_mm_movemask_pd(matches)) << i;
+        }
+#endif
+        for (; i < count; i++) {
+            bits |= static_cast<uint64_t>(Compare::test(chunk[i], operand)) << i;
+        }
+        mask[word] &= bits;
+    }
+}
+
+/**
+ * @brief Whether any value in a block could satisfy a predicate, given the
+ *      block's zone map for the predicate's column.
+ */
+static bool mayMatch(const QueryPredicate& predicate, double minimum, double maximum) {
+    if (std::isnan(minimum)) {
+        // The column holds no values in the block.
+        return false;
+    }
+    switch (predicate.comparison) {
+        case QueryComparison::LESS:          return minimum < predicate.value;
+        case QueryComparison::LESS_EQUAL:    return minimum <= predicate.value;
+        case QueryComparison::GREATER:       return maximum > predicate.value;
+        case QueryComparison::GREATER_EQUAL: return maximum >= predicate.value;
+        case QueryComparison::EQUAL:         return minimum <= predicate.value && predicate.value <= maximum;
+        case QueryComparison::NOT_EQUAL:     return minimum != predicate.value || maximum != predicate.value;
+        default:                             return true;
+    }
+}
+
+static std::size_t lowestBit(uint64_t bits) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(bits);
+#else
+    std::size_t bit = 0;
+    while (!(bits & 1)) {
+        bits >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+
+LogQuery parseLogQuery(const std::string& text) {
+    return QueryParser(text).parse();
+}
+
+LogQueryResult runLogQuery(const ColumnarLog& log, const LogQuery& query) {
+    LogQueryResult result {{}, std::vector<std::vector<double>>(query.columns.size()), 0, 0};
+
+    // Find the columns. Predicates on columns the log lacks match nothing.
+    const std::size_t absent = std::numeric_limits<std::size_t>::max();
+    auto columnOf = [&](EngineParameter parameter) {
+        const auto& parameters = log.parameters();
+        auto it = std::find(parameters.begin(), parameters.end(), parameter);
+        return it == parameters.end() ? absent : static_cast<std::size_t>(it - parameters.begin());
+    };
+    std::vector<std::size_t> columns;
+    for (auto parameter : query.columns) {
+        columns.push_back(columnOf(parameter));
+    }
+    std::vector<std::size_t> predicate_columns;
+    for (const auto& predicate : query.predicates) {
+        predicate_columns.push_back(columnOf(predicate.parameter));
+        if (predicate_columns.back() == absent) {
+            result.blocks_skipped = log.blocks();
+            return result;
+        }
+    }
+
+    std::vector<uint64_t> mask;
+    for (std::size_t block = 0; block < log.blocks(); block++) {
+        bool skip = log.endTime(block) < query.start_time || log.startTime(block) > query.end_time;
+        for (std::size_t i = 0; i < query.predicates.size() && !skip; i++) {
+            skip = !mayMatch(query.predicates[i], log.minimum(block, predicate_columns[i]),
+                             log.maximum(block, predicate_columns[i]));
+        }
+        if (skip) {
+            result.blocks_skipped++;
+            continue;
+        }
+        result.blocks_read++;
+
+        // Times never decrease, so the time range is a run of rows.
+        const uint64_t* times = log.times(block);
+        std::size_t size = log.blockSize(block);
+        std::size_t first = std::lower_bound(times, times + size, query.start_time) - times;
+        std::size_t rows = std::upper_bound(times + first, times + size, query.end_time) - times - first;
+
+        mask.assign((rows + 63) / 64, ~0ULL);
+        if (rows % 64 != 0) {
+            mask.back() = (1ULL << (rows % 64)) - 1;
+        }
+        for (std::size_t i = 0; i < query.predicates.size(); i++) {
+            filterColumn(log.values(block, predicate_columns[i]) + first, rows,
+                         query.predicates[i].comparison, query.predicates[i].value, mask.data());
+        }
+
+        // Copy the matching rows.
+        std::vector<const double*> values;
+        for (std::size_t column : columns) {
+            values.push_back(column == absent ? nullptr : log.values(block, column) + first);
+        }
+        for (std::size_t word = 0; word < mask.size(); word++) {
+            for (uint64_t bits = mask[word]; bits != 0; bits &= bits - 1) {
+                std::size_t row = word * 64 + lowestBit(bits);
+                result.times.push_back(times[first + row]);
+                for (std::size_t i = 0; i < values.size(); i++) {
+                    result.values[i].push_back(values[i] == nullptr ?
+                                               std::numeric_limits<double>::quiet_NaN() : values[i][row]);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+void filterColumn(const double* values, std::size_t size, QueryComparison comparison,
+                  double operand, uint64_t* mask) {
+    switch (comparison) {
+        case QueryComparison::LESS:
+            filterWith<Less>(values, size, operand, mask);
+            break;
+        case QueryComparison::LESS_EQUAL:
+            filterWith<LessEqual>(values, size, operand, mask);
+            break;
+        case QueryComparison::GREATER:
+            filterWith<Greater>(values, size, operand, mask);
+            break;
+        case QueryComparison::GREATER_EQUAL:
+            filterWith<GreaterEqual>(values, size, operand, mask);
+            break;
+        case QueryComparison::EQUAL:
+            filterWith<Equal>(values, size, operand, mask);
+            break;
+        case QueryComparison::NOT_EQUAL:
+            filterWith<NotEqual>(values, size, operand, mask);
+            break;
+        default:
+            std::string error = cmn::pformat("Unknown query comparison: %d", comparison);
+            throw std::invalid_argument(error);
+    }
+}
+
+
+}
@@ -0,0 +1,126 @@
+#ifndef OPENCONSULT_LIB_LOG_QUERY
+#define OPENCONSULT_LIB_LOG_QUERY
+
+#include "consult_engine_parameters.h"
+#include "log_columns.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace openconsult {
+
+
+/**
+ * @brief The comparisons a \c QueryPredicate may make.
+ */
+enum class QueryComparison {
+    LESS,
+    LESS_EQUAL,
+    GREATER,
+    GREATER_EQUAL,
+    EQUAL,
+    NOT_EQUAL,
+};
+
+
+/**
+ * @brief A condition on a parameter's value. Rows in which the parameter was
+ *      not streamed never satisfy a predicate.
+ */
+struct QueryPredicate {
+    EngineParameter parameter;
+    QueryComparison comparison;
+    /// @brief The value compared against, in the parameter's unit.
+    double value;
+};
+
+
+/**
+ * @brief A query over a \c ColumnarLog : the rows satisfying all of a set of
+ *      predicates within a range of log time, projected onto some columns.
+ */
+struct LogQuery {
+    /// @brief The parameters to return, in order.
+    std::vector<EngineParameter> columns;
+    /// @brief The predicates rows must all satisfy.
+    std::vector<QueryPredicate> predicates;
+    /// @brief The earliest log time to return rows from, in nanoseconds.
+    uint64_t start_time;
+    /// @brief The latest log time to return rows from, in nanoseconds.
+    uint64_t end_time;
+};
+
+
+/**
+ * @brief The rows returned by a \c LogQuery .
+ */
+struct LogQueryResult {
+    /// @brief The log time of each row, in nanoseconds.
+    std::vector<uint64_t> times;
+    /// @brief The values of each of the query's columns, in order. Columns
+    ///     the log does not hold are NaN.
+    std::vector<std::vector<double>> values;
+    /// @brief The number of blocks whose columns were read.
+    uint64_t blocks_read;
+    /// @brief The number of blocks skipped by their zone maps alone.
+    uint64_t blocks_skipped;
+};
+
+
+/**
+ * @brief Parses a \c LogQuery from text such as
+ *      "coolant_temp_degc and engine_speed_rpm where engine_speed_rpm > 6000
+ *      between 60s and 2min".
+ *
+ * A query lists the columns to return, by their \c engineParameterId(...) and
+ * separated by "and" or commas. It may be followed by "where" and predicates
+ * separated by "and", each comparing a column to a number with one of <, <=,
+ * >, >=, = (or ==) and != . Finally "between" two log times limits the rows
+ * returned, inclusively. Times are numbers with an optional unit: ns, us, ms,
+ * s (the default), min or h. Keywords are not case sensitive.
+ *
+ * @param text The query.
+ * @return The parsed query.
+ * @throws std::invalid_argument if the query is poorly formed or names an
+ *      unknown column.
+ */
+LogQuery parseLogQuery(const std::string& text);
+
+/**
+ * @brief Runs a query over a \c ColumnarLog .
+ *
+ * Blocks outside of the query's time range, or whose zone maps show that no
+ * row can satisfy a predicate, are skipped without reading their data. In the
+ * remaining blocks each predicate's column is filtered with SIMD comparisons
+ * into a bitmask of matching rows, and only the matching rows of the
+ * requested columns are copied. Columns that are not part of the query are
+ * never read, so as the log is memory mapped their data is never loaded.
+ *
+ * @param log The log to query.
+ * @param query The query.
+ * @return The rows satisfying the query, in log order.
+ */
+LogQueryResult runLogQuery(const ColumnarLog& log, const LogQuery& query);
+
+/**
+ * @brief Filters a column of values with a comparison, using SIMD where
+ *      available.
+ *
+ * @param values Pointer to the values.
+ * @param size The number of values.
+ * @param comparison The comparison to make.
+ * @param operand The value each value is compared to, as its right hand side.
+ * @param mask A bitmask of \c (size+63)/64 words, holding a bit per value
+ *      (value \c i in bit \c i%64 of word \c i/64 ). Bits of values failing
+ *      the comparison are cleared; others are left unchanged. NaN values fail
+ *      every comparison.
+ */
+void filterColumn(const double* values, std::size_t size, QueryComparison comparison,
+                  double operand, uint64_t* mask);
+
+
+}
+
+#endif
@@ -1,84 +1,383 @@
 #include "log_recorder.h"
 #include "common.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
 namespace openconsult {
 
 
 /**
- * @brief The type of record currently being logged.
+ * @brief Writes transactions to a stream in a given \c LogFormat .
+ */
+class TransactionLog {
+public:
+    TransactionLog(std::ostream& stream, LogFormat format)
+            : stream(stream)
+            , in_record(false)
+            , current_type(LogRecordType::READ) {
+        if (format != LogFormat::TEXT) {
+            writer = LogWriter::create(stream, format);
+        }
+    }
+
+    /**
+     * @brief Logs a transaction.
+     *
+     * @param type The direction of the transaction.
+     * @param timestamp The time of the transaction, in nanoseconds since the
+     *      start of the log.
+     * @param bytes The transferred bytes.
+     * @param size The number of bytes transferred.
+     */
+    void log(LogRecordType type, uint64_t timestamp, const uint8_t* bytes, std::size_t size) {
+        // Record-per-transaction formats are handled by the LogWriter. TEXT
+        // logs are coalesced here instead.
+        if (writer) {
+            writer->write(type, timestamp, bytes, size);
+            return;
+        }
+        // If we're currrently logging a different type, finish the entry.
+        if (!in_record || type != current_type) {
+            if (in_record) {
+                stream << '\n';
+            }
+            switch (type) {
+                case LogRecordType::READ:
+                    stream << 'R' << ' ';
+                    break;
+                case LogRecordType::WRITE:
+                    stream << 'W' << ' ';
+                    break;
+            }
+            in_record = true;
+            current_type = type;
+        }
+        hex.resize(2 * size);
+        cmn::hex_encode(bytes, size, &hex[0]);
+        stream.write(hex.data(), hex.size());
+    }
+
+    /**
+     * @brief Completes the log.
+     */
+    void close() {
+        if (!writer) {
+            // Emit a final newline when closing the log. This is not required
+            // by the replayer, but will allow concatenating logs together.
+            stream << '\n';
+        }
+    }
+
+private:
+    std::ostream& stream;
+    /// @brief Writer for record-per-transaction formats. Null when writing
+    ///     TEXT logs.
+    std::unique_ptr<LogWriter> writer;
+    /// @brief Whether a TEXT record has been started.
+    bool in_record;
+    /// @brief The type of TEXT record currently being logged.
+    LogRecordType current_type;
+    /// @brief Reused buffer for hex encoding TEXT data.
+    std::string hex;
+};
+
+
+/**
+ * @brief Writes transactions to a stream from a dedicated thread.
+ *
+ * Transactions are appended, raw, to a fixed-size front buffer. The writer
+ * thread periodically swaps it with a back buffer, formats the back buffer's
+ * transactions, and writes them to the stream in a single batch. Appending
+ * never blocks: transactions which do not fit in the front buffer are dropped
+ * and counted.
  */
-enum class LogRecordType {
-    READ,
-    WRITE,
-    NONE,
+class AsyncTransactionLog {
+public:
+    AsyncTransactionLog(std::ostream& stream, LogFormat format, std::size_t buffer_size)
+            : stream(stream)
+            , formatter(batch, format)
+            , front_size(0)
+            , buffer_size(buffer_size)
+            , appended(0)
+            , written(0)
+            , flush_requested(false)
+            , stopping(false)
+            , dropped_bytes(0) {
+        front.reset(new uint8_t[buffer_size]);
+        back.reset(new uint8_t[buffer_size]);
+        // Write anything the log has already produced, such as a file header,
+        // before starting the thread.
+        writeBatch();
+        thread = std::thread(&AsyncTransactionLog::run, this);
+    }
+
+    ~AsyncTransactionLog() {
+        close();
+    }
+
+    /**
+     * @copydoc TransactionLog::log(LogRecordType, uint64_t, const uint8_t*, std::size_t)
+     */
+    void log(LogRecordType type, uint64_t timestamp, const uint8_t* bytes, std::size_t size) {
+        if (size == 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (ENTRY_HEADER_SIZE + size > buffer_size - front_size) {
+            dropped_bytes += size;
+            return;
+        }
+        uint8_t* entry = front.get() + front_size;
+        uint32_t entry_size = static_cast<uint32_t>(size);
+        entry[0] = static_cast<uint8_t>(type);
+        std::memcpy(entry + 1, &timestamp, sizeof(timestamp));
+        std::memcpy(entry + 1 + sizeof(timestamp), &entry_size, sizeof(entry_size));
+        std::memcpy(entry + ENTRY_HEADER_SIZE, bytes, size);
+        front_size += ENTRY_HEADER_SIZE + size;
+        appended++;
+        // Wake the writer early if the buffer is filling up.
+        if (front_size > buffer_size / 2) {
+            wake.notify_one();
+        }
+    }
+
+    /**
+     * @brief Blocks until every transaction logged so far has been written,
+     *      and the stream flushed.
+     */
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex);
+        uint64_t target = appended;
+        flush_requested = true;
+        wake.notify_one();
+        done.wait(lock, [&]() { return written >= target && !flush_requested; });
+    }
+
+    /**
+     * @brief Writes every transaction logged so far, completes the log, and
+     *      stops the writer thread.
+     */
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) {
+                return;
+            }
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+        formatter.close();
+        writeBatch();
+        stream.flush();
+    }
+
+    uint64_t droppedBytes() const {
+        return dropped_bytes;
+    }
+
+private:
+    /// @brief The size of the header preceding each transaction in the
+    ///     buffers: the type as a byte, the timestamp as a uint64, then the
+    ///     size as a uint32.
+    static constexpr std::size_t ENTRY_HEADER_SIZE = 1 + sizeof(uint64_t) + sizeof(uint32_t);
+
+    /// @brief The longest the writer thread waits before writing buffered
+    ///     transactions.
+    static constexpr std::chrono::milliseconds WRITE_INTERVAL{100};
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait_for(lock, WRITE_INTERVAL, [&]() {
+                return stopping || flush_requested || front_size > buffer_size / 2;
+            });
+            bool flush = flush_requested || stopping;
+            if (front_size == 0 && !flush) {
+                continue;
+            }
+            uint64_t target = appended;
+            std::size_t back_size = front_size;
+            std::swap(front, back);
+            front_size = 0;
+            lock.unlock();
+
+            // Format and write the transactions without holding the lock, so
+            // the snooped interface is never blocked by the stream.
+            for (std::size_t offset = 0; offset < back_size;) {
+                const uint8_t* entry = back.get() + offset;
+                LogRecordType type = static_cast<LogRecordType>(entry[0]);
+                uint64_t timestamp;
+                uint32_t size;
+                std::memcpy(&timestamp, entry + 1, sizeof(timestamp));
+                std::memcpy(&size, entry + 1 + sizeof(timestamp), sizeof(size));
+                offset += ENTRY_HEADER_SIZE;
+                formatter.log(type, timestamp, back.get() + offset, size);
+                offset += size;
+            }
+            writeBatch();
+            if (flush) {
+                stream.flush();
+            }
+
+            lock.lock();
+            written = target;
+            if (flush) {
+                flush_requested = false;
+            }
+            done.notify_all();
+            if (stopping && front_size == 0) {
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief Writes the formatted batch to the stream as a single write.
+     */
+    void writeBatch() {
+        std::string data = batch.str();
+        if (!data.empty()) {
+            stream.write(data.data(), data.size());
+            batch.str("");
+        }
+    }
+
+    std::ostream& stream;
+    /// @brief Transactions formatted by the writer thread, awaiting writing.
+    std::ostringstream batch;
+    /// @brief Formats transactions into \c batch . Writer thread only.
+    TransactionLog formatter;
+
+    /// @brief Guards all members below.
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    /// @brief Buffer transactions are appended to.
+    std::unique_ptr<uint8_t[]> front;
+    /// @brief Buffer being written by the writer thread.
+    std::unique_ptr<uint8_t[]> back;
+    std::size_t front_size;
+    const std::size_t buffer_size;
+    /// @brief The number of transactions appended.
+    uint64_t appended;
+    /// @brief The number of transactions written to the stream.
+    uint64_t written;
+    bool flush_requested;
+    bool stopping;
+    std::atomic<uint64_t> dropped_bytes;
+    std::thread thread;
 };
 
+constexpr std::size_t AsyncTransactionLog::ENTRY_HEADER_SIZE;
+constexpr std::chrono::milliseconds AsyncTransactionLog::WRITE_INTERVAL;
+
 
 struct LogRecorder::impl {
-    impl(std::unique_ptr<ByteInterface> snooped, std::ostream& stream)
-        : shim(std::move(snooped))
-        , log_stream(&stream)
-        , current_type(LogRecordType::NONE) {
+    impl(std::unique_ptr<ByteInterface> snooped, std::ostream& stream, LogFormat format,
+         const LogRecorderOptions& options)
+            : shim(std::move(snooped))
+            , log_stream(&stream)
+            , clock(options.clock)
+            , start_time(ByteInterface::clock::now()) {
+        if (options.async) {
+            async_log.reset(new AsyncTransactionLog(stream, format, options.buffer_size));
+        } else {
+            sync_log.reset(new TransactionLog(stream, format));
+        }
     }
 
     // Non-copyable.
     impl(const impl&) = delete;
     impl& operator=(const impl&) = delete;
 
-    // Movable.
-    impl(impl&& other)
-            : shim(std::move(other.shim))
-            , log_stream(other.log_stream)
-            , current_type(other.current_type) {
-        other.shim = nullptr;
-        other.log_stream = nullptr;
+    ~impl() {
+        close();
     }
-    impl& operator=(impl&& other) {
-        shim = std::move(other.shim);
-        log_stream = other.log_stream;
-        current_type = other.current_type;
-        other.shim = nullptr;
-        other.log_stream = nullptr;
-        return *this;
+
+    /**
+     * @brief The current time, in log time.
+     */
+    uint64_t now() const {
+        if (clock) {
+            return clock();
+        }
+        auto elapsed = ByteInterface::clock::now() - start_time;
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
     }
 
-    ~impl() {
-        if (log_stream) {
-            // Emit a final newline when closing the log. This is not required by
-            // the replayer, but will allow concatenating logs together.
-            *log_stream << '\n';
+    /**
+     * @brief Calculates when a read began, given when it was called and when
+     *      it returned.
+     *
+     * A read returns once its last byte has arrived, having mostly waited for
+     * the device to start sending. So the record is timed from when its first
+     * byte arrived, assuming the bytes arrived back to back at the Consult
+     * baud rate, but not from before the read was called.
+     */
+    static uint64_t readTimestamp(uint64_t called, uint64_t returned, std::size_t size) {
+        uint64_t transfer_time = size * BYTE_TIME_NS;
+        return returned > called + transfer_time ? returned - transfer_time : called;
+    }
+
+    void log(LogRecordType type, uint64_t timestamp, const uint8_t* bytes, std::size_t size) {
+        if (!sync_log && !async_log) {
+            return;
+        }
+        if (async_log) {
+            async_log->log(type, timestamp, bytes, size);
+        } else {
+            sync_log->log(type, timestamp, bytes, size);
         }
     }
 
-    void log(LogRecordType type, const std::vector<uint8_t>& bytes) {
-        // If we're currrently logging a different type, finish the entry.
-        if (type != current_type) {
-            if (current_type != LogRecordType::NONE) {
-                *log_stream << '\n';
-            }
-            switch (type) {
-                case LogRecordType::READ:
-                    *log_stream << 'R' << ' ';
-                    break;
-                case LogRecordType::WRITE:
-                    *log_stream << 'W' << ' ';
-                    break;
-                default:
-                    break;
-            }
-            current_type = type;
+    void flush() {
+        if (async_log) {
+            async_log->flush();
+        } else if (sync_log) {
+            log_stream->flush();
         }
-        *log_stream << cmn::format_bytes(bytes);
+    }
+
+    void close() {
+        if (async_log) {
+            async_log->close();
+            dropped_bytes = async_log->droppedBytes();
+            async_log = nullptr;
+        } else if (sync_log) {
+            sync_log->close();
+            sync_log = nullptr;
+        }
+    }
+
+    uint64_t droppedBytes() const {
+        return async_log ? async_log->droppedBytes() : dropped_bytes;
     }
 
     std::unique_ptr<ByteInterface> shim;
     std::ostream* log_stream;
-    LogRecordType current_type;
+    std::function<uint64_t()> clock;
+    /// @brief The log, when written synchronously. Null once closed.
+    std::unique_ptr<TransactionLog> sync_log;
+    /// @brief The log, when written asynchronously. Null once closed.
+    std::unique_ptr<AsyncTransactionLog> async_log;
+    /// @brief The time timestamps are relative to.
+    ByteInterface::clock::time_point start_time;
+    /// @brief The number of bytes dropped by a closed async log.
+    uint64_t dropped_bytes = 0;
 };
 
 
-LogRecorder::LogRecorder(std::unique_ptr<ByteInterface> snooped, std::ostream& log_stream)
-        : pimpl(new impl(std::move(snooped), log_stream)) {
+LogRecorder::LogRecorder(std::unique_ptr<ByteInterface> snooped, std::ostream& log_stream,
+                         LogFormat format, const LogRecorderOptions& options)
+        : pimpl(new impl(std::move(snooped), log_stream, format, options)) {
 }
 
 LogRecorder::LogRecorder(LogRecorder&& other)
@@ -95,16 +394,54 @@ LogRecorder& LogRecorder::operator=(LogRecorder&& other) {
 LogRecorder::~LogRecorder() {
 }
 
+void LogRecorder::flush() {
+    pimpl->flush();
+}
+
+void LogRecorder::close() {
+    pimpl->close();
+}
+
+uint64_t LogRecorder::droppedBytes() const {
+    return pimpl->droppedBytes();
+}
+
 std::vector<uint8_t> LogRecorder::read(std::size_t size) {
+    uint64_t called = pimpl->now();
     auto bytes = pimpl->shim->read(size);
-    pimpl->log(LogRecordType::READ, bytes);
+    uint64_t timestamp = impl::readTimestamp(called, pimpl->now(), bytes.size());
+    pimpl->log(LogRecordType::READ, timestamp, bytes.data(), bytes.size());
     return bytes;
 }
 
+void LogRecorder::readInto(uint8_t* dst, std::size_t size) {
+    uint64_t called = pimpl->now();
+    pimpl->shim->readInto(dst, size);
+    uint64_t timestamp = impl::readTimestamp(called, pimpl->now(), size);
+    pimpl->log(LogRecordType::READ, timestamp, dst, size);
+}
+
 void LogRecorder::write(const std::vector<uint8_t>& bytes) {
-    pimpl->log(LogRecordType::WRITE, bytes);
+    pimpl->log(LogRecordType::WRITE, pimpl->now(), bytes.data(), bytes.size());
     pimpl->shim->write(bytes);
 }
 
+void LogRecorder::write(const uint8_t* bytes, std::size_t size) {
+    pimpl->log(LogRecordType::WRITE, pimpl->now(), bytes, size);
+    pimpl->shim->write(bytes, size);
+}
+
+void LogRecorder::setTimeout(std::chrono::milliseconds timeout) {
+    pimpl->shim->setTimeout(timeout);
+}
+
+void LogRecorder::setDeadline(clock::time_point deadline) {
+    pimpl->shim->setDeadline(deadline);
+}
+
+ByteInterface::clock::time_point LogRecorder::lastReadTime() const {
+    return pimpl->shim->lastReadTime();
+}
+
 
 }
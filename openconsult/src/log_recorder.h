@@ -2,7 +2,10 @@
 #define OPENCONSULT_LIB_LOG_RECORDER
 
 #include "byte_interface.h"
+#include "log_format.h"
 
+#include <cstdint>
+#include <functional>
 #include <ostream>
 #include <memory>
 #include <vector>
@@ -10,12 +13,36 @@
 namespace openconsult {
 
 
+/**
+ * @brief Options controlling how a \c LogRecorder writes its log.
+ */
+struct LogRecorderOptions {
+    /// @brief \c true to write the log from a dedicated thread, so a stalled
+    ///     output stream cannot stall the snooped interface. Transactions are
+    ///     then only copied into a buffer as they occur. \c false to write
+    ///     each transaction to the stream as it occurs.
+    bool async = false;
+    /// @brief The capacity, in bytes, of each of the two buffers an async
+    ///     recorder alternates between. Transactions that do not fit while the
+    ///     writer is stalled are dropped, and counted by \c droppedBytes() .
+    std::size_t buffer_size = 1 << 20;
+    /// @brief The source of record timestamps, in nanoseconds. If empty, the
+    ///     time elapsed since the recorder was constructed. May be set to a
+    ///     simulated clock, such as \c SimulatedECU::time() , to record a
+    ///     simulated session with its simulated timing.
+    std::function<uint64_t()> clock;
+};
+
+
 /**
  * @brief \c ByteInterface that shims another \c ByteInterface , logging all
  *      transactions invoked on it before forwarding the response.
  *
  * The generated log may be subsequently passed to a \c LogReplay to replay the
- * transactions. Logs may be concatenated.
+ * transactions. Logs of the same format may be concatenated.
+ *
+ * TEXT logs coalesce consecutive transactions in the same direction into a
+ * single record. BINARY logs hold one timestamped record per transaction.
  */
 class LogRecorder : public ByteInterface {
 public:
@@ -23,9 +50,14 @@ public:
      * @brief Construct a new \c LogRecorder .
      *
      * @param snooped Interface whose transactions are to be logged.
-     * @param output_stream Stream to write the log to.
+     * @param output_stream Stream to write the log to. In async mode it must
+     *      not be accessed until the recorder is closed.
+     * @param format The format to write the log in.
+     * @param options Options controlling how the log is written.
      */
-    LogRecorder(std::unique_ptr<ByteInterface> snooped, std::ostream& output_stream);
+    LogRecorder(std::unique_ptr<ByteInterface> snooped, std::ostream& output_stream,
+                LogFormat format = LogFormat::TEXT,
+                const LogRecorderOptions& options = LogRecorderOptions());
 
     // LogRecorder is not copyable.
     LogRecorder(const LogRecorder&) = delete;
@@ -35,21 +67,68 @@ public:
     LogRecorder& operator=(LogRecorder&&);
 
     /**
-     * @brief Destroy the \c LogRecorder , closing the output stream and
-     *      releasing the underlying snooped interface.
+     * @brief Destroy the \c LogRecorder , closing the log and releasing the
+     *      underlying snooped interface.
      */
     ~LogRecorder();
 
+    /**
+     * @brief Writes all transactions logged so far to the output stream, and
+     *      flushes it. In async mode this blocks until the writer thread has
+     *      caught up.
+     */
+    void flush();
+
+    /**
+     * @brief Closes the log: flushes it, completes it, and stops any writer
+     *      thread. Subsequent transactions are forwarded but not logged.
+     *      Called automatically on destruction.
+     */
+    void close();
+
+    /**
+     * @brief The number of transferred bytes that were not logged because an
+     *      async recorder's buffer was full.
+     *
+     * @return The number of bytes dropped. Always zero when not async.
+     */
+    uint64_t droppedBytes() const;
+
     /**
      * @copydoc ByteInterface::read(std::size_t)
      */
     virtual std::vector<uint8_t> read(std::size_t size = 0) override;
 
+    /**
+     * @copydoc ByteInterface::readInto(uint8_t*, std::size_t)
+     */
+    virtual void readInto(uint8_t* dst, std::size_t size) override;
+
     /**
      * @copydoc ByteInterface::write(std::vector<uint8_t>)
      */
     virtual void write(const std::vector<uint8_t>& bytes) override;
 
+    /**
+     * @copydoc ByteInterface::write(const uint8_t*, std::size_t)
+     */
+    virtual void write(const uint8_t* bytes, std::size_t size) override;
+
+    /**
+     * @copydoc ByteInterface::setTimeout(std::chrono::milliseconds)
+     */
+    virtual void setTimeout(std::chrono::milliseconds timeout) override;
+
+    /**
+     * @copydoc ByteInterface::setDeadline(clock::time_point)
+     */
+    virtual void setDeadline(clock::time_point deadline) override;
+
+    /**
+     * @copydoc ByteInterface::lastReadTime()
+     */
+    virtual clock::time_point lastReadTime() const override;
+
 private:
     class impl;
     std::unique_ptr<impl> pimpl;
@@ -1,213 +1,276 @@
 #include "log_replay.h"
 #include "common.h"
+#include "log_format.h"
+#include "log_index.h"
+#include "mapped_file.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
 #include <istream>
+#include <iterator>
 #include <stdexcept>
-#include <stdlib.h>
+#include <string>
 #include <vector>
 
 namespace openconsult {
 
 
 /**
- * @brief The type of record held in a \c LogRecord .
+ * @brief Schedules replayed data to be returned in real time, or a multiple
+ *      of it.
+ *
+ * Log times are mapped to wall clock times relative to an anchor, which is
+ * re-established whenever the replay is driven by a write.
  */
-enum class LogRecordType {
-    READ,
-    WRITE,
-};
-
+class ReplayPacer {
+public:
+    using clock = ByteInterface::clock;
 
-/**
- * @brief A single entry in a replay log.
- */
-struct LogRecord {
-    /// The storage type used to hold the data.
-    using data_t = std::vector<uint8_t>;
+    ReplayPacer()
+        : speed(0)
+        , anchored(false)
+        , anchor_log_time(0) {
+    }
 
     /**
-     * @brief Parses a line and construct a new \c LogRecord from the result.
+     * @brief Sets the replay speed.
      *
-     * @param line The line to parse.
-     *
-     * @throws std::invalid_argument if \c line is poorly formatted.
+     * @param speed The multiple of real time to replay at, or zero to disable
+     *      pacing.
      */
-    LogRecord(const std::string& line) {
-        // The line format is as follows:
-        // (R|W) [0-9a-fA-F]{2}+
-        // Where,
-        // - the first character denotes the record type (read or write).
-        // - the second character is always a space
-        // - the rest of the line is made up of one or more bytes of hex data.
-        // This means the line must have an even length.
-        // Sanity check the provided line before we go any further.
-        if (line.length() < 4 || line.length() % 2) {
-            std::string error = cmn::pformat("Failed to parse line: %s", line.c_str());
-            throw std::invalid_argument(error);
-        }
+    void setSpeed(double speed) {
+        this->speed = speed;
+        reset();
+    }
 
-        // Parse type.
-        switch (line[0]) {
-            case 'R': type = LogRecordType::READ; break;
-            case 'W': type = LogRecordType::WRITE; break;
-            default:
-                std::string error = cmn::pformat("Failed to parse line: %s", line.c_str());
-                throw std::invalid_argument(error);
-        }
+    /**
+     * @brief Discards the anchor, so the next log time waited for is
+     *      anchored to the present. Used when the replay jumps.
+     */
+    void reset() {
+        anchored = false;
+    }
 
-        // Ensure separator is present.
-        if (line[1] != ' ') {
-            std::string error = cmn::pformat("Failed to parse line: %s", line.c_str());
-            throw std::invalid_argument(error);
-        }
+    bool enabled() const {
+        return speed > 0;
+    }
 
-        // Read data.
-        data.reserve((line.length() - 2) / 2);
-        for (std::size_t i = 2; i < line.length(); i += 2) {
-            std::string byte_str = line.substr(i, 2);
-            uint8_t byte = static_cast<uint8_t>(strtoul(byte_str.c_str(), nullptr, 16));
-            data.push_back(byte);
+    /**
+     * @brief Anchors a log time to the present.
+     *
+     * @param log_time The log time, in nanoseconds.
+     */
+    void sync(uint64_t log_time) {
+        anchor_log_time = log_time;
+        anchor_wall_time = clock::now();
+        last_wall_time = anchor_wall_time;
+        anchored = true;
+    }
+
+    /**
+     * @brief Anchors a log time to the time most recently waited for. Used to
+     *      continue seamlessly when the log time jumps, such as on wrapping.
+     *
+     * @param log_time The log time, in nanoseconds.
+     */
+    void restart(uint64_t log_time) {
+        if (!anchored) {
+            sync(log_time);
         }
+        anchor_log_time = log_time;
+        anchor_wall_time = last_wall_time;
     }
 
     /**
-     * @brief Searches for a contiguous range of \c bytes data occuring in this
-     * log record.
+     * @brief Waits until the wall clock time corresponding to a log time. If
+     *      no anchor has been established, the log time is anchored to the
+     *      present.
      *
-     * @tparam Iter The type of iterator used to describe the range.
-     * @param bytes The range of bytes to search for.
-     * @return Iterator to the first contiguous match of \c bytes data in this
-     *      record, or an iterator to the end of the record's data if no such
-     *      match exists.
+     * @param log_time The log time, in nanoseconds.
      */
-    template<class Iter>
-    data_t::iterator find(cmn::range<Iter> bytes) {
-        return std::search(data.begin(), data.end(), bytes.begin(), bytes.end());
+    void waitUntil(uint64_t log_time) {
+        if (!anchored) {
+            sync(log_time);
+        }
+        clock::time_point target = anchor_wall_time;
+        if (log_time > anchor_log_time) {
+            std::chrono::duration<double, std::nano> delta((log_time - anchor_log_time) / speed);
+            target += std::chrono::duration_cast<clock::duration>(delta);
+        }
+        last_wall_time = target;
+        cmn::sleep_until_precise(target);
     }
 
-    /// @brief The \c LogRecordType represented by this record.
-    LogRecordType type;
-    /// @brief The data that is in this record.
-    data_t data;
+private:
+    double speed;
+    bool anchored;
+    uint64_t anchor_log_time;
+    clock::time_point anchor_wall_time;
+    clock::time_point last_wall_time;
 };
 
 
-/// @brief Type alias for a collection of \c LogRecord s.
-using LogRecords = std::vector<LogRecord>;
-
-
 /**
- * @brief Iterator over the underlying data in \c LogRecords .
+ * @brief Iterator over the underlying data in a log held in memory, parsing
+ *      records lazily as it advances.
  */
-class LogRecordsIterator : public std::iterator<std::forward_iterator_tag, uint8_t> {
-    // Type aliases.
-private:
-    /// @brief Iterator over the individual records in a \c LogRecords .
-    using records_iter_t = LogRecords::iterator;
-    /// @brief Iterator over the data in an individual \c LogRecord .
-    using record_iter_t = LogRecord::data_t::iterator;
+class MappedRecordsIterator {
+    // Iterator traits
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = uint8_t;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const uint8_t*;
+    using reference = uint8_t;
 
     // Constructors
 public:
-    LogRecordsIterator() = default;
-    LogRecordsIterator(const LogRecordsIterator&) = default;
-    LogRecordsIterator(LogRecordsIterator&&) = default;
-    LogRecordsIterator& operator=(const LogRecordsIterator&) = default;
-    LogRecordsIterator& operator=(LogRecordsIterator&&) = default;
+    MappedRecordsIterator() = default;
+    MappedRecordsIterator(const MappedRecordsIterator&) = default;
+    MappedRecordsIterator(MappedRecordsIterator&&) = default;
+    MappedRecordsIterator& operator=(const MappedRecordsIterator&) = default;
+    MappedRecordsIterator& operator=(MappedRecordsIterator&&) = default;
 
     /**
-     * @brief Helper method to create a \c LogRecordsIterator to the start of
-     *      the complete collection of records held by a \c LogRecords .
+     * @brief Helper method to create a \c MappedRecordsIterator to the start
+     *      of a log.
      *
-     * @param records The \c LogRecords over which to iterate.
-     * @param type The type of \c LogRecord to consider. Any \c LogRecord in \c
-     *      records that does not match this type will be skipped.
+     * @param log Parser positioned at the start of the log.
+     * @param type The type of record to consider. Records of other types will
+     *      be skipped.
      * @param wrap \c true to wrap the iterator whenever it reaches the end of
-     *      \c records , \c false to only iterate through \c records once.
-     * @return \c LogRecordsIterator to the start of the range.
+     *      the log, \c false to only iterate through the log once.
+     * @return \c MappedRecordsIterator to the start of the log.
      */
-    static LogRecordsIterator begin(LogRecords& records, LogRecordType type, bool wrap = false) {
-        return LogRecordsIterator(type, records.begin(), records.end(), wrap);
+    static MappedRecordsIterator begin(const LogBufferParser& log, LogRecordType type, bool wrap = false) {
+        return MappedRecordsIterator(type, log, false, wrap);
     }
 
     /**
-     * @brief Helper method to create a \c LogRecordsIterator to the end of the
-     *      complete collection of records held by a \c LogRecords .
+     * @brief Helper method to create a \c MappedRecordsIterator to the end of
+     *      a log.
      *
-     * @param records The \c LogRecords over which to iterate.
-     * @param type The type of \c LogRecord to consider. Any \c LogRecord in \c
-     *      records that does not match this type will be skipped.
+     * @param log Parser positioned at the start of the log.
+     * @param type The type of record to consider. Records of other types will
+     *      be skipped.
      * @param wrap \c true to wrap the iterator whenever it reaches the end of
-     *      \c records , \c false to only iterate through \c records once.
-     * @return \c LogRecordsIterator to the end of the range.
+     *      the log, \c false to only iterate through the log once.
+     * @return \c MappedRecordsIterator to the end of the log.
      */
-    static LogRecordsIterator end(LogRecords& records, LogRecordType type, bool wrap = false) {
-        return LogRecordsIterator(type, records.end(), records.end(), wrap);
+    static MappedRecordsIterator end(const LogBufferParser& log, LogRecordType type, bool wrap = false) {
+        return MappedRecordsIterator(type, log, true, wrap);
     }
 
-private:
     /**
-     * @brief Construct a new \c LogRecordsIterator over the specified range.
+     * @brief Helper method to create a \c MappedRecordsIterator to a position
+     *      part way through a log.
      *
-     * @param type The type of \c LogRecord to consider. Any \c LogRecord in \c
-     *      records that does not match this type will be skipped.
-     * @param begin Iterator to the first \c LogRecord to iterate from.
-     * @param end Iterator to the 'beyond the last' \c LogRecord to iterate to.
+     * @param log Parser positioned at the start of the log.
+     * @param position The position to start from. If it is not within a
+     *      record of the given type, the iterator starts at the next record
+     *      of that type.
+     * @param type The type of record to consider. Records of other types will
+     *      be skipped.
+     * @param wrap \c true to wrap the iterator whenever it reaches the end of
+     *      the log, \c false to only iterate through the log once.
+     * @return \c MappedRecordsIterator to the position.
      */
-    LogRecordsIterator(LogRecordType type, records_iter_t begin, records_iter_t end, bool wrap)
-            : record_type(type), records_cursor(begin)
-            , records_begin(begin), records_end(end)
-            , should_wrap(wrap), wrap_count(0) {
-        resetRecordCursor(false);
+    static MappedRecordsIterator at(const LogBufferParser& log, const LogPosition& position,
+                                    LogRecordType type, bool wrap = false) {
+        MappedRecordsIterator it(type, log, true, wrap);
+        it.parser.seek(position.offset, position.timestamp);
+        it.line_time = position.line_time;
+        it.nextRecord(wrap);
+        if (!it.at_end && it.record_start.position() == position.offset) {
+            it.record_offset = position.byte;
+        }
+        return it;
+    }
+
+private:
+    MappedRecordsIterator(LogRecordType type, const LogBufferParser& log, bool at_end, bool wrap)
+            : record_type(type), log_begin(log), parser(log), record_start(log)
+            , record(), record_offset(0), at_end(at_end)
+            , should_wrap(wrap), wrap_count(0)
+            , line_time(0), record_line_time(0), record_time(0) {
+        if (!at_end) {
+            nextRecord(false);
+        }
     }
 
     // Operators
 public:
     // ++prefix operator
-    LogRecordsIterator& operator++() {
-        // Advance the record cursor.
-        record_cursor++;
-        if (record_cursor == record_end) {
-            // If that has caused the record cursor to now be at the end,
-            // advance the records cursor and reset the record cursor.
-            records_cursor++;
-            resetRecordCursor(should_wrap);
+    MappedRecordsIterator& operator++() {
+        record_offset++;
+        if (record_offset == record.size) {
+            nextRecord(should_wrap);
         }
         return *this;
     }
 
     // postfix++ operator
-    LogRecordsIterator operator++(int) {
-        LogRecordsIterator prev = *this;
+    MappedRecordsIterator operator++(int) {
+        MappedRecordsIterator prev = *this;
         ++(*this);
         return prev;
     }
 
-    bool operator==(const LogRecordsIterator& other) const {
-        // If records_cursor is at the end, the value of record_cursor is
-        // undefined and must not be accessed. This only considers remaining
-        // data in the iterator - the begin points are not compared.
-        return record_type    == other.record_type &&
-               wrap_count     == other.wrap_count &&
-               should_wrap    == other.should_wrap &&
-               records_cursor == other.records_cursor &&
-               records_end    == other.records_end &&
-             ((records_cursor == records_end) ||
-              (record_cursor  == other.record_cursor &&
-               record_end     == other.record_end));
+    bool operator==(const MappedRecordsIterator& other) const {
+        // Only the remaining data in the iterator is considered. An iterator
+        // only reaches the end of a wrapping log if the log holds no data of
+        // its type, so the wrap count is irrelevant there.
+        return record_type == other.record_type &&
+               should_wrap == other.should_wrap &&
+               at_end      == other.at_end &&
+             ((at_end) ||
+              (wrap_count          == other.wrap_count &&
+               parser.position()   == other.parser.position() &&
+               record_offset       == other.record_offset));
     }
 
-    bool operator!=(const LogRecordsIterator &other) const {
+    bool operator!=(const MappedRecordsIterator& other) const {
         return !(*this == other);
     }
 
-    const uint8_t& operator*() const {
-        return *record_cursor;
+    uint8_t operator*() const {
+        return record[record_offset];
     }
 
-    uint8_t& operator*() {
-        return *record_cursor;
+    // Accessors.
+public:
+    /**
+     * @brief The time the current byte finished transferring, for pacing
+     *      replay. Must not be called on an iterator at the end.
+     *
+     * @return The log time, in nanoseconds.
+     */
+    uint64_t availableAt() const {
+        return record_time + (record_offset + 1) * BYTE_TIME_NS;
+    }
+
+    /**
+     * @brief The number of times the iterator has wrapped.
+     *
+     * @return The wrap count.
+     */
+    std::size_t wraps() const {
+        return wrap_count;
+    }
+
+    /**
+     * @brief An iterator to the same position one pass through the log later,
+     *      so a search of a wrapping log may be bounded to a single pass.
+     *
+     * @return The iterator one wrap ahead.
+     */
+    MappedRecordsIterator nextPass() const {
+        MappedRecordsIterator it = *this;
+        it.wrap_count++;
+        return it;
     }
 
     // Other modifiers.
@@ -218,144 +281,620 @@ public:
      * If \c pos is iterating over a different \c LogRecordType than this
      * iterator, this iterator will be advanced to the next legal position after
      * that described by \c pos. If \c pos is at a position beyond the end of
-     * this iterator, behaviour is undefined.
+     * this iterator, behaviour is undefined. If \c pos is at the end, so is
+     * this iterator.
      *
      * @param pos The iterator describing the position to advance this iterator
      *      to.
      */
-    void advanceTo(const LogRecordsIterator& pos) {
-        // Advance the records cursor and reset the record cursor.
-        records_cursor = pos.records_cursor;
-        resetRecordCursor(should_wrap);
-        // If resetting the records cursor did not advance it, set the record
-        // cursor to the correct position. Otherwise leave the record cursor
-        // pointing at the beginning of the (next valid) record.
-        if (records_cursor == pos.records_cursor) {
-            record_cursor = pos.record_cursor;
+    void advanceTo(const MappedRecordsIterator& pos) {
+        if (pos.at_end) {
+            // An end iterator's parser need not be at the end of the log, so
+            // there is nothing to re-parse from.
+            at_end = true;
+            return;
+        }
+        // Re-parse from the start of the record pos is in. If that record is
+        // of this iterator's type, resume from pos's position within it.
+        // Otherwise this leaves the iterator at the start of the next record
+        // of its type.
+        parser = pos.record_start;
+        line_time = pos.record_line_time;
+        nextRecord(should_wrap);
+        if (!at_end && parser.position() == pos.parser.position()) {
+            record_offset = pos.record_offset;
         }
     }
 
 private:
     /**
-     * @brief Resets the cursor that describes the position in the current
-     *      record to the start of the current record. If the current record
-     *      does not match this iterator's type, the current record is advanced
-     *      until a record matching this iterator's type is found.
+     * @brief Parses forward from the current position until a non-empty
+     *      record matching this iterator's type is found.
      *
-     * After directly modifying \c records_cursor the iterator is in an
-     * undefined state until this method is called.
-     *
-     * @param wrap \c true if the records cursor should be wrapped to the start
-     *      of the records when no more records matching the iterator's type are
-     *      available. \c false to leave the iterator at the end when records
-     *      matching the iterator's type are depleted. The cursor will wrap no
-     *      more than once, so even when passsing \c true , it is necessary to
-     *      check the \c records_cursor is not at the end before attempting to
-     *      de-reference it.
+     * @param wrap \c true if the parser should be wrapped to the start of the
+     *      log when no more records matching the iterator's type are
+     *      available. The parser will wrap no more than once.
      */
-    void resetRecordCursor(bool wrap) {
-        // Advance the records cursor until we find a valid record.
-        while (records_cursor != records_end && records_cursor->type != record_type) {
-            records_cursor++;
-        }
-        if (records_cursor != records_end) {
-            // If we found a record, set the record cursor to point to it.
-            record_cursor = records_cursor->data.begin();
-            record_end = records_cursor->data.end();
-        } else if (wrap) {
-            // Otherwise, if we are wrapping, reset the records cursor back to
-            // the start and then re-invoke this method (forcing wrap off to
-            // prevent endlessly recursing if there are no valid records).
-            records_cursor = records_begin;
-            wrap_count++;
-            resetRecordCursor(false);
+    void nextRecord(bool wrap) {
+        record_offset = 0;
+        while (true) {
+            LogBufferParser start = parser;
+            uint64_t start_line_time = line_time;
+            if (!parser.next(record)) {
+                if (wrap) {
+                    parser = log_begin;
+                    line_time = 0;
+                    wrap_count++;
+                    wrap = false;
+                    continue;
+                }
+                at_end = true;
+                return;
+            }
+            uint64_t start_time = recordStartTime(record.timestamp, line_time);
+            line_time = start_time + record.size * BYTE_TIME_NS;
+            if (record.type == record_type && record.size > 0) {
+                record_start = start;
+                record_line_time = start_line_time;
+                record_time = start_time;
+                at_end = false;
+                return;
+            }
         }
     }
 
     // Members
 private:
     LogRecordType record_type;
-    records_iter_t records_cursor;
-    records_iter_t records_begin;
-    records_iter_t records_end;
-    record_iter_t record_cursor;
-    record_iter_t record_end;
+    /// @brief Parser positioned at the start of the log.
+    LogBufferParser log_begin;
+    /// @brief Parser positioned after the current record.
+    LogBufferParser parser;
+    /// @brief Parser positioned at the start of the current record.
+    LogBufferParser record_start;
+    LogRecordView record;
+    std::size_t record_offset;
+    bool at_end;
     bool should_wrap;
     std::size_t wrap_count;
+    /// @brief The time the record before \c parser finished transferring.
+    uint64_t line_time;
+    /// @brief The time the record before \c record_start finished
+    ///     transferring.
+    uint64_t record_line_time;
+    /// @brief The time the current record began transferring.
+    uint64_t record_time;
+};
+
+
+/**
+ * @brief The data of all records in one direction of a log, held contiguously.
+ *
+ * A side table maps each record back to its position in the complete log, so
+ * the read and write data can be related to one another.
+ */
+class ReplayArena {
+public:
+    /**
+     * @brief Appends a record's data.
+     *
+     * @param record The index of the record in the complete log. Must be
+     *      greater than that of any record already appended.
+     * @param time The time the record began transferring.
+     * @param data Pointer to the record's data.
+     * @param size The number of bytes of data.
+     */
+    void append(std::size_t record, uint64_t time, const uint8_t* data, std::size_t size) {
+        if (size == 0) {
+            return;
+        }
+        record_indices.push_back(record);
+        record_offsets.push_back(bytes.size());
+        record_times.push_back(time);
+        bytes.insert(bytes.end(), data, data + size);
+    }
+
+    const uint8_t* data() const {
+        return bytes.data();
+    }
+
+    std::size_t size() const {
+        return bytes.size();
+    }
+
+    /**
+     * @brief Finds the index, in the complete log, of the record holding a
+     *      byte.
+     *
+     * @param offset The offset of the byte. Must be less than \c size() .
+     * @return The record's index.
+     */
+    std::size_t recordAt(std::size_t offset) const {
+        auto it = std::upper_bound(record_offsets.begin(), record_offsets.end(), offset);
+        return record_indices[it - record_offsets.begin() - 1];
+    }
+
+    /**
+     * @brief Finds the time a byte finished transferring, for pacing replay.
+     *
+     * @param offset The offset of the byte. Must be less than \c size() .
+     * @return The log time, in nanoseconds.
+     */
+    uint64_t availableAt(std::size_t offset) const {
+        auto it = std::upper_bound(record_offsets.begin(), record_offsets.end(), offset) - 1;
+        return record_times[it - record_offsets.begin()] + (offset - *it + 1) * BYTE_TIME_NS;
+    }
+
+    /**
+     * @brief Finds the start of the first record after a given record in the
+     *      complete log.
+     *
+     * @param record The index of the record in the complete log.
+     * @return The offset of the first byte of the next record, or \c size() if
+     *      there are no further records.
+     */
+    std::size_t offsetAfter(std::size_t record) const {
+        auto it = std::upper_bound(record_indices.begin(), record_indices.end(), record);
+        if (it == record_indices.end()) {
+            return bytes.size();
+        }
+        return record_offsets[it - record_indices.begin()];
+    }
+
+    /**
+     * @brief Finds the start of the first record at or after a given record in
+     *      the complete log.
+     *
+     * @param record The index of the record in the complete log.
+     * @return The offset of the first byte of the record, or \c size() if
+     *      there are no further records.
+     */
+    std::size_t offsetAt(std::size_t record) const {
+        return record > 0 ? offsetAfter(record - 1) : 0;
+    }
+
+    /**
+     * @brief Finds the start of the first record to begin at or after a log
+     *      time.
+     *
+     * @param time The log time, in nanoseconds.
+     * @return The offset of the first byte of the record, or \c size() if
+     *      there are no further records.
+     */
+    std::size_t offsetAtTime(uint64_t time) const {
+        auto it = std::lower_bound(record_times.begin(), record_times.end(), time);
+        if (it == record_times.end()) {
+            return bytes.size();
+        }
+        return record_offsets[it - record_times.begin()];
+    }
+
+    /**
+     * @brief Searches for the first occurrence of a byte sequence.
+     *
+     * @param from The offset to search from.
+     * @param pattern The byte sequence to search for. Must not be empty.
+     * @param size The length of \c pattern .
+     * @param wrap \c true to treat the data as cyclic: the search continues
+     *      from the start of the data up to \c from , and matches may span the
+     *      end of the data.
+     * @return The offset of the match, or \c size() if there is none.
+     */
+    std::size_t find(std::size_t from, const uint8_t* pattern, std::size_t size, bool wrap) const {
+        std::size_t match = findIn(from, bytes.size(), pattern, size, wrap);
+        if (match == bytes.size() && wrap) {
+            match = findIn(0, from, pattern, size, wrap);
+            if (match == from) {
+                match = bytes.size();
+            }
+        }
+        return match;
+    }
+
+private:
+    /**
+     * @brief Searches for a byte sequence starting anywhere in a range of
+     *      offsets. Candidates are located with \c memchr , then confirmed with
+     *      \c memcmp , both of which are vectorised by the C library.
+     *
+     * @return The offset of the match, or \c end if there is none.
+     */
+    std::size_t findIn(std::size_t begin, std::size_t end,
+                       const uint8_t* pattern, std::size_t size, bool wrap) const {
+        const uint8_t* cursor = bytes.data() + begin;
+        const uint8_t* bound = bytes.data() + end;
+        while (cursor < bound) {
+            cursor = static_cast<const uint8_t*>(std::memchr(cursor, pattern[0], bound - cursor));
+            if (!cursor) {
+                break;
+            }
+            std::size_t offset = cursor - bytes.data();
+            if (matchesAt(offset, pattern, size, wrap)) {
+                return offset;
+            }
+            cursor++;
+        }
+        return end;
+    }
+
+    bool matchesAt(std::size_t offset, const uint8_t* pattern, std::size_t size, bool wrap) const {
+        if (offset + size <= bytes.size()) {
+            return std::memcmp(bytes.data() + offset, pattern, size) == 0;
+        } else if (!wrap) {
+            return false;
+        }
+        // The match spans the end of the data, possibly several times.
+        while (size > 0) {
+            std::size_t chunk = std::min(size, bytes.size() - offset);
+            if (std::memcmp(bytes.data() + offset, pattern, chunk) != 0) {
+                return false;
+            }
+            pattern += chunk;
+            size -= chunk;
+            offset = 0;
+        }
+        return true;
+    }
+
+    /// @brief The data of every record, concatenated.
+    std::vector<uint8_t> bytes;
+    /// @brief The offset in \c bytes of each record's data.
+    std::vector<std::size_t> record_offsets;
+    /// @brief The index of each record in the complete log.
+    std::vector<std::size_t> record_indices;
+    /// @brief The time each record began transferring.
+    std::vector<uint64_t> record_times;
 };
 
 
 struct LogReplay::impl {
-    impl(std::istream& log_stream, bool wrap);
+    class RecordsReplay;
+    class MappedReplay;
 
-    std::vector<uint8_t> read(std::size_t size);
-    void write(const std::vector<uint8_t>& bytes);
+    virtual ~impl() = default;
 
-    LogRecords records;
-    LogRecordsIterator read_cursor;
-    LogRecordsIterator read_bound;
-    LogRecordsIterator write_cursor;
-    LogRecordsIterator write_bound;
+    virtual void read(uint8_t* dst, std::size_t size) = 0;
+    virtual void write(const uint8_t* bytes, std::size_t size) = 0;
+    virtual void seek(LogSeekUnit unit, uint64_t value) = 0;
+
+    ReplayPacer pacer;
 };
 
 
-LogReplay::impl::impl(std::istream& log_stream, bool wrap) {
-    for (std::string line; std::getline(log_stream, line);) {
-        records.emplace_back(line);
+/**
+ * @brief Replays a log read in its entirety from a stream. The read and write
+ *      data are each held in a \c ReplayArena , so are replayed by copying
+ *      and searching contiguous memory.
+ */
+class LogReplay::impl::RecordsReplay : public LogReplay::impl {
+public:
+    RecordsReplay(std::istream& log_stream, bool wrap, LogFormat format)
+            : wrap(wrap)
+            , record_count(0)
+            , read_cursor(0)
+            , write_cursor(0) {
+        auto reader = LogReader::create(log_stream, format);
+        LogRecord record;
+        uint64_t line_time = 0;
+        for (; reader->read(record); record_count++) {
+            ReplayArena& arena = record.type == LogRecordType::READ ? reads : writes;
+            uint64_t start_time = recordStartTime(record.timestamp, line_time);
+            line_time = start_time + record.data.size() * BYTE_TIME_NS;
+            arena.append(record_count, start_time, record.data.data(), record.data.size());
+        }
     }
-    read_cursor  = LogRecordsIterator::begin(records, LogRecordType::READ,  wrap);
-    read_bound   = LogRecordsIterator::end(  records, LogRecordType::READ,  wrap);
-    write_cursor = LogRecordsIterator::begin(records, LogRecordType::WRITE, wrap);
-    write_bound  = LogRecordsIterator::end(  records, LogRecordType::WRITE, wrap);
-}
 
-std::vector<uint8_t> LogReplay::impl::read(std::size_t size) {
-    LogRecordsIterator start = read_cursor;
-    std::size_t remaining = cmn::advance(read_cursor, size, read_bound);
-    if (remaining) {
-        throw std::runtime_error("No more read log records to replay");
+    void read(uint8_t* dst, std::size_t size) override {
+        while (size > 0) {
+            if (read_cursor == reads.size()) {
+                if (!wrap || reads.size() == 0) {
+                    throw std::runtime_error("No more read log records to replay");
+                }
+                read_cursor = 0;
+                if (pacer.enabled()) {
+                    // Continue one byte after the end of the log.
+                    pacer.restart(reads.availableAt(0) - BYTE_TIME_NS);
+                }
+            }
+            std::size_t chunk = std::min(size, reads.size() - read_cursor);
+            std::memcpy(dst, reads.data() + read_cursor, chunk);
+            dst += chunk;
+            size -= chunk;
+            read_cursor += chunk;
+            if (pacer.enabled()) {
+                pacer.waitUntil(reads.availableAt(read_cursor - 1));
+            }
+        }
+        if (wrap && read_cursor == reads.size()) {
+            read_cursor = 0;
+            if (pacer.enabled()) {
+                pacer.restart(reads.availableAt(0) - BYTE_TIME_NS);
+            }
+        }
     }
-    // Slightly dumb pattern because we loop through the iterator twice. But
-    // without C++20 this is about as nice as we can get without sacrificing
-    // readability.
-    return std::vector<uint8_t>(start, read_cursor);
-}
 
-void LogReplay::impl::write(const std::vector<uint8_t>& bytes) {
-    // Advance the write cursor to the next position that contains a write of
-    // the given byte sequence.
-    write_cursor = std::search(write_cursor, write_bound, bytes.begin(), bytes.end());
+    void write(const uint8_t* bytes, std::size_t size) override {
+        // Find the next position that contains a write of the given byte
+        // sequence.
+        std::size_t match = write_cursor;
+        if (size > 0 && write_cursor < writes.size()) {
+            match = writes.find(write_cursor, bytes, size, wrap);
+        }
+        if (match == writes.size()) {
+            if (!wrap) {
+                write_cursor = writes.size();
+                read_cursor = reads.size();
+            }
+            throw std::runtime_error("No more write log records to replay");
+        }
 
-    // Advance the write cursor, then advance the read cursor to it.
-    // The read cursor needs to be set to the position the final byte was
-    // written to. The final byte written may have caused the write cursor to
-    // advance a record, skipping over any read records that immediately follow
-    // the write record (and which we want to replay).
-    std::size_t remaining = 0;
-    if (bytes.size() > 0) {
-        remaining += cmn::advance(write_cursor, bytes.size() - 1, write_bound);
+        // Advance the read cursor to the first read record following the write
+        // record the final byte was written to, so any reads that immediately
+        // follow it are replayed next. Then advance the write cursor past the
+        // final byte.
+        std::size_t last = size > 0 ? (match + size - 1) % writes.size() : match;
+        if (pacer.enabled()) {
+            // Replay the following reads relative to now.
+            pacer.sync(writes.availableAt(last));
+        }
+        read_cursor = reads.offsetAfter(writes.recordAt(last));
+        if (wrap && read_cursor == reads.size()) {
+            read_cursor = 0;
+        }
+        write_cursor = last + 1;
+        if (wrap && write_cursor == writes.size()) {
+            write_cursor = 0;
+        }
     }
-    read_cursor.advanceTo(write_cursor);
-    remaining += cmn::advance(write_cursor, 1, write_bound);
 
-    if (remaining) {
-        throw std::runtime_error("No more write log records to replay");
+    void seek(LogSeekUnit unit, uint64_t value) override {
+        // Without the log itself there is no index: positions are found in the
+        // arenas instead.
+        std::size_t read_target = reads.size();
+        std::size_t write_target = writes.size();
+        bool found = false;
+        switch (unit) {
+            case LogSeekUnit::RECORD:
+                read_target = reads.offsetAt(value);
+                write_target = writes.offsetAt(value);
+                found = value < record_count;
+                break;
+            case LogSeekUnit::TIME:
+                read_target = reads.offsetAtTime(value);
+                write_target = writes.offsetAtTime(value);
+                found = read_target < reads.size() || write_target < writes.size();
+                break;
+            case LogSeekUnit::FRAME: {
+                FrameCounter counter;
+                uint64_t frame = 0;
+                for (std::size_t i = 0; i < reads.size() && !found; i++) {
+                    if (counter.feed(reads.data()[i]) && frame++ == value) {
+                        read_target = i;
+                        write_target = writes.offsetAfter(reads.recordAt(i));
+                        found = true;
+                    }
+                }
+                break;
+            }
+        }
+        if (!found) {
+            throw std::invalid_argument("Seek position is beyond the end of the log");
+        }
+        read_cursor = read_target;
+        write_cursor = write_target;
+        if (wrap && read_cursor == reads.size()) {
+            read_cursor = 0;
+        }
+        if (wrap && write_cursor == writes.size()) {
+            write_cursor = 0;
+        }
+        pacer.reset();
     }
-}
+
+private:
+    ReplayArena reads;
+    ReplayArena writes;
+    bool wrap;
+    /// @brief The number of records in the log, including empty ones.
+    std::size_t record_count;
+    /// @brief Offset of the next byte to replay in \c reads .
+    std::size_t read_cursor;
+    /// @brief Offset in \c writes from which to match the next write.
+    std::size_t write_cursor;
+};
 
 
-LogReplay::LogReplay(std::istream& log_stream, bool wrap)
-        : pimpl(new impl(log_stream, wrap)) {
+/**
+ * @brief Replays a log mapped into memory, parsing it as it is replayed.
+ */
+class LogReplay::impl::MappedReplay : public LogReplay::impl {
+public:
+    MappedReplay(const std::string& path, bool wrap, LogFormat format)
+            : path(path)
+            , wrap(wrap)
+            , format(format)
+            , file(path)
+            , log(file.data(), file.size(), format)
+            , read_cursor( MappedRecordsIterator::begin(log, LogRecordType::READ,  wrap))
+            , read_bound(  MappedRecordsIterator::end(  log, LogRecordType::READ,  wrap))
+            , write_cursor(MappedRecordsIterator::begin(log, LogRecordType::WRITE, wrap))
+            , write_bound( MappedRecordsIterator::end(  log, LogRecordType::WRITE, wrap)) {
+    }
+
+    void read(uint8_t* dst, std::size_t size) override {
+        uint64_t available = 0;
+        for (; size > 0; size--) {
+            if (read_cursor == read_bound) {
+                throw std::runtime_error("No more read log records to replay");
+            }
+            *(dst++) = *read_cursor;
+            if (pacer.enabled()) {
+                available = read_cursor.availableAt();
+                std::size_t wraps = read_cursor.wraps();
+                ++read_cursor;
+                if (read_cursor.wraps() != wraps && read_cursor != read_bound) {
+                    // Continue one byte after the end of the log.
+                    pacer.waitUntil(available);
+                    pacer.restart(read_cursor.availableAt() - BYTE_TIME_NS);
+                    available = 0;
+                }
+            } else {
+                ++read_cursor;
+            }
+        }
+        if (available) {
+            pacer.waitUntil(available);
+        }
+    }
+
+    void write(const uint8_t* bytes, std::size_t size) override {
+        // Advance the write cursor to the next position that contains a write
+        // of the given byte sequence. A wrapping log is searched for a single
+        // pass, as it would otherwise be searched forever, and the cursors are
+        // left unchanged if there is no match.
+        MappedRecordsIterator match = find(bytes, size);
+        if (wrap && match == write_bound) {
+            throw std::runtime_error("No more write log records to replay");
+        }
+        write_cursor = match;
+
+        // Advance the write cursor, then advance the read cursor to it.
+        // The read cursor needs to be set to the position the final byte was
+        // written to. The final byte written may have caused the write cursor
+        // to advance a record, skipping over any read records that immediately
+        // follow the write record (and which we want to replay).
+        std::size_t remaining = 0;
+        if (size > 0) {
+            remaining += cmn::advance(write_cursor, size - 1, write_bound);
+        }
+        if (pacer.enabled() && write_cursor != write_bound) {
+            // Replay the following reads relative to now.
+            pacer.sync(write_cursor.availableAt());
+        }
+        read_cursor.advanceTo(write_cursor);
+        remaining += cmn::advance(write_cursor, 1, write_bound);
+
+        if (remaining) {
+            throw std::runtime_error("No more write log records to replay");
+        }
+    }
+
+    void seek(LogSeekUnit unit, uint64_t value) override {
+        LogPosition position = getIndex().locate(log, unit, value);
+        read_cursor  = MappedRecordsIterator::at(log, position, LogRecordType::READ,  wrap);
+        write_cursor = MappedRecordsIterator::at(log, position, LogRecordType::WRITE, wrap);
+        pacer.reset();
+    }
+
+private:
+    /**
+     * @brief Searches for the first write of a byte sequence, starting within
+     *      one pass of the write cursor. Matches may span the end of a
+     *      wrapping log.
+     *
+     * @return Iterator to the start of the match, or \c write_bound if there
+     *      is none.
+     */
+    MappedRecordsIterator find(const uint8_t* bytes, std::size_t size) const {
+        if (size == 0) {
+            return write_cursor;
+        }
+        MappedRecordsIterator limit = wrap ? write_cursor.nextPass() : write_bound;
+        for (MappedRecordsIterator candidate = write_cursor;
+             candidate != limit && candidate != write_bound; ++candidate) {
+            if (*candidate != bytes[0]) {
+                continue;
+            }
+            MappedRecordsIterator it = candidate;
+            std::size_t matched = 1;
+            for (++it; matched < size && it != write_bound && *it == bytes[matched]; ++it) {
+                matched++;
+            }
+            if (matched == size) {
+                return candidate;
+            }
+        }
+        return write_bound;
+    }
+
+    /**
+     * @brief Gets the log's index, loading it on first use. A sidecar index
+     *      file is used if one exists for this log, otherwise the index is
+     *      built in memory.
+     */
+    const LogIndex& getIndex() {
+        if (!index) {
+            std::string index_path = path + ".idx";
+            if (std::ifstream(index_path).good()) {
+                try {
+                    index.reset(new LogIndex(index_path));
+                    if (!index->matches(file.data(), file.size(), format)) {
+                        // The log has changed since it was indexed.
+                        index.reset();
+                    }
+                } catch (const std::invalid_argument&) {
+                    // The index is corrupt, or from an older version.
+                    index.reset();
+                }
+            }
+            if (!index) {
+                index.reset(new LogIndex(file.data(), file.size(), format));
+            }
+        }
+        return *index;
+    }
+
+    std::string path;
+    bool wrap;
+    LogFormat format;
+    MappedFile file;
+    LogBufferParser log;
+    MappedRecordsIterator read_cursor;
+    MappedRecordsIterator read_bound;
+    MappedRecordsIterator write_cursor;
+    MappedRecordsIterator write_bound;
+    std::unique_ptr<LogIndex> index;
+};
+
+
+LogReplay::LogReplay(std::istream& log_stream, bool wrap, LogFormat format)
+        : pimpl(new impl::RecordsReplay(log_stream, wrap, format)) {
+}
+
+LogReplay::LogReplay(const std::string& path, bool wrap, LogFormat format)
+        : pimpl(new impl::MappedReplay(path, wrap, format)) {
 }
 
 LogReplay::~LogReplay() = default;
 
 std::vector<uint8_t> LogReplay::read(std::size_t size) {
-    return pimpl->read(size);
+    std::vector<uint8_t> bytes(size);
+    pimpl->read(bytes.data(), size);
+    return bytes;
+}
+
+void LogReplay::readInto(uint8_t* dst, std::size_t size) {
+    pimpl->read(dst, size);
 }
 
 void LogReplay::write(const std::vector<uint8_t>& bytes) {
-    pimpl->write(bytes);
+    pimpl->write(bytes.data(), bytes.size());
+}
+
+void LogReplay::write(const uint8_t* bytes, std::size_t size) {
+    pimpl->write(bytes, size);
+}
+
+void LogReplay::seek(LogSeekUnit unit, uint64_t value) {
+    pimpl->seek(unit, value);
+}
+
+void LogReplay::setPacing(double speed) {
+    if (!(speed >= 0)) {
+        std::string error = cmn::pformat("Invalid replay speed: %f", speed);
+        throw std::invalid_argument(error);
+    }
+    pimpl->pacer.setSpeed(speed);
 }
 
 
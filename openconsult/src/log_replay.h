@@ -2,9 +2,12 @@
 #define OPENCONSULT_LIB_LOG_REPLAY
 
 #include "byte_interface.h"
+#include "log_format.h"
+#include "log_index.h"
 
 #include <istream>
 #include <memory>
+#include <string>
 
 namespace openconsult {
 
@@ -23,8 +26,26 @@ public:
      *      end, \c false to raise \c std::runtime_error from the \c read(...)
      *      and \c write(...) methods when attempting to interact with it after
      *      their respective logged data has been depleted.
+     * @param format The format the log is in.
+     * @throws std::invalid_argument if the log is poorly formatted.
      */
-    LogReplay(std::istream& input_stream, bool wrap = false);
+    LogReplay(std::istream& input_stream, bool wrap = false, LogFormat format = LogFormat::TEXT);
+
+    /**
+     * @brief Construct a new \c LogReplay from a log file. The file is mapped
+     *      into memory and parsed on demand as it is replayed, so memory use is
+     *      bounded by the OS page cache regardless of the log's size.
+     *      Construction only parses as far as the first read and first write
+     *      records. Malformed records are only detected when reached, by
+     *      \c read(...) or \c write(...) raising \c std::invalid_argument .
+     *
+     * @param path Path of the log file.
+     * @param wrap As for \c LogReplay(std::istream&, bool, LogFormat) .
+     * @param format The format the log is in.
+     * @throws os_error if the file cannot be opened or mapped.
+     * @throws std::invalid_argument if the log's file header is invalid.
+     */
+    LogReplay(const std::string& path, bool wrap = false, LogFormat format = LogFormat::TEXT);
 
     /**
      * @brief Destroy the \c LogReplay , closing the input stream.
@@ -36,11 +57,56 @@ public:
      */
     virtual std::vector<uint8_t> read(std::size_t size = 0) override;
 
+    /**
+     * @copydoc ByteInterface::readInto(uint8_t*, std::size_t)
+     */
+    virtual void readInto(uint8_t* dst, std::size_t size) override;
+
     /**
      * @copydoc ByteInterface::write(std::vector<uint8_t>)
      */
     virtual void write(const std::vector<uint8_t>& bytes) override;
 
+    /**
+     * @copydoc ByteInterface::write(const uint8_t*, std::size_t)
+     */
+    virtual void write(const uint8_t* bytes, std::size_t size) override;
+
+    /**
+     * @brief Paces reads to the timing of the original transactions, so the
+     *      replay behaves like a real ECU. By default data is returned
+     *      immediately.
+     *
+     * Data is timed from the log's timestamps where present. Logs without
+     * timestamps are timed as a continuous transfer at the Consult baud rate.
+     * Each write restarts the timing of the reads that follow it from the
+     * time of the write, so responses are paced relative to their requests.
+     *
+     * @param speed The multiple of real time to replay at, e.g. 2.0 for twice
+     *      as fast. Zero disables pacing.
+     * @throws std::invalid_argument if \c speed is negative.
+     */
+    void setPacing(double speed);
+
+    /**
+     * @brief Moves the replay to a position part way through the log. Reads
+     *      continue from the position and writes are matched from it, as
+     *      though the log started there.
+     *
+     * Logs replayed from a file are seeked using a \c LogIndex . A sidecar
+     * index file, named after the log with an ".idx" suffix, is used if it
+     * matches the log. Otherwise the index is built in memory on the first
+     * seek.
+     *
+     * @param unit The unit \c value is given in.
+     * @param value The position to move to. Records and times move to the
+     *      start of the first record at or after them. Frames move to the
+     *      frame's start byte.
+     * @throws std::invalid_argument if the position is beyond the end of the
+     *      log.
+     */
+    void seek(LogSeekUnit unit, uint64_t value);
+
 private:
     class impl;
     std::unique_ptr<impl> pimpl;
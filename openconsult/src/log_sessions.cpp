@@ -0,0 +1,346 @@
+#include "log_sessions.h"
+#include "common.h"
+#include "log_index.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+
+namespace openconsult {
+
+
+/// @brief The smallest chunk worth segmenting on its own thread, in bytes.
+static const std::size_t MIN_CHUNK_SIZE = 1 << 20;
+
+
+static TransactionType transactionTypeOf(const LogRecordView& command) {
+    switch (command[0]) {
+        case 0xFF:
+            if (command.size >= 3 && command[1] == 0xFF && command[2] == 0xEF) {
+                return TransactionType::HANDSHAKE;
+            }
+            return TransactionType::OTHER;
+        case 0xD0: return TransactionType::ECU_INFO;
+        case 0xD1: return TransactionType::FAULT_CODES;
+        case 0x5A: return TransactionType::REGISTER_SELECT;
+        default:   return TransactionType::OTHER;
+    }
+}
+
+/**
+ * @brief Whether a record starts a transaction when it follows a read,
+ *      whatever came before.
+ */
+static bool startsTransaction(const LogRecordView& record) {
+    return record.type == LogRecordType::WRITE && record.size > 0 &&
+           record[0] != GO_AHEAD && record[0] != HALT;
+}
+
+
+/**
+ * @brief Splits a sequence of records into transactions.
+ */
+class Segmenter {
+public:
+    Segmenter()
+            : active(false)
+            , streaming(false)
+            , last_was_write(false) {
+    }
+
+    /**
+     * @brief Consumes the next record.
+     *
+     * @param record The record.
+     * @param offset The position from which the record was parsed.
+     * @param index The index of the record in the log.
+     */
+    void add(const LogRecordView& record, uint64_t offset, uint64_t index) {
+        if (record.size == 0) {
+            if (active) {
+                transactions.back().records++;
+            }
+            return;
+        }
+        if (record.type == LogRecordType::WRITE) {
+            uint8_t command = record[0];
+            if (active && command == GO_AHEAD && !streaming) {
+                streaming = true;
+                counter = FrameCounter();
+            } else if (active && command == HALT) {
+                transactions.back().halted = true;
+            } else if (active && last_was_write && !streaming && !transactions.back().halted) {
+                // Further command bytes.
+                transactions.back().command_size += static_cast<uint32_t>(record.size);
+            } else {
+                begin(record, offset, index);
+            }
+            last_was_write = true;
+        } else {
+            if (!active) {
+                begin(record, offset, index);
+            } else if (streaming) {
+                LogTransaction& transaction = transactions.back();
+                for (std::size_t i = 0; i < record.size; i++) {
+                    transaction.frames += counter.feed(record[i]);
+                }
+            }
+            last_was_write = false;
+        }
+        LogTransaction& transaction = transactions.back();
+        transaction.records++;
+        transaction.end_timestamp = record.timestamp;
+    }
+
+    /**
+     * @brief Continues from the state of a segmenter which consumed the
+     *      records following those consumed by this one, taking its
+     *      transactions.
+     *
+     * @param next The segmenter. It must have started its first transaction
+     *      with a record for which \c startsTransaction(...) holds, following
+     *      a read.
+     * @param record_base The index in the log of the first record \c next
+     *      consumed, less the index it was given.
+     */
+    void append(Segmenter&& next, uint64_t record_base) {
+        for (auto& transaction : next.transactions) {
+            transaction.first_record += record_base;
+        }
+        transactions.insert(transactions.end(), next.transactions.begin(), next.transactions.end());
+        active = next.active;
+        streaming = next.streaming;
+        last_was_write = next.last_was_write;
+        counter = next.counter;
+    }
+
+    std::vector<LogTransaction> transactions;
+
+private:
+    void begin(const LogRecordView& record, uint64_t offset, uint64_t index) {
+        LogTransaction transaction;
+        bool command = record.type == LogRecordType::WRITE;
+        transaction.type = command ? transactionTypeOf(record) : TransactionType::OTHER;
+        transaction.session = 0;
+        transaction.first_record = index;
+        transaction.records = 0;
+        transaction.offset = offset;
+        transaction.start_timestamp = record.timestamp;
+        transaction.end_timestamp = record.timestamp;
+        transaction.frames = 0;
+        transaction.command_size = command ? static_cast<uint32_t>(record.size) : 0;
+        transaction.command = command ? record[0] : 0;
+        transaction.halted = false;
+        transactions.push_back(transaction);
+        active = true;
+        streaming = false;
+    }
+
+    /// @brief Whether a transaction has been started.
+    bool active;
+    /// @brief Whether the current transaction has been given the go-ahead.
+    bool streaming;
+    bool last_was_write;
+    FrameCounter counter;
+};
+
+
+/**
+ * @brief A range of a log segmented independently of the rest.
+ */
+struct Chunk {
+    std::size_t begin;
+    std::size_t end;
+
+    /// @brief The transactions from \c start onwards.
+    Segmenter segmenter;
+    /// @brief The position of the chunk's first transaction which can be
+    ///     identified without knowing what precedes the chunk.
+    std::size_t start;
+    /// @brief The number of records in the chunk.
+    uint64_t records;
+    /// @brief The position segmenting stopped at. Beyond \c end if the chunk
+    ///     ends part way through a record, i.e. the next chunk began at a
+    ///     false sync marker.
+    std::size_t stop;
+    /// @brief Whether \c start was found.
+    bool started;
+    /// @brief Whether the chunk could not be parsed from \c begin .
+    bool failed;
+};
+
+static LogBufferParser parserAt(const uint8_t* data, std::size_t size, LogFormat format, std::size_t position) {
+    LogBufferParser parser(data, size, format);
+    if (position > 0) {
+        parser.seek(position, 0);
+    }
+    return parser;
+}
+
+/**
+ * @brief Segments a chunk. The first chunk is segmented from its start. Later
+ *      chunks are segmented from their first transaction following a read, so
+ *      the result does not depend on the chunks before them.
+ */
+static void segmentChunk(const uint8_t* data, std::size_t size, LogFormat format, Chunk& chunk) {
+    try {
+        LogBufferParser parser = parserAt(data, size, format, chunk.begin);
+        LogRecordView record;
+        bool after_read = false;
+        chunk.started = chunk.begin == 0;
+        chunk.start = chunk.begin;
+        while (parser.position() < chunk.end) {
+            std::size_t offset = parser.position();
+            if (!parser.next(record)) {
+                break;
+            }
+            if (!chunk.started && after_read && startsTransaction(record)) {
+                chunk.started = true;
+                chunk.start = offset;
+            }
+            if (chunk.started) {
+                chunk.segmenter.add(record, offset, chunk.records);
+            } else if (record.size > 0) {
+                after_read = record.type == LogRecordType::READ;
+            }
+            chunk.records++;
+        }
+        chunk.stop = parser.position();
+    } catch (...) {
+        // Most likely the chunk began at a false sync marker. It will be
+        // segmented in order instead, which reports any genuine error.
+        chunk.failed = true;
+    }
+}
+
+/**
+ * @brief Segments part of a log in order, continuing from a segmenter's state.
+ *
+ * @param position The position to start from. Set to the position segmenting
+ *      stopped at.
+ * @param end The position to stop at.
+ * @param record_base The index of the record at \c position .
+ * @return The number of records segmented.
+ */
+static uint64_t segmentRange(const uint8_t* data, std::size_t size, LogFormat format,
+                             std::size_t& position, std::size_t end, uint64_t record_base,
+                             Segmenter& segmenter) {
+    LogBufferParser parser = parserAt(data, size, format, position);
+    LogRecordView record;
+    uint64_t records = 0;
+    while (parser.position() < end) {
+        std::size_t offset = parser.position();
+        if (!parser.next(record)) {
+            break;
+        }
+        segmenter.add(record, offset, record_base + records);
+        records++;
+    }
+    position = parser.position();
+    return records;
+}
+
+static std::vector<LogSession> groupSessions(std::vector<LogTransaction>& transactions) {
+    std::vector<LogSession> sessions;
+    for (std::size_t i = 0; i < transactions.size(); i++) {
+        LogTransaction& transaction = transactions[i];
+        bool handshake = transaction.type == TransactionType::HANDSHAKE;
+        if (sessions.empty() || handshake) {
+            sessions.push_back({handshake, i, 0, transaction.first_record, 0,
+                                transaction.offset, transaction.start_timestamp, 0, 0});
+        }
+        LogSession& session = sessions.back();
+        session.transactions++;
+        session.records = transaction.first_record + transaction.records - session.first_record;
+        session.end_timestamp = transaction.end_timestamp;
+        session.frames += transaction.frames;
+        transaction.session = sessions.size() - 1;
+    }
+    return sessions;
+}
+
+
+std::string transactionTypeName(TransactionType type) {
+    switch (type) {
+        case TransactionType::HANDSHAKE:       return "HANDSHAKE";
+        case TransactionType::ECU_INFO:        return "ECU_INFO";
+        case TransactionType::FAULT_CODES:     return "FAULT_CODES";
+        case TransactionType::REGISTER_SELECT: return "REGISTER_SELECT";
+        case TransactionType::OTHER:           return "OTHER";
+        default:
+            std::string error = cmn::pformat("Unknown transaction type: %d", type);
+            throw std::invalid_argument(error);
+    }
+}
+
+SessionTable segmentLog(const uint8_t* data, std::size_t size, LogFormat format, unsigned threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::size_t chunk_count = std::max<std::size_t>(1, std::min<std::size_t>(threads, size / MIN_CHUNK_SIZE));
+
+    // Split the log into chunks of roughly equal size.
+    std::vector<Chunk> chunks;
+    std::size_t begin = 0;
+    for (std::size_t i = 1; i <= chunk_count; i++) {
+        std::size_t end = i == chunk_count ? size :
+                          findResumePosition(data, size, format, size / chunk_count * i);
+        if (end > begin || (i == chunk_count && chunks.empty())) {
+            chunks.push_back({begin, end, Segmenter(), begin, 0, begin, false, false});
+            begin = end;
+        }
+    }
+
+    // Segment the chunks in parallel.
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < chunks.size(); i++) {
+        workers.emplace_back(segmentChunk, data, size, format, std::ref(chunks[i]));
+    }
+    segmentChunk(data, size, format, chunks[0]);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    // Stitch the chunks together, segmenting in order the records before each
+    // chunk's first transaction.
+    Segmenter result;
+    uint64_t record_base = 0;
+    std::size_t position = 0;
+    for (auto& chunk : chunks) {
+        if (chunk.failed || !chunk.started || position != chunk.begin) {
+            record_base += segmentRange(data, size, format, position, chunk.end, record_base, result);
+            continue;
+        }
+        segmentRange(data, size, format, position, chunk.start, record_base, result);
+        result.append(std::move(chunk.segmenter), record_base);
+        record_base += chunk.records;
+        position = chunk.stop;
+    }
+
+    SessionTable table;
+    table.transactions = std::move(result.transactions);
+    table.sessions = groupSessions(table.transactions);
+    return table;
+}
+
+void writeSessionTable(const SessionTable& table, std::ostream& output_stream) {
+    output_stream << "session,type,first_record,records,offset,start_timestamp,end_timestamp,"
+                     "command,command_size,frames,halted\n";
+    for (const auto& transaction : table.transactions) {
+        output_stream << transaction.session << ','
+                      << transactionTypeName(transaction.type) << ','
+                      << transaction.first_record << ','
+                      << transaction.records << ','
+                      << transaction.offset << ','
+                      << transaction.start_timestamp << ','
+                      << transaction.end_timestamp << ','
+                      << cmn::format_bytes(&transaction.command, 1) << ','
+                      << transaction.command_size << ','
+                      << transaction.frames << ','
+                      << (transaction.halted ? 1 : 0) << '\n';
+    }
+}
+
+
+}
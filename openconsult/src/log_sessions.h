@@ -0,0 +1,144 @@
+#ifndef OPENCONSULT_LIB_LOG_SESSIONS
+#define OPENCONSULT_LIB_LOG_SESSIONS
+
+#include "log_format.h"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace openconsult {
+
+
+/**
+ * @brief The kind of Consult transaction, identified by its command.
+ */
+enum class TransactionType {
+    /// @brief Connecting to the ECU: FF FF EF, answered by 10.
+    HANDSHAKE,
+    /// @brief Reading the ECU's part number: D0.
+    ECU_INFO,
+    /// @brief Reading the stored fault codes: D1.
+    FAULT_CODES,
+    /// @brief Selecting registers to stream engine parameters from: 5A xx.
+    REGISTER_SELECT,
+    /// @brief Any other command, or data logged without a preceding command.
+    OTHER,
+};
+
+
+/**
+ * @brief A single Consult transaction in a log: a command and its echo, then
+ *      optionally the go-ahead (F0), the frames streamed in response, and the
+ *      halt (30) and its acknowledgement.
+ */
+struct LogTransaction {
+    /// @brief The kind of transaction.
+    TransactionType type;
+    /// @brief The index of the session the transaction belongs to.
+    uint64_t session;
+    /// @brief The index of the transaction's first record in the log.
+    uint64_t first_record;
+    /// @brief The number of records in the transaction.
+    uint64_t records;
+    /// @brief The \c LogBufferParser::position() from which the transaction's
+    ///     first record is parsed.
+    uint64_t offset;
+    /// @brief The timestamp of the transaction's first record.
+    uint64_t start_timestamp;
+    /// @brief The timestamp of the transaction's last record.
+    uint64_t end_timestamp;
+    /// @brief The number of frames streamed. See \c FrameCounter .
+    uint64_t frames;
+    /// @brief The number of command bytes written before the go-ahead. Zero
+    ///     if the transaction has no command.
+    uint32_t command_size;
+    /// @brief The first command byte.
+    uint8_t command;
+    /// @brief Whether the transaction was halted.
+    bool halted;
+};
+
+
+/**
+ * @brief A session in a log: a handshake and the transactions following it,
+ *      up to the next handshake.
+ */
+struct LogSession {
+    /// @brief Whether the session starts with a handshake. Only the first
+    ///     session in a log, holding any transactions before the first
+    ///     handshake, may not.
+    bool handshake;
+    /// @brief The index of the session's first transaction.
+    uint64_t first_transaction;
+    /// @brief The number of transactions in the session.
+    uint64_t transactions;
+    /// @brief The index of the session's first record in the log.
+    uint64_t first_record;
+    /// @brief The number of records in the session.
+    uint64_t records;
+    /// @brief The \c LogBufferParser::position() from which the session's
+    ///     first record is parsed.
+    uint64_t offset;
+    /// @brief The timestamp of the session's first record.
+    uint64_t start_timestamp;
+    /// @brief The timestamp of the session's last record.
+    uint64_t end_timestamp;
+    /// @brief The number of frames streamed in the session.
+    uint64_t frames;
+};
+
+
+/**
+ * @brief The sessions and transactions in a log.
+ */
+struct SessionTable {
+    std::vector<LogSession> sessions;
+    std::vector<LogTransaction> transactions;
+};
+
+
+/**
+ * @brief Gets the name of a \c TransactionType .
+ *
+ * @param type The transaction type.
+ * @return The type's name, e.g. "REGISTER_SELECT".
+ */
+std::string transactionTypeName(TransactionType type);
+
+/**
+ * @brief Splits a log into sessions and transactions.
+ *
+ * Transactions are delimited by their commands: each write, other than a
+ * go-ahead or halt, which follows a read starts a transaction. Consecutive
+ * writes before the go-ahead form a single command.
+ *
+ * Large logs are split into chunks at positions found by
+ * \c findResumePosition(...) and segmented in parallel. Each chunk is then
+ * stitched to the one before it by re-segmenting, in order, the records before
+ * its first transaction.
+ *
+ * @param data Pointer to the log.
+ * @param size The size of the log, in bytes.
+ * @param format The format the log is in.
+ * @param threads The number of threads to use, or zero to use one per core.
+ * @return The log's sessions and transactions.
+ * @throws std::invalid_argument if the log is poorly formatted.
+ */
+SessionTable segmentLog(const uint8_t* data, std::size_t size, LogFormat format, unsigned threads = 0);
+
+/**
+ * @brief Writes a \c SessionTable 's transactions as CSV, one row per
+ *      transaction, for querying with other tools. The first row names the
+ *      columns.
+ *
+ * @param table The table to write.
+ * @param output_stream Stream to write to.
+ */
+void writeSessionTable(const SessionTable& table, std::ostream& output_stream);
+
+
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef OPENCONSULT_LIB_MAPPED_FILE
+#define OPENCONSULT_LIB_MAPPED_FILE
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace openconsult {
+
+
+/**
+ * @brief Basic RAII interface for mapping a file read-only into memory in a
+ *      platform-agnostic manner.
+ *
+ * Pages are loaded by the OS as they are accessed, so mapping even a very
+ * large file is cheap, and the memory used is bounded by the page cache rather
+ * than the file's size. The file is expected to be read sequentially.
+ */
+class MappedFile {
+public:
+    /**
+     * @brief Construct a new \c MappedFile , mapping the file at \c path .
+     *
+     * @param path Path of the file to map.
+     * @throws os_error if the file cannot be opened or mapped.
+     */
+    MappedFile(const std::string& path);
+
+    // MappedFile is not copyable.
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief Destroy the \c MappedFile , unmapping the file.
+     */
+    ~MappedFile();
+
+    /**
+     * @brief The contents of the file. Valid for the lifetime of this object.
+     *
+     * @return Pointer to the first byte of the file, or \c nullptr if the file
+     *      is empty.
+     */
+    const uint8_t* data() const;
+
+    /**
+     * @brief The size of the file.
+     *
+     * @return The size of the file, in bytes.
+     */
+    std::size_t size() const;
+
+private:
+    class impl;
+    std::unique_ptr<impl> pimpl;
+};
+
+
+}
+
+#endif
@@ -0,0 +1,78 @@
+#include "mapped_file.h"
+#include "byte_interface.h"
+#include "common.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace openconsult {
+
+
+class MappedFile::impl {
+public:
+    impl(const std::string& path)
+            : data(nullptr)
+            , size(0) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            std::string error = cmn::pformat("Failed to open %s: %s", path.c_str(), strerror(errno));
+            throw os_error(error);
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) < 0) {
+            std::string error = cmn::pformat("Failed to query %s: %s", path.c_str(), strerror(errno));
+            close(fd);
+            throw os_error(error);
+        }
+        size = static_cast<std::size_t>(info.st_size);
+
+        // Empty files cannot be mapped, but there is nothing to map anyway.
+        if (size > 0) {
+            void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                std::string error = cmn::pformat("Failed to map %s: %s", path.c_str(), strerror(errno));
+                close(fd);
+                throw os_error(error);
+            }
+            data = static_cast<const uint8_t*>(mapping);
+            // Encourage aggressive read-ahead, and early eviction of pages
+            // already read. Purely advisory, so failure is ignored.
+            madvise(mapping, size, MADV_SEQUENTIAL);
+        }
+
+        // The mapping remains valid after the descriptor is closed.
+        close(fd);
+    }
+
+    ~impl() {
+        if (data) {
+            munmap(const_cast<uint8_t*>(data), size);
+        }
+    }
+
+    const uint8_t* data;
+    std::size_t size;
+};
+
+
+MappedFile::MappedFile(const std::string& path)
+        : pimpl(new impl(path)) {
+}
+
+MappedFile::~MappedFile() = default;
+
+const uint8_t* MappedFile::data() const {
+    return pimpl->data;
+}
+
+std::size_t MappedFile::size() const {
+    return pimpl->size;
+}
+
+
+}
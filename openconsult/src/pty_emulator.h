@@ -0,0 +1,67 @@
+#ifndef OPENCONSULT_LIB_PTY_EMULATOR
+#define OPENCONSULT_LIB_PTY_EMULATOR
+
+#include "byte_interface.h"
+
+#include <memory>
+#include <string>
+
+namespace openconsult {
+
+
+/**
+ * @brief Serves a \c ByteInterface , typically a \c SimulatedECU , on a
+ *      pseudo-terminal, so a \c SerialPort may be opened on it exactly as on a
+ *      Consult cable.
+ *
+ * A background thread forwards bytes written to the terminal device to the
+ * \c ByteInterface , and forwards everything the \c ByteInterface has
+ * available back. The \c ByteInterface is therefore expected to pace its own
+ * replies, as a \c SimulatedECU does. It must be fully configured before it is
+ * served, and is not accessed by anything else while served.
+ */
+class PtyEmulator {
+public:
+    /**
+     * @brief Construct a new \c PtyEmulator , opening a pseudo-terminal and
+     *      serving \c device on it.
+     *
+     * @param device The interface to serve.
+     * @throws os_error if the pseudo-terminal cannot be opened.
+     */
+    PtyEmulator(std::unique_ptr<ByteInterface> device);
+
+    // PtyEmulator is not copyable.
+    PtyEmulator(const PtyEmulator&) = delete;
+    PtyEmulator& operator=(const PtyEmulator&) = delete;
+
+    /**
+     * @brief Destroy the \c PtyEmulator , stopping serving and closing the
+     *      pseudo-terminal.
+     */
+    ~PtyEmulator();
+
+    /**
+     * @brief The path of the terminal device to open, such as "/dev/pts/3".
+     *
+     * @return The path of the device.
+     */
+    const std::string& devicePath() const;
+
+    /**
+     * @brief Blocks until serving stops, which it only does on an error.
+     *
+     * @throws os_error if the pseudo-terminal fails.
+     * @throws The exception raised by the \c ByteInterface , if it failed.
+     */
+    void wait();
+
+private:
+    class impl;
+    std::unique_ptr<impl> pimpl;
+};
+
+
+}
+
+#endif
@@ -0,0 +1,175 @@
+#include "pty_emulator.h"
+#include "common.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace openconsult {
+
+
+/// @brief The longest the server sleeps between checking the served interface
+///     for bytes to forward. About a byte's transfer time at the Consult baud
+///     rate, so streamed bytes are forwarded as they become available.
+static const int POLL_INTERVAL_MS = 1;
+
+class PtyEmulator::impl {
+public:
+    impl(std::unique_ptr<ByteInterface> _device)
+            : device(std::move(_device))
+            , master_fd(-1)
+            , slave_fd(-1)
+            , stopping(false)
+            , finished(false) {
+        master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+        if (master_fd < 0) {
+            throw os_error(cmn::pformat("Failed to open pseudo-terminal: %s", strerror(errno)));
+        }
+        try {
+            if (grantpt(master_fd) != 0 || unlockpt(master_fd) != 0) {
+                throw os_error(cmn::pformat("Failed to unlock pseudo-terminal: %s", strerror(errno)));
+            }
+            const char* name = ptsname(master_fd);
+            if (name == nullptr) {
+                throw os_error(cmn::pformat("Failed to name pseudo-terminal: %s", strerror(errno)));
+            }
+            path = name;
+            if (fcntl(master_fd, F_SETFL, fcntl(master_fd, F_GETFL) | O_NONBLOCK) != 0) {
+                throw os_error(cmn::pformat("Failed to configure pseudo-terminal: %s", strerror(errno)));
+            }
+
+            // Hold the terminal device open, so the master is never hung up
+            // between clients. Its settings are left at the system defaults,
+            // as a serial port's would be, for the client to configure.
+            slave_fd = open(path.c_str(), O_RDWR | O_NOCTTY);
+            if (slave_fd < 0) {
+                throw os_error(cmn::pformat("Failed to open %s: %s", path.c_str(), strerror(errno)));
+            }
+        } catch (...) {
+            closeAll();
+            throw;
+        }
+        thread = std::thread(&impl::run, this);
+    }
+
+    // Non-copyable.
+    impl(const impl&) = delete;
+    impl& operator=(const impl&) = delete;
+
+    ~impl() {
+        stopping = true;
+        thread.join();
+        closeAll();
+    }
+
+    void closeAll() {
+        if (slave_fd >= 0) {
+            close(slave_fd);
+        }
+        if (master_fd >= 0) {
+            close(master_fd);
+        }
+    }
+
+    void run() {
+        try {
+            serve();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished = true;
+        }
+        finished_changed.notify_all();
+    }
+
+    void serve() {
+        std::vector<uint8_t> received(4096);
+        std::vector<uint8_t> pending;
+        std::size_t sent = 0;
+        while (!stopping) {
+            // Collect what the device has available before polling, so the
+            // poll only sleeps when there is nothing to forward either way.
+            if (pending.empty()) {
+                pending = device->read(0);
+                sent = 0;
+            }
+            struct pollfd pfd = {master_fd, static_cast<short>(POLLIN | (pending.empty() ? 0 : POLLOUT)), 0};
+            if (::poll(&pfd, 1, POLL_INTERVAL_MS) < 0 && errno != EINTR) {
+                throw os_error(cmn::pformat("Failed to poll pseudo-terminal: %s", strerror(errno)));
+            }
+
+            // Forward what the client has written.
+            ssize_t bytes_read = ::read(master_fd, received.data(), received.size());
+            if (bytes_read > 0) {
+                device->write(received.data(), static_cast<std::size_t>(bytes_read));
+            } else if (bytes_read < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                throw os_error(cmn::pformat("Failed to read from pseudo-terminal: %s", strerror(errno)));
+            }
+
+            // Forward what the device had available, as far as the terminal
+            // will accept it.
+            if (!pending.empty()) {
+                ssize_t bytes_written = ::write(master_fd, pending.data() + sent, pending.size() - sent);
+                if (bytes_written > 0) {
+                    sent += static_cast<std::size_t>(bytes_written);
+                    if (sent == pending.size()) {
+                        pending.clear();
+                    }
+                } else if (bytes_written < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    throw os_error(cmn::pformat("Failed to write to pseudo-terminal: %s", strerror(errno)));
+                }
+            }
+        }
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished_changed.wait(lock, [this]() { return finished; });
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    std::unique_ptr<ByteInterface> device;
+    std::string path;
+    int master_fd;
+    int slave_fd;
+    std::atomic<bool> stopping;
+    /// @brief Guards \c finished .
+    std::mutex mutex;
+    std::condition_variable finished_changed;
+    bool finished;
+    std::exception_ptr error;
+    std::thread thread;
+};
+
+
+PtyEmulator::PtyEmulator(std::unique_ptr<ByteInterface> device)
+        : pimpl(new impl(std::move(device))) {
+}
+
+PtyEmulator::~PtyEmulator() {
+}
+
+const std::string& PtyEmulator::devicePath() const {
+    return pimpl->path;
+}
+
+void PtyEmulator::wait() {
+    pimpl->wait();
+}
+
+
+}
@@ -3,6 +3,7 @@
 
 #include "byte_interface.h"
 
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include <stdexcept>
@@ -12,24 +13,16 @@
 namespace openconsult {
 
 
-/**
- * @brief Exception type thrown to indicate an unhandled error coming from an
- * Operating System call.
- */
-class os_error : public std::runtime_error {
-public:
-    os_error(const char* message) :
-        std::runtime_error(message) {
-    }
-
-    os_error(const std::string& message) :
-        std::runtime_error(message) {
-    }
-};
-
 /**
  * @brief Basic RAII interface for communicating with a serial port in a
  *      platform-agnostic manner.
+ *
+ * Reads are buffered: each time the port is read from, everything the device
+ * has ready is pulled into an internal buffer, from which subsequent reads are
+ * served. Small reads therefore rarely require a system call.
+ *
+ * Reads block indefinitely by default. A timeout and/or deadline may be set to
+ * bound them, in which case a stalled device raises \c timeout_error .
  */
 class SerialPort : public ByteInterface {
 public:
@@ -57,17 +50,42 @@ public:
     /**
      * @copydoc ByteInterface::read(std::size_t)
      *
-     * @throws os_error is the read fails unexpectedly.
+     * @throws os_error if the read fails unexpectedly.
      */
     virtual std::vector<uint8_t> read(std::size_t size = 0) override;
 
+    /**
+     * @copydoc ByteInterface::readInto(uint8_t*, std::size_t)
+     *
+     * @throws os_error if the read fails unexpectedly.
+     */
+    virtual void readInto(uint8_t* dst, std::size_t size) override;
+
     /**
      * @copydoc ByteInterface::write(std::vector<uint8_t>)
      *
-     * @throws os_error is the write fails unexpectedly.
+     * @throws os_error if the write fails unexpectedly.
+     * @throws timeout_error if the device cannot accept the bytes in time.
      */
     virtual void write(const std::vector<uint8_t>& bytes) override;
 
+    /**
+     * @copydoc ByteInterface::write(const uint8_t*, std::size_t)
+     *
+     * @throws os_error if the write fails unexpectedly.
+     * @throws timeout_error if the device cannot accept the bytes in time.
+     */
+    virtual void write(const uint8_t* bytes, std::size_t size) override;
+
+    /// @copydoc ByteInterface::setTimeout(std::chrono::milliseconds)
+    virtual void setTimeout(std::chrono::milliseconds timeout) override;
+
+    /// @copydoc ByteInterface::setDeadline(clock::time_point)
+    virtual void setDeadline(clock::time_point deadline) override;
+
+    /// @copydoc ByteInterface::lastReadTime()
+    virtual clock::time_point lastReadTime() const override;
+
 private:
     struct impl;
     std::unique_ptr<impl> pimpl;
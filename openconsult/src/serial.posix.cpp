@@ -3,17 +3,191 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <string.h>
+#include <sys/uio.h>
 #include <termios.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <chrono>
 #include <string>
 
 namespace openconsult {
 
 
+/// @brief Capacity of the receive buffer. Must be a power of two.
+static constexpr std::size_t RX_BUFFER_SIZE = 4096;
+
 struct SerialPort::impl {
+    impl() : rx_buffer(RX_BUFFER_SIZE), rx_head(0), rx_count(0)
+           , rx_stamps(RX_BUFFER_SIZE), stamp_head(0), stamp_count(0)
+           , rx_received(0), rx_consumed(0)
+           , timeout(0), deadline(ByteInterface::clock::time_point::max()) {
+    }
+
+    /**
+     * @brief Calculates the time by which a call starting now must complete,
+     *      from the configured timeout and deadline.
+     *
+     * @return The time the call must complete by, or
+     *      \c clock::time_point::max() if it may block indefinitely.
+     */
+    ByteInterface::clock::time_point callDeadline() const {
+        if (timeout.count() > 0) {
+            return std::min(deadline, ByteInterface::clock::now() + timeout);
+        }
+        return deadline;
+    }
+
+    /**
+     * @brief Waits until the device is ready for the requested operation.
+     *
+     * @param events The poll events to wait for (\c POLLIN or \c POLLOUT ).
+     * @param until The time by which the device must become ready.
+     * @throws timeout_error if the device does not become ready in time.
+     * @throws os_error if polling the device fails unexpectedly, or the device
+     *      has hung up.
+     */
+    void wait(short events, ByteInterface::clock::time_point until) {
+        auto now = ByteInterface::clock::now();
+        struct pollfd pfd;
+        int poll_result;
+        do {
+            int wait_ms = -1;
+            if (until != ByteInterface::clock::time_point::max()) {
+                // Round up so we never spin on a sub-millisecond remainder.
+                auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(until - now);
+                if (remaining < until - now) {
+                    remaining += std::chrono::milliseconds(1);
+                }
+                wait_ms = static_cast<int>(std::max<std::chrono::milliseconds::rep>(remaining.count(), 0));
+            }
+            pfd = {port_fd, events, 0};
+            poll_result = ::poll(&pfd, 1, wait_ms);
+            now = ByteInterface::clock::now();
+        } while (poll_result < 0 && errno == EINTR);
+        if (poll_result < 0) {
+            std::string error = cmn::pformat("Failed to poll serial port: %s", strerror(errno));
+            throw os_error(error);
+        }
+        if (poll_result == 0) {
+            throw timeout_error();
+        }
+        // A hung up device polls ready immediately, forever. Any bytes it sent
+        // before hanging up are still read first.
+        if (!(pfd.revents & events) && (pfd.revents & (POLLHUP | POLLERR | POLLNVAL))) {
+            throw os_error("Serial device disconnected");
+        }
+    }
+
+    /**
+     * @brief Pulls as many bytes as the device has ready into the receive
+     *      buffer, in a single system call.
+     *
+     * @param block \c true to wait until at least one byte is available,
+     *      \c false to return immediately if there is nothing to read.
+     * @param until The time by which data must arrive, if blocking.
+     * @throws timeout_error if blocking and no data arrives in time.
+     * @throws os_error if the read fails unexpectedly, or the device has hung
+     *      up while blocking.
+     */
+    void fill(bool block, ByteInterface::clock::time_point until = ByteInterface::clock::time_point::max()) {
+        // The free space in the ring may wrap, in which case it is described
+        // by two regions.
+        std::size_t tail = (rx_head + rx_count) & (RX_BUFFER_SIZE - 1);
+        std::size_t free = RX_BUFFER_SIZE - rx_count;
+        std::size_t first = std::min(free, RX_BUFFER_SIZE - tail);
+        struct iovec regions[2] = {
+            {rx_buffer.data() + tail, first},
+            {rx_buffer.data(),        free - first},
+        };
+        while (true) {
+            ssize_t bytes_read = ::readv(port_fd, regions, regions[1].iov_len ? 2 : 1);
+            if (bytes_read > 0) {
+                rx_count += static_cast<std::size_t>(bytes_read);
+                rx_received += static_cast<uint64_t>(bytes_read);
+                // Each fill holds at least one byte, so there are never more
+                // stamps than bytes in the ring.
+                rx_stamps[(stamp_head + stamp_count++) & (RX_BUFFER_SIZE - 1)] = {
+                    rx_received, ByteInterface::clock::now()};
+                return;
+            } else if (bytes_read == 0) {
+                // End of file: the device has gone away.
+                if (!block) {
+                    return;
+                }
+                throw os_error("Serial device disconnected");
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (!block) {
+                    return;
+                }
+                wait(POLLIN, until);
+            } else if (errno != EINTR) {
+                std::string error = cmn::pformat("Failed to read from serial port: %s", strerror(errno));
+                throw os_error(error);
+            }
+        }
+    }
+
+    /**
+     * @brief Moves up to \c size bytes out of the receive buffer, noting when
+     *      the last of them was received.
+     *
+     * @param dst Destination to copy the bytes to.
+     * @param size Maximum number of bytes to copy.
+     * @return The number of bytes copied.
+     */
+    std::size_t drain(uint8_t* dst, std::size_t size) {
+        std::size_t count = std::min(size, rx_count);
+        std::size_t first = std::min(count, RX_BUFFER_SIZE - rx_head);
+        std::copy_n(rx_buffer.data() + rx_head, first, dst);
+        std::copy_n(rx_buffer.data(), count - first, dst + first);
+        rx_head = (rx_head + count) & (RX_BUFFER_SIZE - 1);
+        rx_count -= count;
+        if (count > 0) {
+            // Drop the stamps of fills consumed entirely, keeping the time
+            // of the fill holding the last byte consumed.
+            rx_consumed += count;
+            while (rx_stamps[stamp_head].end < rx_consumed) {
+                stamp_head = (stamp_head + 1) & (RX_BUFFER_SIZE - 1);
+                stamp_count--;
+            }
+            last_read_time = rx_stamps[stamp_head].time;
+            if (rx_stamps[stamp_head].end == rx_consumed) {
+                stamp_head = (stamp_head + 1) & (RX_BUFFER_SIZE - 1);
+                stamp_count--;
+            }
+        }
+        return count;
+    }
+
     int port_fd;
+    /// @brief Ring buffer of bytes read from the device but not yet consumed.
+    std::vector<uint8_t> rx_buffer;
+    std::size_t rx_head;
+    std::size_t rx_count;
+    /// @brief When a fill of the receive buffer was received.
+    struct RxStamp {
+        /// @brief The total number of bytes received by the end of the fill.
+        uint64_t end;
+        ByteInterface::clock::time_point time;
+    };
+    /// @brief Ring buffer of the times of the fills still in \c rx_buffer ,
+    ///     oldest first.
+    std::vector<RxStamp> rx_stamps;
+    std::size_t stamp_head;
+    std::size_t stamp_count;
+    /// @brief The total number of bytes read from the device.
+    uint64_t rx_received;
+    /// @brief The total number of bytes drained from the receive buffer.
+    uint64_t rx_consumed;
+    /// @brief When the last byte drained from the receive buffer was received.
+    ByteInterface::clock::time_point last_read_time;
+    /// @brief Maximum time a single read may wait for data. Zero to disable.
+    std::chrono::milliseconds timeout;
+    /// @brief Time by which all reads must complete.
+    ByteInterface::clock::time_point deadline;
 };
 
 speed_t baudRateToSpeed(uint32_t baud_rate) {
@@ -55,7 +229,7 @@ speed_t baudRateToSpeed(uint32_t baud_rate) {
 SerialPort::SerialPort(const std::string& device, uint32_t baud_rate)
         : pimpl(new impl) {
     // Open the port.
-    int fd = open(device.c_str(), O_RDWR | O_NOCTTY | O_SYNC);
+    int fd = open(device.c_str(), O_RDWR | O_NOCTTY | O_SYNC | O_NONBLOCK);
     if (fd < 0) {
         std::string error = cmn::pformat("Failed to open %s: %s", device.c_str(), strerror(errno));
         throw os_error(error);
@@ -65,6 +239,7 @@ SerialPort::SerialPort(const std::string& device, uint32_t baud_rate)
     struct termios tty;
     if (tcgetattr(fd, &tty) != 0) {
         std::string error = cmn::pformat("Failed to query device: %s", strerror(errno));
+        close(fd);
         throw os_error(error);
     }
 
@@ -80,14 +255,17 @@ SerialPort::SerialPort(const std::string& device, uint32_t baud_rate)
     tty.c_cflag &= ~CRTSCTS;                    // Disable RTS/CTS flow control. Non posix.
     tty.c_lflag = 0;                            // Disable all echoing and signal generation. Also
                                                 // ensure non-canonical mode (so not line-based).
-    tty.c_iflag &= ~IGNBRK;                     // Ignore BREAK condition on input.
+    tty.c_iflag &= ~(IGNBRK | BRKINT | PARMRK); // Read BREAK conditions as null bytes.
+    tty.c_iflag &= ~(INPCK | ISTRIP);           // Disable parity checking and 7-bit stripping.
+    tty.c_iflag &= ~(INLCR | IGNCR | ICRNL);    // Disable carriage return and newline remapping.
     tty.c_iflag &= ~(IXON | IXOFF | IXANY);     // Disable XON/XOFF flow control.
     tty.c_oflag = 0;                            // Disable all remapping and delays.
-    tty.c_cc[VMIN] = 1;                         // Set VMIN to a non-zero value to enable blocking.
-    tty.c_cc[VTIME] = 0;                        // Disable read timeouts.
+    tty.c_cc[VMIN] = 1;                         // Blocking is handled with poll(), as the port
+    tty.c_cc[VTIME] = 0;                        // is non-blocking, so VMIN/VTIME are unused.
 
     if (tcsetattr(fd, TCSANOW, &tty) != 0) {
         std::string error = cmn::pformat("Failed to configure device: %s", strerror(errno));
+        close(fd);
         throw os_error(error);
     }
 
@@ -100,28 +278,49 @@ SerialPort::~SerialPort() {
 }
 
 std::vector<uint8_t> SerialPort::read(std::size_t size) {
-    std::vector<uint8_t> buff(size);
-    std::size_t total_bytes_read = 0;
-    while (total_bytes_read < size) {
-        int bytes_read = ::read(pimpl->port_fd,
-                buff.data() + total_bytes_read,
-                size - total_bytes_read);
-        if (bytes_read < 0) {
-            std::string error = cmn::pformat("Failed to read from serial port: %s", strerror(errno));
-            throw os_error(error);
-        }
-        total_bytes_read += static_cast<std::size_t>(bytes_read);
+    if (size == 0) {
+        // Return everything that is available without blocking.
+        pimpl->fill(false);
+        std::vector<uint8_t> buff(pimpl->rx_count);
+        pimpl->drain(buff.data(), buff.size());
+        return buff;
     }
+
+    std::vector<uint8_t> buff(size);
+    readInto(buff.data(), size);
     return buff;
 }
 
+void SerialPort::readInto(uint8_t* dst, std::size_t size) {
+    std::size_t total_bytes_read = pimpl->drain(dst, size);
+    if (total_bytes_read < size) {
+        auto until = pimpl->callDeadline();
+        do {
+            pimpl->fill(true, until);
+            total_bytes_read += pimpl->drain(dst + total_bytes_read,
+                                             size - total_bytes_read);
+        } while (total_bytes_read < size);
+    }
+}
+
 void SerialPort::write(const std::vector<uint8_t>& bytes) {
+    write(bytes.data(), bytes.size());
+}
+
+void SerialPort::write(const uint8_t* bytes, std::size_t size) {
+    auto until = pimpl->callDeadline();
     std::size_t total_bytes_written = 0;
-    while (total_bytes_written < bytes.size()) {
+    while (total_bytes_written < size) {
         ssize_t bytes_written = ::write(pimpl->port_fd,
-                bytes.data() + total_bytes_written,
-                bytes.size() - total_bytes_written);
+                bytes + total_bytes_written,
+                size - total_bytes_written);
         if (bytes_written < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                pimpl->wait(POLLOUT, until);
+                continue;
+            } else if (errno == EINTR) {
+                continue;
+            }
             std::string error = cmn::pformat("Failed to write to serial port: %s", strerror(errno));
             throw os_error(error);
         }
@@ -129,5 +328,17 @@ void SerialPort::write(const std::vector<uint8_t>& bytes) {
     }
 }
 
+void SerialPort::setTimeout(std::chrono::milliseconds timeout) {
+    pimpl->timeout = timeout;
+}
+
+void SerialPort::setDeadline(clock::time_point deadline) {
+    pimpl->deadline = deadline;
+}
+
+ByteInterface::clock::time_point SerialPort::lastReadTime() const {
+    return pimpl->last_read_time;
+}
+
 
 }
@@ -3,14 +3,105 @@
 
 #include <Windows.h>
 
+#include <algorithm>
+#include <chrono>
 #include <string>
 #include <system_error>
 
 namespace openconsult {
 
 
+std::string last_error();
+
 struct SerialPort::impl {
+    impl() : timeout(0), deadline(ByteInterface::clock::time_point::max()), applied_valid(false) {
+    }
+
+    /**
+     * @brief Calculates the time by which a call starting now must complete,
+     *      from the configured timeout and deadline.
+     *
+     * @return The time the call must complete by, or
+     *      \c clock::time_point::max() if it may block indefinitely.
+     */
+    ByteInterface::clock::time_point callDeadline() const {
+        if (timeout.count() > 0) {
+            return std::min(deadline, ByteInterface::clock::now() + timeout);
+        }
+        return deadline;
+    }
+
+    /**
+     * @brief Configures the port's timeouts so the next transfer completes by
+     *      a given time. The port is only reconfigured if this changes its
+     *      timeouts, which without a deadline they rarely do.
+     *
+     * @param until The time by which the transfer must complete, or
+     *      \c clock::time_point::max() to block indefinitely.
+     * @throws timeout_error if \c until has already passed.
+     * @throws os_error if the timeouts cannot be configured.
+     */
+    void applyDeadline(ByteInterface::clock::time_point until) {
+        COMMTIMEOUTS timeouts = {0};
+        if (until != ByteInterface::clock::time_point::max()) {
+            // Round up so we never spin on a sub-millisecond remainder. A zero
+            // total timeout would block indefinitely, so is never applied.
+            auto now = ByteInterface::clock::now();
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(until - now);
+            if (remaining < until - now) {
+                remaining += std::chrono::milliseconds(1);
+            }
+            if (remaining.count() <= 0) {
+                throw timeout_error();
+            }
+            DWORD constant = static_cast<DWORD>(std::min<std::chrono::milliseconds::rep>(remaining.count(), MAXDWORD - 1));
+            timeouts.ReadTotalTimeoutConstant = constant;
+            timeouts.WriteTotalTimeoutConstant = constant;
+        }
+        setTimeouts(timeouts);
+    }
+
+    /**
+     * @brief Configures the port so reads return immediately with whatever is
+     *      available.
+     *
+     * @throws os_error if the timeouts cannot be configured.
+     */
+    void applyNonBlocking() {
+        COMMTIMEOUTS timeouts = {0};
+        timeouts.ReadIntervalTimeout = MAXDWORD;
+        setTimeouts(timeouts);
+    }
+
+    void setTimeouts(COMMTIMEOUTS& timeouts) {
+        if (applied_valid &&
+                timeouts.ReadIntervalTimeout == applied.ReadIntervalTimeout &&
+                timeouts.ReadTotalTimeoutMultiplier == applied.ReadTotalTimeoutMultiplier &&
+                timeouts.ReadTotalTimeoutConstant == applied.ReadTotalTimeoutConstant &&
+                timeouts.WriteTotalTimeoutMultiplier == applied.WriteTotalTimeoutMultiplier &&
+                timeouts.WriteTotalTimeoutConstant == applied.WriteTotalTimeoutConstant) {
+            return;
+        }
+        applied_valid = false;
+        if (!SetCommTimeouts(port_handle, &timeouts)) {
+            std::string error = cmn::pformat("Failed to configure timeouts: %s", last_error().c_str());
+            throw os_error(error);
+        }
+        applied = timeouts;
+        applied_valid = true;
+    }
+
     HANDLE port_handle;
+    /// @brief Maximum time a single read may wait for data. Zero to disable.
+    std::chrono::milliseconds timeout;
+    /// @brief Time by which all reads must complete.
+    ByteInterface::clock::time_point deadline;
+    /// @brief The timeouts the port is configured with, if \c applied_valid .
+    COMMTIMEOUTS applied;
+    bool applied_valid;
+    /// @brief When the last byte read was received. Reads are not buffered
+    ///     ahead, so this is when the read returned it.
+    ByteInterface::clock::time_point last_read_time;
 };
 
 std::string last_error() {
@@ -29,14 +120,14 @@ SerialPort::SerialPort(const std::string& device, uint32_t baud_rate)
             FILE_ATTRIBUTE_NORMAL,      // No special file type.
             NULL);                      // No template file.
 	if (handle == INVALID_HANDLE_VALUE) {
-        std::string error = cmn::pformat("Failed to open %s: %s", device, last_error());
+        std::string error = cmn::pformat("Failed to open %s: %s", device.c_str(), last_error().c_str());
         throw os_error(error);
 	}
 
     // Configure the port.
     DCB params = {0};
     if (!GetCommState(handle, &params)) {
-        std::string error = cmn::pformat("Failed to query device: %s", last_error());
+        std::string error = cmn::pformat("Failed to query device: %s", last_error().c_str());
         throw os_error(error);
     }
 
@@ -47,14 +138,15 @@ SerialPort::SerialPort(const std::string& device, uint32_t baud_rate)
     params.Parity = NOPARITY;
     params.fDtrControl = DTR_CONTROL_ENABLE;    // Enable DTR flow control.
 
-    if (!SetCommState(handle, &params))
-        std::string error = cmn::pformat("Failed to configure device: %s", last_error());
+    if (!SetCommState(handle, &params)) {
+        std::string error = cmn::pformat("Failed to configure device: %s", last_error().c_str());
         throw os_error(error);
     }
     PurgeComm(handle, PURGE_RXCLEAR | PURGE_TXCLEAR);
 
-    // Assign to the impl.
+    // Assign to the impl, and block indefinitely until a timeout is set.
     pimpl->port_handle = handle;
+    pimpl->applyDeadline(pimpl->callDeadline());
 }
 
 SerialPort::~SerialPort() {
@@ -62,38 +154,102 @@ SerialPort::~SerialPort() {
 }
 
 std::vector<uint8_t> SerialPort::read(std::size_t size) {
+    if (size == 0) {
+        // Return everything that is available without blocking.
+        COMSTAT status;
+        if (!ClearCommError(pimpl->port_handle, NULL, &status)) {
+            std::string error = cmn::pformat("Failed to query serial port: %s", last_error().c_str());
+            throw os_error(error);
+        }
+        std::vector<uint8_t> buff(status.cbInQue);
+        if (!buff.empty()) {
+            pimpl->applyNonBlocking();
+            DWORD bytes_read = 0;
+            if (!ReadFile(pimpl->port_handle, buff.data(), static_cast<DWORD>(buff.size()), &bytes_read, NULL)) {
+                std::string error = cmn::pformat("Failed to read from serial port: %s", last_error().c_str());
+                throw os_error(error);
+            }
+            buff.resize(bytes_read);
+            if (bytes_read > 0) {
+                pimpl->last_read_time = ByteInterface::clock::now();
+            }
+        }
+        return buff;
+    }
+
     std::vector<uint8_t> buff(size);
+    readInto(buff.data(), size);
+    return buff;
+}
+
+void SerialPort::readInto(uint8_t* dst, std::size_t size) {
+    auto until = pimpl->callDeadline();
+    pimpl->applyDeadline(until);
     std::size_t total_bytes_read = 0;
     while (total_bytes_read < size) {
-        std::size_t bytes_read = 0;
+        DWORD requested = static_cast<DWORD>(size - total_bytes_read);
+        DWORD bytes_read = 0;
         bool success = ReadFile(pimpl->port_handle,
-                buff.data() + total_bytes_read,
-                size - total_bytes_read,
+                dst + total_bytes_read,
+                requested,
                 &bytes_read, NULL);
         if (!success) {
-            std::string error = cmn::pformat("Failed to read from serial port: %s", last_error());
+            std::string error = cmn::pformat("Failed to read from serial port: %s", last_error().c_str());
             throw os_error(error);
         }
+        if (bytes_read < requested && until != ByteInterface::clock::time_point::max()) {
+            // The total timeout elapsed before the rest of the bytes arrived.
+            throw timeout_error();
+        }
         total_bytes_read += bytes_read;
     }
-    return buff;
+    if (size > 0) {
+        pimpl->last_read_time = ByteInterface::clock::now();
+    }
 }
 
 void SerialPort::write(const std::vector<uint8_t>& bytes) {
+    write(bytes.data(), bytes.size());
+}
+
+void SerialPort::write(const uint8_t* bytes, std::size_t size) {
+    auto until = pimpl->callDeadline();
+    pimpl->applyDeadline(until);
     std::size_t total_bytes_written = 0;
-    while (total_bytes_written < bytes.size()) {
-        std::size_t bytes_written = 0;
+    while (total_bytes_written < size) {
+        DWORD requested = static_cast<DWORD>(size - total_bytes_written);
+        DWORD bytes_written = 0;
         bool success = WriteFile(pimpl->port_handle,
-                bytes.data() + total_bytes_written,
-                bytes.size() - total_bytes_written,
+                bytes + total_bytes_written,
+                requested,
                 &bytes_written, NULL);
         if (!success) {
-            std::string error = cmn::pformat("Failed to write to serial port: %s", last_error());
+            std::string error = cmn::pformat("Failed to write to serial port: %s", last_error().c_str());
             throw os_error(error);
         }
+        if (bytes_written < requested && until != ByteInterface::clock::time_point::max()) {
+            throw timeout_error();
+        }
         total_bytes_written += bytes_written;
     }
 }
 
+void SerialPort::setTimeout(std::chrono::milliseconds timeout) {
+    pimpl->timeout = timeout;
+    if (pimpl->deadline == clock::time_point::max()) {
+        // Without a deadline every transfer uses these timeouts, so apply
+        // them now rather than on the next transfer.
+        pimpl->applyDeadline(pimpl->callDeadline());
+    }
+}
+
+void SerialPort::setDeadline(clock::time_point deadline) {
+    pimpl->deadline = deadline;
+}
+
+ByteInterface::clock::time_point SerialPort::lastReadTime() const {
+    return pimpl->last_read_time;
+}
+
 
 }
@@ -0,0 +1,484 @@
+#include "simulated_ecu.h"
+#include "common.h"
+#include "consult_engine_parameters.internal.h"
+#include "consult_fault_codes.internal.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+namespace openconsult {
+
+
+/**
+ * @brief Encodes a value as the raw bytes of a parameter which decode nearest
+ *      to it.
+ *
+ * @param decoder The parameter's decoder.
+ * @param value The value to encode.
+ * @return The raw bytes, most significant first for two-byte parameters.
+ */
+static uint16_t encodeNearest(const EngineParameterDecoder& decoder, double value) {
+    auto decode = [&decoder](uint16_t raw) {
+        uint8_t bytes[2];
+        if (decoder.width == 1) {
+            bytes[0] = static_cast<uint8_t>(raw);
+        } else {
+            bytes[0] = static_cast<uint8_t>(raw >> 8);
+            bytes[1] = static_cast<uint8_t>(raw);
+        }
+        return decoder.decode(bytes);
+    };
+    if (decoder.width == 1) {
+        // Single-byte encodings need not be monotonic, so try every byte.
+        uint16_t nearest = 0;
+        for (uint16_t raw = 1; raw <= 0xFF; raw++) {
+            if (std::fabs(decode(raw) - value) < std::fabs(decode(nearest) - value)) {
+                nearest = raw;
+            }
+        }
+        return nearest;
+    }
+    // Two-byte encodings are linear, so binary search for the first raw value
+    // at or beyond the value.
+    bool increasing = decode(0xFFFF) >= decode(0);
+    uint32_t low = 0;
+    uint32_t high = 0xFFFF;
+    while (low < high) {
+        uint32_t middle = (low + high) / 2;
+        double decoded = decode(static_cast<uint16_t>(middle));
+        if (increasing ? decoded < value : decoded > value) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low > 0 && std::fabs(decode(static_cast<uint16_t>(low - 1)) - value) <=
+                   std::fabs(decode(static_cast<uint16_t>(low)) - value)) {
+        low--;
+    }
+    return static_cast<uint16_t>(low);
+}
+
+
+struct SimulatedECU::impl {
+    using clock = ByteInterface::clock;
+
+    /// @brief What the ECU has been asked to stream.
+    enum class Request {
+        NONE,
+        METADATA,
+        FAULT_CODES,
+        REGISTERS,
+    };
+
+    /// @brief A byte sent by the ECU, and the time it finishes arriving.
+    struct Byte {
+        uint64_t time;
+        uint8_t value;
+    };
+
+    impl(SimulatedTiming timing)
+            : timing(timing)
+            , epoch(clock::now())
+            , virtual_time(0)
+            , timeout(0)
+            , deadline(clock::time_point::max())
+            , latency(0)
+            , host_free(0)
+            , ecu_free(0)
+            , connected(false)
+            , handshake(0)
+            , selecting(false)
+            , request(Request::NONE)
+            , streaming(false)
+            , metadata {{0x00, 0x00, 0x04, 0x88, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x0F, 0x00}}
+            , fault_codes {{faultCodeToId(FaultCode::NO_MALFUNCTION), 0x00}} {
+    }
+
+    uint64_t now() const {
+        if (timing == SimulatedTiming::VIRTUAL) {
+            return virtual_time;
+        }
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - epoch).count();
+    }
+
+    /**
+     * @brief Receives bytes from the host. Each is acted upon as it finishes
+     *      arriving, after those before it.
+     */
+    void receive(const uint8_t* bytes, std::size_t size) {
+        uint64_t time = std::max(now(), host_free);
+        for (std::size_t i = 0; i < size; i++) {
+            time += BYTE_TIME_NS;
+            receive(bytes[i], time + latency);
+        }
+        host_free = time;
+    }
+
+    void receive(uint8_t byte, uint64_t time) {
+        // Register selects take the following byte as the register.
+        if (selecting) {
+            selecting = false;
+            registers.push_back(byte);
+            send(byte, time);
+            return;
+        }
+
+        // The handshake is recognised at any time, and resets the ECU.
+        if (byte == 0xFF) {
+            handshake = std::min(handshake + 1, 2);
+            return;
+        }
+        if (byte == 0xEF && handshake == 2) {
+            handshake = 0;
+            halt(time);
+            connected = true;
+            send(0x10, time);
+            return;
+        }
+        handshake = 0;
+        if (!connected) {
+            return;
+        }
+
+        // While streaming only the stop is acted upon.
+        if (streaming) {
+            if (byte == 0x30) {
+                halt(time);
+                send(0xCF, time);
+            }
+            return;
+        }
+        switch (byte) {
+            case 0x5A:
+                if (request != Request::REGISTERS) {
+                    request = Request::REGISTERS;
+                    registers.clear();
+                }
+                selecting = true;
+                send(static_cast<uint8_t>(~byte), time);
+                break;
+            case 0xD0:
+                request = Request::METADATA;
+                send(static_cast<uint8_t>(~byte), time);
+                break;
+            case 0xD1:
+                request = Request::FAULT_CODES;
+                send(static_cast<uint8_t>(~byte), time);
+                break;
+            case 0xF0:
+                if (request == Request::NONE) {
+                    send(0xFE, time);
+                } else {
+                    streaming = true;
+                    ecu_free = std::max(ecu_free, time);
+                }
+                break;
+            case 0x30:
+                request = Request::NONE;
+                send(0xCF, time);
+                break;
+            default:
+                send(0xFE, time);
+                break;
+        }
+    }
+
+    /**
+     * @brief Queues a byte to be sent once the ECU has sent those before it.
+     */
+    void send(uint8_t value, uint64_t time) {
+        ecu_free = std::max(ecu_free, time) + BYTE_TIME_NS;
+        output.push_back({ecu_free, value});
+    }
+
+    /**
+     * @brief Queues the next frame of the stream, sampled at the time it
+     *      starts.
+     */
+    void sendFrame() {
+        uint64_t start = ecu_free;
+        frame.clear();
+        switch (request) {
+            case Request::NONE:
+                break;
+            case Request::METADATA:
+                frame = metadata;
+                break;
+            case Request::FAULT_CODES:
+                frame = fault_codes;
+                break;
+            case Request::REGISTERS:
+                for (uint8_t address : registers) {
+                    frame.push_back(waveforms[address] ? waveforms[address](start) : 0);
+                }
+                break;
+        }
+        send(0xFF, start);
+        send(static_cast<uint8_t>(frame.size()), start);
+        for (uint8_t byte : frame) {
+            send(byte, start);
+        }
+    }
+
+    /**
+     * @brief Stops streaming at a time, completing any frame started before
+     *      it.
+     */
+    void halt(uint64_t time) {
+        if (streaming) {
+            while (ecu_free < time) {
+                sendFrame();
+            }
+        }
+        streaming = false;
+        selecting = false;
+        request = Request::NONE;
+    }
+
+    /**
+     * @brief Queues frames until at least \c size bytes are queued, if
+     *      streaming.
+     *
+     * @return \c true if \c size bytes are queued.
+     */
+    bool fill(std::size_t size) {
+        while (output.size() < size && streaming) {
+            sendFrame();
+        }
+        return output.size() >= size;
+    }
+
+    /**
+     * @brief The time the current read must complete by, with \c REAL_TIME
+     *      timing.
+     */
+    clock::time_point readLimit() const {
+        clock::time_point limit = deadline;
+        if (timeout.count() > 0) {
+            limit = std::min(limit, clock::now() + timeout);
+        }
+        return limit;
+    }
+
+    /**
+     * @brief Waits until a time, as a read ending then would.
+     *
+     * @throws timeout_error if the time is beyond the read's timeout or
+     *      deadline.
+     */
+    void waitUntil(uint64_t time) {
+        if (timing == SimulatedTiming::VIRTUAL) {
+            virtual_time = std::max(virtual_time, time);
+            return;
+        }
+        clock::time_point target = epoch + std::chrono::nanoseconds(time);
+        clock::time_point limit = readLimit();
+        if (target > limit) {
+            std::this_thread::sleep_until(limit);
+            throw timeout_error();
+        }
+        cmn::sleep_until_precise(target);
+    }
+
+    /**
+     * @brief Fails a read which could never complete.
+     *
+     * @throws timeout_error always.
+     */
+    void starve() {
+        if (timing == SimulatedTiming::REAL_TIME) {
+            clock::time_point limit = readLimit();
+            if (limit != clock::time_point::max()) {
+                std::this_thread::sleep_until(limit);
+            }
+        }
+        throw timeout_error();
+    }
+
+    void readInto(uint8_t* dst, std::size_t size) {
+        if (size == 0) {
+            return;
+        }
+        if (!fill(size)) {
+            starve();
+        }
+        waitUntil(output[size - 1].time);
+        for (std::size_t i = 0; i < size; i++) {
+            dst[i] = output.front().value;
+            output.pop_front();
+        }
+    }
+
+    std::vector<uint8_t> readAvailable() {
+        uint64_t time = now();
+        if (timing == SimulatedTiming::VIRTUAL) {
+            // Nothing need be waited for, so the bytes due next are available.
+            if (output.empty() && streaming) {
+                sendFrame();
+            }
+            time = output.empty() ? time : output.back().time;
+            virtual_time = std::max(virtual_time, time);
+        } else {
+            while (streaming && ecu_free <= time) {
+                sendFrame();
+            }
+        }
+        std::vector<uint8_t> bytes;
+        while (!output.empty() && output.front().time <= time) {
+            bytes.push_back(output.front().value);
+            output.pop_front();
+        }
+        return bytes;
+    }
+
+    SimulatedTiming timing;
+    /// @brief The wall clock time of simulated time zero.
+    clock::time_point epoch;
+    /// @brief The simulated time, with \c VIRTUAL timing.
+    uint64_t virtual_time;
+    std::chrono::milliseconds timeout;
+    clock::time_point deadline;
+    /// @brief The time the ECU takes to act upon each byte received, in
+    ///     nanoseconds.
+    uint64_t latency;
+    /// @brief The times the host's and ECU's lines are next free to send.
+    uint64_t host_free;
+    uint64_t ecu_free;
+    /// @brief Bytes sent by the ECU which have not yet been read.
+    std::deque<Byte> output;
+
+    bool connected;
+    /// @brief The number of consecutive FF handshake bytes received.
+    int handshake;
+    /// @brief \c true if the next byte received selects a register.
+    bool selecting;
+    Request request;
+    std::vector<uint8_t> registers;
+    bool streaming;
+
+    std::array<RegisterWaveform, 256> waveforms;
+    std::vector<uint8_t> metadata;
+    std::vector<uint8_t> fault_codes;
+    /// @brief Scratch buffer for the frame being sent.
+    std::vector<uint8_t> frame;
+};
+
+
+SimulatedECU::SimulatedECU(SimulatedTiming timing)
+        : pimpl(new impl(timing)) {
+}
+
+SimulatedECU::~SimulatedECU() {
+}
+
+std::vector<uint8_t> SimulatedECU::read(std::size_t size) {
+    if (size == 0) {
+        return pimpl->readAvailable();
+    }
+    std::vector<uint8_t> bytes(size);
+    pimpl->readInto(bytes.data(), size);
+    return bytes;
+}
+
+void SimulatedECU::readInto(uint8_t* dst, std::size_t size) {
+    pimpl->readInto(dst, size);
+}
+
+void SimulatedECU::write(const std::vector<uint8_t>& bytes) {
+    pimpl->receive(bytes.data(), bytes.size());
+}
+
+void SimulatedECU::write(const uint8_t* bytes, std::size_t size) {
+    pimpl->receive(bytes, size);
+}
+
+void SimulatedECU::setTimeout(std::chrono::milliseconds timeout) {
+    pimpl->timeout = timeout;
+}
+
+void SimulatedECU::setDeadline(clock::time_point deadline) {
+    pimpl->deadline = deadline;
+}
+
+void SimulatedECU::setLatency(std::chrono::microseconds latency) {
+    if (latency.count() < 0) {
+        throw std::invalid_argument("Latency must not be negative");
+    }
+    pimpl->latency = std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count();
+}
+
+void SimulatedECU::setRegister(uint8_t address, RegisterWaveform waveform) {
+    pimpl->waveforms[address] = std::move(waveform);
+}
+
+void SimulatedECU::setParameter(EngineParameter parameter, ParameterWaveform waveform) {
+    auto command = engineParameterCommand(parameter);
+    // Encoding searches the parameter's encodings, so the last encoding is
+    // kept for waveforms which hold their value between frames. It is shared
+    // by the registers of two-byte parameters.
+    struct Encoder {
+        const EngineParameterDecoder* decoder;
+        ParameterWaveform waveform;
+        double value;
+        uint16_t raw;
+
+        uint16_t encode(uint64_t time) {
+            double next = waveform(time);
+            if (next != value) {
+                value = next;
+                raw = encodeNearest(*decoder, value);
+            }
+            return raw;
+        }
+    };
+    std::shared_ptr<Encoder> encoder(new Encoder {&engineParameterDecoder(parameter), std::move(waveform),
+                                                  std::numeric_limits<double>::quiet_NaN(), 0});
+    if (encoder->decoder->width == 1) {
+        setRegister(command[1], [encoder](uint64_t time) {
+            return static_cast<uint8_t>(encoder->encode(time));
+        });
+    } else {
+        setRegister(command[1], [encoder](uint64_t time) {
+            return static_cast<uint8_t>(encoder->encode(time) >> 8);
+        });
+        setRegister(command[3], [encoder](uint64_t time) {
+            return static_cast<uint8_t>(encoder->encode(time));
+        });
+    }
+}
+
+void SimulatedECU::setMetadata(const std::vector<uint8_t>& frame) {
+    if (frame.size() > 0xFF) {
+        throw std::invalid_argument(cmn::pformat("Metadata frame of %d bytes is too long",
+                                                 static_cast<int>(frame.size())));
+    }
+    pimpl->metadata = frame;
+}
+
+void SimulatedECU::setFaultCodes(const std::vector<std::pair<FaultCode, uint8_t>>& codes) {
+    if (codes.size() > 0xFF / 2) {
+        throw std::invalid_argument(cmn::pformat("Too many fault codes (%d)", static_cast<int>(codes.size())));
+    }
+    pimpl->fault_codes.clear();
+    for (const auto& code : codes) {
+        pimpl->fault_codes.push_back(faultCodeToId(code.first));
+        pimpl->fault_codes.push_back(code.second);
+    }
+    if (codes.empty()) {
+        pimpl->fault_codes = {{faultCodeToId(FaultCode::NO_MALFUNCTION), 0x00}};
+    }
+}
+
+uint64_t SimulatedECU::time() const {
+    return pimpl->now();
+}
+
+
+}
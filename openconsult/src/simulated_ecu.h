@@ -0,0 +1,193 @@
+#ifndef OPENCONSULT_LIB_SIMULATED_ECU
+#define OPENCONSULT_LIB_SIMULATED_ECU
+
+#include "byte_interface.h"
+#include "consult_engine_parameters.h"
+#include "consult_fault_codes.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace openconsult {
+
+
+/**
+ * @brief How a \c SimulatedECU paces the bytes it transfers.
+ */
+enum class SimulatedTiming {
+    /// @brief Time is simulated. Reads return immediately, advancing the
+    ///     simulated time to when their last byte would have arrived.
+    VIRTUAL,
+    /// @brief Reads block until their last byte would have arrived.
+    REAL_TIME,
+};
+
+
+/**
+ * @brief The value of an ECU register over time.
+ *
+ * @param time The time at which the register is sampled, in nanoseconds
+ *      since the \c SimulatedECU was constructed.
+ * @return The register's raw value.
+ */
+using RegisterWaveform = std::function<uint8_t(uint64_t time)>;
+
+/**
+ * @brief The value of an \c EngineParameter over time.
+ *
+ * @param time The time at which the parameter is sampled, in nanoseconds
+ *      since the \c SimulatedECU was constructed.
+ * @return The parameter's value, in the unit described by the parameter.
+ */
+using ParameterWaveform = std::function<double(uint64_t time)>;
+
+
+/**
+ * @brief \c ByteInterface which simulates an ECU speaking the Consult
+ *      protocol, so a \c ConsultInterface may be driven without a vehicle.
+ *
+ * The simulated ECU answers the FF FF EF handshake, reads of its part number
+ * (D0) and fault codes (D1), and register selects (5A). Requests are echoed
+ * and, following the F0 go-ahead, the requested frame is streamed until a 30
+ * stop is received. The frame in progress is then completed before CF
+ * acknowledges the stop. Commands the ECU does not recognise are answered
+ * with FE.
+ *
+ * Bytes are transferred at the Consult baud rate of 9600 baud 8N1 in each
+ * direction. Frames are streamed back to back, and registers are sampled at
+ * the time their frame starts. Registers without a waveform read as zero.
+ * With \c VIRTUAL timing all times are derived from the bytes transferred, so
+ * a conversation is repeatable. With \c REAL_TIME timing the host's writes
+ * arrive at the wall clock time they are made.
+ *
+ * Reads which could never complete, as the ECU is not due to send enough
+ * bytes, raise \c timeout_error rather than blocking forever: immediately
+ * with \c VIRTUAL timing, or once the timeout or deadline passes with
+ * \c REAL_TIME timing. Timeouts and deadlines otherwise only apply to
+ * \c REAL_TIME timing.
+ *
+ * Reads of all available bytes return those which have arrived with
+ * \c REAL_TIME timing. With \c VIRTUAL timing nothing need be waited for, so
+ * they return the bytes the ECU is due to send next: any queued replies, or
+ * else the next frame of a stream.
+ */
+class SimulatedECU : public ByteInterface {
+public:
+    /**
+     * @brief Construct a new \c SimulatedECU , with the part number
+     *      "0488 23710-50F00", no fault codes and all registers zero.
+     *
+     * @param timing How the bytes transferred are paced.
+     */
+    SimulatedECU(SimulatedTiming timing = SimulatedTiming::VIRTUAL);
+
+    // SimulatedECU is not copyable.
+    SimulatedECU(const SimulatedECU&) = delete;
+    SimulatedECU& operator=(const SimulatedECU&) = delete;
+
+    /**
+     * @brief Destroy the \c SimulatedECU .
+     */
+    virtual ~SimulatedECU();
+
+    /**
+     * @copydoc ByteInterface::read(std::size_t)
+     */
+    virtual std::vector<uint8_t> read(std::size_t size = 0) override;
+
+    /**
+     * @copydoc ByteInterface::readInto(uint8_t*, std::size_t)
+     */
+    virtual void readInto(uint8_t* dst, std::size_t size) override;
+
+    /**
+     * @copydoc ByteInterface::write(std::vector<uint8_t>)
+     */
+    virtual void write(const std::vector<uint8_t>& bytes) override;
+
+    /**
+     * @copydoc ByteInterface::write(const uint8_t*, std::size_t)
+     */
+    virtual void write(const uint8_t* bytes, std::size_t size) override;
+
+    /**
+     * @copydoc ByteInterface::setTimeout(std::chrono::milliseconds)
+     */
+    virtual void setTimeout(std::chrono::milliseconds timeout) override;
+
+    /**
+     * @copydoc ByteInterface::setDeadline(clock::time_point)
+     */
+    virtual void setDeadline(clock::time_point deadline) override;
+
+    /**
+     * @brief Sets the time the ECU takes to act upon each byte it receives,
+     *      delaying its replies and the start of its streams. By default it
+     *      acts as soon as each byte has arrived.
+     *
+     * @param latency The time taken.
+     * @throws std::invalid_argument if \c latency is negative.
+     */
+    void setLatency(std::chrono::microseconds latency);
+
+    /**
+     * @brief Sets the value of a register over time.
+     *
+     * @param address The register's address, as selected by 5A.
+     * @param waveform The register's value over time.
+     */
+    void setRegister(uint8_t address, RegisterWaveform waveform);
+
+    /**
+     * @brief Sets the value of an \c EngineParameter over time, by setting
+     *      the registers it is read from. Values are encoded to the nearest
+     *      value the parameter can represent.
+     *
+     * @param parameter The parameter to set.
+     * @param waveform The parameter's value over time.
+     * @throws std::invalid_argument if \c parameter is not valid.
+     */
+    void setParameter(EngineParameter parameter, ParameterWaveform waveform);
+
+    /**
+     * @brief Sets the frame returned when the ECU's part number is read.
+     *
+     * @param frame The frame's data bytes, which \c ECUMetadata expects 22
+     *      of.
+     * @throws std::invalid_argument if \c frame is too long to be sent.
+     */
+    void setMetadata(const std::vector<uint8_t>& frame);
+
+    /**
+     * @brief Sets the fault codes the ECU reports, and the number of times the
+     *      engine has been started since each was observed. With no fault
+     *      codes, \c FaultCode::NO_MALFUNCTION is reported.
+     *
+     * @param codes The fault codes to report.
+     * @throws std::invalid_argument if there are too many codes to be sent.
+     */
+    void setFaultCodes(const std::vector<std::pair<FaultCode, uint8_t>>& codes);
+
+    /**
+     * @brief The current simulated time: with \c VIRTUAL timing, the time the
+     *      last byte read arrived, or with \c REAL_TIME timing, the time
+     *      elapsed.
+     *
+     * @return The time, in nanoseconds since the \c SimulatedECU was
+     *      constructed.
+     */
+    uint64_t time() const;
+
+private:
+    class impl;
+    std::unique_ptr<impl> pimpl;
+};
+
+
+}
+
+#endif
@@ -0,0 +1,164 @@
+#include "stream_broadcast.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace openconsult {
+
+
+/**
+ * @brief State shared between a broadcast and its subscriptions.
+ */
+struct EngineParametersSubscription::State {
+    State(std::size_t history_frames)
+        : history(history_frames)
+        , next_sequence(0)
+        , finished(false) {
+    }
+
+    /// @brief Guards all other members.
+    std::mutex mutex;
+    std::condition_variable frame_published;
+    /// @brief The most recently published frames. Frame \c n is held in
+    ///     slot \c n % history.size() .
+    std::vector<std::shared_ptr<const EngineParameters>> history;
+    /// @brief Sequence number the next published frame will have.
+    uint64_t next_sequence;
+    /// @brief \c true once no more frames will be published.
+    bool finished;
+    std::exception_ptr error;
+};
+
+
+//
+// EngineParametersSubscription
+//
+
+EngineParametersSubscription::EngineParametersSubscription(std::shared_ptr<State> _state, uint64_t _sequence)
+    : state(std::move(_state))
+    , sequence(_sequence)
+    , skipped_frames(0) {
+}
+
+EngineParametersSubscription::EngineParametersSubscription(EngineParametersSubscription&&) = default;
+EngineParametersSubscription& EngineParametersSubscription::operator=(EngineParametersSubscription&&) = default;
+EngineParametersSubscription::~EngineParametersSubscription() = default;
+
+std::shared_ptr<const EngineParameters> EngineParametersSubscription::getFrame() {
+    std::shared_ptr<const EngineParameters> frame;
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->frame_published.wait(lock, [this]() {
+        return sequence < state->next_sequence || state->finished;
+    });
+    lock.unlock();
+    tryGetFrame(frame);
+    return frame;
+}
+
+bool EngineParametersSubscription::tryGetFrame(std::shared_ptr<const EngineParameters>& frame) {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (sequence == state->next_sequence) {
+        if (!state->finished) {
+            return false;
+        }
+        if (state->error) {
+            std::rethrow_exception(state->error);
+        }
+        throw std::runtime_error("Broadcast has ended");
+    }
+    uint64_t oldest = state->next_sequence - std::min<uint64_t>(state->next_sequence, state->history.size());
+    if (sequence < oldest) {
+        skipped_frames += oldest - sequence;
+        sequence = oldest;
+    }
+    frame = state->history[sequence++ % state->history.size()];
+    return true;
+}
+
+uint64_t EngineParametersSubscription::skippedFrames() const {
+    return skipped_frames;
+}
+
+
+//
+// EngineParametersBroadcast
+//
+
+class EngineParametersBroadcast::impl {
+public:
+    impl(EngineParametersStream&& _stream, std::size_t history_frames)
+            : stream(std::move(_stream))
+            , state(std::make_shared<EngineParametersSubscription::State>(history_frames))
+            , stopping(false) {
+        publisher = std::thread(&impl::publish, this);
+    }
+
+    ~impl() {
+        stopping = true;
+        // The thread will stop once it has read the frame currently in flight.
+        publisher.join();
+    }
+
+    void publish() {
+        try {
+            while (!stopping) {
+                std::shared_ptr<const EngineParameters> frame =
+                        std::make_shared<const EngineParameters>(stream.getFrame());
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    // Swap rather than assign so the evicted frame is released
+                    // outside the lock.
+                    state->history[state->next_sequence % state->history.size()].swap(frame);
+                    state->next_sequence++;
+                }
+                state->frame_published.notify_all();
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->error = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->finished = true;
+        }
+        state->frame_published.notify_all();
+    }
+
+    EngineParametersStream stream;
+    std::shared_ptr<EngineParametersSubscription::State> state;
+    std::atomic<bool> stopping;
+    std::thread publisher;
+};
+
+EngineParametersBroadcast::EngineParametersBroadcast(EngineParametersStream&& stream, std::size_t history_frames) {
+    if (history_frames == 0) {
+        throw std::invalid_argument("Broadcast history must be non-zero");
+    }
+    if (stream.timeout().count() == 0) {
+        // The publishing thread could otherwise block forever on a quiet
+        // device, so the broadcast could never be ended.
+        throw std::invalid_argument("Broadcast streams require a timeout");
+    }
+    pimpl.reset(new impl(std::move(stream), history_frames));
+}
+
+EngineParametersBroadcast::~EngineParametersBroadcast() = default;
+
+EngineParametersSubscription EngineParametersBroadcast::subscribe() {
+    std::lock_guard<std::mutex> lock(pimpl->state->mutex);
+    return EngineParametersSubscription(pimpl->state, pimpl->state->next_sequence);
+}
+
+uint64_t EngineParametersBroadcast::publishedFrames() const {
+    std::lock_guard<std::mutex> lock(pimpl->state->mutex);
+    return pimpl->state->next_sequence;
+}
+
+
+}
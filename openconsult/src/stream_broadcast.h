@@ -0,0 +1,136 @@
+#ifndef OPENCONSULT_LIB_STREAM_BROADCAST
+#define OPENCONSULT_LIB_STREAM_BROADCAST
+
+#include "consult_interface.h"
+
+#include <cstdint>
+#include <memory>
+
+namespace openconsult {
+
+
+class EngineParametersBroadcast;
+
+
+/**
+ * @brief A single consumer's view of an \c EngineParametersBroadcast .
+ *
+ * Each subscription has its own position in the broadcast, starting at the
+ * first frame published after it subscribed. Frames are shared between all
+ * subscriptions rather than copied. A subscription which falls so far behind
+ * that its next frame has left the broadcast's history skips forward to the
+ * oldest retained frame; the publisher is never held up waiting for it.
+ *
+ * Subscriptions may outlive the broadcast, in which case the remaining
+ * history may still be retrieved.
+ */
+class EngineParametersSubscription {
+public:
+    // EngineParametersSubscription is not copyable.
+    EngineParametersSubscription(const EngineParametersSubscription&) = delete;
+    EngineParametersSubscription& operator=(const EngineParametersSubscription&) = delete;
+    // EngineParametersSubscription is movable.
+    EngineParametersSubscription(EngineParametersSubscription&&);
+    EngineParametersSubscription& operator=(EngineParametersSubscription&&);
+
+    ~EngineParametersSubscription();
+
+    /**
+     * @brief Blocking call to retrieve this subscription's next frame.
+     *
+     * @return The next frame. Shared with all other subscriptions.
+     * @throws std::runtime_error if the broadcast has ended and all of its
+     *      frames have been retrieved. If the broadcast ended because its
+     *      stream failed, that error is rethrown instead.
+     */
+    std::shared_ptr<const EngineParameters> getFrame();
+
+    /**
+     * @brief Non-blocking call to retrieve this subscription's next frame, if
+     *      one is available.
+     *
+     * @param frame Set to the next frame, if one is available. Otherwise left
+     *      unmodified.
+     * @return \c true if a frame was retrieved, \c false otherwise.
+     * @throws std::runtime_error under the same conditions as \c getFrame() .
+     */
+    bool tryGetFrame(std::shared_ptr<const EngineParameters>& frame);
+
+    /**
+     * @brief The number of frames this subscription has missed because it
+     *      fell too far behind.
+     *
+     * @return The number of skipped frames.
+     */
+    uint64_t skippedFrames() const;
+
+private:
+    friend class EngineParametersBroadcast;
+    struct State;
+    EngineParametersSubscription(std::shared_ptr<State> state, uint64_t sequence);
+
+    std::shared_ptr<State> state;
+    /// @brief Sequence number of the next frame to retrieve.
+    uint64_t sequence;
+    uint64_t skipped_frames;
+};
+
+
+/**
+ * @brief RAII class distributing a single \c EngineParametersStream to any
+ *      number of subscribers.
+ *
+ * The broadcast takes ownership of the stream and reads it on a dedicated
+ * thread. Each frame is decoded once and retained in a fixed-size history,
+ * from which every \c EngineParametersSubscription reads at its own pace.
+ */
+class EngineParametersBroadcast {
+public:
+    /**
+     * @brief Construct a new \c EngineParametersBroadcast , starting to read
+     *      from the stream immediately.
+     *
+     * @param stream The stream to broadcast.
+     * @param history_frames The number of frames retained for subscribers
+     *      which have fallen behind. Must be greater than zero.
+     * @throws std::invalid_argument if \c history_frames is zero, or if the
+     *      stream has no timeout, as the broadcast could then never end while
+     *      the device is quiet.
+     */
+    EngineParametersBroadcast(EngineParametersStream&& stream, std::size_t history_frames = 64);
+
+    // EngineParametersBroadcast is neither copyable nor movable.
+    EngineParametersBroadcast(const EngineParametersBroadcast&) = delete;
+    EngineParametersBroadcast& operator=(const EngineParametersBroadcast&) = delete;
+
+    /**
+     * @brief Destroy the \c EngineParametersBroadcast , ending the broadcast
+     *      and releasing the stream. Waits for any frame currently being read
+     *      from the stream.
+     */
+    ~EngineParametersBroadcast();
+
+    /**
+     * @brief Subscribe to the broadcast. Thread-safe.
+     *
+     * @return A subscription which will receive all frames published from
+     *      now on.
+     */
+    EngineParametersSubscription subscribe();
+
+    /**
+     * @brief The number of frames published so far.
+     *
+     * @return The number of frames read from the stream.
+     */
+    uint64_t publishedFrames() const;
+
+private:
+    class impl;
+    std::unique_ptr<impl> pimpl;
+};
+
+
+}
+
+#endif
@@ -0,0 +1,284 @@
+#include "stream_scheduler.h"
+#include "common.h"
+
+#include <algorithm>
+#include <exception>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+namespace openconsult {
+
+
+/**
+ * @brief The time taken to transfer a frame over the link.
+ *
+ * @param frame_size The number of data bytes in the frame.
+ * @return The transfer time, in nanoseconds.
+ */
+static uint64_t frameTime(std::size_t frame_size) {
+    // Each frame also carries a start byte and a length byte.
+    return (2 + frame_size) * BYTE_TIME_NS;
+}
+
+/**
+ * @brief The time taken to switch to a new register-select session over the
+ *      link: halting the current session, selecting each parameter and
+ *      having the selection echoed, then starting the stream.
+ *
+ * @param parameter_count The number of parameters selected.
+ * @return The transfer time, in nanoseconds.
+ */
+static uint64_t sessionTime(std::size_t parameter_count) {
+    return (2 + 4 * parameter_count + 1) * BYTE_TIME_NS;
+}
+
+/**
+ * @brief The frame rate achievable when streaming frames of a given size.
+ *
+ * @param frame_size The number of data bytes in each frame.
+ * @return The number of frames per second.
+ */
+static double achievableRate(std::size_t frame_size) {
+    return 1e9 / static_cast<double>(frameTime(frame_size));
+}
+
+
+class EngineParametersScheduler::impl {
+public:
+    impl(ConsultInterface& _consult, const std::vector<ScheduledParameter>& parameters)
+            : consult(_consult)
+            , frame_size(0)
+            , session_count(0)
+            , session_frame_count(0)
+            , frame_count(0)
+            , refreshing(false)
+            , link_time(0) {
+        if (parameters.empty()) {
+            throw std::invalid_argument("At least one engine parameter must be scheduled");
+        }
+        for (const auto& parameter : parameters) {
+            if (!(parameter.rate > 0)) {
+                throw std::invalid_argument(cmn::pformat("Invalid rate for engine parameter %s: %f",
+                                                         engineParameterId(parameter.parameter).c_str(),
+                                                         parameter.rate));
+            }
+            for (const auto& channel : channels) {
+                if (channel.parameter == parameter.parameter) {
+                    throw std::invalid_argument(cmn::pformat("Engine parameter %s scheduled more than once",
+                                                             engineParameterId(parameter.parameter).c_str()));
+                }
+            }
+            Channel channel;
+            channel.parameter = parameter.parameter;
+            channel.rate = parameter.rate;
+            channel.period = static_cast<uint64_t>(1e9 / parameter.rate);
+            channel.width = engineParameterEncoding(parameter.parameter).width;
+            channel.fast = false;
+            channel.samples = 0;
+            channel.due = 0;
+            channels.push_back(channel);
+        }
+
+        // Stream the most parameters, highest rates first, which can be
+        // streamed together at the highest of their rates. If even that
+        // cannot be met, stream the fastest alone, along with any sharing its
+        // rate.
+        std::vector<std::size_t> order(channels.size());
+        for (std::size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b) {
+            return channels[a].rate > channels[b].rate;
+        });
+        std::size_t fast_count = 1;
+        while (fast_count < order.size() && channels[order[fast_count]].rate == channels[order[0]].rate) {
+            fast_count++;
+        }
+        std::size_t frame_size = 0;
+        for (std::size_t k = 0; k < order.size(); k++) {
+            frame_size += channels[order[k]].width;
+            if (achievableRate(frame_size) >= channels[order[0]].rate) {
+                fast_count = std::max(fast_count, k + 1);
+            }
+        }
+        for (std::size_t k = 0; k < fast_count; k++) {
+            channels[order[k]].fast = true;
+        }
+        for (const auto& channel : channels) {
+            if (channel.fast) {
+                fast_parameters.push_back(channel.parameter);
+            }
+        }
+
+        // Sample everything first, then settle into the fast parameters.
+        startSession(std::vector<bool>(channels.size(), true));
+        refreshing = fast_parameters.size() < channels.size();
+    }
+
+    // Non-copyable.
+    impl(const impl&) = delete;
+    impl& operator=(const impl&) = delete;
+
+    EngineParameters getFrame() {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        if (refreshing && session_frame_count > 0) {
+            startSession(fastSession());
+            refreshing = false;
+        } else if (!refreshing && fast_parameters.size() < channels.size()) {
+            std::vector<bool> session = fastSession();
+            bool due = false;
+            for (std::size_t i = 0; i < channels.size(); i++) {
+                if (!channels[i].fast) {
+                    due |= channels[i].due <= link_time;
+                    session[i] = channels[i].due <= link_time + channels[i].period / 4;
+                }
+            }
+            if (due) {
+                startSession(session);
+                refreshing = true;
+            }
+        }
+
+        EngineParameters frame = stream->getFrame();
+        link_time += frameTime(frame_size);
+        for (std::size_t i = 0; i < channels.size(); i++) {
+            if (in_session[i]) {
+                // Keep to the schedule, rather than letting the delay before
+                // each refresh accumulate, unless it has fallen behind.
+                Channel& channel = channels[i];
+                if (channel.samples++ == 0) {
+                    channel.due = link_time + channel.period;
+                } else {
+                    channel.due = std::max(channel.due + channel.period, link_time);
+                }
+            }
+        }
+        session_frame_count++;
+        frame.sequence = frame_count++;
+        return frame;
+    }
+
+    std::vector<ScheduledParameterStatistics> statistics() const {
+        double elapsed = static_cast<double>(link_time) / 1e9;
+        std::vector<ScheduledParameterStatistics> result;
+        for (const auto& channel : channels) {
+            ScheduledParameterStatistics statistics;
+            statistics.parameter = channel.parameter;
+            statistics.target_rate = channel.rate;
+            statistics.samples = channel.samples;
+            if (frame_count > 0 && elapsed > 0) {
+                statistics.achieved_rate = static_cast<double>(channel.samples) / elapsed;
+            }
+            result.push_back(statistics);
+        }
+        return result;
+    }
+
+    struct Channel {
+        EngineParameter parameter;
+        double rate;
+        /// @brief The sampling period, in nanoseconds.
+        uint64_t period;
+        std::size_t width;
+        /// @brief \c true if streamed continuously.
+        bool fast;
+        uint64_t samples;
+        /// @brief The link time at which a slow parameter is next due to be
+        ///     refreshed.
+        uint64_t due;
+    };
+
+    std::vector<bool> fastSession() const {
+        std::vector<bool> session;
+        for (const auto& channel : channels) {
+            session.push_back(channel.fast);
+        }
+        return session;
+    }
+
+    void startSession(const std::vector<bool>& session) {
+        std::vector<EngineParameter> parameters;
+        for (std::size_t i = 0; i < channels.size(); i++) {
+            if (session[i]) {
+                parameters.push_back(channels[i].parameter);
+            }
+        }
+        auto plan = plans.find(parameters);
+        if (plan == plans.end()) {
+            plan = plans.emplace(parameters, StreamPlan(parameters)).first;
+        }
+        // The current session must be halted before the next is selected, so
+        // if selecting fails there is no session left to read from.
+        stream.reset();
+        try {
+            stream.reset(new EngineParametersStream(consult.streamEngineParameters(plan->second)));
+        } catch (...) {
+            error = std::current_exception();
+            throw;
+        }
+        in_session = session;
+        frame_size = plan->second.frameSize();
+        link_time += sessionTime(parameters.size());
+        session_count++;
+        session_frame_count = 0;
+    }
+
+    ConsultInterface& consult;
+    /// @brief The scheduled parameters, in the order given.
+    std::vector<Channel> channels;
+    std::vector<EngineParameter> fast_parameters;
+    /// @brief Plans for each session selected so far, so rotating between
+    ///     sessions does not rebuild them.
+    std::map<std::vector<EngineParameter>, StreamPlan> plans;
+    std::unique_ptr<EngineParametersStream> stream;
+    /// @brief Which channels the current session samples.
+    std::vector<bool> in_session;
+    /// @brief The number of data bytes in each of the current session's
+    ///     frames.
+    std::size_t frame_size;
+    uint64_t session_count;
+    /// @brief The number of frames retrieved from the current session.
+    uint64_t session_frame_count;
+    uint64_t frame_count;
+    /// @brief \c true if the current session is to be left after one frame.
+    bool refreshing;
+    /// @brief The time the link has spent transferring the schedule's
+    ///     sessions and frames, in nanoseconds. Sampling is scheduled against
+    ///     this rather than the host clock, so the schedule holds however
+    ///     quickly the device is read, as from a simulation or an unpaced
+    ///     replay.
+    uint64_t link_time;
+    /// @brief The error which ended the schedule, if any.
+    std::exception_ptr error;
+};
+
+
+EngineParametersScheduler::EngineParametersScheduler(ConsultInterface& consult,
+                                                     const std::vector<ScheduledParameter>& parameters)
+        : pimpl(new impl(consult, parameters)) {
+}
+
+EngineParametersScheduler::~EngineParametersScheduler() {
+}
+
+EngineParameters EngineParametersScheduler::getFrame() {
+    return pimpl->getFrame();
+}
+
+const std::vector<EngineParameter>& EngineParametersScheduler::fastParameters() const {
+    return pimpl->fast_parameters;
+}
+
+uint64_t EngineParametersScheduler::sessions() const {
+    return pimpl->session_count;
+}
+
+std::vector<ScheduledParameterStatistics> EngineParametersScheduler::statistics() const {
+    return pimpl->statistics();
+}
+
+
+}
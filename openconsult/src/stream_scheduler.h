@@ -0,0 +1,131 @@
+#ifndef OPENCONSULT_LIB_STREAM_SCHEDULER
+#define OPENCONSULT_LIB_STREAM_SCHEDULER
+
+#include "consult_interface.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace openconsult {
+
+
+/**
+ * @brief An \c EngineParameter and the rate at which it should be sampled.
+ */
+struct ScheduledParameter {
+    /// @brief The parameter to sample.
+    EngineParameter parameter;
+    /// @brief The target number of samples per second.
+    double rate;
+};
+
+
+/**
+ * @brief The rate at which an \c EngineParametersScheduler has sampled a
+ *      parameter.
+ */
+struct ScheduledParameterStatistics {
+    /// @brief The parameter sampled.
+    EngineParameter parameter;
+    /// @brief The target number of samples per second.
+    double target_rate = 0;
+    /// @brief The number of samples per second achieved since the schedule
+    ///     started, measured in link time.
+    ///
+    /// Link time is the time the link has spent transferring the schedule's
+    /// frames and session switches, estimated from the number of bytes
+    /// transferred, so it is independent of how quickly the device is read.
+    double achieved_rate = 0;
+    /// @brief The number of samples taken.
+    uint64_t samples = 0;
+};
+
+
+/**
+ * @brief RAII class sampling each of a set of engine parameters at its own
+ *      target rate, by rotating between register-select sessions.
+ *
+ * The Consult link transfers a fixed number of bytes per second, so a stream
+ * of more parameters has a lower frame rate. The scheduler instead streams
+ * only the fast parameters: the largest set of the highest-rate parameters
+ * whose frame rate, streamed together, meets all of their targets. The
+ * remaining slow parameters are refreshed by briefly halting the stream and
+ * selecting the fast parameters together with those slow parameters which
+ * are due, for a single frame, before returning to the fast parameters. Slow
+ * parameters due within a quarter of their period are refreshed together, to
+ * save switching. Parameters are scheduled in link time, rather than by the
+ * host clock, so a simulated or unpaced device is sampled in the same pattern
+ * as a real one. If every target can be met by streaming all of the
+ * parameters together, they are, and no rotation takes place.
+ *
+ * Frames are read on the caller's thread, and sessions are switched as frames
+ * are retrieved. The scheduler uses its \c ConsultInterface exclusively, as a
+ * stream does, and must live no longer than it.
+ */
+class EngineParametersScheduler {
+public:
+    /**
+     * @brief Construct a new \c EngineParametersScheduler , starting with a
+     *      session for every parameter so each is sampled immediately.
+     *
+     * @param consult The interface to read the parameters from.
+     * @param parameters The parameters to sample, and their target rates.
+     * @throws std::invalid_argument if \c parameters is empty, contains an
+     *      invalid or repeated parameter, or a rate which is not positive.
+     */
+    EngineParametersScheduler(ConsultInterface& consult, const std::vector<ScheduledParameter>& parameters);
+
+    // EngineParametersScheduler is not copyable.
+    EngineParametersScheduler(const EngineParametersScheduler&) = delete;
+    EngineParametersScheduler& operator=(const EngineParametersScheduler&) = delete;
+
+    /**
+     * @brief Destroy the \c EngineParametersScheduler , halting the current
+     *      session.
+     */
+    ~EngineParametersScheduler();
+
+    /**
+     * @brief Blocking call to retrieve the next frame, switching sessions
+     *      first if any slow parameter is due.
+     *
+     * @return The frame. It holds the fast parameters, and any slow
+     *      parameters refreshed in it. Its sequence number counts the frames
+     *      retrieved from the scheduler.
+     * @throws std::exception if a session could not be started. The schedule
+     *      cannot continue, so the same error is thrown by every later call.
+     */
+    EngineParameters getFrame();
+
+    /**
+     * @brief The parameters streamed continuously.
+     *
+     * @return The fast \c EngineParameter s, in the order given.
+     */
+    const std::vector<EngineParameter>& fastParameters() const;
+
+    /**
+     * @brief The number of register-select sessions started, including the
+     *      first.
+     *
+     * @return The number of sessions.
+     */
+    uint64_t sessions() const;
+
+    /**
+     * @brief The rate at which each parameter has been sampled.
+     *
+     * @return Statistics for each parameter, in the order given.
+     */
+    std::vector<ScheduledParameterStatistics> statistics() const;
+
+private:
+    class impl;
+    std::unique_ptr<impl> pimpl;
+};
+
+
+}
+
+#endif
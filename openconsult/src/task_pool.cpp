@@ -0,0 +1,182 @@
+#include "task_pool.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace openconsult {
+
+
+class TaskPool::impl {
+public:
+    impl(unsigned threads)
+            : queues(threads)
+            , task(nullptr)
+            , generation(0)
+            , running(0)
+            , stopping(false) {
+        for (unsigned i = 1; i < threads; i++) {
+            workers.emplace_back(&impl::work, this, i);
+        }
+    }
+
+    ~impl() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        start.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    unsigned size() const {
+        return static_cast<unsigned>(queues.size());
+    }
+
+    void run(std::size_t count, const std::function<void(std::size_t)>& batch_task) {
+        if (count == 0) {
+            return;
+        }
+        // Deal the tasks out in contiguous runs.
+        std::size_t begin = 0;
+        for (std::size_t i = 0; i < queues.size(); i++) {
+            std::size_t end = count * (i + 1) / queues.size();
+            std::lock_guard<std::mutex> lock(queues[i].mutex);
+            for (std::size_t index = begin; index < end; index++) {
+                queues[i].tasks.push_back(index);
+            }
+            begin = end;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task = &batch_task;
+            error = nullptr;
+            running = workers.size();
+            generation++;
+        }
+        start.notify_all();
+
+        drain(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]{ return running == 0; });
+        task = nullptr;
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    /**
+     * @brief The tasks dealt to a thread, taken from the front by their
+     *      thread and stolen from the back by the others.
+     */
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::size_t> tasks;
+    };
+
+    void work(unsigned id) {
+        uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                start.wait(lock, [&]{ return stopping || generation != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = generation;
+            }
+            drain(id);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                running--;
+            }
+            done.notify_one();
+        }
+    }
+
+    /**
+     * @brief Runs tasks until none remain in any queue. As no tasks are added
+     *      during a batch, none will be added after this returns.
+     */
+    void drain(unsigned id) {
+        std::size_t index;
+        while (take(id, index)) {
+            try {
+                (*task)(index);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+    }
+
+    bool take(unsigned id, std::size_t& index) {
+        {
+            Queue& own = queues[id];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                index = own.tasks.front();
+                own.tasks.pop_front();
+                return true;
+            }
+        }
+        for (std::size_t i = 1; i < queues.size(); i++) {
+            Queue& victim = queues[(id + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                index = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<Queue> queues;
+    std::vector<std::thread> workers;
+
+    /// @brief Guards the fields below.
+    std::mutex mutex;
+    std::condition_variable start;
+    std::condition_variable done;
+    /// @brief The current batch's task, valid while it runs.
+    const std::function<void(std::size_t)>* task;
+    /// @brief Incremented as each batch starts.
+    uint64_t generation;
+    /// @brief The number of background threads still working on the batch.
+    std::size_t running;
+    std::exception_ptr error;
+    bool stopping;
+};
+
+
+TaskPool::TaskPool(unsigned threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    pimpl.reset(new impl(threads));
+}
+
+TaskPool::~TaskPool() = default;
+
+unsigned TaskPool::size() const {
+    return pimpl->size();
+}
+
+void TaskPool::run(std::size_t count, const std::function<void(std::size_t)>& task) {
+    pimpl->run(count, task);
+}
+
+
+}
@@ -0,0 +1,64 @@
+#ifndef OPENCONSULT_LIB_TASK_POOL
+#define OPENCONSULT_LIB_TASK_POOL
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+namespace openconsult {
+
+
+/**
+ * @brief A fixed set of threads running batches of independent tasks.
+ *
+ * Each batch of tasks is dealt out in contiguous runs, one run per thread, so
+ * each thread works through neighbouring tasks (e.g. adjacent chunks of a
+ * file) in order. A thread which finishes its run steals tasks from the far
+ * end of another thread's run, so uneven tasks still keep every thread busy.
+ *
+ * The thread calling \c run(...) works as one of the pool's threads.
+ */
+class TaskPool {
+public:
+    /**
+     * @brief Construct a new \c TaskPool .
+     *
+     * @param threads The number of threads to run tasks on, including the
+     *      caller of \c run(...) , or zero to use one per core.
+     */
+    explicit TaskPool(unsigned threads = 0);
+
+    // TaskPool is not copyable.
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    /**
+     * @brief Destroy the \c TaskPool , stopping its threads.
+     */
+    ~TaskPool();
+
+    /**
+     * @brief The number of threads tasks are run on.
+     */
+    unsigned size() const;
+
+    /**
+     * @brief Runs a batch of tasks, blocking until all have finished.
+     *
+     * @param count The number of tasks.
+     * @param task Function running a task, given the task's index from zero.
+     *      Called concurrently from several threads.
+     * @throws Any exception thrown by a task. If several tasks throw, the
+     *      first is rethrown once all tasks have finished.
+     */
+    void run(std::size_t count, const std::function<void(std::size_t)>& task);
+
+private:
+    class impl;
+    std::unique_ptr<impl> pimpl;
+};
+
+
+}
+
+#endif
@@ -17,6 +17,65 @@ TEST(FormatBytesTest, args) {
     EXPECT_EQ(format_bytes(bytes), std::string("01026f"));
 }
 
+TEST(FormatBytesTest, pointer_args) {
+    const uint8_t bytes[] = {1u, 2u, 111u};
+    EXPECT_EQ(format_bytes(bytes, 2), std::string("0102"));
+}
+
+
+
+TEST(HexTest, encode_all_bytes) {
+    // Exercise the vectorised and scalar paths with every byte value.
+    std::vector<uint8_t> bytes(256 + 47);
+    for (std::size_t i = 0; i < bytes.size(); i++) {
+        bytes[i] = static_cast<uint8_t>(i * 7);
+    }
+    std::string expected;
+    for (uint8_t byte : bytes) {
+        expected += pformat("%02x", byte);
+    }
+    std::string encoded(2 * bytes.size(), '\0');
+    hex_encode(bytes.data(), bytes.size(), &encoded[0]);
+    EXPECT_EQ(encoded, expected);
+}
+
+TEST(HexTest, decode_round_trip) {
+    for (std::size_t size = 0; size < 100; size++) {
+        std::vector<uint8_t> bytes(size);
+        for (std::size_t i = 0; i < size; i++) {
+            bytes[i] = static_cast<uint8_t>(i * 37 + size);
+        }
+        std::string encoded = format_bytes(bytes);
+        std::vector<uint8_t> decoded(size);
+        EXPECT_TRUE(hex_decode(encoded.data(), size, decoded.data()));
+        EXPECT_EQ(decoded, bytes);
+    }
+}
+
+TEST(HexTest, decode_mixed_case) {
+    std::string digits = "0123456789abcdefABCDEF0123456789aBcDeF0123456789AbCdEf";
+    std::vector<uint8_t> decoded(digits.size() / 2);
+    EXPECT_TRUE(hex_decode(digits.data(), decoded.size(), decoded.data()));
+    EXPECT_EQ(format_bytes(decoded), "0123456789abcdefabcdef0123456789abcdef0123456789abcdef");
+}
+
+TEST(HexTest, decode_invalid) {
+    // Every position, for every character adjacent to a digit range, and a
+    // non-ASCII character.
+    std::string digits(80, '0');
+    for (char c : {'/', ':', '@', 'G', '`', 'g', ' ', '\x80', '\xff'}) {
+        for (std::size_t i = 0; i < digits.size(); i++) {
+            std::string invalid = digits;
+            invalid[i] = c;
+            std::vector<uint8_t> decoded(invalid.size() / 2);
+            EXPECT_FALSE(hex_decode(invalid.data(), decoded.size(), decoded.data()));
+            EXPECT_FALSE(is_hex(invalid.data(), invalid.size()));
+        }
+    }
+    EXPECT_TRUE(is_hex(digits.data(), digits.size()));
+    EXPECT_TRUE(is_hex("", 0));
+}
+
 
 
 TEST(AdvanceTest, within_bound) {
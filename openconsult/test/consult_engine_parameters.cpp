@@ -86,6 +86,98 @@ TEST(ConsultEngineParametersTest, engineParameterDecode_parameter_invalid) {
 }
 
 
+/**
+ * @brief Reference decoding of each parameter, as given by the ECU
+ *      documentation.
+ */
+static double referenceDecode(EngineParameter parameter, uint32_t raw) {
+    switch (parameter) {
+        case EngineParameter::ENGINE_RPM:
+            return raw * 12.5;
+        case EngineParameter::LH_MAF_VOLTAGE:
+        case EngineParameter::RH_MAF_VOLTAGE:
+            return raw * 5 * 0.001;
+        case EngineParameter::COOLANT_TEMPERATURE:
+        case EngineParameter::FUEL_TEMPERATURE:
+        case EngineParameter::INTAKE_AIR_TEMPERATURE:
+        case EngineParameter::TANK_FUEL_TEMPERATURE:
+            return static_cast<int>(raw) - 50;
+        case EngineParameter::LH_O2_SENSOR_VOLTAGE:
+        case EngineParameter::RH_O2_SENSOR_VOLTAGE:
+            return raw * 10 * 0.001;
+        case EngineParameter::VEHICLE_SPEED:
+            return raw * 2;
+        case EngineParameter::BATTERY_VOLTAGE:
+            return raw * 80 * 0.001;
+        case EngineParameter::THROTTLE_POSITION:
+        case EngineParameter::EXHAUST_GAS_TEMPERATURE:
+        case EngineParameter::TURBO_BOOST_SENSOR:
+        case EngineParameter::FPCM_DR_VOLTAGE:
+        case EngineParameter::FUEL_GAUGE_VOLTAGE:
+            return raw * 20 * 0.001;
+        case EngineParameter::LH_INJECTION_TIMING:
+        case EngineParameter::RH_INJECTION_TIMING:
+            return raw * 0.01 * 0.001;
+        case EngineParameter::IGNITION_TIMING:
+            return 110.0 - raw;
+        case EngineParameter::AAC_VALVE:
+            return raw / 2.0;
+        default:
+            return raw;
+    }
+}
+
+TEST(ConsultEngineParametersTest, engineParameterEncoding_exhaustive) {
+    for (int p = static_cast<int>(EngineParameter::ENGINE_RPM);
+            p <= static_cast<int>(EngineParameter::DIGITAL_BIT_REGISTER3); p++) {
+        EngineParameter parameter = static_cast<EngineParameter>(p);
+        EngineParameterEncoding encoding = engineParameterEncoding(parameter);
+        // Each register holds one byte, so the width follows from the command.
+        EXPECT_EQ(engineParameterCommand(parameter).size() / 2, encoding.width);
+        uint32_t limit = encoding.width == 2 ? 0x10000 : 0x100;
+        for (uint32_t raw = 0; raw < limit; raw++) {
+            const std::vector<uint8_t> data = encoding.width == 2 ?
+                std::vector<uint8_t>{static_cast<uint8_t>(raw >> 8), static_cast<uint8_t>(raw)} :
+                std::vector<uint8_t>{static_cast<uint8_t>(raw)};
+            auto range = cmn::make_range(data);
+            // Values must be bit-identical, not merely close.
+            ASSERT_EQ(referenceDecode(parameter, raw), engineParameterDecode(parameter, range))
+                << engineParameterId(parameter) << " raw=" << raw;
+            ASSERT_TRUE(range.empty());
+        }
+    }
+    EXPECT_THROW({
+        engineParameterEncoding(static_cast<EngineParameter>(0xffu));
+    }, std::invalid_argument);
+}
+
+
+TEST(ConsultEngineParametersTest, engineParameterDecoder_exhaustive) {
+    for (std::size_t p = 0; p < ENGINE_PARAMETER_COUNT; p++) {
+        EngineParameter parameter = static_cast<EngineParameter>(p);
+        EngineParameterEncoding encoding = engineParameterEncoding(parameter);
+        const EngineParameterDecoder& decoder = engineParameterDecoder(parameter);
+        EXPECT_EQ(encoding.width, decoder.width);
+        uint32_t limit = encoding.width == 2 ? 0x10000 : 0x100;
+        for (uint32_t raw = 0; raw < limit; raw++) {
+            uint8_t data[2] = {static_cast<uint8_t>(raw), 0};
+            if (encoding.width == 2) {
+                data[0] = static_cast<uint8_t>(raw >> 8);
+                data[1] = static_cast<uint8_t>(raw);
+            }
+            ASSERT_EQ(encoding.decode(data), decoder.decode(data))
+                << engineParameterId(parameter) << " raw=" << raw;
+        }
+    }
+    // Decoders are shared.
+    EXPECT_EQ(&engineParameterDecoder(EngineParameter::ENGINE_RPM),
+              &engineParameterDecoder(EngineParameter::ENGINE_RPM));
+    EXPECT_THROW({
+        engineParameterDecoder(static_cast<EngineParameter>(0xffu));
+    }, std::invalid_argument);
+}
+
+
 TEST(ConsultEngineParametersTest, engineParameterId) {
     EXPECT_EQ(engineParameterId(EngineParameter::ENGINE_RPM),
               "engine_speed_rpm");
@@ -117,3 +209,84 @@ TEST(ConsultEngineParametersTest, engineParameterDescription) {
         engineParameterDescription(static_cast<EngineParameter>(0xffu));
     }, std::invalid_argument);
 }
+
+
+TEST(EngineParameterValuesTest, access) {
+    EngineParameterValues values;
+    EXPECT_TRUE(values.empty());
+    EXPECT_EQ(0, values.size());
+    EXPECT_EQ(0, values.count(EngineParameter::BATTERY_VOLTAGE));
+    EXPECT_THROW({
+        values.at(EngineParameter::BATTERY_VOLTAGE);
+    }, std::out_of_range);
+
+    values[EngineParameter::BATTERY_VOLTAGE] = 12.08;
+    EXPECT_FALSE(values.empty());
+    EXPECT_EQ(1, values.size());
+    EXPECT_EQ(1, values.count(EngineParameter::BATTERY_VOLTAGE));
+    EXPECT_EQ(12.08, values.at(EngineParameter::BATTERY_VOLTAGE));
+
+    // As with std::map, accessing an absent value inserts zero.
+    EXPECT_EQ(0.0, values[EngineParameter::ENGINE_RPM]);
+    EXPECT_EQ(2, values.size());
+
+    values.clear();
+    EXPECT_TRUE(values.empty());
+    EXPECT_EQ(0.0, values[EngineParameter::BATTERY_VOLTAGE]);
+
+    EXPECT_THROW({
+        values[static_cast<EngineParameter>(0xffu)];
+    }, std::out_of_range);
+    EXPECT_EQ(0, values.count(static_cast<EngineParameter>(0xffu)));
+}
+
+TEST(EngineParameterValuesTest, iteration) {
+    EngineParameterValues values;
+    EXPECT_EQ(values.begin(), values.end());
+
+    values[EngineParameter::DIGITAL_BIT_REGISTER3] = 3.0;
+    values[EngineParameter::BATTERY_VOLTAGE] = 2.0;
+    values[EngineParameter::ENGINE_RPM] = 1.0;
+
+    // Parameters are visited in enum order, regardless of insertion order.
+    std::vector<std::pair<EngineParameter, double>> visited;
+    for (const auto& value : values) {
+        visited.push_back(std::make_pair(value.first, value.second));
+    }
+    EXPECT_THAT(visited, ElementsAre(std::make_pair(EngineParameter::ENGINE_RPM, 1.0),
+                                     std::make_pair(EngineParameter::BATTERY_VOLTAGE, 2.0),
+                                     std::make_pair(EngineParameter::DIGITAL_BIT_REGISTER3, 3.0)));
+}
+
+TEST(EngineParameterValuesTest, find) {
+    EngineParameterValues values;
+    EXPECT_EQ(values.find(EngineParameter::ENGINE_RPM), values.end());
+    EXPECT_EQ(values.find(static_cast<EngineParameter>(0xffu)), values.end());
+
+    values[EngineParameter::BATTERY_VOLTAGE] = 2.0;
+    values[EngineParameter::ENGINE_RPM] = 1.0;
+    auto it = values.find(EngineParameter::BATTERY_VOLTAGE);
+    ASSERT_NE(it, values.end());
+    EXPECT_EQ(it->first, EngineParameter::BATTERY_VOLTAGE);
+    EXPECT_EQ(it->second, 2.0);
+    EXPECT_EQ(++it, values.end());
+}
+
+TEST(EngineParameterValuesTest, equality) {
+    EngineParameterValues a;
+    EngineParameterValues b;
+    EXPECT_EQ(a, b);
+
+    a[EngineParameter::ENGINE_RPM] = 1.0;
+    EXPECT_NE(a, b);
+    b[EngineParameter::ENGINE_RPM] = 2.0;
+    EXPECT_NE(a, b);
+    b[EngineParameter::ENGINE_RPM] = 1.0;
+    EXPECT_EQ(a, b);
+
+    // Values left behind by clear() are not compared.
+    a[EngineParameter::BATTERY_VOLTAGE] = 3.0;
+    a.clear();
+    b.clear();
+    EXPECT_EQ(a, b);
+}
@@ -3,11 +3,16 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <deque>
+#include <thread>
+
 using namespace openconsult;
 using ::testing::AtLeast;
 using ::testing::ElementsAre;
 using ::testing::Exactly;
 using ::testing::Return;
+using ::testing::Throw;
 
 
 TEST(ECUMetadataTest, toJSON) {
@@ -63,6 +68,64 @@ TEST(EngineParametersTest, toJSON) {
               "}", parameters.toJSON());
 }
 
+TEST(EngineParametersTest, ctor_invalid_size) {
+    std::vector<EngineParameter> params {EngineParameter::ENGINE_RPM, EngineParameter::BATTERY_VOLTAGE};
+    EXPECT_THROW(EngineParameters(params, {0x01, 0x59}), std::invalid_argument);
+    EXPECT_THROW(EngineParameters(params, {0x01, 0x59, 0x97, 0x00}), std::invalid_argument);
+}
+
+
+TEST(StreamPlanTest, decode) {
+    StreamPlan plan({EngineParameter::ENGINE_RPM, EngineParameter::BATTERY_VOLTAGE});
+    EXPECT_THAT(plan.parameters(), ElementsAre(EngineParameter::ENGINE_RPM, EngineParameter::BATTERY_VOLTAGE));
+    EXPECT_EQ(3, plan.frameSize());
+
+    std::vector<uint8_t> data {0x01, 0x59, 0x97};
+    EngineParameters parameters;
+    plan.decode(data.data(), data.size(), parameters);
+    EXPECT_EQ(2, parameters.parameters.size());
+    EXPECT_EQ(4312.5, parameters.parameters[EngineParameter::ENGINE_RPM]);
+    EXPECT_EQ(12.08, parameters.parameters[EngineParameter::BATTERY_VOLTAGE]);
+
+    EXPECT_THROW({
+        plan.decode(data.data(), 2, parameters);
+    }, std::invalid_argument);
+}
+
+
+TEST(StreamPlanTest, ctor_invalid_parameter) {
+    EXPECT_THROW({
+        StreamPlan plan({static_cast<EngineParameter>(0xffu)});
+    }, std::invalid_argument);
+}
+
+
+TEST(TypedEngineParametersTest, decode) {
+    using Parameters = TypedEngineParameters<EngineParameter::ENGINE_RPM,
+                                             EngineParameter::BATTERY_VOLTAGE,
+                                             EngineParameter::LH_INJECTION_TIMING>;
+    static_assert(Parameters::frameSize() == 5, "Frame size must be known at compile time");
+    static_assert(Parameters::parameter(1) == EngineParameter::BATTERY_VOLTAGE, "Parameters must be in frame order");
+
+    std::vector<uint8_t> data {0x01, 0x59, 0x97, 0x11, 0xa2};
+    Parameters parameters(data.data(), data.size());
+    EXPECT_EQ(4312.5, parameters.get<EngineParameter::ENGINE_RPM>());
+    EXPECT_EQ(12.08, parameters.get<EngineParameter::BATTERY_VOLTAGE>());
+    EXPECT_EQ(0.04514, parameters.get<EngineParameter::LH_INJECTION_TIMING>());
+
+    // The typed and untyped decodings must agree exactly.
+    EngineParameters untyped({EngineParameter::ENGINE_RPM,
+                              EngineParameter::BATTERY_VOLTAGE,
+                              EngineParameter::LH_INJECTION_TIMING}, data);
+    EXPECT_EQ(untyped.toJSON(), parameters.toJSON());
+    EXPECT_EQ(untyped.parameters[EngineParameter::LH_INJECTION_TIMING],
+              parameters.get<EngineParameter::LH_INJECTION_TIMING>());
+
+    EXPECT_THROW({
+        Parameters(data.data(), 4);
+    }, std::invalid_argument);
+}
+
 
 class MockByteInterface : public ByteInterface {
 public:
@@ -401,6 +464,51 @@ TEST(ConsultInterfaceTest, streamEngineParameters_single) {
     }
 }
 
+TEST(ConsultInterfaceTest, streamEngineParameters_resync) {
+    // A stray byte between frames is skipped, rather than ending the stream.
+    std::unique_ptr<MockByteInterface> byte_interface(new MockByteInterface);
+    EXPECT_CALL(*byte_interface, write(ElementsAre(0xFF, 0xFF, 0xEF)))
+        .Times(Exactly(1))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, read(1))
+        .Times(Exactly(6))
+        .WillOnce(Return(std::vector<uint8_t>{0x10}))
+        .WillOnce(Return(std::vector<uint8_t>{0xB4}))
+        .WillOnce(Return(std::vector<uint8_t>{0x01}))
+        .WillOnce(Return(std::vector<uint8_t>{0xB5}))
+        .WillOnce(Return(std::vector<uint8_t>{0xB6}))
+        .WillOnce(Return(std::vector<uint8_t>{0xCF}))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, write(ElementsAre(0x5A, 0x0C)))
+        .Times(Exactly(1))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, read(2))
+        .Times(Exactly(4))
+        .WillOnce(Return(std::vector<uint8_t>{0xA5, 0x0C}))
+        .WillOnce(Return(std::vector<uint8_t>{0xFF, 0x01}))
+        .WillOnce(Return(std::vector<uint8_t>{0xB4, 0xFF}))
+        .WillOnce(Return(std::vector<uint8_t>{0xFF, 0x01}))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, write(ElementsAre(0xF0)))
+        .Times(Exactly(1))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, write(ElementsAre(0x30)))
+        .Times(Exactly(1))
+        .RetiresOnSaturation();
+
+    ConsultInterface iface(std::move(byte_interface));
+    std::vector<EngineParameter> params {EngineParameter::BATTERY_VOLTAGE};
+    {
+        auto stream = iface.streamEngineParameters(params);
+        EXPECT_EQ(stream.getFrame().parameters[EngineParameter::BATTERY_VOLTAGE], 14.40);
+        EXPECT_EQ(0, stream.resyncs());
+        EXPECT_EQ(stream.getFrame().parameters[EngineParameter::BATTERY_VOLTAGE], 14.48);
+        EXPECT_EQ(1, stream.resyncs());
+        EXPECT_EQ(stream.getFrame().parameters[EngineParameter::BATTERY_VOLTAGE], 14.56);
+        EXPECT_EQ(1, stream.resyncs());
+    }
+}
+
 TEST(ConsultInterfaceTest, streamEngineParameters_multiple) {
     std::unique_ptr<MockByteInterface> byte_interface(new MockByteInterface);
     EXPECT_CALL(*byte_interface, write(ElementsAre(0xFF, 0xFF, 0xEF)))
@@ -452,3 +560,376 @@ TEST(ConsultInterfaceTest, streamEngineParameters_multiple) {
         EXPECT_EQ(data.parameters[EngineParameter::ENGINE_RPM], 1862.5);
     }
 }
+
+TEST(ConsultInterfaceTest, ctor_timeout) {
+    std::unique_ptr<MockByteInterface> byte_interface(new MockByteInterface);
+    EXPECT_CALL(*byte_interface, write(ElementsAre(0xFF, 0xFF, 0xEF)))
+        .Times(Exactly(1))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, read(1))
+        .Times(Exactly(1))
+        .WillOnce(Throw(timeout_error()))
+        .RetiresOnSaturation();
+
+    EXPECT_THROW({
+        ConsultInterface iface(std::move(byte_interface), std::chrono::milliseconds(100));
+    }, timeout_error);
+}
+
+TEST(ConsultInterfaceTest, streamEngineParameters_timeout) {
+    std::unique_ptr<MockByteInterface> byte_interface(new MockByteInterface);
+    EXPECT_CALL(*byte_interface, write(ElementsAre(0xFF, 0xFF, 0xEF)))
+        .Times(Exactly(1))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, read(1))
+        .Times(Exactly(2))
+        .WillOnce(Return(std::vector<uint8_t>{0x10}))
+        .WillOnce(Throw(timeout_error()))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, write(ElementsAre(0x5A, 0x0C)))
+        .Times(Exactly(1))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, read(2))
+        .Times(Exactly(2))
+        .WillOnce(Return(std::vector<uint8_t>{0xA5, 0x0C}))
+        .WillOnce(Throw(timeout_error()))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, write(ElementsAre(0xF0)))
+        .Times(Exactly(1))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, write(ElementsAre(0x30)))
+        .Times(Exactly(1))
+        .RetiresOnSaturation();
+
+    ConsultInterface iface(std::move(byte_interface), std::chrono::milliseconds(100));
+    std::vector<EngineParameter> params {EngineParameter::BATTERY_VOLTAGE};
+    {
+        // The stall must be reported to the caller, and must not prevent the
+        // stream from being released.
+        auto stream = iface.streamEngineParameters(params);
+        EXPECT_THROW({
+            stream.getFrame();
+        }, timeout_error);
+    }
+}
+
+
+/**
+ * @brief Fake device which streams coolant temperature frames, with the value
+ *      incrementing in each frame, until it has sent a given number of frames
+ *      and then stalls.
+ */
+class StreamingByteInterface : public ByteInterface {
+public:
+    StreamingByteInterface(std::size_t frame_limit) :
+        frame_limit(frame_limit) {
+    }
+
+    std::vector<uint8_t> read(std::size_t size) override {
+        std::vector<uint8_t> bytes;
+        while (bytes.size() < size) {
+            if (pending.empty()) {
+                if (!streaming || frames_sent == frame_limit) {
+                    throw timeout_error();
+                }
+                pending.insert(pending.end(), {0xFF, 0x01, static_cast<uint8_t>(frames_sent++)});
+            }
+            bytes.push_back(pending.front());
+            pending.pop_front();
+        }
+        return bytes;
+    }
+
+    void write(const std::vector<uint8_t>& bytes) override {
+        if (bytes == std::vector<uint8_t>{0xFF, 0xFF, 0xEF}) {
+            pending.push_back(0x10);
+        } else if (bytes == std::vector<uint8_t>{0x5A, 0x08}) {
+            pending.insert(pending.end(), {0xA5, 0x08});
+        } else if (bytes == std::vector<uint8_t>{0xF0}) {
+            streaming = true;
+        } else if (bytes == std::vector<uint8_t>{0x30}) {
+            streaming = false;
+            pending.push_back(0xCF);
+        } else {
+            throw std::runtime_error("Unexpected write");
+        }
+    }
+
+private:
+    const std::size_t frame_limit;
+    std::size_t frames_sent = 0;
+    bool streaming = false;
+    std::deque<uint8_t> pending;
+};
+
+static void waitForDroppedFrames(const EngineParametersStream& stream, uint64_t expected) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (stream.droppedFrames() < expected && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(expected, stream.droppedFrames());
+}
+
+TEST(ConsultInterfaceTest, streamEngineParameters_background_drop_oldest) {
+    ConsultInterface iface(std::unique_ptr<ByteInterface>(new StreamingByteInterface(10)),
+                           std::chrono::milliseconds(1000));
+    std::vector<EngineParameter> params {EngineParameter::COOLANT_TEMPERATURE};
+    StreamOptions options;
+    options.background = true;
+    options.buffer_frames = 4;
+    options.overflow_policy = OverflowPolicy::DROP_OLDEST;
+    {
+        auto stream = iface.streamEngineParameters(params, options);
+        waitForDroppedFrames(stream, 6);
+        for (int i = 6; i < 10; i++) {
+            auto frame = stream.getFrame();
+            EXPECT_EQ(i - 50, frame.parameters[EngineParameter::COOLANT_TEMPERATURE]);
+            // The dropped frames leave a gap in the sequence.
+            EXPECT_EQ(i, frame.sequence);
+        }
+        auto statistics = stream.statistics();
+        EXPECT_EQ(10, statistics.frames);
+        EXPECT_EQ(6, statistics.dropped_frames);
+        // Once drained, the device's stall is reported.
+        EXPECT_THROW({
+            stream.getFrame();
+        }, timeout_error);
+    }
+}
+
+TEST(ConsultInterfaceTest, streamEngineParameters_background_drop_newest) {
+    ConsultInterface iface(std::unique_ptr<ByteInterface>(new StreamingByteInterface(10)),
+                           std::chrono::milliseconds(1000));
+    std::vector<EngineParameter> params {EngineParameter::COOLANT_TEMPERATURE};
+    StreamOptions options;
+    options.background = true;
+    options.buffer_frames = 4;
+    options.overflow_policy = OverflowPolicy::DROP_NEWEST;
+    {
+        auto stream = iface.streamEngineParameters(params, options);
+        waitForDroppedFrames(stream, 6);
+        for (int i = 0; i < 4; i++) {
+            EXPECT_EQ(i - 50, stream.getFrame().parameters[EngineParameter::COOLANT_TEMPERATURE]);
+        }
+        EXPECT_THROW({
+            stream.getFrame();
+        }, timeout_error);
+    }
+}
+
+TEST(ConsultInterfaceTest, streamEngineParameters_background_block) {
+    ConsultInterface iface(std::unique_ptr<ByteInterface>(new StreamingByteInterface(10)),
+                           std::chrono::milliseconds(1000));
+    std::vector<EngineParameter> params {EngineParameter::COOLANT_TEMPERATURE};
+    StreamOptions options;
+    options.background = true;
+    options.buffer_frames = 2;
+    options.overflow_policy = OverflowPolicy::BLOCK;
+    {
+        auto stream = iface.streamEngineParameters(params, options);
+        for (int i = 0; i < 10; i++) {
+            EXPECT_EQ(i - 50, stream.getFrame().parameters[EngineParameter::COOLANT_TEMPERATURE]);
+        }
+        EXPECT_THROW({
+            stream.getFrame();
+        }, timeout_error);
+        EXPECT_EQ(0, stream.droppedFrames());
+    }
+}
+
+TEST(ConsultInterfaceTest, streamEngineParameters_background_tryGetFrame) {
+    ConsultInterface iface(std::unique_ptr<ByteInterface>(new StreamingByteInterface(3)),
+                           std::chrono::milliseconds(1000));
+    std::vector<EngineParameter> params {EngineParameter::COOLANT_TEMPERATURE};
+    StreamOptions options;
+    options.background = true;
+    {
+        auto stream = iface.streamEngineParameters(params, options);
+        EngineParameters data;
+        int frames = 0;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (frames < 3 && std::chrono::steady_clock::now() < deadline) {
+            if (stream.tryGetFrame(data)) {
+                EXPECT_EQ(frames - 50, data.parameters[EngineParameter::COOLANT_TEMPERATURE]);
+                frames++;
+            }
+        }
+        EXPECT_EQ(3, frames);
+    }
+}
+
+TEST(ConsultInterfaceTest, streamEngineParameters_background_no_timeout) {
+    // A background stream could not be stopped while its read is blocked
+    // forever on a quiet device.
+    ConsultInterface iface(std::unique_ptr<ByteInterface>(new StreamingByteInterface(3)));
+    std::vector<EngineParameter> params {EngineParameter::COOLANT_TEMPERATURE};
+    StreamOptions options;
+    options.background = true;
+    EXPECT_THROW(iface.streamEngineParameters(params, options), std::invalid_argument);
+
+    // No stream was started.
+    options.background = false;
+    auto stream = iface.streamEngineParameters(params, options);
+    EXPECT_EQ(-50, stream.getFrame().parameters[EngineParameter::COOLANT_TEMPERATURE]);
+}
+
+TEST(ConsultInterfaceTest, streamEngineParameters_stamped) {
+    ConsultInterface iface(std::unique_ptr<ByteInterface>(new StreamingByteInterface(20)),
+                           std::chrono::milliseconds(1000));
+    std::vector<EngineParameter> params {EngineParameter::COOLANT_TEMPERATURE};
+    for (bool background : {false, true}) {
+        StreamOptions options;
+        options.background = background;
+        options.overflow_policy = OverflowPolicy::BLOCK;
+        auto begin = ByteInterface::clock::now();
+        auto stream = iface.streamEngineParameters(params, options);
+        ByteInterface::clock::time_point previous = begin;
+        for (uint64_t i = 0; i < 10; i++) {
+            auto frame = stream.getFrame();
+            EXPECT_EQ(i, frame.sequence);
+            EXPECT_GE(frame.timestamp, previous);
+            EXPECT_LE(frame.timestamp, ByteInterface::clock::now());
+            previous = frame.timestamp;
+        }
+
+        auto statistics = stream.statistics();
+        EXPECT_GE(statistics.frames, 10);
+        EXPECT_EQ(0, statistics.dropped_frames);
+        EXPECT_EQ(0, statistics.resyncs);
+        EXPECT_GT(statistics.frame_rate, 0);
+        EXPECT_GE(statistics.jitter.count(), 0);
+        uint64_t intervals = 0;
+        for (uint64_t count : statistics.interval_histogram) {
+            intervals += count;
+        }
+        EXPECT_EQ(statistics.frames - 1, intervals);
+    }
+}
+
+TEST(ConsultInterfaceTest, readEngineParameters_stamped) {
+    ConsultInterface iface(std::unique_ptr<ByteInterface>(new StreamingByteInterface(1)));
+    auto begin = ByteInterface::clock::now();
+    auto frame = iface.readEngineParameters<EngineParameter::COOLANT_TEMPERATURE>();
+    EXPECT_GE(frame.timestamp, begin);
+    EXPECT_LE(frame.timestamp, ByteInterface::clock::now());
+    EXPECT_EQ(0, frame.sequence);
+}
+
+TEST(ConsultInterfaceTest, streamEngineParameters_tryGetFrame_foreground) {
+    ConsultInterface iface(std::unique_ptr<ByteInterface>(new StreamingByteInterface(3)));
+    std::vector<EngineParameter> params {EngineParameter::COOLANT_TEMPERATURE};
+    {
+        auto stream = iface.streamEngineParameters(params);
+        EngineParameters data;
+        EXPECT_THROW({
+            stream.tryGetFrame(data);
+        }, std::logic_error);
+    }
+}
+
+TEST(ConsultInterfaceTest, readEngineParameters_plan_reused) {
+    std::unique_ptr<MockByteInterface> byte_interface(new MockByteInterface);
+    EXPECT_CALL(*byte_interface, write(ElementsAre(0xFF, 0xFF, 0xEF)))
+        .Times(Exactly(1))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, read(1))
+        .Times(Exactly(5))
+        .WillOnce(Return(std::vector<uint8_t>{0x10}))
+        .WillOnce(Return(std::vector<uint8_t>{0xB4}))
+        .WillOnce(Return(std::vector<uint8_t>{0xCF}))
+        .WillOnce(Return(std::vector<uint8_t>{0xB5}))
+        .WillOnce(Return(std::vector<uint8_t>{0xCF}))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, write(ElementsAre(0x5A, 0x0C)))
+        .Times(Exactly(2))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, read(2))
+        .Times(Exactly(4))
+        .WillOnce(Return(std::vector<uint8_t>{0xA5, 0x0C}))
+        .WillOnce(Return(std::vector<uint8_t>{0xFF, 0x01}))
+        .WillOnce(Return(std::vector<uint8_t>{0xA5, 0x0C}))
+        .WillOnce(Return(std::vector<uint8_t>{0xFF, 0x01}))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, write(ElementsAre(0xF0)))
+        .Times(Exactly(2))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, write(ElementsAre(0x30)))
+        .Times(Exactly(2))
+        .RetiresOnSaturation();
+
+    ConsultInterface iface(std::move(byte_interface));
+    StreamPlan plan({EngineParameter::BATTERY_VOLTAGE});
+    EXPECT_EQ(14.40, iface.readEngineParameters(plan).parameters[EngineParameter::BATTERY_VOLTAGE]);
+    EXPECT_EQ(14.48, iface.readEngineParameters(plan).parameters[EngineParameter::BATTERY_VOLTAGE]);
+}
+
+TEST(ConsultInterfaceTest, readEngineParameters_typed) {
+    std::unique_ptr<MockByteInterface> byte_interface(new MockByteInterface);
+    EXPECT_CALL(*byte_interface, write(ElementsAre(0xFF, 0xFF, 0xEF)))
+        .Times(Exactly(1))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, read(1))
+        .Times(Exactly(2))
+        .WillOnce(Return(std::vector<uint8_t>{0x10}))
+        .WillOnce(Return(std::vector<uint8_t>{0xCF}))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, write(ElementsAre(0x5A, 0x00, 0x5A, 0x01, 0x5A, 0x0C)))
+        .Times(Exactly(1))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, read(6))
+        .Times(Exactly(1))
+        .WillOnce(Return(std::vector<uint8_t>{0xA5, 0x00, 0xA5, 0x01, 0xA5, 0x0C}))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, write(ElementsAre(0xF0)))
+        .Times(Exactly(1))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, read(2))
+        .Times(Exactly(1))
+        .WillOnce(Return(std::vector<uint8_t>{0xFF, 0x03}))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, read(3))
+        .Times(Exactly(1))
+        .WillOnce(Return(std::vector<uint8_t>{0x01, 0x59, 0xB4}))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*byte_interface, write(ElementsAre(0x30)))
+        .Times(Exactly(1))
+        .RetiresOnSaturation();
+
+    ConsultInterface iface(std::move(byte_interface));
+    auto data = iface.readEngineParameters<EngineParameter::ENGINE_RPM, EngineParameter::BATTERY_VOLTAGE>();
+    EXPECT_EQ(4312.5, data.get<EngineParameter::ENGINE_RPM>());
+    EXPECT_EQ(14.40, data.get<EngineParameter::BATTERY_VOLTAGE>());
+}
+
+TEST(ConsultInterfaceTest, streamEngineParameters_typed) {
+    ConsultInterface iface(std::unique_ptr<ByteInterface>(new StreamingByteInterface(3)));
+    {
+        auto stream = iface.streamEngineParameters<EngineParameter::COOLANT_TEMPERATURE>();
+        for (int i = 0; i < 3; i++) {
+            EXPECT_EQ(i - 50, stream.getFrame().get<EngineParameter::COOLANT_TEMPERATURE>());
+        }
+    }
+}
+
+TEST(ConsultInterfaceTest, streamEngineParameters_typed_background) {
+    ConsultInterface iface(std::unique_ptr<ByteInterface>(new StreamingByteInterface(3)),
+                           std::chrono::milliseconds(1000));
+    StreamOptions options;
+    options.background = true;
+    {
+        auto stream = iface.streamEngineParameters<EngineParameter::COOLANT_TEMPERATURE>(options);
+        TypedEngineParameters<EngineParameter::COOLANT_TEMPERATURE> data;
+        int frames = 0;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (frames < 3 && std::chrono::steady_clock::now() < deadline) {
+            if (stream.tryGetFrame(data)) {
+                EXPECT_EQ(frames - 50, data.get<EngineParameter::COOLANT_TEMPERATURE>());
+                frames++;
+            }
+        }
+        EXPECT_EQ(3, frames);
+        EXPECT_THROW({
+            stream.getFrame();
+        }, timeout_error);
+    }
+}
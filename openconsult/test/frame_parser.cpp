@@ -0,0 +1,124 @@
+#include "openconsult/src/frame_parser.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace openconsult;
+
+
+/**
+ * @brief Pushes a stream to a parser in chunks of a given size, returning the
+ *      frames parsed.
+ */
+static std::vector<std::vector<uint8_t>> parse(FrameParser& parser, const std::vector<uint8_t>& stream,
+                                               std::size_t chunk_size) {
+    std::vector<std::vector<uint8_t>> frames;
+    for (std::size_t offset = 0; offset < stream.size(); offset += chunk_size) {
+        std::size_t size = std::min(chunk_size, stream.size() - offset);
+        std::size_t consumed = 0;
+        while (consumed < size) {
+            consumed += parser.push(stream.data() + offset + consumed, size - consumed);
+            if (parser.hasFrame()) {
+                frames.push_back(parser.frame());
+            }
+        }
+    }
+    return frames;
+}
+
+
+TEST(FrameParserTest, push) {
+    FrameParser parser(2);
+    EXPECT_TRUE(parser.atBoundary());
+    EXPECT_EQ(2, parser.needed());
+
+    std::vector<uint8_t> stream {0xFF, 0x02, 0x12, 0x34, 0xFF, 0x02, 0x56, 0x78};
+    EXPECT_EQ(4, parser.push(stream.data(), stream.size()));
+    ASSERT_TRUE(parser.hasFrame());
+    EXPECT_EQ(std::vector<uint8_t>({0x12, 0x34}), parser.frame());
+
+    EXPECT_EQ(1, parser.push(stream.data() + 4, 1));
+    EXPECT_FALSE(parser.hasFrame());
+    EXPECT_FALSE(parser.atBoundary());
+    EXPECT_EQ(1, parser.needed());
+    EXPECT_EQ(1, parser.push(stream.data() + 5, 1));
+    EXPECT_EQ(2, parser.needed());
+    EXPECT_EQ(2, parser.push(stream.data() + 6, 2));
+    ASSERT_TRUE(parser.hasFrame());
+    EXPECT_EQ(std::vector<uint8_t>({0x56, 0x78}), parser.frame());
+    EXPECT_TRUE(parser.atBoundary());
+    EXPECT_EQ(0, parser.resyncs());
+}
+
+TEST(FrameParserTest, any_chunk_size) {
+    std::vector<uint8_t> stream;
+    for (int i = 0; i < 50; i++) {
+        stream.insert(stream.end(), {0xFF, 0x03, static_cast<uint8_t>(i), 0xFF, 0x03});
+        if (i % 7 == 0) {
+            // Noise between frames, including a start byte with the wrong
+            // length.
+            stream.insert(stream.end(), {0x00, 0xFF, 0x05, 0x03});
+        }
+    }
+
+    FrameParser reference(3);
+    auto expected = parse(reference, stream, stream.size());
+    ASSERT_EQ(50, expected.size());
+    EXPECT_EQ(8, reference.resyncs());
+    EXPECT_EQ(8 * 4, reference.discardedBytes());
+    for (std::size_t chunk_size = 1; chunk_size < 20; chunk_size++) {
+        FrameParser parser(3);
+        EXPECT_EQ(expected, parse(parser, stream, chunk_size)) << "chunk_size " << chunk_size;
+        EXPECT_EQ(reference.resyncs(), parser.resyncs());
+    }
+}
+
+TEST(FrameParserTest, resync_start_byte) {
+    // A corrupted start byte loses only its own frame.
+    FrameParser parser(1);
+    std::vector<uint8_t> stream {0xFF, 0x01, 0xA0, 0x7F, 0x01, 0xA1, 0xFF, 0x01, 0xA2};
+    auto frames = parse(parser, stream, 1);
+    EXPECT_EQ(std::vector<std::vector<uint8_t>>({{0xA0}, {0xA2}}), frames);
+    EXPECT_EQ(1, parser.resyncs());
+    EXPECT_EQ(3, parser.discardedBytes());
+}
+
+TEST(FrameParserTest, resync_dropped_byte) {
+    // Data bytes of FF are not mistaken for start bytes while aligned.
+    FrameParser parser(2);
+    std::vector<uint8_t> stream {0xFF, 0x02, 0xFF, 0xFF, 0xFF, 0x02, 0xFF, 0x02, 0xFF, 0x02, 0x22, 0x33};
+    auto frames = parse(parser, stream, 4);
+    EXPECT_EQ(std::vector<std::vector<uint8_t>>({{0xFF, 0xFF}, {0xFF, 0x02}, {0x22, 0x33}}), frames);
+    EXPECT_EQ(0, parser.resyncs());
+
+    // A dropped data byte misaligns the following header, losing the frame
+    // after it too.
+    parser.reset(2);
+    stream = {0xFF, 0x02, 0x11, 0xFF, 0x02, 0x22, 0x33, 0xFF, 0x02, 0x44, 0x55};
+    frames = parse(parser, stream, 4);
+    EXPECT_EQ(std::vector<std::vector<uint8_t>>({{0x11, 0xFF}, {0x44, 0x55}}), frames);
+    EXPECT_EQ(1, parser.resyncs());
+}
+
+TEST(FrameParserTest, any_size) {
+    FrameParser parser;
+    std::vector<uint8_t> stream {0xFF, 0x00, 0x12, 0xFF, 0x03, 0x01, 0x02, 0x03, 0xFF, 0x01, 0x04};
+    auto frames = parse(parser, stream, 3);
+    EXPECT_EQ(std::vector<std::vector<uint8_t>>({{}, {0x01, 0x02, 0x03}, {0x04}}), frames);
+    EXPECT_EQ(1, parser.resyncs());
+    EXPECT_EQ(1, parser.discardedBytes());
+}
+
+TEST(FrameParserTest, reset) {
+    FrameParser parser(1);
+    std::vector<uint8_t> stream {0x00, 0xFF};
+    parser.push(stream.data(), stream.size());
+    EXPECT_EQ(1, parser.resyncs());
+    EXPECT_FALSE(parser.atBoundary());
+
+    parser.reset(1);
+    EXPECT_TRUE(parser.atBoundary());
+    EXPECT_EQ(0, parser.resyncs());
+    EXPECT_EQ(0, parser.discardedBytes());
+}
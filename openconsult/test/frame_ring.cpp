@@ -0,0 +1,147 @@
+#include "openconsult/src/frame_ring.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace openconsult;
+
+
+TEST(FrameRingTest, ctor_zero_capacity) {
+    EXPECT_THROW({
+        FrameRing ring(0, 16);
+    }, std::invalid_argument);
+}
+
+TEST(FrameRingTest, push_pop) {
+    FrameRing ring(2, 16);
+    EXPECT_TRUE(ring.empty());
+    EXPECT_FALSE(ring.full());
+
+    std::vector<uint8_t> a {0x01, 0x02, 0x03};
+    std::vector<uint8_t> b {0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D};
+    EXPECT_TRUE(ring.tryPush(a.data(), a.size()));
+    EXPECT_TRUE(ring.tryPush(b.data(), b.size()));
+    EXPECT_TRUE(ring.full());
+    EXPECT_FALSE(ring.tryPush(a.data(), a.size()));
+
+    std::vector<uint8_t> out(ring.maxFrameSize());
+    std::size_t size = 0;
+    EXPECT_TRUE(ring.tryPop(out.data(), size));
+    out.resize(size);
+    EXPECT_EQ(a, out);
+
+    out.resize(ring.maxFrameSize());
+    EXPECT_TRUE(ring.tryPop(out.data(), size));
+    out.resize(size);
+    EXPECT_EQ(b, out);
+
+    EXPECT_TRUE(ring.empty());
+    EXPECT_FALSE(ring.tryPop(out.data(), size));
+}
+
+TEST(FrameRingTest, push_empty_frame) {
+    FrameRing ring(1, 16);
+    EXPECT_TRUE(ring.tryPush(nullptr, 0));
+    uint8_t out[16];
+    std::size_t size = 99;
+    EXPECT_TRUE(ring.tryPop(out, size));
+    EXPECT_EQ(0, size);
+}
+
+TEST(FrameRingTest, push_oversized_frame) {
+    FrameRing ring(2, 4);
+    std::vector<uint8_t> frame(5);
+    EXPECT_THROW({
+        ring.tryPush(frame.data(), frame.size());
+    }, std::invalid_argument);
+    EXPECT_THROW({
+        ring.pushOverwrite(frame.data(), frame.size());
+    }, std::invalid_argument);
+    EXPECT_TRUE(ring.empty());
+}
+
+TEST(FrameRingTest, pushOverwrite) {
+    FrameRing ring(2, 1);
+    for (uint8_t i = 0; i < 2; i++) {
+        EXPECT_FALSE(ring.pushOverwrite(&i, 1));
+    }
+    for (uint8_t i = 2; i < 5; i++) {
+        EXPECT_TRUE(ring.pushOverwrite(&i, 1));
+    }
+
+    uint8_t out;
+    std::size_t size = 0;
+    EXPECT_TRUE(ring.tryPop(&out, size));
+    EXPECT_EQ(3, out);
+    EXPECT_TRUE(ring.tryPop(&out, size));
+    EXPECT_EQ(4, out);
+    EXPECT_FALSE(ring.tryPop(&out, size));
+}
+
+/**
+ * @brief Pushes numbered frames from one thread and pops them on another,
+ *      checking every popped frame is intact and frames arrive in order.
+ */
+static void stress(bool overwrite) {
+    static const uint32_t FRAME_COUNT = 200000;
+    FrameRing ring(8, 64);
+
+    std::thread producer([&]() {
+        uint8_t frame[64];
+        for (uint32_t i = 0; i < FRAME_COUNT; i++) {
+            std::size_t size = sizeof(i) + i % 60;
+            std::memcpy(frame, &i, sizeof(i));
+            for (std::size_t j = sizeof(i); j < size; j++) {
+                frame[j] = static_cast<uint8_t>(i + j);
+            }
+            if (overwrite) {
+                ring.pushOverwrite(frame, size);
+            } else {
+                while (!ring.tryPush(frame, size)) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    });
+
+    uint8_t frame[64];
+    std::size_t size = 0;
+    uint32_t expected = 0;
+    uint32_t received = 0;
+    // The final frame is never discarded, so is always eventually popped.
+    while (expected < FRAME_COUNT) {
+        if (!ring.tryPop(frame, size)) {
+            std::this_thread::yield();
+            continue;
+        }
+        uint32_t i;
+        std::memcpy(&i, frame, sizeof(i));
+        if (overwrite) {
+            ASSERT_GE(i, expected);
+        } else {
+            ASSERT_EQ(expected, i);
+        }
+        ASSERT_EQ(sizeof(i) + i % 60, size);
+        for (std::size_t j = sizeof(i); j < size; j++) {
+            ASSERT_EQ(static_cast<uint8_t>(i + j), frame[j]);
+        }
+        expected = i + 1;
+        received++;
+    }
+    producer.join();
+
+    if (!overwrite) {
+        EXPECT_EQ(FRAME_COUNT, received);
+    }
+}
+
+TEST(FrameRingTest, stress_tryPush) {
+    stress(false);
+}
+
+TEST(FrameRingTest, stress_pushOverwrite) {
+    stress(true);
+}
@@ -0,0 +1,198 @@
+#include "openconsult/src/log_columns.h"
+#include "openconsult/src/byte_interface.h"
+#include "openconsult/src/consult_engine_parameters.internal.h"
+#include "openconsult/test/test_helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+using namespace openconsult;
+
+
+static ColumnarLogSummary decode(const std::string& log, LogFormat format, const std::string& path,
+                                 unsigned threads = 1,
+                                 uint32_t block_rows = ColumnarLog::DEFAULT_BLOCK_ROWS) {
+    LogIndex index(bytesOf(log), log.size(), format);
+    std::ofstream file(::testing::TempDir() + path, std::ios_base::out | std::ios_base::binary);
+    return decodeLog(bytesOf(log), log.size(), format, index, file, threads, block_rows);
+}
+
+static double decodeBytes(EngineParameter parameter, const std::vector<uint8_t>& bytes) {
+    auto data = cmn::make_range(bytes);
+    return engineParameterDecode(parameter, data);
+}
+
+
+TEST(LogColumnsTest, empty) {
+    auto summary = decode("", LogFormat::TEXT, "log_columns_empty.oclc");
+    EXPECT_EQ(summary.rows, 0);
+    EXPECT_EQ(summary.blocks, 0);
+    EXPECT_TRUE(summary.parameters.empty());
+
+    ColumnarLog columns(::testing::TempDir() + "log_columns_empty.oclc");
+    EXPECT_EQ(columns.rows(), 0);
+    EXPECT_EQ(columns.blocks(), 0);
+    EXPECT_TRUE(columns.parameters().empty());
+}
+
+TEST(LogColumnsTest, decode_session) {
+    for (auto format : {LogFormat::TEXT, LogFormat::BINARY}) {
+        std::string log = format == LogFormat::TEXT ? SESSION_LOG : toBinary(SESSION_LOG);
+        auto summary = decode(log, format, "log_columns_decode_session.oclc");
+        EXPECT_EQ(summary.rows, 5);
+        EXPECT_EQ(summary.blocks, 1);
+        EXPECT_EQ(summary.skipped_frames, 0);
+        std::vector<EngineParameter> parameters {{EngineParameter::ENGINE_RPM,
+                                                  EngineParameter::VEHICLE_SPEED,
+                                                  EngineParameter::BATTERY_VOLTAGE}};
+        EXPECT_EQ(summary.parameters, parameters);
+
+        ColumnarLog columns(::testing::TempDir() + "log_columns_decode_session.oclc");
+        EXPECT_EQ(columns.parameters(), parameters);
+        ASSERT_EQ(columns.rows(), 5);
+        ASSERT_EQ(columns.blocks(), 1);
+        ASSERT_EQ(columns.blockSize(0), 5);
+
+        const uint8_t frames[5][4] = {{0x00, 0x75, 0x00, 0xB4}, {0x00, 0x75, 0x00, 0xB5},
+                                      {0x00, 0x74, 0x00, 0xB3}, {0x00, 0x75, 0x00, 0xB4},
+                                      {0x00, 0x76, 0x00, 0xB5}};
+        const double* rpm = columns.values(0, columns.column(EngineParameter::ENGINE_RPM));
+        const double* speed = columns.values(0, columns.column(EngineParameter::VEHICLE_SPEED));
+        const double* battery = columns.values(0, columns.column(EngineParameter::BATTERY_VOLTAGE));
+        for (int i = 0; i < 5; i++) {
+            EXPECT_EQ(rpm[i], decodeBytes(EngineParameter::ENGINE_RPM, {frames[i][0], frames[i][1]}));
+            EXPECT_EQ(speed[i], decodeBytes(EngineParameter::VEHICLE_SPEED, {frames[i][2]}));
+            EXPECT_EQ(battery[i], decodeBytes(EngineParameter::BATTERY_VOLTAGE, {frames[i][3]}));
+        }
+
+        // Rows are timed at their frame's start byte. The part number frame
+        // and two fault code frames precede them.
+        LogIndex index(bytesOf(log), log.size(), format);
+        LogBufferParser parser(bytesOf(log), log.size(), format);
+        for (int i = 0; i < 5; i++) {
+            EXPECT_EQ(columns.times(0)[i], index.locate(parser, LogSeekUnit::FRAME, 3 + i).time);
+        }
+        EXPECT_EQ(columns.startTime(0), columns.times(0)[0]);
+        EXPECT_EQ(columns.endTime(0), columns.times(0)[4]);
+        EXPECT_THROW(columns.column(EngineParameter::COOLANT_TEMPERATURE), std::invalid_argument);
+    }
+}
+
+TEST(LogColumnsTest, unknown_registers) {
+    // Registers which are not part of a parameter, including half of a
+    // two-byte parameter, still take a byte of each frame.
+    std::string log = "W 5a025a085a00\nR a502a508a500\nW f0\nR ff03115a22\nR ff0311ff22\n";
+    auto summary = decode(log, LogFormat::TEXT, "log_columns_unknown_registers.oclc");
+    std::vector<EngineParameter> parameters {{EngineParameter::COOLANT_TEMPERATURE}};
+    EXPECT_EQ(summary.parameters, parameters);
+    EXPECT_EQ(summary.rows, 2);
+
+    ColumnarLog columns(::testing::TempDir() + "log_columns_unknown_registers.oclc");
+    EXPECT_EQ(columns.values(0, 0)[0], decodeBytes(EngineParameter::COOLANT_TEMPERATURE, {0x5A}));
+    EXPECT_EQ(columns.values(0, 0)[1], decodeBytes(EngineParameter::COOLANT_TEMPERATURE, {0xFF}));
+}
+
+TEST(LogColumnsTest, mixed_streams) {
+    // Parameters missing from a stream are NaN. Frames of the wrong length,
+    // and frames cut short by the end of the log, are skipped.
+    std::string log = "W 5a08\nR a508\nW f0\nR ff0150\nR ff025051\nW 30\nR ff0151cf\n"
+                      "W 5a0b\nR a50b\nW f0\nR ff0120\nR ff01";
+    auto summary = decode(log, LogFormat::TEXT, "log_columns_mixed_streams.oclc");
+    EXPECT_EQ(summary.rows, 3);
+    EXPECT_EQ(summary.skipped_frames, 2);
+
+    ColumnarLog columns(::testing::TempDir() + "log_columns_mixed_streams.oclc");
+    std::size_t coolant = columns.column(EngineParameter::COOLANT_TEMPERATURE);
+    std::size_t speed = columns.column(EngineParameter::VEHICLE_SPEED);
+    EXPECT_FALSE(std::isnan(columns.values(0, coolant)[0]));
+    EXPECT_FALSE(std::isnan(columns.values(0, coolant)[1]));
+    EXPECT_TRUE(std::isnan(columns.values(0, coolant)[2]));
+    EXPECT_TRUE(std::isnan(columns.values(0, speed)[0]));
+    EXPECT_EQ(columns.values(0, speed)[2], decodeBytes(EngineParameter::VEHICLE_SPEED, {0x20}));
+}
+
+TEST(LogColumnsTest, zone_maps) {
+    std::string log = "W 5a08\nR a508\nW f0\nR ";
+    for (int i = 0; i < 100; i++) {
+        log += cmn::format_bytes(std::vector<uint8_t> {{0xFF, 0x01, static_cast<uint8_t>(i * 37 % 256)}});
+    }
+    log += "\n";
+    auto summary = decode(log, LogFormat::TEXT, "log_columns_zone_maps.oclc", 1, 16);
+    EXPECT_EQ(summary.rows, 100);
+    EXPECT_EQ(summary.blocks, 7);
+
+    ColumnarLog columns(::testing::TempDir() + "log_columns_zone_maps.oclc");
+    EXPECT_EQ(columns.blockRows(), 16);
+    ASSERT_EQ(columns.blocks(), 7);
+    EXPECT_EQ(columns.blockSize(6), 4);
+    for (std::size_t block = 0; block < columns.blocks(); block++) {
+        const double* values = columns.values(block, 0);
+        std::size_t rows = columns.blockSize(block);
+        EXPECT_EQ(columns.minimum(block, 0), *std::min_element(values, values + rows));
+        EXPECT_EQ(columns.maximum(block, 0), *std::max_element(values, values + rows));
+        EXPECT_EQ(columns.startTime(block), columns.times(block)[0]);
+        EXPECT_EQ(columns.endTime(block), columns.times(block)[rows - 1]);
+        if (block > 0) {
+            EXPECT_LT(columns.endTime(block - 1), columns.startTime(block));
+        }
+    }
+}
+
+TEST(LogColumnsTest, parallel_matches_sequential) {
+    // Enough streams for many tasks, some long enough to span several.
+    std::string text;
+    for (int i = 0; text.size() < (4 << 20); i++) {
+        bool rpm = i % 2 == 0;
+        text += rpm ? "W 5a005a015a08\nR a500a501a508\nW f0\n" : "W 5a0b\nR a50b\nW f0\n";
+        for (int j = 0; j < (i % 5) * 2000; j++) {
+            std::vector<uint8_t> frame {{0xFF, static_cast<uint8_t>(rpm ? 3 : 1), static_cast<uint8_t>(j)}};
+            if (rpm) {
+                frame.insert(frame.end(), {static_cast<uint8_t>(i), static_cast<uint8_t>(j >> 4)});
+            }
+            text += "R " + cmn::format_bytes(frame) + "\n";
+        }
+        text += "W 30\nR cf\n";
+    }
+    for (auto format : {LogFormat::TEXT, LogFormat::BINARY}) {
+        std::string log = format == LogFormat::TEXT ? text : toBinary(text);
+        auto expected = decode(log, format, "log_columns_sequential.oclc", 1, 1000);
+        auto actual = decode(log, format, "log_columns_parallel.oclc", 5, 1000);
+        EXPECT_GT(expected.rows, 10000);
+        EXPECT_EQ(actual.rows, expected.rows);
+        EXPECT_EQ(actual.parameters, expected.parameters);
+        EXPECT_EQ(readFile(::testing::TempDir() + "log_columns_parallel.oclc"),
+                  readFile(::testing::TempDir() + "log_columns_sequential.oclc"));
+    }
+}
+
+TEST(LogColumnsTest, invalid_arguments) {
+    std::string log = SESSION_LOG;
+    LogIndex index(bytesOf(log), log.size(), LogFormat::TEXT);
+    std::ostringstream output;
+    EXPECT_THROW(decodeLog(bytesOf(log), log.size() - 1, LogFormat::TEXT, index, output),
+                 std::invalid_argument);
+    EXPECT_THROW(decodeLog(bytesOf(log), log.size(), LogFormat::TEXT, index, output, 1, 0),
+                 std::invalid_argument);
+}
+
+TEST(LogColumnsTest, open_invalid) {
+    EXPECT_THROW(ColumnarLog(::testing::TempDir() + "log_columns_open_missing.oclc"), os_error);
+
+    decode(SESSION_LOG, LogFormat::TEXT, "log_columns_open_valid.oclc");
+    std::string valid = readFile(::testing::TempDir() + "log_columns_open_valid.oclc");
+    std::string invalid[] = {
+        "",
+        "OCLX" + valid.substr(4),
+        valid.substr(0, valid.size() - 1),
+        valid.substr(0, 40) + valid.substr(48),
+    };
+    for (const auto& contents : invalid) {
+        std::string path = ::testing::TempDir() + "log_columns_open_invalid.oclc";
+        std::ofstream(path, std::ios_base::out | std::ios_base::binary) << contents;
+        EXPECT_THROW(ColumnarLog columns(path), std::invalid_argument);
+    }
+}
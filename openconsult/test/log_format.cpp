@@ -0,0 +1,218 @@
+#include "openconsult/src/log_format.h"
+
+#include <gmock/gmock-matchers.h>
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+using namespace openconsult;
+using ::testing::ElementsAre;
+
+
+static std::vector<LogRecord> readAll(const std::string& log, LogFormat format) {
+    std::istringstream stream(log);
+    auto reader = LogReader::create(stream, format);
+    std::vector<LogRecord> records;
+    for (LogRecord record; reader->read(record);) {
+        records.push_back(record);
+    }
+    return records;
+}
+
+static std::string writeAll(const std::vector<LogRecord>& records, LogFormat format) {
+    std::ostringstream stream;
+    auto writer = LogWriter::create(stream, format);
+    for (const auto& record : records) {
+        writer->write(record);
+    }
+    return stream.str();
+}
+
+
+TEST(LogFormatTest, text_read) {
+    auto records = readAll("R 0102\nW aB\n", LogFormat::TEXT);
+    ASSERT_EQ(records.size(), 2);
+    EXPECT_EQ(records[0].type, LogRecordType::READ);
+    EXPECT_EQ(records[0].timestamp, 0);
+    EXPECT_THAT(records[0].data, ElementsAre(0x01, 0x02));
+    EXPECT_EQ(records[1].type, LogRecordType::WRITE);
+    EXPECT_THAT(records[1].data, ElementsAre(0xab));
+}
+
+TEST(LogFormatTest, text_read_invalid) {
+    EXPECT_THROW(readAll("R 0g\n", LogFormat::TEXT), std::invalid_argument);
+    EXPECT_THROW(readAll("R 011\n", LogFormat::TEXT), std::invalid_argument);
+    EXPECT_THROW(readAll("X 01\n", LogFormat::TEXT), std::invalid_argument);
+}
+
+TEST(LogFormatTest, text_write) {
+    std::vector<LogRecord> records {
+        {LogRecordType::WRITE, 5, {0x5a, 0x0b}},
+        {LogRecordType::READ, 10, {}},
+        {LogRecordType::READ, 15, {0xa5}},
+    };
+    EXPECT_EQ(writeAll(records, LogFormat::TEXT), "W 5a0b\nR a5\n");
+}
+
+TEST(LogFormatTest, binary_empty) {
+    EXPECT_TRUE(readAll("", LogFormat::BINARY).empty());
+    std::string log = writeAll({}, LogFormat::BINARY);
+    EXPECT_EQ(log.size(), 8 + 24);
+    EXPECT_EQ(log.substr(0, 4), "OCLG");
+    EXPECT_TRUE(readAll(log, LogFormat::BINARY).empty());
+}
+
+TEST(LogFormatTest, binary_round_trip) {
+    std::vector<LogRecord> records;
+    for (std::size_t i = 0; i < 3000; i++) {
+        LogRecordType type = i % 3 ? LogRecordType::READ : LogRecordType::WRITE;
+        std::vector<uint8_t> data(i % 300, static_cast<uint8_t>(i));
+        records.push_back({type, i * i * 1000, data});
+    }
+    auto log = writeAll(records, LogFormat::BINARY);
+    auto result = readAll(log, LogFormat::BINARY);
+    ASSERT_EQ(result.size(), records.size());
+    for (std::size_t i = 0; i < records.size(); i++) {
+        EXPECT_EQ(result[i].type, records[i].type);
+        EXPECT_EQ(result[i].timestamp, records[i].timestamp);
+        EXPECT_EQ(result[i].data, records[i].data);
+    }
+}
+
+TEST(LogFormatTest, binary_decreasing_timestamp) {
+    std::ostringstream stream;
+    auto writer = LogWriter::create(stream, LogFormat::BINARY);
+    uint8_t byte = 0;
+    writer->write(LogRecordType::READ, 10, &byte, 1);
+    EXPECT_THROW(writer->write(LogRecordType::READ, 9, &byte, 1), std::invalid_argument);
+}
+
+TEST(LogFormatTest, binary_concatenated) {
+    auto log = writeAll({{LogRecordType::WRITE, 7, {0x01}}}, LogFormat::BINARY) +
+               writeAll({{LogRecordType::READ, 3, {0x02}}}, LogFormat::BINARY);
+    auto records = readAll(log, LogFormat::BINARY);
+    ASSERT_EQ(records.size(), 2);
+    EXPECT_EQ(records[0].timestamp, 7);
+    EXPECT_EQ(records[1].timestamp, 3);
+    EXPECT_THAT(records[1].data, ElementsAre(0x02));
+}
+
+TEST(LogFormatTest, binary_invalid) {
+    auto log = writeAll({{LogRecordType::WRITE, 7, {0x01, 0x02}}}, LogFormat::BINARY);
+    // Truncated data.
+    EXPECT_THROW(readAll(log.substr(0, log.size() - 1), LogFormat::BINARY), std::invalid_argument);
+    // Bad header.
+    EXPECT_THROW(readAll("OCLG\x02\x00\x00\x00", LogFormat::BINARY), std::invalid_argument);
+    EXPECT_THROW(readAll("R 01\n", LogFormat::BINARY), std::invalid_argument);
+    // Bad tag.
+    EXPECT_THROW(readAll(log + "X", LogFormat::BINARY), std::invalid_argument);
+}
+
+TEST(LogFormatTest, detect) {
+    std::istringstream text("R 01\n");
+    EXPECT_EQ(detectLogFormat(text), LogFormat::TEXT);
+    EXPECT_EQ(text.tellg(), 0);
+    std::istringstream binary(writeAll({}, LogFormat::BINARY));
+    EXPECT_EQ(detectLogFormat(binary), LogFormat::BINARY);
+    EXPECT_EQ(binary.tellg(), 0);
+}
+
+TEST(LogFormatTest, convert_round_trip) {
+    std::string text = "W 5a0b\nR a5\nR ff00\nW 01\n";
+    std::istringstream text_in(text);
+    std::ostringstream binary_out;
+    EXPECT_EQ(convertLog(text_in, LogFormat::TEXT, binary_out, LogFormat::BINARY), 4);
+
+    std::istringstream binary_in(binary_out.str());
+    std::ostringstream text_out;
+    EXPECT_EQ(convertLog(binary_in, LogFormat::BINARY, text_out, LogFormat::TEXT), 4);
+    EXPECT_EQ(text_out.str(), text);
+}
+
+static std::vector<LogRecord> parseAll(const std::string& log, LogFormat format) {
+    LogBufferParser parser(reinterpret_cast<const uint8_t*>(log.data()), log.size(), format);
+    std::vector<LogRecord> records;
+    for (LogRecordView view; parser.next(view);) {
+        std::vector<uint8_t> data;
+        for (std::size_t i = 0; i < view.size; i++) {
+            data.push_back(view[i]);
+        }
+        records.push_back({view.type, view.timestamp, data});
+    }
+    return records;
+}
+
+TEST(LogFormatTest, buffer_parser_text) {
+    auto records = parseAll("R 09aF\r\nW 3c\n", LogFormat::TEXT);
+    ASSERT_EQ(records.size(), 2);
+    EXPECT_EQ(records[0].type, LogRecordType::READ);
+    EXPECT_THAT(records[0].data, ElementsAre(0x09, 0xaf));
+    EXPECT_EQ(records[1].type, LogRecordType::WRITE);
+    EXPECT_THAT(records[1].data, ElementsAre(0x3c));
+
+    EXPECT_THROW(parseAll("R 09aF\nW 3c\n\nR 00", LogFormat::TEXT), std::invalid_argument);
+    EXPECT_EQ(parseAll("R 0102\nW 03", LogFormat::TEXT).size(), 2);
+    EXPECT_THROW(parseAll("R 0x\n", LogFormat::TEXT), std::invalid_argument);
+}
+
+TEST(LogFormatTest, buffer_parser_binary) {
+    std::vector<LogRecord> records;
+    for (std::size_t i = 0; i < 2500; i++) {
+        LogRecordType type = i % 2 ? LogRecordType::READ : LogRecordType::WRITE;
+        records.push_back({type, i * 7, std::vector<uint8_t>(i % 5, static_cast<uint8_t>(i))});
+    }
+    auto log = writeAll(records, LogFormat::BINARY);
+    log += writeAll({{LogRecordType::READ, 2, {0xff}}}, LogFormat::BINARY);
+    auto result = parseAll(log, LogFormat::BINARY);
+    ASSERT_EQ(result.size(), records.size() + 1);
+    for (std::size_t i = 0; i < records.size(); i++) {
+        EXPECT_EQ(result[i].type, records[i].type);
+        EXPECT_EQ(result[i].timestamp, records[i].timestamp);
+        EXPECT_EQ(result[i].data, records[i].data);
+    }
+    EXPECT_EQ(result.back().timestamp, 2);
+
+    EXPECT_THROW(parseAll(log.substr(0, log.size() - 1), LogFormat::BINARY), std::invalid_argument);
+    EXPECT_THROW(parseAll("R 01\n", LogFormat::BINARY), std::invalid_argument);
+}
+
+TEST(LogFormatTest, buffer_parser_rewind) {
+    std::string log = "R 01\nW 02\n";
+    LogBufferParser parser(reinterpret_cast<const uint8_t*>(log.data()), log.size(), LogFormat::TEXT);
+    LogRecordView view;
+    ASSERT_TRUE(parser.next(view));
+    LogBufferParser copy = parser;
+    ASSERT_TRUE(parser.next(view));
+    EXPECT_FALSE(parser.next(view));
+    EXPECT_EQ(parser.position(), log.size());
+
+    ASSERT_TRUE(copy.next(view));
+    EXPECT_EQ(view.type, LogRecordType::WRITE);
+
+    parser.rewind();
+    EXPECT_EQ(parser.position(), 0);
+    ASSERT_TRUE(parser.next(view));
+    EXPECT_EQ(view.type, LogRecordType::READ);
+}
+
+TEST(LogFormatTest, buffer_parser_seek) {
+    std::string log = writeAll({{LogRecordType::READ, 5, {0x01}},
+                                {LogRecordType::WRITE, 9, {0x02}}}, LogFormat::BINARY);
+    LogBufferParser parser(reinterpret_cast<const uint8_t*>(log.data()), log.size(), LogFormat::BINARY);
+    LogRecordView view;
+    ASSERT_TRUE(parser.next(view));
+    std::size_t position = parser.position();
+    uint64_t timestamp = parser.lastTimestamp();
+    EXPECT_EQ(timestamp, 5);
+    ASSERT_TRUE(parser.next(view));
+
+    // Resuming restores the timestamp the next record is relative to.
+    LogBufferParser resumed(reinterpret_cast<const uint8_t*>(log.data()), log.size(), LogFormat::BINARY);
+    resumed.seek(position, timestamp);
+    ASSERT_TRUE(resumed.next(view));
+    EXPECT_EQ(view.timestamp, 9);
+    EXPECT_FALSE(resumed.next(view));
+
+    EXPECT_THROW(resumed.seek(0, 0), std::invalid_argument);
+    EXPECT_THROW(resumed.seek(log.size() + 1, 0), std::invalid_argument);
+}
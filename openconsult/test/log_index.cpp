@@ -0,0 +1,229 @@
+#include "openconsult/src/log_index.h"
+#include "openconsult/src/byte_interface.h"
+#include "openconsult/test/test_helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <sstream>
+
+using namespace openconsult;
+
+
+/**
+ * @brief Writes a log of a stream being started, followed by frames split
+ *      across records as a \c ConsultInterface would read them.
+ */
+static std::string streamLog(LogFormat format, std::size_t frame_count) {
+    std::ostringstream log;
+    auto writer = LogWriter::create(log, format);
+    uint64_t time = 0;
+    writer->write({LogRecordType::WRITE, time, {0x5A, 0x08, 0xF0}});
+    writer->write({LogRecordType::READ, time += 1000000, {0xA5, 0xF7}});
+    for (std::size_t i = 0; i < frame_count; i++) {
+        uint8_t value = static_cast<uint8_t>(i);
+        writer->write({LogRecordType::READ, time += 1000000, {0xFF, 0x02}});
+        writer->write({LogRecordType::READ, time += 100000, {value, 0xFF}});
+    }
+    return log.str();
+}
+
+/**
+ * @brief A position found by parsing the log from the start.
+ */
+struct Expected {
+    uint64_t record;
+    uint64_t time;
+    uint8_t first_byte;
+};
+
+static std::vector<Expected> recordStarts(const std::string& log, LogFormat format) {
+    LogBufferParser parser(bytesOf(log), log.size(), format);
+    std::vector<Expected> starts;
+    uint64_t line_time = 0;
+    for (LogRecordView view; parser.next(view);) {
+        uint64_t start = recordStartTime(view.timestamp, line_time);
+        starts.push_back({starts.size(), start, view[0]});
+        line_time = start + view.size * BYTE_TIME_NS;
+    }
+    return starts;
+}
+
+
+TEST(LogIndexTest, frame_counter) {
+    // An echo, a frame holding 0xFF, then the start of a second frame.
+    const uint8_t bytes[] = {0xA5, 0xFF, 0x02, 0xFF, 0x00, 0xFF, 0x01};
+    FrameCounter counter;
+    int frames = 0;
+    for (uint8_t byte : bytes) {
+        frames += counter.feed(byte);
+    }
+    EXPECT_EQ(frames, 2);
+
+    // Counting resumes from a saved state.
+    FrameCounter resumed(FrameCounter(0).state());
+    EXPECT_TRUE(resumed.feed(0xFF));
+    FrameCounter mid_frame(resumed.state());
+    EXPECT_FALSE(mid_frame.feed(0xFF));
+}
+
+TEST(LogIndexTest, empty) {
+    LogIndex index(nullptr, 0, LogFormat::TEXT);
+    EXPECT_EQ(index.records(), 0);
+    EXPECT_EQ(index.frames(), 0);
+    EXPECT_EQ(index.size(), 1);
+    LogBufferParser log;
+    EXPECT_THROW(index.locate(log, LogSeekUnit::RECORD, 0), std::invalid_argument);
+    EXPECT_THROW(index.locate(log, LogSeekUnit::TIME, 0), std::invalid_argument);
+}
+
+TEST(LogIndexTest, counts) {
+    for (auto format : {LogFormat::TEXT, LogFormat::BINARY}) {
+        std::string log = streamLog(format, 100);
+        LogIndex index(bytesOf(log), log.size(), format, 16);
+        EXPECT_EQ(index.format(), format);
+        EXPECT_EQ(index.logSize(), log.size());
+        EXPECT_EQ(index.records(), 202);
+        EXPECT_EQ(index.frames(), 100);
+        // One position at the start, then one every 16 records or frames.
+        EXPECT_EQ(index.size(), 1 + 202 / 16 + 100 / 16);
+    }
+}
+
+TEST(LogIndexTest, locate_records) {
+    for (auto format : {LogFormat::TEXT, LogFormat::BINARY}) {
+        std::string log = streamLog(format, 100);
+        LogBufferParser parser(bytesOf(log), log.size(), format);
+        LogIndex index(bytesOf(log), log.size(), format, 5);
+        for (const auto& expected : recordStarts(log, format)) {
+            LogPosition position = index.locate(parser, LogSeekUnit::RECORD, expected.record);
+            EXPECT_EQ(position.record, expected.record);
+            EXPECT_EQ(position.byte, 0);
+            EXPECT_EQ(position.time, expected.time);
+
+            // The position resumes parsing at the record.
+            LogBufferParser resumed = parser;
+            resumed.seek(position.offset, position.timestamp);
+            LogRecordView view;
+            ASSERT_TRUE(resumed.next(view));
+            EXPECT_EQ(view[0], expected.first_byte);
+        }
+        EXPECT_THROW(index.locate(parser, LogSeekUnit::RECORD, 202), std::invalid_argument);
+    }
+}
+
+TEST(LogIndexTest, locate_frames) {
+    for (auto format : {LogFormat::TEXT, LogFormat::BINARY}) {
+        std::string log = streamLog(format, 100);
+        LogBufferParser parser(bytesOf(log), log.size(), format);
+        LogIndex index(bytesOf(log), log.size(), format, 7);
+        for (uint64_t frame = 0; frame < 100; frame++) {
+            LogPosition position = index.locate(parser, LogSeekUnit::FRAME, frame);
+            EXPECT_EQ(position.frame, frame);
+            // Each frame's header is a record of its own, after the echo.
+            EXPECT_EQ(position.record, 2 + 2 * frame);
+            EXPECT_EQ(position.byte, 0);
+        }
+        EXPECT_THROW(index.locate(parser, LogSeekUnit::FRAME, 100), std::invalid_argument);
+    }
+}
+
+TEST(LogIndexTest, locate_frames_within_records) {
+    // Text logs recorded from a stream hold many frames per record.
+    std::string log = "W 5a08f0\nR a5f7";
+    for (int i = 0; i < 50; i++) {
+        log += "ff02" + std::string(i == 7 ? "ff" : "00") + "01";
+    }
+    log += "\n";
+    LogBufferParser parser(bytesOf(log), log.size(), LogFormat::TEXT);
+    LogIndex index(bytesOf(log), log.size(), LogFormat::TEXT, 4);
+    EXPECT_EQ(index.frames(), 50);
+    for (uint64_t frame = 0; frame < 50; frame++) {
+        LogPosition position = index.locate(parser, LogSeekUnit::FRAME, frame);
+        EXPECT_EQ(position.record, 1);
+        EXPECT_EQ(position.byte, 2 + 4 * frame);
+    }
+}
+
+TEST(LogIndexTest, locate_times) {
+    for (auto format : {LogFormat::TEXT, LogFormat::BINARY}) {
+        std::string log = streamLog(format, 100);
+        LogBufferParser parser(bytesOf(log), log.size(), format);
+        LogIndex index(bytesOf(log), log.size(), format, 5);
+        auto starts = recordStarts(log, format);
+        for (std::size_t i = 1; i < starts.size(); i++) {
+            // Times between records resolve to the later record.
+            uint64_t time = starts[i - 1].time + 1;
+            LogPosition position = index.locate(parser, LogSeekUnit::TIME, time);
+            EXPECT_EQ(position.record, i);
+            EXPECT_EQ(position.time, starts[i].time);
+        }
+        EXPECT_THROW(index.locate(parser, LogSeekUnit::TIME, index.duration()), std::invalid_argument);
+    }
+}
+
+TEST(LogIndexTest, save_and_open) {
+    std::string log = streamLog(LogFormat::BINARY, 100);
+    LogIndex built(bytesOf(log), log.size(), LogFormat::BINARY, 8);
+    std::string path = ::testing::TempDir() + "log_index_save_and_open.idx";
+    {
+        std::ofstream file(path, std::ios_base::out | std::ios_base::binary);
+        built.write(file);
+    }
+
+    LogIndex opened(path);
+    EXPECT_EQ(opened.format(), LogFormat::BINARY);
+    EXPECT_EQ(opened.logSize(), built.logSize());
+    EXPECT_EQ(opened.records(), built.records());
+    EXPECT_EQ(opened.frames(), built.frames());
+    EXPECT_EQ(opened.duration(), built.duration());
+    ASSERT_EQ(opened.size(), built.size());
+    for (std::size_t i = 0; i < built.size(); i++) {
+        EXPECT_EQ(opened[i].offset, built[i].offset);
+        EXPECT_EQ(opened[i].timestamp, built[i].timestamp);
+        EXPECT_EQ(opened[i].frame_state, built[i].frame_state);
+    }
+
+    LogBufferParser parser(bytesOf(log), log.size(), LogFormat::BINARY);
+    EXPECT_EQ(opened.locate(parser, LogSeekUnit::FRAME, 50).record, 102);
+}
+
+TEST(LogIndexTest, matches) {
+    std::string log = streamLog(LogFormat::TEXT, 10);
+    LogIndex index(bytesOf(log), log.size(), LogFormat::TEXT);
+    EXPECT_TRUE(index.matches(bytesOf(log), log.size(), LogFormat::TEXT));
+    EXPECT_FALSE(index.matches(bytesOf(log), log.size(), LogFormat::BINARY));
+    EXPECT_FALSE(index.matches(bytesOf(log), log.size() - 1, LogFormat::TEXT));
+
+    // A log rewritten to the same size does not match.
+    std::string rewritten = log;
+    rewritten[rewritten.size() - 2] = rewritten[rewritten.size() - 2] == '0' ? '1' : '0';
+    EXPECT_FALSE(index.matches(bytesOf(rewritten), rewritten.size(), LogFormat::TEXT));
+
+    // Nor does a large one changed only at its start.
+    std::string large = streamLog(LogFormat::TEXT, 2000);
+    LogIndex large_index(bytesOf(large), large.size(), LogFormat::TEXT);
+    EXPECT_TRUE(large_index.matches(bytesOf(large), large.size(), LogFormat::TEXT));
+    rewritten = large;
+    rewritten[2] = rewritten[2] == '0' ? '1' : '0';
+    EXPECT_FALSE(large_index.matches(bytesOf(rewritten), rewritten.size(), LogFormat::TEXT));
+}
+
+TEST(LogIndexTest, open_invalid) {
+    EXPECT_THROW(LogIndex(::testing::TempDir() + "log_index_open_missing.idx"), os_error);
+
+    std::string log = streamLog(LogFormat::TEXT, 10);
+    std::ostringstream saved;
+    LogIndex(bytesOf(log), log.size(), LogFormat::TEXT).write(saved);
+    std::string valid = saved.str();
+    std::string invalid[] = {
+        "",
+        "OCLG" + valid.substr(4),
+        valid.substr(0, valid.size() - 1),
+    };
+    for (const auto& contents : invalid) {
+        std::string path = ::testing::TempDir() + "log_index_open_invalid.idx";
+        std::ofstream(path, std::ios_base::out | std::ios_base::binary) << contents;
+        EXPECT_THROW(LogIndex index(path), std::invalid_argument);
+    }
+}
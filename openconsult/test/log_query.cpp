@@ -0,0 +1,241 @@
+#include "openconsult/src/log_query.h"
+#include "openconsult/src/common.h"
+#include "openconsult/test/test_helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <sstream>
+
+using namespace openconsult;
+
+
+/**
+ * @brief Decodes a log streaming engine speed and coolant temperature, which
+ *      rise and fall slowly as they would on a drive, into a \c ColumnarLog
+ *      of small blocks. A vehicle speed stream follows.
+ */
+static std::string writeDriveLog(const std::string& name) {
+    std::string log = "W 5a005a015a08\nR a500a501a508\nW f0\n";
+    for (int i = 0; i < 2000; i++) {
+        int rpm = i % 1000 * 6 / 10;
+        std::vector<uint8_t> frame {{0xFF, 0x03, static_cast<uint8_t>(rpm >> 8),
+                                     static_cast<uint8_t>(rpm), static_cast<uint8_t>(50 + i / 40)}};
+        log += "R " + cmn::format_bytes(frame) + "\n";
+    }
+    log += "W 30\nR cf\nW 5a0b\nR a50b\nW f0\n";
+    for (int i = 0; i < 100; i++) {
+        log += "R ff01" + cmn::format_bytes(std::vector<uint8_t> {static_cast<uint8_t>(i)}) + "\n";
+    }
+    const uint8_t* data = bytesOf(log);
+    LogIndex index(data, log.size(), LogFormat::TEXT);
+    std::string path = ::testing::TempDir() + name;
+    std::ofstream file(path, std::ios_base::out | std::ios_base::binary);
+    decodeLog(data, log.size(), LogFormat::TEXT, index, file, 1, 64);
+    return path;
+}
+
+/**
+ * @brief Runs a query by testing every row of a log.
+ */
+static LogQueryResult scanAll(const ColumnarLog& log, const LogQuery& query) {
+    LogQueryResult result {{}, std::vector<std::vector<double>>(query.columns.size()), 0, 0};
+    auto valueOf = [&](EngineParameter parameter, std::size_t block, std::size_t row) {
+        const auto& parameters = log.parameters();
+        auto it = std::find(parameters.begin(), parameters.end(), parameter);
+        return it == parameters.end() ? std::numeric_limits<double>::quiet_NaN() :
+                                        log.values(block, it - parameters.begin())[row];
+    };
+    for (std::size_t block = 0; block < log.blocks(); block++) {
+        for (std::size_t row = 0; row < log.blockSize(block); row++) {
+            uint64_t time = log.times(block)[row];
+            bool match = time >= query.start_time && time <= query.end_time;
+            for (const auto& predicate : query.predicates) {
+                double value = valueOf(predicate.parameter, block, row);
+                switch (predicate.comparison) {
+                    case QueryComparison::LESS:          match &= value < predicate.value; break;
+                    case QueryComparison::LESS_EQUAL:    match &= value <= predicate.value; break;
+                    case QueryComparison::GREATER:       match &= value > predicate.value; break;
+                    case QueryComparison::GREATER_EQUAL: match &= value >= predicate.value; break;
+                    case QueryComparison::EQUAL:         match &= value == predicate.value; break;
+                    case QueryComparison::NOT_EQUAL:     match &= value < predicate.value || value > predicate.value; break;
+                }
+            }
+            if (match) {
+                result.times.push_back(time);
+                for (std::size_t i = 0; i < query.columns.size(); i++) {
+                    result.values[i].push_back(valueOf(query.columns[i], block, row));
+                }
+            }
+        }
+    }
+    return result;
+}
+
+static void expectResultsEqual(const LogQueryResult& actual, const LogQueryResult& expected) {
+    ASSERT_EQ(actual.times, expected.times);
+    ASSERT_EQ(actual.values.size(), expected.values.size());
+    for (std::size_t i = 0; i < expected.values.size(); i++) {
+        ASSERT_EQ(actual.values[i].size(), expected.values[i].size());
+        for (std::size_t j = 0; j < expected.values[i].size(); j++) {
+            if (std::isnan(expected.values[i][j])) {
+                EXPECT_TRUE(std::isnan(actual.values[i][j]));
+            } else {
+                EXPECT_EQ(actual.values[i][j], expected.values[i][j]);
+            }
+        }
+    }
+}
+
+
+TEST(LogQueryTest, parse) {
+    LogQuery query = parseLogQuery("coolant_temp_degc and engine_speed_rpm "
+                                   "where engine_speed_rpm > 6000 between 60 and 120");
+    EXPECT_EQ(query.columns, std::vector<EngineParameter>({EngineParameter::COOLANT_TEMPERATURE,
+                                                           EngineParameter::ENGINE_RPM}));
+    ASSERT_EQ(query.predicates.size(), 1);
+    EXPECT_EQ(query.predicates[0].parameter, EngineParameter::ENGINE_RPM);
+    EXPECT_EQ(query.predicates[0].comparison, QueryComparison::GREATER);
+    EXPECT_EQ(query.predicates[0].value, 6000);
+    EXPECT_EQ(query.start_time, 60000000000ULL);
+    EXPECT_EQ(query.end_time, 120000000000ULL);
+
+    query = parseLogQuery("battery_v, vehicle_speed_kmph WHERE battery_v<=11.5 And "
+                          "vehicle_speed_kmph!=0 and ignition_timing_degbtdc >= -2.5e1 "
+                          "BETWEEN 250ms AND 1.5min");
+    EXPECT_EQ(query.columns.size(), 2);
+    ASSERT_EQ(query.predicates.size(), 3);
+    EXPECT_EQ(query.predicates[0].comparison, QueryComparison::LESS_EQUAL);
+    EXPECT_EQ(query.predicates[0].value, 11.5);
+    EXPECT_EQ(query.predicates[1].comparison, QueryComparison::NOT_EQUAL);
+    EXPECT_EQ(query.predicates[2].comparison, QueryComparison::GREATER_EQUAL);
+    EXPECT_EQ(query.predicates[2].value, -25);
+    EXPECT_EQ(query.start_time, 250000000ULL);
+    EXPECT_EQ(query.end_time, 90000000000ULL);
+}
+
+TEST(LogQueryTest, parse_defaults) {
+    LogQuery query = parseLogQuery("coolant_temp_degc where coolant_temp_degc = 100");
+    EXPECT_EQ(query.predicates[0].comparison, QueryComparison::EQUAL);
+    EXPECT_EQ(query.start_time, 0);
+    EXPECT_EQ(query.end_time, std::numeric_limits<uint64_t>::max());
+
+    query = parseLogQuery("coolant_temp_degc between 1h and 3600000000000ns");
+    EXPECT_TRUE(query.predicates.empty());
+    EXPECT_EQ(query.start_time, query.end_time);
+}
+
+TEST(LogQueryTest, parse_invalid) {
+    const char* invalid[] = {
+        "",
+        "coolant_temp",
+        "coolant_temp_degc and",
+        "coolant_temp_degc where",
+        "coolant_temp_degc where coolant_temp_degc",
+        "coolant_temp_degc where coolant_temp_degc > hot",
+        "coolant_temp_degc where coolant_temp_degc ~ 5",
+        "coolant_temp_degc where 5 < coolant_temp_degc",
+        "coolant_temp_degc between 10",
+        "coolant_temp_degc between 10 20",
+        "coolant_temp_degc between 20 and 10",
+        "coolant_temp_degc between -1 and 10",
+        "coolant_temp_degc engine_speed_rpm",
+    };
+    for (const char* query : invalid) {
+        EXPECT_THROW(parseLogQuery(query), std::invalid_argument) << query;
+    }
+}
+
+TEST(LogQueryTest, filter_column) {
+    // Every comparison, at every alignment and length, matches a scalar
+    // comparison. Earlier filters are kept.
+    std::mt19937 random(42);
+    std::vector<double> values(300);
+    for (auto& value : values) {
+        value = random() % 4 == 0 ? std::numeric_limits<double>::quiet_NaN() : random() % 10;
+    }
+    for (auto comparison : {QueryComparison::LESS, QueryComparison::LESS_EQUAL, QueryComparison::GREATER,
+                            QueryComparison::GREATER_EQUAL, QueryComparison::EQUAL,
+                            QueryComparison::NOT_EQUAL}) {
+        for (std::size_t offset = 0; offset < 4; offset++) {
+            for (std::size_t size = 0; size < 200; size += 7) {
+                std::vector<uint64_t> mask((size + 63) / 64, 0xF0F0F0F0F0F0F0F0ULL);
+                filterColumn(values.data() + offset, size, comparison, 5, mask.data());
+                for (std::size_t i = 0; i < size; i++) {
+                    double value = values[offset + i];
+                    bool expected = i % 8 >= 4;
+                    switch (comparison) {
+                        case QueryComparison::LESS:          expected &= value < 5; break;
+                        case QueryComparison::LESS_EQUAL:    expected &= value <= 5; break;
+                        case QueryComparison::GREATER:       expected &= value > 5; break;
+                        case QueryComparison::GREATER_EQUAL: expected &= value >= 5; break;
+                        case QueryComparison::EQUAL:         expected &= value == 5; break;
+                        case QueryComparison::NOT_EQUAL:     expected &= !std::isnan(value) && value != 5; break;
+                    }
+                    EXPECT_EQ((mask[i / 64] >> (i % 64)) & 1, expected ? 1 : 0) << i;
+                }
+            }
+        }
+    }
+}
+
+TEST(LogQueryTest, run_matches_scan) {
+    ColumnarLog log(writeDriveLog("log_query_run_matches_scan.oclc"));
+    uint64_t end = log.endTime(log.blocks() - 1);
+    const std::string queries[] = {
+        "engine_speed_rpm",
+        "coolant_temp_degc and engine_speed_rpm where engine_speed_rpm > 6000",
+        "engine_speed_rpm where engine_speed_rpm >= 6000 and coolant_temp_degc < 60",
+        "vehicle_speed_kmph, engine_speed_rpm where vehicle_speed_kmph != 50",
+        "engine_speed_rpm where engine_speed_rpm = 1000",
+        "engine_speed_rpm where engine_speed_rpm <= 3000 between 1s and 3s",
+        "coolant_temp_degc between 0 and " + std::to_string(end) + "ns",
+    };
+    for (const auto& text : queries) {
+        LogQuery query = parseLogQuery(text);
+        LogQueryResult result = runLogQuery(log, query);
+        expectResultsEqual(result, scanAll(log, query));
+        EXPECT_EQ(result.blocks_read + result.blocks_skipped, log.blocks()) << text;
+        EXPECT_FALSE(result.times.empty()) << text;
+    }
+}
+
+TEST(LogQueryTest, zone_maps_skip_blocks) {
+    ColumnarLog log(writeDriveLog("log_query_zone_maps_skip_blocks.oclc"));
+
+    // Engine speed only exceeds 6000 RPM at the peak of each cycle.
+    LogQueryResult result = runLogQuery(log, parseLogQuery("engine_speed_rpm where engine_speed_rpm > 6000"));
+    EXPECT_GT(result.blocks_skipped, result.blocks_read);
+    for (double rpm : result.values[0]) {
+        EXPECT_GT(rpm, 6000);
+    }
+
+    // Blocks outside the time range are skipped.
+    uint64_t start = log.startTime(5);
+    uint64_t end = log.endTime(6);
+    LogQuery query = parseLogQuery("coolant_temp_degc");
+    query.start_time = start;
+    query.end_time = end;
+    result = runLogQuery(log, query);
+    EXPECT_EQ(result.blocks_read, 2);
+    EXPECT_EQ(result.times.size(), log.blockSize(5) + log.blockSize(6));
+}
+
+TEST(LogQueryTest, missing_columns) {
+    ColumnarLog log(writeDriveLog("log_query_missing_columns.oclc"));
+
+    // A predicate on a column the log lacks matches nothing.
+    LogQueryResult result = runLogQuery(log, parseLogQuery("coolant_temp_degc where battery_v > 0"));
+    EXPECT_TRUE(result.times.empty());
+    EXPECT_EQ(result.blocks_skipped, log.blocks());
+
+    // A column the log lacks is NaN.
+    result = runLogQuery(log, parseLogQuery("battery_v and coolant_temp_degc"));
+    EXPECT_EQ(result.times.size(), log.rows());
+    EXPECT_TRUE(std::isnan(result.values[0][0]));
+    EXPECT_FALSE(std::isnan(result.values[1][0]));
+}
@@ -1,12 +1,16 @@
 #include "openconsult/src/log_recorder.h"
+#include "openconsult/src/simulated_ecu.h"
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <condition_variable>
+#include <mutex>
 #include <sstream>
 
 using namespace openconsult;
 using ::testing::ElementsAre;
+using ::testing::ElementsAreArray;
 using ::testing::Exactly;
 using ::testing::Return;
 
@@ -15,6 +19,8 @@ class MockByteInterface : public ByteInterface {
 public:
     MOCK_METHOD(std::vector<uint8_t>, read, (std::size_t size), (override));
     MOCK_METHOD(void, write, (const std::vector<uint8_t>& bytes), (override));
+    MOCK_METHOD(void, setTimeout, (std::chrono::milliseconds timeout), (override));
+    MOCK_METHOD(void, setDeadline, (clock::time_point deadline), (override));
 };
 
 TEST(LogRecorderTest, ctor) {
@@ -87,6 +93,26 @@ TEST(LogRecorderTest, multiple_writes) {
     EXPECT_EQ(stream.str(), "W 2021");
 }
 
+TEST(LogRecorderTest, readInto_then_write_pointer) {
+    std::unique_ptr<MockByteInterface> byte_interface(new MockByteInterface);
+    EXPECT_CALL(*byte_interface, read(2))
+        .Times(Exactly(1))
+        .WillOnce(Return(std::vector<uint8_t>{0x01, 0x02}));
+    EXPECT_CALL(*byte_interface, write(ElementsAre(0x02)))
+        .Times(Exactly(1));
+
+    std::ostringstream stream;
+    LogRecorder recorder(std::move(byte_interface), stream);
+
+    uint8_t bytes[2];
+    recorder.readInto(bytes, 2);
+    EXPECT_THAT(bytes, ElementsAre(0x01, 0x02));
+
+    recorder.write(bytes + 1, 1);
+
+    EXPECT_EQ(stream.str(), "R 0102\nW 02");
+}
+
 TEST(LogRecorderTest, read_then_write) {
     std::unique_ptr<MockByteInterface> byte_interface(new MockByteInterface);
     EXPECT_CALL(*byte_interface, read(1))
@@ -185,3 +211,228 @@ TEST(LogRecorderTest, final_newline) {
 
     EXPECT_EQ(stream.str(), "R 01\n");
 }
+
+TEST(LogRecorderTest, forwards_timeouts) {
+    auto deadline = ByteInterface::clock::now();
+    std::unique_ptr<MockByteInterface> byte_interface(new MockByteInterface);
+    EXPECT_CALL(*byte_interface, setTimeout(std::chrono::milliseconds(50)))
+        .Times(Exactly(1));
+    EXPECT_CALL(*byte_interface, setDeadline(deadline))
+        .Times(Exactly(1));
+
+    std::ostringstream stream;
+    LogRecorder recorder(std::move(byte_interface), stream);
+    recorder.setTimeout(std::chrono::milliseconds(50));
+    recorder.setDeadline(deadline);
+
+    EXPECT_EQ(stream.str(), "");
+}
+
+TEST(LogRecorderTest, binary) {
+    std::unique_ptr<MockByteInterface> byte_interface(new MockByteInterface);
+    EXPECT_CALL(*byte_interface, write(ElementsAre(0x01)))
+        .Times(Exactly(1));
+    EXPECT_CALL(*byte_interface, read(1))
+        .Times(Exactly(2))
+        .WillRepeatedly(Return(std::vector<uint8_t>{0x02}));
+
+    std::ostringstream stream;
+    {
+        LogRecorder recorder(std::move(byte_interface), stream, LogFormat::BINARY);
+        recorder.write(std::vector<uint8_t>{0x01});
+        recorder.read(1);
+        recorder.read(1);
+    }
+
+    // Each transaction is a separate, timestamped record.
+    std::istringstream log(stream.str());
+    auto reader = LogReader::create(log, LogFormat::BINARY);
+    std::vector<LogRecord> records;
+    for (LogRecord record; reader->read(record);) {
+        records.push_back(record);
+    }
+    ASSERT_EQ(records.size(), 3);
+    EXPECT_EQ(records[0].type, LogRecordType::WRITE);
+    EXPECT_THAT(records[0].data, ElementsAre(0x01));
+    EXPECT_EQ(records[1].type, LogRecordType::READ);
+    EXPECT_THAT(records[1].data, ElementsAre(0x02));
+    EXPECT_EQ(records[2].type, LogRecordType::READ);
+    EXPECT_LE(records[0].timestamp, records[1].timestamp);
+    EXPECT_LE(records[1].timestamp, records[2].timestamp);
+}
+
+TEST(LogRecorderTest, read_timestamps) {
+    // Reads are timed from when their first byte arrived, not their last.
+    SimulatedECU* ecu = new SimulatedECU(SimulatedTiming::VIRTUAL);
+    LogRecorderOptions options;
+    options.clock = [ecu]() { return ecu->time(); };
+    std::ostringstream stream;
+    std::vector<uint64_t> read_ends;
+    {
+        LogRecorder recorder(std::unique_ptr<ByteInterface>(ecu), stream, LogFormat::BINARY, options);
+        recorder.write(std::vector<uint8_t>{0xFF, 0xFF, 0xEF});
+        recorder.read(1);
+        read_ends.push_back(ecu->time());
+        recorder.write(std::vector<uint8_t>{0x5A, 0x0C, 0xF0});
+        recorder.read(2);
+        read_ends.push_back(ecu->time());
+        uint8_t frame[3];
+        for (int i = 0; i < 4; i++) {
+            recorder.readInto(frame, sizeof(frame));
+            read_ends.push_back(ecu->time());
+        }
+    }
+
+    std::istringstream log(stream.str());
+    auto reader = LogReader::create(log, LogFormat::BINARY);
+    std::vector<LogRecord> reads;
+    for (LogRecord record; reader->read(record);) {
+        if (record.type == LogRecordType::READ) {
+            reads.push_back(record);
+        }
+    }
+    ASSERT_EQ(reads.size(), read_ends.size());
+    for (std::size_t i = 0; i < reads.size(); i++) {
+        EXPECT_EQ(reads[i].timestamp, read_ends[i] - reads[i].data.size() * BYTE_TIME_NS);
+    }
+    // Streamed frames follow each other back to back.
+    EXPECT_EQ(reads[3].timestamp - reads[2].timestamp, 3 * BYTE_TIME_NS);
+}
+
+TEST(LogRecorderTest, close) {
+    std::unique_ptr<MockByteInterface> byte_interface(new MockByteInterface);
+    EXPECT_CALL(*byte_interface, read(1))
+        .Times(Exactly(2))
+        .WillRepeatedly(Return(std::vector<uint8_t>{0x01}));
+
+    std::ostringstream stream;
+    LogRecorder recorder(std::move(byte_interface), stream);
+    recorder.read(1);
+    recorder.close();
+    EXPECT_EQ(stream.str(), "R 01\n");
+
+    // Transactions are still forwarded, but no longer logged.
+    recorder.read(1);
+    recorder.close();
+    EXPECT_EQ(stream.str(), "R 01\n");
+}
+
+TEST(LogRecorderTest, async_matches_sync) {
+    std::ostringstream sync_stream;
+    std::ostringstream async_stream;
+    for (auto* stream : {&sync_stream, &async_stream}) {
+        std::unique_ptr<MockByteInterface> byte_interface(new MockByteInterface);
+        EXPECT_CALL(*byte_interface, read(2))
+            .Times(Exactly(200))
+            .WillRepeatedly(Return(std::vector<uint8_t>{0x01, 0x02}));
+        EXPECT_CALL(*byte_interface, write(ElementsAre(0x03)))
+            .Times(Exactly(100));
+
+        LogRecorderOptions options;
+        options.async = stream == &async_stream;
+        LogRecorder recorder(std::move(byte_interface), *stream, LogFormat::TEXT, options);
+        for (int i = 0; i < 100; i++) {
+            recorder.write(std::vector<uint8_t>{0x03});
+            recorder.read(2);
+            recorder.read(2);
+        }
+        recorder.close();
+        EXPECT_EQ(recorder.droppedBytes(), 0);
+    }
+    EXPECT_EQ(async_stream.str(), sync_stream.str());
+}
+
+TEST(LogRecorderTest, async_flush) {
+    std::unique_ptr<MockByteInterface> byte_interface(new MockByteInterface);
+    EXPECT_CALL(*byte_interface, read(1))
+        .Times(Exactly(1))
+        .WillOnce(Return(std::vector<uint8_t>{0x1a}));
+
+    std::ostringstream stream;
+    LogRecorderOptions options;
+    options.async = true;
+    LogRecorder recorder(std::move(byte_interface), stream, LogFormat::BINARY, options);
+    recorder.read(1);
+    recorder.flush();
+
+    // The stream is not touched again until there is more to write.
+    std::istringstream log(stream.str());
+    auto reader = LogReader::create(log, LogFormat::BINARY);
+    LogRecord record;
+    ASSERT_TRUE(reader->read(record));
+    EXPECT_EQ(record.type, LogRecordType::READ);
+    EXPECT_THAT(record.data, ElementsAre(0x1a));
+    EXPECT_FALSE(reader->read(record));
+}
+
+/**
+ * @brief Stream buffer whose writes block until released.
+ */
+class StallingStreamBuf : public std::stringbuf {
+public:
+    void release() {
+        std::lock_guard<std::mutex> lock(mutex);
+        released = true;
+        changed.notify_all();
+    }
+
+    void waitUntilStalled() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]() { return stalled; });
+    }
+
+protected:
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        stall();
+        return std::stringbuf::xsputn(s, n);
+    }
+
+    int_type overflow(int_type c) override {
+        stall();
+        return std::stringbuf::overflow(c);
+    }
+
+private:
+    void stall() {
+        std::unique_lock<std::mutex> lock(mutex);
+        stalled = true;
+        changed.notify_all();
+        changed.wait(lock, [&]() { return released; });
+    }
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool stalled = false;
+    bool released = false;
+};
+
+TEST(LogRecorderTest, async_counts_dropped_bytes) {
+    std::vector<uint8_t> bytes(16, 0xab);
+    std::unique_ptr<MockByteInterface> byte_interface(new MockByteInterface);
+    EXPECT_CALL(*byte_interface, write(ElementsAreArray(bytes)))
+        .Times(Exactly(11));
+
+    StallingStreamBuf buffer;
+    std::ostream stream(&buffer);
+    LogRecorderOptions options;
+    options.async = true;
+    options.buffer_size = 64;
+    LogRecorder recorder(std::move(byte_interface), stream, LogFormat::TEXT, options);
+
+    // The writer takes the first write, then stalls on the stream.
+    recorder.write(bytes);
+    buffer.waitUntilStalled();
+
+    // Only two more writes fit in the buffer. The rest are dropped, without
+    // blocking.
+    for (int i = 0; i < 10; i++) {
+        recorder.write(bytes);
+    }
+    EXPECT_EQ(recorder.droppedBytes(), 8 * bytes.size());
+
+    buffer.release();
+    recorder.close();
+    std::string expected = "W " + std::string(6 * bytes.size(), 'x') + "\n";
+    EXPECT_EQ(buffer.str().size(), expected.size());
+    EXPECT_EQ(recorder.droppedBytes(), 8 * bytes.size());
+}
@@ -1,9 +1,11 @@
 #include "openconsult/src/log_replay.h"
 #include "openconsult/src/common.h"
+#include "openconsult/test/test_helpers.h"
 
 #include <gmock/gmock-matchers.h>
 #include <gtest/gtest.h>
 
+#include <fstream>
 #include <sstream>
 
 using namespace openconsult;
@@ -65,6 +67,22 @@ TEST(LogReplayTest, read_one_byte_without_newline) {
     EXPECT_THAT(data, ElementsAre(1u));
 }
 
+TEST(LogReplayTest, readInto_across_lines) {
+    std::istringstream stream("R 0102\nR 0304\n");
+    LogReplay replay(stream);
+
+    uint8_t data[3];
+    replay.readInto(data, 3);
+    EXPECT_THAT(data, ElementsAre(1u, 2u, 3u));
+
+    replay.readInto(data, 1);
+    EXPECT_EQ(data[0], 4u);
+
+    EXPECT_THROW({
+        replay.readInto(data, 1);
+    }, std::runtime_error);
+}
+
 TEST(LogReplayTest, read_too_many_bytes) {
     std::istringstream stream("R 01\n");
     LogReplay replay(stream);
@@ -167,6 +185,18 @@ TEST(LogReplayTest, write_different_byte) {
     }, std::runtime_error);
 }
 
+TEST(LogReplayTest, write_pointer) {
+    std::istringstream stream("W 0102\nR 0304\nW 0506\n");
+    LogReplay replay(stream);
+
+    const uint8_t bytes[] = {5u, 6u};
+    replay.write(bytes, 1);
+    replay.write(bytes + 1, 1);
+    EXPECT_THROW({
+        replay.write(bytes, 1);
+    }, std::runtime_error);
+}
+
 TEST(LogReplayTest, write_too_many_bytes) {
     std::istringstream stream("W 01\n");
     LogReplay replay(stream);
@@ -374,3 +404,346 @@ TEST(LogReplayTest, write_wrapped_sequence) {
     data = replay.read(2);
     EXPECT_THAT(data, ElementsAre(3u, 4u));
 }
+
+TEST(LogReplayTest, binary) {
+    std::istringstream text("W 0102\nR 03\nR 04\n");
+    std::ostringstream binary;
+    convertLog(text, LogFormat::TEXT, binary, LogFormat::BINARY);
+
+    std::istringstream stream(binary.str());
+    LogReplay replay(stream, false, LogFormat::BINARY);
+
+    std::vector<uint8_t> bytes {{1u, 2u}};
+    replay.write(bytes);
+    auto data = replay.read(2);
+    EXPECT_THAT(data, ElementsAre(3u, 4u));
+}
+
+TEST(LogReplayTest, write_spanning_wrap) {
+    std::istringstream stream("W 0102\nR 03\nW 0304\nR 05");
+    LogReplay replay(stream, true);
+
+    std::vector<uint8_t> bytes1 {{3u, 4u}};
+    replay.write(bytes1);
+    EXPECT_THAT(replay.read(1), ElementsAre(5u));
+
+    // A match may span the end of the log, and even repeat it.
+    std::vector<uint8_t> bytes2 {{4u, 1u, 2u, 3u, 4u, 1u}};
+    replay.write(bytes2);
+    EXPECT_THAT(replay.read(1), ElementsAre(3u));
+}
+
+TEST(LogReplayTest, write_wrapped_no_match) {
+    std::istringstream stream("W 01\nR 02");
+    LogReplay replay(stream, true);
+
+    std::vector<uint8_t> bytes {{3u}};
+    EXPECT_THROW({
+        replay.write(bytes);
+    }, std::runtime_error);
+
+    // The cursors are left unchanged.
+    std::vector<uint8_t> bytes2 {{1u}};
+    replay.write(bytes2);
+    EXPECT_THAT(replay.read(1), ElementsAre(2u));
+}
+
+TEST(LogReplayTest, mapped_write_wrapped_no_match) {
+    LogReplay replay(writeTempFile("log_replay_mapped_write_wrapped_no_match", "W 01\nR 02"), true);
+
+    std::vector<uint8_t> bytes {{3u}};
+    EXPECT_THROW({
+        replay.write(bytes);
+    }, std::runtime_error);
+
+    // The cursors are left unchanged.
+    std::vector<uint8_t> bytes2 {{1u}};
+    replay.write(bytes2);
+    EXPECT_THAT(replay.read(1), ElementsAre(2u));
+}
+
+TEST(LogReplayTest, mapped_empty) {
+    LogReplay replay(writeTempFile("log_replay_mapped_empty", ""));
+    EXPECT_THROW(replay.read(1), std::runtime_error);
+}
+
+TEST(LogReplayTest, mapped_missing) {
+    EXPECT_THROW({
+        LogReplay replay(::testing::TempDir() + "log_replay_mapped_missing");
+    }, os_error);
+}
+
+TEST(LogReplayTest, mapped_write_read) {
+    LogReplay replay(writeTempFile("log_replay_mapped_write_read",
+                                  "W 0102\nR 0304\nW 05\nR 06\nR 07\n"));
+
+    std::vector<uint8_t> bytes1 {{1u, 2u}};
+    replay.write(bytes1);
+    EXPECT_THAT(replay.read(1), ElementsAre(3u));
+
+    // Writing skips the remaining read data, to the reads following the write.
+    std::vector<uint8_t> bytes2 {{5u}};
+    replay.write(bytes2);
+    EXPECT_THAT(replay.read(2), ElementsAre(6u, 7u));
+    EXPECT_THROW(replay.read(1), std::runtime_error);
+    EXPECT_THROW(replay.write(bytes2), std::runtime_error);
+}
+
+TEST(LogReplayTest, mapped_read_after_failed_write) {
+    // A write with no match depletes the replay, as it does when streamed,
+    // rather than replaying the log again from the start.
+    const std::string log = "R aa\nW 01\nR 02\n";
+    std::istringstream stream(log);
+    LogReplay streamed(stream);
+    LogReplay mapped(writeTempFile("log_replay_mapped_read_after_failed_write", log));
+
+    std::vector<uint8_t> bytes {{3u}};
+    EXPECT_THROW(streamed.write(bytes), std::runtime_error);
+    EXPECT_THROW(mapped.write(bytes), std::runtime_error);
+    EXPECT_THROW(streamed.read(1), std::runtime_error);
+    EXPECT_THROW(mapped.read(1), std::runtime_error);
+}
+
+TEST(LogReplayTest, mapped_write_wrapped_sequence) {
+    LogReplay replay(writeTempFile("log_replay_mapped_write_wrapped_sequence",
+                                  "R 01\nW 02\nR 0304\nW 05"), true);
+
+    std::vector<uint8_t> bytes1 {{2u, 5u}};
+    replay.write(bytes1);
+    EXPECT_THAT(replay.read(1), ElementsAre(1u));
+
+    std::vector<uint8_t> bytes2 {{5u, 2u}};
+    replay.write(bytes2);
+    EXPECT_THAT(replay.read(2), ElementsAre(3u, 4u));
+}
+
+TEST(LogReplayTest, mapped_matches_stream) {
+    // Replay the same sequence of transactions from a stream and a file, in
+    // both formats, and compare the results.
+    std::string text;
+    for (int i = 0; i < 200; i++) {
+        text += cmn::pformat("W %02x%02x\nR %02x\nR %02x%02x\n", i, i + 1, i + 2, i + 3, i + 4);
+    }
+    std::istringstream text_stream(text);
+    std::ostringstream binary;
+    convertLog(text_stream, LogFormat::TEXT, binary, LogFormat::BINARY);
+
+    for (auto format : {LogFormat::TEXT, LogFormat::BINARY}) {
+        std::string log = format == LogFormat::TEXT ? text : binary.str();
+        std::istringstream stream(log);
+        LogReplay expected(stream, true, format);
+        LogReplay actual(writeTempFile("log_replay_mapped_matches_stream", log), true, format);
+        for (int i = 0; i < 500; i++) {
+            std::vector<uint8_t> bytes {{static_cast<uint8_t>(i % 200)}};
+            if (i % 3 == 0) {
+                expected.write(bytes);
+                actual.write(bytes);
+            }
+            EXPECT_EQ(actual.read(2), expected.read(2));
+        }
+    }
+}
+
+TEST(LogReplayTest, mapped_lazy_parse_error) {
+    // Construction succeeds, as the malformed record is not yet reached.
+    LogReplay replay(writeTempFile("log_replay_mapped_lazy_parse_error", "W 00\nR 0102\nR 0g\n"));
+    EXPECT_THAT(replay.read(1), ElementsAre(1u));
+    EXPECT_THROW(replay.read(1), std::invalid_argument);
+}
+
+static std::string timestampedLog(uint64_t interval = 100000000) {
+    // A write, then reads one and two intervals later: 100ms and 200ms by
+    // default.
+    std::ostringstream log;
+    auto writer = LogWriter::create(log, LogFormat::BINARY);
+    writer->write({LogRecordType::WRITE, 0, {0x01}});
+    writer->write({LogRecordType::READ, interval, {0x02}});
+    writer->write({LogRecordType::READ, 2 * interval, {0x03}});
+    return log.str();
+}
+
+static void expectPacedReads(LogReplay& replay) {
+    // At four times real time, the reads arrive after 25ms and 50ms.
+    replay.setPacing(4.0);
+    auto start = ByteInterface::clock::now();
+    std::vector<uint8_t> bytes {{1u}};
+    replay.write(bytes);
+    EXPECT_THAT(replay.read(1), ElementsAre(2u));
+    auto first = ByteInterface::clock::now();
+    EXPECT_THAT(replay.read(1), ElementsAre(3u));
+    auto second = ByteInterface::clock::now();
+
+    // Only lower bounds are reliable on a loaded machine. The upper bound
+    // just catches pacing which is far too slow.
+    EXPECT_GE(first - start, std::chrono::milliseconds(24));
+    EXPECT_GE(second - first, std::chrono::milliseconds(24));
+    EXPECT_LT(second - start, std::chrono::seconds(5));
+}
+
+TEST(LogReplayTest, paced_timestamps) {
+    std::istringstream stream(timestampedLog());
+    LogReplay replay(stream, false, LogFormat::BINARY);
+    expectPacedReads(replay);
+}
+
+TEST(LogReplayTest, mapped_paced_timestamps) {
+    LogReplay replay(writeTempFile("log_replay_mapped_paced_timestamps", timestampedLog()),
+                     false, LogFormat::BINARY);
+    expectPacedReads(replay);
+}
+
+TEST(LogReplayTest, paced_baud_rate) {
+    // Without timestamps, bytes are paced at 9600 baud: ~1.04ms per byte. The
+    // first read anchors the timing, so returns immediately.
+    std::string log = "R ";
+    for (int i = 0; i < 49; i++) {
+        log += "ab";
+    }
+    std::istringstream stream(log);
+    LogReplay replay(stream);
+    replay.setPacing(2.0);
+
+    replay.read(1);
+    auto start = ByteInterface::clock::now();
+    replay.read(48);
+    auto elapsed = ByteInterface::clock::now() - start;
+    EXPECT_GE(elapsed, std::chrono::milliseconds(24));
+    EXPECT_LT(elapsed, std::chrono::seconds(5));
+}
+
+TEST(LogReplayTest, paced_wrapped) {
+    std::istringstream stream("R 0102");
+    LogReplay replay(stream, true);
+    replay.setPacing(1.0);
+
+    // Wrapping continues one byte after the end of the log.
+    replay.read(1);
+    auto start = ByteInterface::clock::now();
+    replay.read(4);
+    auto elapsed = ByteInterface::clock::now() - start;
+    EXPECT_GE(elapsed, std::chrono::microseconds(4 * 1041));
+    EXPECT_LT(elapsed, std::chrono::seconds(5));
+}
+
+TEST(LogReplayTest, unpaced) {
+    // Paced, the reads would take 10s, far longer than any scheduling delay.
+    std::istringstream stream(timestampedLog(20000000000ULL));
+    LogReplay replay(stream, false, LogFormat::BINARY);
+    replay.setPacing(4.0);
+    replay.setPacing(0.0);
+
+    auto start = ByteInterface::clock::now();
+    std::vector<uint8_t> bytes {{1u}};
+    replay.write(bytes);
+    replay.read(2);
+    EXPECT_LT(ByteInterface::clock::now() - start, std::chrono::seconds(5));
+}
+
+TEST(LogReplayTest, paced_invalid_speed) {
+    std::istringstream stream("R 01");
+    LogReplay replay(stream);
+    EXPECT_THROW(replay.setPacing(-1.0), std::invalid_argument);
+}
+
+static std::string seekableLog() {
+    // Writes each followed by a frame read in two parts. The writes differ so
+    // each can only be matched once.
+    std::string log;
+    for (int i = 0; i < 40; i++) {
+        log += cmn::pformat("W %02x\nR ff02\nR %02x%02x\n", i, i, i + 1);
+    }
+    return log;
+}
+
+static void expectSeeks(LogReplay& replay) {
+    // Record 3 is the write of 0x01.
+    replay.seek(LogSeekUnit::RECORD, 3);
+    std::vector<uint8_t> bytes {{1u}};
+    replay.write(bytes);
+    EXPECT_THAT(replay.read(4), ElementsAre(0xFFu, 2u, 1u, 2u));
+
+    // Seeking backwards replays earlier data again.
+    replay.seek(LogSeekUnit::FRAME, 0);
+    EXPECT_THAT(replay.read(4), ElementsAre(0xFFu, 2u, 0u, 1u));
+    replay.seek(LogSeekUnit::FRAME, 30);
+    EXPECT_THAT(replay.read(4), ElementsAre(0xFFu, 2u, 30u, 31u));
+
+    // Seeking to a record in between frames continues from the next read.
+    replay.seek(LogSeekUnit::RECORD, 2);
+    EXPECT_THAT(replay.read(2), ElementsAre(0u, 1u));
+
+    // Writes are matched from the position.
+    replay.seek(LogSeekUnit::FRAME, 20);
+    std::vector<uint8_t> earlier {{10u}};
+    EXPECT_THROW(replay.write(earlier), std::runtime_error);
+
+    EXPECT_THROW(replay.seek(LogSeekUnit::RECORD, 120), std::invalid_argument);
+    EXPECT_THROW(replay.seek(LogSeekUnit::FRAME, 40), std::invalid_argument);
+}
+
+TEST(LogReplayTest, seek) {
+    std::istringstream stream(seekableLog());
+    LogReplay replay(stream);
+    expectSeeks(replay);
+}
+
+TEST(LogReplayTest, mapped_seek) {
+    LogReplay replay(writeTempFile("log_replay_mapped_seek", seekableLog()));
+    expectSeeks(replay);
+}
+
+TEST(LogReplayTest, mapped_seek_sidecar_index) {
+    std::string log = seekableLog();
+    std::ostringstream index;
+    LogIndex(bytesOf(log), log.size(), LogFormat::TEXT, 4).write(index);
+
+    std::string path = writeTempFile("log_replay_mapped_seek_sidecar_index", log);
+    writeTempFile("log_replay_mapped_seek_sidecar_index.idx", index.str());
+    LogReplay replay(path);
+    expectSeeks(replay);
+
+    // A stale index is ignored.
+    std::string stale_path = writeTempFile("log_replay_mapped_seek_stale_index",
+                                          log.substr(0, log.size() / 2));
+    writeTempFile("log_replay_mapped_seek_stale_index.idx", index.str());
+    LogReplay stale(stale_path);
+    EXPECT_THROW(stale.seek(LogSeekUnit::FRAME, 30), std::invalid_argument);
+
+    // As is an index of a different log of the same size, here one without
+    // any frames.
+    std::string rewritten = log;
+    for (std::size_t i = rewritten.find("R ff02"); i != std::string::npos; i = rewritten.find("R ff02", i)) {
+        rewritten.replace(i, 6, "R 0002");
+    }
+    std::ostringstream rewritten_index;
+    LogIndex(bytesOf(rewritten), rewritten.size(), LogFormat::TEXT, 4)
+            .write(rewritten_index);
+    std::string same_size_path = writeTempFile("log_replay_mapped_seek_same_size_index", log);
+    writeTempFile("log_replay_mapped_seek_same_size_index.idx", rewritten_index.str());
+    LogReplay same_size(same_size_path);
+    expectSeeks(same_size);
+}
+
+TEST(LogReplayTest, seek_time) {
+    std::istringstream stream(timestampedLog());
+    LogReplay replay(stream, false, LogFormat::BINARY);
+    replay.seek(LogSeekUnit::TIME, 150000000);
+    EXPECT_THAT(replay.read(1), ElementsAre(3u));
+    EXPECT_THROW(replay.seek(LogSeekUnit::TIME, 300000000), std::invalid_argument);
+
+    LogReplay mapped(writeTempFile("log_replay_seek_time", timestampedLog()), false, LogFormat::BINARY);
+    mapped.seek(LogSeekUnit::TIME, 50000000);
+    EXPECT_THAT(mapped.read(2), ElementsAre(2u, 3u));
+    EXPECT_THROW(mapped.seek(LogSeekUnit::TIME, 300000000), std::invalid_argument);
+}
+
+TEST(LogReplayTest, seek_wrapped) {
+    std::istringstream stream("R 01\nR 02\nR 03\n");
+    LogReplay replay(stream, true);
+    replay.seek(LogSeekUnit::RECORD, 2);
+    EXPECT_THAT(replay.read(3), ElementsAre(3u, 1u, 2u));
+
+    LogReplay mapped(writeTempFile("log_replay_seek_wrapped", "R 01\nR 02\nR 03\n"), true);
+    mapped.seek(LogSeekUnit::RECORD, 2);
+    EXPECT_THAT(mapped.read(3), ElementsAre(3u, 1u, 2u));
+}
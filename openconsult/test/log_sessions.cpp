@@ -0,0 +1,154 @@
+#include "openconsult/src/log_sessions.h"
+#include "openconsult/test/test_helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+using namespace openconsult;
+
+
+static SessionTable segment(const std::string& log, LogFormat format, unsigned threads = 1) {
+    return segmentLog(bytesOf(log), log.size(), format, threads);
+}
+
+static void expectTablesEqual(const SessionTable& actual, const SessionTable& expected) {
+    ASSERT_EQ(actual.transactions.size(), expected.transactions.size());
+    for (std::size_t i = 0; i < expected.transactions.size(); i++) {
+        const auto& a = actual.transactions[i];
+        const auto& e = expected.transactions[i];
+        EXPECT_EQ(a.type, e.type) << i;
+        EXPECT_EQ(a.session, e.session) << i;
+        EXPECT_EQ(a.first_record, e.first_record) << i;
+        EXPECT_EQ(a.records, e.records) << i;
+        EXPECT_EQ(a.offset, e.offset) << i;
+        EXPECT_EQ(a.start_timestamp, e.start_timestamp) << i;
+        EXPECT_EQ(a.end_timestamp, e.end_timestamp) << i;
+        EXPECT_EQ(a.frames, e.frames) << i;
+        EXPECT_EQ(a.command_size, e.command_size) << i;
+        EXPECT_EQ(a.command, e.command) << i;
+        EXPECT_EQ(a.halted, e.halted) << i;
+    }
+    ASSERT_EQ(actual.sessions.size(), expected.sessions.size());
+    for (std::size_t i = 0; i < expected.sessions.size(); i++) {
+        EXPECT_EQ(actual.sessions[i].first_transaction, expected.sessions[i].first_transaction);
+        EXPECT_EQ(actual.sessions[i].records, expected.sessions[i].records);
+        EXPECT_EQ(actual.sessions[i].frames, expected.sessions[i].frames);
+    }
+}
+
+
+TEST(LogSessionsTest, empty) {
+    auto table = segment("", LogFormat::TEXT);
+    EXPECT_TRUE(table.sessions.empty());
+    EXPECT_TRUE(table.transactions.empty());
+}
+
+TEST(LogSessionsTest, single_session) {
+    for (auto format : {LogFormat::TEXT, LogFormat::BINARY}) {
+        std::string log = format == LogFormat::TEXT ? SESSION_LOG : toBinary(SESSION_LOG);
+        auto table = segment(log, format);
+
+        ASSERT_EQ(table.transactions.size(), 4);
+        const auto& handshake = table.transactions[0];
+        EXPECT_EQ(handshake.type, TransactionType::HANDSHAKE);
+        EXPECT_EQ(handshake.records, 2);
+        EXPECT_EQ(handshake.frames, 0);
+        EXPECT_FALSE(handshake.halted);
+
+        const auto& ecu_info = table.transactions[1];
+        EXPECT_EQ(ecu_info.type, TransactionType::ECU_INFO);
+        EXPECT_EQ(ecu_info.first_record, 2);
+        EXPECT_EQ(ecu_info.records, 6);
+        EXPECT_EQ(ecu_info.frames, 1);
+        EXPECT_TRUE(ecu_info.halted);
+
+        const auto& fault_codes = table.transactions[2];
+        EXPECT_EQ(fault_codes.type, TransactionType::FAULT_CODES);
+        EXPECT_EQ(fault_codes.frames, 2);
+
+        const auto& registers = table.transactions[3];
+        EXPECT_EQ(registers.type, TransactionType::REGISTER_SELECT);
+        EXPECT_EQ(registers.command, 0x5A);
+        EXPECT_EQ(registers.command_size, 8);
+        EXPECT_EQ(registers.frames, 5);
+        EXPECT_EQ(registers.first_record + registers.records, 23);
+
+        ASSERT_EQ(table.sessions.size(), 1);
+        EXPECT_TRUE(table.sessions[0].handshake);
+        EXPECT_EQ(table.sessions[0].transactions, 4);
+        EXPECT_EQ(table.sessions[0].records, 23);
+        EXPECT_EQ(table.sessions[0].frames, 8);
+    }
+}
+
+TEST(LogSessionsTest, concatenated_sessions) {
+    // Data logged before the first handshake forms a session of its own.
+    std::string log = std::string("R ff0100\n") + SESSION_LOG + SESSION_LOG + SESSION_LOG;
+    auto table = segment(log, LogFormat::TEXT);
+    ASSERT_EQ(table.sessions.size(), 4);
+    EXPECT_FALSE(table.sessions[0].handshake);
+    EXPECT_EQ(table.sessions[0].records, 1);
+    EXPECT_EQ(table.transactions[0].type, TransactionType::OTHER);
+    EXPECT_EQ(table.transactions[0].command_size, 0);
+    for (std::size_t i = 1; i < 4; i++) {
+        EXPECT_TRUE(table.sessions[i].handshake);
+        EXPECT_EQ(table.sessions[i].first_transaction, 1 + 4 * (i - 1));
+        EXPECT_EQ(table.sessions[i].first_record, 1 + 23 * (i - 1));
+        EXPECT_EQ(table.sessions[i].offset, log.find("W ffffef", table.sessions[i - 1].offset + 1));
+    }
+    EXPECT_EQ(table.transactions.back().session, 3);
+}
+
+TEST(LogSessionsTest, parallel_matches_sequential) {
+    // Enough sessions for several chunks, some streaming long enough that a
+    // chunk starts part way through a stream.
+    std::string text;
+    for (int i = 0; text.size() < (6 << 20); i++) {
+        text += SESSION_LOG;
+        text += "W 5a08\nR a508\nW f0\n";
+        for (int j = 0; j < (i % 7) * 500; j++) {
+            text += "R ff01" + std::string(j % 3 ? "11" : "ff") + "\n";
+        }
+        text += "W 30\nR cf\n";
+    }
+    for (auto format : {LogFormat::TEXT, LogFormat::BINARY}) {
+        std::string log = format == LogFormat::TEXT ? text : toBinary(text);
+        auto expected = segment(log, format, 1);
+        auto actual = segment(log, format, 5);
+        expectTablesEqual(actual, expected);
+    }
+}
+
+TEST(LogSessionsTest, parallel_false_sync_marker) {
+    // Records holding the sync marker pattern may be mistaken for chunk
+    // boundaries, and must not affect the result.
+    std::ostringstream stream;
+    auto writer = LogWriter::create(stream, LogFormat::BINARY);
+    const std::vector<uint8_t> marker {{'S', 'Y', 'N', 'C', 0xA5, 0x5A, 0xC3, 0x3C, 0x00}};
+    std::vector<uint8_t> padding(4000, 0x11);
+    for (int i = 0; i < 2000; i++) {
+        writer->write({LogRecordType::WRITE, 0, {0xD0}});
+        writer->write({LogRecordType::READ, 0, marker});
+        writer->write({LogRecordType::READ, 0, padding});
+    }
+    std::string log = stream.str();
+    auto expected = segment(log, LogFormat::BINARY, 1);
+    EXPECT_EQ(expected.transactions.size(), 2000);
+    expectTablesEqual(segment(log, LogFormat::BINARY, 4), expected);
+}
+
+TEST(LogSessionsTest, write_table) {
+    auto table = segment(SESSION_LOG, LogFormat::TEXT);
+    std::ostringstream csv;
+    writeSessionTable(table, csv);
+    std::istringstream lines(csv.str());
+    std::string line;
+    std::getline(lines, line);
+    EXPECT_EQ(line, "session,type,first_record,records,offset,start_timestamp,end_timestamp,"
+                    "command,command_size,frames,halted");
+    std::getline(lines, line);
+    EXPECT_EQ(line, "0,HANDSHAKE,0,2,0,0,0,ff,3,0,0");
+    std::getline(lines, line);
+    EXPECT_EQ(line, "0,ECU_INFO,2,6,14,0,0,d0,1,1,1");
+}
@@ -0,0 +1,31 @@
+#include "openconsult/src/mapped_file.h"
+#include "openconsult/src/byte_interface.h"
+#include "openconsult/test/test_helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <fstream>
+#include <string>
+
+using namespace openconsult;
+
+
+TEST(MappedFileTest, contents) {
+    std::string contents("mapped\0file", 11);
+    MappedFile file(writeTempFile("mapped_file_contents", contents));
+    ASSERT_EQ(file.size(), contents.size());
+    EXPECT_EQ(std::memcmp(file.data(), contents.data(), contents.size()), 0);
+}
+
+TEST(MappedFileTest, empty) {
+    MappedFile file(writeTempFile("mapped_file_empty", ""));
+    EXPECT_EQ(file.size(), 0);
+    EXPECT_EQ(file.data(), nullptr);
+}
+
+TEST(MappedFileTest, missing) {
+    EXPECT_THROW({
+        MappedFile file(::testing::TempDir() + "mapped_file_missing");
+    }, os_error);
+}
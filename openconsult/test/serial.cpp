@@ -0,0 +1,168 @@
+#include "openconsult/src/serial.h"
+#include "openconsult/src/consult_interface.h"
+#include "openconsult/src/pty_emulator.h"
+#include "openconsult/src/simulated_ecu.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+using namespace openconsult;
+
+
+/**
+ * @brief Serves a configured \c SimulatedECU on a pseudo-terminal, which takes
+ *      ownership of it.
+ */
+static std::unique_ptr<PtyEmulator> emulate(SimulatedECU* ecu) {
+    return std::unique_ptr<PtyEmulator>(new PtyEmulator(std::unique_ptr<ByteInterface>(ecu)));
+}
+
+static ConsultInterface connect(const PtyEmulator& emulator) {
+    return ConsultInterface(std::unique_ptr<ByteInterface>(new SerialPort(emulator.devicePath(), 9600)),
+                            std::chrono::milliseconds(1000));
+}
+
+/**
+ * @brief \c ByteInterface which fails when written to.
+ */
+class FailingByteInterface : public ByteInterface {
+public:
+    std::vector<uint8_t> read(std::size_t) override {
+        return {};
+    }
+
+    void write(const std::vector<uint8_t>&) override {
+        throw std::runtime_error("Device failed");
+    }
+};
+
+
+TEST(SerialPortTest, ctor_invalid) {
+    EXPECT_THROW(SerialPort("/dev/openconsult_missing", 9600), os_error);
+
+    auto emulator = emulate(new SimulatedECU(SimulatedTiming::REAL_TIME));
+    EXPECT_THROW(SerialPort(emulator->devicePath(), 12345), os_error);
+}
+
+TEST(SerialPortTest, consult_session) {
+    SimulatedECU* ecu = new SimulatedECU(SimulatedTiming::REAL_TIME);
+    ecu->setFaultCodes({{FaultCode::KNOCK_SENSOR, 13}});
+    ecu->setParameter(EngineParameter::ENGINE_RPM, [](uint64_t) { return 2500; });
+    ecu->setParameter(EngineParameter::BATTERY_VOLTAGE, [](uint64_t) { return 13.6; });
+    auto emulator = emulate(ecu);
+    ConsultInterface iface = connect(*emulator);
+
+    EXPECT_EQ(iface.readECUMetadata().part_number, "0488 23710-50F00");
+    auto codes = iface.readFaultCodes();
+    ASSERT_EQ(codes.fault_codes.size(), 1);
+    EXPECT_EQ(codes.fault_codes[0].fault_code, FaultCode::KNOCK_SENSOR);
+    auto values = iface.readEngineParameters({EngineParameter::ENGINE_RPM, EngineParameter::BATTERY_VOLTAGE});
+    EXPECT_NEAR(values.parameters[EngineParameter::ENGINE_RPM], 2500, 1e-9);
+    EXPECT_NEAR(values.parameters[EngineParameter::BATTERY_VOLTAGE], 13.6, 1e-9);
+}
+
+TEST(SerialPortTest, binary_transparent) {
+    // Every byte value passes through the terminal unaltered, including
+    // carriage returns, newlines and flow control characters.
+    auto counter = [](SimulatedECU& ecu) {
+        uint8_t count = 0;
+        ecu.setRegister(0x08, [count](uint64_t) mutable { return count++; });
+    };
+    auto stream = [](ConsultInterface& iface) {
+        std::vector<double> values;
+        auto stream = iface.streamEngineParameters({EngineParameter::COOLANT_TEMPERATURE});
+        for (int i = 0; i < 512; i++) {
+            values.push_back(stream.getFrame().parameters[EngineParameter::COOLANT_TEMPERATURE]);
+        }
+        return values;
+    };
+
+    SimulatedECU* direct = new SimulatedECU();
+    counter(*direct);
+    std::unique_ptr<ByteInterface> direct_device(direct);
+    ConsultInterface direct_iface(std::move(direct_device));
+
+    SimulatedECU* ecu = new SimulatedECU();
+    counter(*ecu);
+    auto emulator = emulate(ecu);
+    ConsultInterface iface = connect(*emulator);
+
+    EXPECT_EQ(stream(iface), stream(direct_iface));
+}
+
+TEST(SerialPortTest, read_timeout) {
+    // The ECU does not reply until the handshake.
+    auto emulator = emulate(new SimulatedECU(SimulatedTiming::REAL_TIME));
+    SerialPort port(emulator->devicePath(), 9600);
+    port.setTimeout(std::chrono::milliseconds(20));
+    auto begin = ByteInterface::clock::now();
+    EXPECT_THROW(port.read(1), timeout_error);
+    EXPECT_GE(ByteInterface::clock::now() - begin, std::chrono::milliseconds(20));
+
+    port.setTimeout(std::chrono::milliseconds(0));
+    port.setDeadline(ByteInterface::clock::now() + std::chrono::milliseconds(20));
+    EXPECT_THROW(port.read(1), timeout_error);
+    port.setDeadline(ByteInterface::clock::time_point::max());
+
+    port.write({{0xFF, 0xFF, 0xEF}});
+    port.setTimeout(std::chrono::milliseconds(1000));
+    EXPECT_EQ(port.read(1), std::vector<uint8_t>({0x10}));
+}
+
+TEST(SerialPortTest, hangup) {
+    // Reads fail promptly once the device goes away, rather than waiting for
+    // their timeout.
+    auto emulator = emulate(new SimulatedECU(SimulatedTiming::REAL_TIME));
+    SerialPort port(emulator->devicePath(), 9600);
+    port.setTimeout(std::chrono::milliseconds(5000));
+    std::thread hangup([&emulator]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        emulator.reset();
+    });
+    auto begin = ByteInterface::clock::now();
+    EXPECT_THROW(port.read(1), os_error);
+    EXPECT_LT(ByteInterface::clock::now() - begin, std::chrono::milliseconds(1000));
+    hangup.join();
+    EXPECT_THROW(port.read(1), os_error);
+}
+
+TEST(SerialPortTest, read_available) {
+    // Streamed bytes accumulate in the terminal, and are read together.
+    auto emulator = emulate(new SimulatedECU(SimulatedTiming::REAL_TIME));
+    SerialPort port(emulator->devicePath(), 9600);
+    EXPECT_TRUE(port.read().empty());
+    port.write({{0xFF, 0xFF, 0xEF, 0x5A, 0x0C, 0xF0}});
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto bytes = port.read();
+    ASSERT_GE(bytes.size(), 4 + 3 * 5);
+    EXPECT_EQ(std::vector<uint8_t>(bytes.begin(), bytes.begin() + 6),
+              std::vector<uint8_t>({0x10, 0xA5, 0x0C, 0xFF, 0x01, 0x00}));
+}
+
+TEST(SerialPortTest, read_ahead_time) {
+    // Bytes buffered by an earlier read report when they were received, not
+    // when they were read.
+    auto emulator = emulate(new SimulatedECU(SimulatedTiming::REAL_TIME));
+    SerialPort port(emulator->devicePath(), 9600);
+    port.setTimeout(std::chrono::milliseconds(1000));
+    port.write({{0xFF, 0xFF, 0xEF, 0x5A, 0x0C, 0xF0}});
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto begin = ByteInterface::clock::now();
+    EXPECT_EQ(port.read(1), std::vector<uint8_t>({0x10}));
+    auto buffered = ByteInterface::clock::now();
+    EXPECT_LE(port.lastReadTime(), buffered);
+    EXPECT_GE(port.lastReadTime(), begin);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(port.read(2), std::vector<uint8_t>({0xA5, 0x0C}));
+    EXPECT_LE(port.lastReadTime(), buffered);
+}
+
+TEST(PtyEmulatorTest, device_error) {
+    PtyEmulator emulator(std::unique_ptr<ByteInterface>(new FailingByteInterface));
+    SerialPort port(emulator.devicePath(), 9600);
+    port.write({{0x00}});
+    EXPECT_THROW(emulator.wait(), std::runtime_error);
+}
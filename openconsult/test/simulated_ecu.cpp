@@ -0,0 +1,197 @@
+#include "openconsult/src/simulated_ecu.h"
+#include "openconsult/src/common.h"
+#include "openconsult/src/consult_interface.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+using namespace openconsult;
+
+
+/**
+ * @brief Connects a \c ConsultInterface to a \c SimulatedECU , which remains
+ *      accessible.
+ */
+static ConsultInterface connect(SimulatedECU*& ecu, SimulatedTiming timing = SimulatedTiming::VIRTUAL) {
+    ecu = new SimulatedECU(timing);
+    return ConsultInterface(std::unique_ptr<ByteInterface>(ecu));
+}
+
+/**
+ * @brief A coolant temperature which counts the milliseconds since the
+ *      simulation started, modulo 100.
+ */
+static double clockWaveform(uint64_t time) {
+    return static_cast<double>(time / 1000000 % 100);
+}
+
+/**
+ * @brief Streams the coolant temperature of a \c SimulatedECU running
+ *      \c clockWaveform(...) .
+ */
+static std::vector<double> streamClock(SimulatedTiming timing, std::size_t frames) {
+    SimulatedECU* ecu;
+    ConsultInterface iface = connect(ecu, timing);
+    ecu->setParameter(EngineParameter::COOLANT_TEMPERATURE, clockWaveform);
+    std::vector<double> result;
+    auto stream = iface.streamEngineParameters({EngineParameter::COOLANT_TEMPERATURE});
+    for (std::size_t i = 0; i < frames; i++) {
+        result.push_back(stream.getFrame().parameters[EngineParameter::COOLANT_TEMPERATURE]);
+    }
+    return result;
+}
+
+
+TEST(SimulatedECUTest, handshake) {
+    SimulatedECU ecu;
+    // Commands are ignored until the handshake.
+    ecu.write({{0xD0}});
+    EXPECT_TRUE(ecu.read().empty());
+    ecu.write({{0xFF, 0xFF, 0xEF}});
+    EXPECT_EQ(ecu.read(1), std::vector<uint8_t>({0x10}));
+    EXPECT_EQ(ecu.time(), 5 * BYTE_TIME_NS);
+}
+
+TEST(SimulatedECUTest, latency) {
+    SimulatedECU ecu;
+    EXPECT_THROW(ecu.setLatency(std::chrono::microseconds(-1)), std::invalid_argument);
+    ecu.setLatency(std::chrono::microseconds(2000));
+    ecu.write({{0xFF, 0xFF, 0xEF}});
+    EXPECT_EQ(ecu.read(1), std::vector<uint8_t>({0x10}));
+    EXPECT_EQ(ecu.time(), 4 * BYTE_TIME_NS + 2000000);
+}
+
+TEST(SimulatedECUTest, commands) {
+    SimulatedECU ecu;
+    ecu.write({{0xFF, 0xFF, 0xEF}});
+    ecu.read(1);
+
+    // Unknown commands, and go-aheads without a request, are rejected. Stops
+    // are acknowledged.
+    ecu.write({{0x12, 0xF0, 0x30}});
+    EXPECT_EQ(ecu.read(3), std::vector<uint8_t>({0xFE, 0xFE, 0xCF}));
+
+    // Register selects are echoed, then streamed until stopped. The frame in
+    // progress when the stop arrives is completed.
+    ecu.setRegister(0x0C, [](uint64_t) { return 0xB4; });
+    ecu.write({{0x5A, 0x0C, 0x5A, 0x0B}});
+    EXPECT_EQ(ecu.read(4), std::vector<uint8_t>({0xA5, 0x0C, 0xA5, 0x0B}));
+    ecu.write({{0xF0}});
+    EXPECT_EQ(ecu.read(8), std::vector<uint8_t>({0xFF, 0x02, 0xB4, 0x00, 0xFF, 0x02, 0xB4, 0x00}));
+    ecu.write({{0x30}});
+    EXPECT_EQ(ecu.read(5), std::vector<uint8_t>({0xFF, 0x02, 0xB4, 0x00, 0xCF}));
+
+    // Nothing further is due, so reads cannot complete.
+    EXPECT_THROW(ecu.read(1), timeout_error);
+    EXPECT_TRUE(ecu.read().empty());
+}
+
+TEST(SimulatedECUTest, readECUMetadata) {
+    SimulatedECU* ecu;
+    ConsultInterface iface = connect(ecu);
+    EXPECT_EQ(iface.readECUMetadata().part_number, "0488 23710-50F00");
+
+    std::vector<uint8_t> frame(22);
+    frame[2] = 0x12;
+    frame[3] = 0x34;
+    frame[19] = 0x0A;
+    frame[20] = 0xBC;
+    frame[21] = 0xDE;
+    ecu->setMetadata(frame);
+    EXPECT_EQ(iface.readECUMetadata().part_number, "1234 23710-ABCDE");
+    EXPECT_THROW(ecu->setMetadata(std::vector<uint8_t>(256)), std::invalid_argument);
+}
+
+TEST(SimulatedECUTest, readFaultCodes) {
+    SimulatedECU* ecu;
+    ConsultInterface iface = connect(ecu);
+    auto codes = iface.readFaultCodes();
+    ASSERT_EQ(codes.fault_codes.size(), 1);
+    EXPECT_EQ(codes.fault_codes[0].fault_code, FaultCode::NO_MALFUNCTION);
+
+    ecu->setFaultCodes({{FaultCode::KNOCK_SENSOR, 13}, {FaultCode::ENGINE_COOLANT_SENSOR, 2}});
+    codes = iface.readFaultCodes();
+    ASSERT_EQ(codes.fault_codes.size(), 2);
+    EXPECT_EQ(codes.fault_codes[0].fault_code, FaultCode::KNOCK_SENSOR);
+    EXPECT_EQ(codes.fault_codes[0].starts_since_observed, 13);
+    EXPECT_EQ(codes.fault_codes[1].fault_code, FaultCode::ENGINE_COOLANT_SENSOR);
+    EXPECT_EQ(codes.fault_codes[1].starts_since_observed, 2);
+}
+
+TEST(SimulatedECUTest, readEngineParameters) {
+    SimulatedECU* ecu;
+    ConsultInterface iface = connect(ecu);
+    ecu->setParameter(EngineParameter::ENGINE_RPM, [](uint64_t) { return 3000; });
+    ecu->setParameter(EngineParameter::COOLANT_TEMPERATURE, [](uint64_t) { return 80; });
+    ecu->setParameter(EngineParameter::BATTERY_VOLTAGE, [](uint64_t) { return 14.41; });
+    EXPECT_THROW(ecu->setParameter(static_cast<EngineParameter>(-1), [](uint64_t) { return 0; }),
+                 std::invalid_argument);
+
+    uint64_t start = ecu->time();
+    auto values = iface.readEngineParameters({EngineParameter::ENGINE_RPM,
+                                              EngineParameter::COOLANT_TEMPERATURE,
+                                              EngineParameter::BATTERY_VOLTAGE});
+    EXPECT_NEAR(values.parameters[EngineParameter::ENGINE_RPM], 3000, 1e-9);
+    EXPECT_NEAR(values.parameters[EngineParameter::COOLANT_TEMPERATURE], 80, 1e-9);
+    EXPECT_NEAR(values.parameters[EngineParameter::BATTERY_VOLTAGE], 14.40, 1e-9);
+
+    // Eight bytes of request, echoed a byte behind, then the go-ahead, two
+    // frames of six bytes, as the stop arrives during the first, and the stop
+    // acknowledgement.
+    EXPECT_EQ(ecu->time() - start, (9 + 1 + 12 + 1) * BYTE_TIME_NS);
+}
+
+TEST(SimulatedECUTest, stream_timing) {
+    // Frames of three bytes are sent back to back, sampled as they start.
+    SimulatedECU* ecu;
+    ConsultInterface iface = connect(ecu);
+    ecu->setParameter(EngineParameter::COOLANT_TEMPERATURE, clockWaveform);
+    auto stream = iface.streamEngineParameters({EngineParameter::COOLANT_TEMPERATURE});
+    uint64_t previous = 0;
+    for (int i = 0; i < 100; i++) {
+        auto frame = stream.getFrame();
+        uint64_t start = ecu->time() - 3 * BYTE_TIME_NS;
+        EXPECT_EQ(frame.parameters[EngineParameter::COOLANT_TEMPERATURE], clockWaveform(start));
+        if (i > 0) {
+            EXPECT_EQ(ecu->time() - previous, 3 * BYTE_TIME_NS);
+        }
+        previous = ecu->time();
+    }
+}
+
+TEST(SimulatedECUTest, deterministic) {
+    auto frames = streamClock(SimulatedTiming::VIRTUAL, 1000);
+    EXPECT_EQ(frames, streamClock(SimulatedTiming::VIRTUAL, 1000));
+    EXPECT_NE(frames.front(), frames.back());
+}
+
+TEST(SimulatedECUTest, real_time) {
+    // Frames take as long as they would on the wire.
+    auto begin = ByteInterface::clock::now();
+    streamClock(SimulatedTiming::REAL_TIME, 20);
+    EXPECT_GE(ByteInterface::clock::now() - begin, std::chrono::nanoseconds(60 * BYTE_TIME_NS));
+
+    // Reads which cannot complete wait for their timeout.
+    SimulatedECU ecu(SimulatedTiming::REAL_TIME);
+    ecu.setTimeout(std::chrono::milliseconds(10));
+    begin = ByteInterface::clock::now();
+    EXPECT_THROW(ecu.read(1), timeout_error);
+    EXPECT_GE(ByteInterface::clock::now() - begin, std::chrono::milliseconds(10));
+}
+
+TEST(SimulatedECUTest, background_stream) {
+    SimulatedECU* ecu = new SimulatedECU();
+    ConsultInterface iface(std::unique_ptr<ByteInterface>(ecu), std::chrono::milliseconds(1000));
+    ecu->setParameter(EngineParameter::VEHICLE_SPEED, [](uint64_t) { return 60; });
+    {
+        StreamOptions options;
+        options.background = true;
+        auto stream = iface.streamEngineParameters({EngineParameter::VEHICLE_SPEED}, options);
+        for (int i = 0; i < 10; i++) {
+            EXPECT_NEAR(stream.getFrame().parameters[EngineParameter::VEHICLE_SPEED], 60, 1e-9);
+        }
+    }
+    // The stream halted cleanly.
+    EXPECT_EQ(iface.readECUMetadata().part_number, "0488 23710-50F00");
+}
@@ -0,0 +1,209 @@
+#include "openconsult/src/stream_broadcast.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <thread>
+
+using namespace openconsult;
+
+
+/**
+ * @brief Fake device which streams coolant temperature frames, with the value
+ *      incrementing in each frame. Frames are only sent once the test allows
+ *      them, and the device stalls after a given number of frames.
+ */
+class StreamingByteInterface : public ByteInterface {
+public:
+    StreamingByteInterface(std::size_t frame_limit, const std::atomic<std::size_t>& allowed_frames) :
+        frame_limit(frame_limit),
+        allowed_frames(allowed_frames) {
+    }
+
+    std::vector<uint8_t> read(std::size_t size) override {
+        std::vector<uint8_t> bytes;
+        while (bytes.size() < size) {
+            if (pending.empty()) {
+                while (streaming && frames_sent == allowed_frames && frames_sent < frame_limit) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                if (!streaming || frames_sent == frame_limit) {
+                    throw timeout_error();
+                }
+                pending.insert(pending.end(), {0xFF, 0x01, static_cast<uint8_t>(frames_sent++)});
+            }
+            bytes.push_back(pending.front());
+            pending.pop_front();
+        }
+        return bytes;
+    }
+
+    void write(const std::vector<uint8_t>& bytes) override {
+        if (bytes == std::vector<uint8_t>{0xFF, 0xFF, 0xEF}) {
+            pending.push_back(0x10);
+        } else if (bytes == std::vector<uint8_t>{0x5A, 0x08}) {
+            pending.insert(pending.end(), {0xA5, 0x08});
+        } else if (bytes == std::vector<uint8_t>{0xF0}) {
+            streaming = true;
+        } else if (bytes == std::vector<uint8_t>{0x30}) {
+            streaming = false;
+            pending.push_back(0xCF);
+        } else {
+            throw std::runtime_error("Unexpected write");
+        }
+    }
+
+private:
+    const std::size_t frame_limit;
+    const std::atomic<std::size_t>& allowed_frames;
+    std::size_t frames_sent = 0;
+    bool streaming = false;
+    std::deque<uint8_t> pending;
+};
+
+/**
+ * @brief Connects a \c ConsultInterface to a device, with a timeout so it can
+ *      be broadcast.
+ */
+static ConsultInterface connect(ByteInterface* device) {
+    return ConsultInterface(std::unique_ptr<ByteInterface>(device), std::chrono::milliseconds(1000));
+}
+
+static double coolant(const std::shared_ptr<const EngineParameters>& frame) {
+    return frame->parameters.at(EngineParameter::COOLANT_TEMPERATURE);
+}
+
+static void waitForPublishedFrames(const EngineParametersBroadcast& broadcast, uint64_t expected) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (broadcast.publishedFrames() < expected && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(expected, broadcast.publishedFrames());
+}
+
+static const std::vector<EngineParameter> PARAMS {EngineParameter::COOLANT_TEMPERATURE};
+
+
+TEST(EngineParametersBroadcastTest, ctor_zero_history) {
+    std::atomic<std::size_t> allowed_frames(SIZE_MAX);
+    ConsultInterface iface = connect(new StreamingByteInterface(0, allowed_frames));
+    EXPECT_THROW({
+        EngineParametersBroadcast broadcast(iface.streamEngineParameters(PARAMS), 0);
+    }, std::invalid_argument);
+}
+
+TEST(EngineParametersBroadcastTest, ctor_no_timeout) {
+    // The publishing thread could not be stopped while its read is blocked
+    // forever on a quiet device.
+    std::atomic<std::size_t> allowed_frames(SIZE_MAX);
+    ConsultInterface iface(std::unique_ptr<ByteInterface>(new StreamingByteInterface(0, allowed_frames)));
+    EXPECT_THROW({
+        EngineParametersBroadcast broadcast(iface.streamEngineParameters(PARAMS));
+    }, std::invalid_argument);
+}
+
+TEST(EngineParametersBroadcastTest, many_subscribers) {
+    std::atomic<std::size_t> allowed_frames(0);
+    ConsultInterface iface = connect(new StreamingByteInterface(10, allowed_frames));
+    EngineParametersBroadcast broadcast(iface.streamEngineParameters(PARAMS), 16);
+    auto a = broadcast.subscribe();
+    auto b = broadcast.subscribe();
+    allowed_frames = SIZE_MAX;
+
+    for (int i = 0; i < 10; i++) {
+        auto frame_a = a.getFrame();
+        auto frame_b = b.getFrame();
+        EXPECT_EQ(i - 50, coolant(frame_a));
+        // Frames are shared, not copied.
+        EXPECT_EQ(frame_a.get(), frame_b.get());
+    }
+    // Once drained, the stream's failure is reported to every subscriber.
+    EXPECT_THROW({
+        a.getFrame();
+    }, timeout_error);
+    EXPECT_THROW({
+        b.getFrame();
+    }, timeout_error);
+    EXPECT_EQ(0, a.skippedFrames());
+    EXPECT_EQ(0, b.skippedFrames());
+}
+
+TEST(EngineParametersBroadcastTest, slow_subscriber_skipped) {
+    std::atomic<std::size_t> allowed_frames(0);
+    ConsultInterface iface = connect(new StreamingByteInterface(10, allowed_frames));
+    EngineParametersBroadcast broadcast(iface.streamEngineParameters(PARAMS), 4);
+    auto fast = broadcast.subscribe();
+    auto slow = broadcast.subscribe();
+
+    // The fast subscriber reads every frame while the slow one does nothing.
+    for (int i = 0; i < 10; i++) {
+        allowed_frames = i + 1;
+        EXPECT_EQ(i - 50, coolant(fast.getFrame()));
+    }
+    waitForPublishedFrames(broadcast, 10);
+
+    for (int i = 6; i < 10; i++) {
+        EXPECT_EQ(i - 50, coolant(slow.getFrame()));
+    }
+    EXPECT_EQ(0, fast.skippedFrames());
+    EXPECT_EQ(6, slow.skippedFrames());
+}
+
+TEST(EngineParametersBroadcastTest, late_subscriber) {
+    std::atomic<std::size_t> allowed_frames(SIZE_MAX);
+    ConsultInterface iface = connect(new StreamingByteInterface(3, allowed_frames));
+    EngineParametersBroadcast broadcast(iface.streamEngineParameters(PARAMS), 4);
+    waitForPublishedFrames(broadcast, 3);
+
+    // Subscribers only see frames published after they subscribed.
+    auto late = broadcast.subscribe();
+    std::shared_ptr<const EngineParameters> frame;
+    EXPECT_THROW({
+        late.tryGetFrame(frame);
+    }, timeout_error);
+    EXPECT_EQ(nullptr, frame);
+}
+
+TEST(EngineParametersBroadcastTest, tryGetFrame) {
+    std::atomic<std::size_t> allowed_frames(0);
+    ConsultInterface iface = connect(new StreamingByteInterface(2, allowed_frames));
+    EngineParametersBroadcast broadcast(iface.streamEngineParameters(PARAMS), 4);
+    auto subscription = broadcast.subscribe();
+
+    std::shared_ptr<const EngineParameters> frame;
+    EXPECT_FALSE(subscription.tryGetFrame(frame));
+    EXPECT_EQ(nullptr, frame);
+
+    allowed_frames = 2;
+    waitForPublishedFrames(broadcast, 2);
+    EXPECT_TRUE(subscription.tryGetFrame(frame));
+    EXPECT_EQ(0 - 50, coolant(frame));
+    EXPECT_TRUE(subscription.tryGetFrame(frame));
+    EXPECT_EQ(1 - 50, coolant(frame));
+}
+
+TEST(EngineParametersBroadcastTest, subscription_outlives_broadcast) {
+    std::atomic<std::size_t> allowed_frames(0);
+    ConsultInterface iface = connect(new StreamingByteInterface(100, allowed_frames));
+    std::unique_ptr<EngineParametersSubscription> subscription;
+    {
+        EngineParametersBroadcast broadcast(iface.streamEngineParameters(PARAMS), 128);
+        subscription.reset(new EngineParametersSubscription(broadcast.subscribe()));
+        allowed_frames = 2;
+        waitForPublishedFrames(broadcast, 2);
+        // Let the publisher finish reading so the broadcast can be released.
+        allowed_frames = 3;
+    }
+
+    // The retained history is still available, then the end is reported.
+    EXPECT_EQ(0 - 50, coolant(subscription->getFrame()));
+    EXPECT_EQ(1 - 50, coolant(subscription->getFrame()));
+    EXPECT_THROW({
+        while (true) {
+            subscription->getFrame();
+        }
+    }, std::runtime_error);
+}
@@ -0,0 +1,159 @@
+#include "openconsult/src/stream_scheduler.h"
+#include "openconsult/src/common.h"
+#include "openconsult/src/simulated_ecu.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <memory>
+
+using namespace openconsult;
+
+
+/**
+ * @brief Connects a \c ConsultInterface to a \c SimulatedECU .
+ */
+static ConsultInterface connect(SimulatedTiming timing = SimulatedTiming::VIRTUAL) {
+    SimulatedECU* ecu = new SimulatedECU(timing);
+    ecu->setParameter(EngineParameter::ENGINE_RPM, [](uint64_t) { return 3000; });
+    ecu->setParameter(EngineParameter::COOLANT_TEMPERATURE, [](uint64_t) { return 80; });
+    return ConsultInterface(std::unique_ptr<ByteInterface>(ecu));
+}
+
+/**
+ * @brief Simulated ECU which times out once a given number of register-select
+ *      sessions have been requested.
+ */
+class FailingECU : public ByteInterface {
+public:
+    FailingECU(std::size_t session_limit) : session_limit(session_limit) {
+        ecu.setParameter(EngineParameter::ENGINE_RPM, [](uint64_t) { return 3000; });
+    }
+
+    std::vector<uint8_t> read(std::size_t size) override {
+        return ecu.read(size);
+    }
+
+    void readInto(uint8_t* dst, std::size_t size) override {
+        ecu.readInto(dst, size);
+    }
+
+    void write(const std::vector<uint8_t>& bytes) override {
+        write(bytes.data(), bytes.size());
+    }
+
+    void write(const uint8_t* bytes, std::size_t size) override {
+        // Register-select requests start with 0x5A.
+        if (size > 0 && bytes[0] == 0x5A && session_limit-- == 0) {
+            throw timeout_error();
+        }
+        ecu.write(bytes, size);
+    }
+
+private:
+    SimulatedECU ecu;
+    std::size_t session_limit;
+};
+
+
+TEST(EngineParametersSchedulerTest, ctor_invalid) {
+    ConsultInterface iface = connect();
+    EXPECT_THROW(EngineParametersScheduler(iface, {}), std::invalid_argument);
+    EXPECT_THROW(EngineParametersScheduler(iface, {{EngineParameter::ENGINE_RPM, 0}}), std::invalid_argument);
+    EXPECT_THROW(EngineParametersScheduler(iface, {{EngineParameter::ENGINE_RPM, 10},
+                                                   {EngineParameter::ENGINE_RPM, 20}}),
+                 std::invalid_argument);
+    EXPECT_THROW(EngineParametersScheduler(iface, {{static_cast<EngineParameter>(-1), 10}}),
+                 std::invalid_argument);
+}
+
+TEST(EngineParametersSchedulerTest, single_session) {
+    // Streamed together, these parameters exceed all of their targets.
+    ConsultInterface iface = connect();
+    EngineParametersScheduler scheduler(iface, {{EngineParameter::ENGINE_RPM, 50},
+                                                {EngineParameter::COOLANT_TEMPERATURE, 10},
+                                                {EngineParameter::BATTERY_VOLTAGE, 1}});
+    EXPECT_EQ(scheduler.fastParameters(), std::vector<EngineParameter>({EngineParameter::ENGINE_RPM,
+                                                                        EngineParameter::COOLANT_TEMPERATURE,
+                                                                        EngineParameter::BATTERY_VOLTAGE}));
+    for (uint64_t i = 0; i < 100; i++) {
+        auto frame = scheduler.getFrame();
+        EXPECT_EQ(frame.sequence, i);
+        EXPECT_EQ(frame.parameters.size(), 3);
+        EXPECT_NEAR(frame.parameters.at(EngineParameter::ENGINE_RPM), 3000, 1e-9);
+    }
+    EXPECT_EQ(scheduler.sessions(), 1);
+    for (const auto& statistics : scheduler.statistics()) {
+        EXPECT_EQ(statistics.samples, 100);
+    }
+}
+
+TEST(EngineParametersSchedulerTest, multi_rate) {
+    // Engine speed alone streams at about 240 Hz, but with the slow
+    // parameters alongside it, at only about 70 Hz.
+    const std::vector<EngineParameter> slow_parameters = {
+        EngineParameter::COOLANT_TEMPERATURE,
+        EngineParameter::VEHICLE_SPEED,
+        EngineParameter::BATTERY_VOLTAGE,
+        EngineParameter::THROTTLE_POSITION,
+        EngineParameter::FUEL_TEMPERATURE,
+        EngineParameter::INTAKE_AIR_TEMPERATURE,
+        EngineParameter::IGNITION_TIMING,
+        EngineParameter::AAC_VALVE,
+    };
+    std::vector<ScheduledParameter> schedule = {{EngineParameter::ENGINE_RPM, 200}};
+    for (auto parameter : slow_parameters) {
+        schedule.push_back({parameter, 4});
+    }
+    const double together_rate = 1e9 / ((2 + 2 + slow_parameters.size()) * BYTE_TIME_NS);
+
+    // The schedule is kept in link time, so it holds however quickly the
+    // simulation runs.
+    ConsultInterface iface = connect(SimulatedTiming::VIRTUAL);
+    EngineParametersScheduler scheduler(iface, schedule);
+    EXPECT_EQ(scheduler.fastParameters(), std::vector<EngineParameter>({EngineParameter::ENGINE_RPM}));
+
+    // Every parameter is sampled straight away.
+    auto frame = scheduler.getFrame();
+    EXPECT_EQ(frame.parameters.size(), schedule.size());
+
+    // About five seconds of link time.
+    for (int i = 0; i < 1000; i++) {
+        frame = scheduler.getFrame();
+        EXPECT_NEAR(frame.parameters.at(EngineParameter::ENGINE_RPM), 3000, 1e-9);
+    }
+
+    auto statistics = scheduler.statistics();
+    ASSERT_EQ(statistics.size(), schedule.size());
+    EXPECT_EQ(statistics[0].target_rate, 200);
+    EXPECT_GT(statistics[0].achieved_rate, together_rate);
+    for (std::size_t i = 1; i < statistics.size(); i++) {
+        EXPECT_EQ(statistics[i].parameter, slow_parameters[i - 1]);
+        EXPECT_NEAR(statistics[i].achieved_rate, 4, 0.4);
+    }
+    // Each refresh takes one session, and returning to the fast parameters
+    // another.
+    double elapsed = statistics[0].samples / statistics[0].achieved_rate;
+    EXPECT_NEAR(scheduler.sessions(), 1 + 2 * 4 * elapsed, 4);
+}
+
+TEST(EngineParametersSchedulerTest, session_failure) {
+    // The first session and the return to the fast parameters succeed, but
+    // the first refresh does not.
+    ConsultInterface iface(std::unique_ptr<ByteInterface>(new FailingECU(2)));
+    EngineParametersScheduler scheduler(iface, {{EngineParameter::ENGINE_RPM, 200},
+                                                {EngineParameter::COOLANT_TEMPERATURE, 4}});
+    bool failed = false;
+    for (int i = 0; i < 1000 && !failed; i++) {
+        try {
+            scheduler.getFrame();
+        } catch (const timeout_error&) {
+            failed = true;
+        }
+    }
+    ASSERT_TRUE(failed);
+
+    // The schedule cannot continue.
+    EXPECT_THROW(scheduler.getFrame(), timeout_error);
+    EXPECT_THROW(scheduler.getFrame(), timeout_error);
+}
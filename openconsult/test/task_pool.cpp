@@ -0,0 +1,87 @@
+#include "openconsult/src/task_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace openconsult;
+
+
+TEST(TaskPoolTest, size) {
+    EXPECT_EQ(TaskPool(3).size(), 3);
+    EXPECT_GE(TaskPool().size(), 1);
+}
+
+TEST(TaskPoolTest, runs_each_task_once) {
+    TaskPool pool(4);
+    for (std::size_t count : {0, 1, 3, 4, 1000}) {
+        std::vector<std::atomic<int>> runs(count);
+        pool.run(count, [&](std::size_t i) {
+            runs[i]++;
+        });
+        for (std::size_t i = 0; i < count; i++) {
+            EXPECT_EQ(runs[i], 1) << i;
+        }
+    }
+}
+
+TEST(TaskPoolTest, steals_from_busy_threads) {
+    // The first task to start blocks its thread until every other task has
+    // finished, including those dealt to its thread, which must be stolen.
+    TaskPool pool(2);
+    std::atomic<bool> started(false);
+    std::atomic<int> finished(0);
+    std::set<std::thread::id> threads;
+    std::mutex mutex;
+    pool.run(8, [&](std::size_t) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            threads.insert(std::this_thread::get_id());
+        }
+        if (!started.exchange(true)) {
+            while (finished < 7) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        } else {
+            finished++;
+        }
+    });
+    EXPECT_EQ(finished, 7);
+    EXPECT_EQ(threads.size(), 2);
+}
+
+TEST(TaskPoolTest, single_thread) {
+    // Tasks run in order on the calling thread.
+    TaskPool pool(1);
+    std::vector<std::size_t> order;
+    std::thread::id caller = std::this_thread::get_id();
+    pool.run(5, [&](std::size_t i) {
+        EXPECT_EQ(std::this_thread::get_id(), caller);
+        order.push_back(i);
+    });
+    EXPECT_EQ(order, std::vector<std::size_t>({0, 1, 2, 3, 4}));
+}
+
+TEST(TaskPoolTest, rethrows_errors) {
+    TaskPool pool(3);
+    std::atomic<int> runs(0);
+    EXPECT_THROW(pool.run(30, [&](std::size_t i) {
+        runs++;
+        if (i % 10 == 5) {
+            throw std::runtime_error("Task failed");
+        }
+    }), std::runtime_error);
+    // The remaining tasks still run, and the pool remains usable.
+    EXPECT_EQ(runs, 30);
+    runs = 0;
+    pool.run(30, [&](std::size_t) {
+        runs++;
+    });
+    EXPECT_EQ(runs, 30);
+}
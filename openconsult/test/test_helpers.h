@@ -0,0 +1,68 @@
+#ifndef OPENCONSULT_TEST_TEST_HELPERS
+#define OPENCONSULT_TEST_TEST_HELPERS
+
+#include "openconsult/src/log_format.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace openconsult {
+
+
+/// @brief A session as recorded by a \c LogRecorder : reading the ECU's part
+///     number and fault codes, then streaming engine speed, vehicle speed and
+///     battery voltage.
+constexpr const char* SESSION_LOG =
+    "W ffffef\nR 10\n"
+    "W d0\nR 2f\nW f0\nR ff16002114802000003f8080e220000028ffff4141353032\nW 30\nR cf\n"
+    "W d1\nR 2e\nW f0\nR ff02330b\nW 30\nR ff02330bcf\n"
+    "W 5a005a015a0b5a0c\nR a500a501a50ba50c\nW f0\n"
+    "R ff04007500b4\nR ff04007500b5\nR ff04007400b3\nR ff04007500b4\nW 30\nR ff04007600b5cf\n";
+
+/**
+ * @brief Views a log held in a string as bytes.
+ */
+inline const uint8_t* bytesOf(const std::string& log) {
+    return reinterpret_cast<const uint8_t*>(log.data());
+}
+
+/**
+ * @brief Converts a TEXT log to the BINARY format.
+ */
+inline std::string toBinary(const std::string& text) {
+    std::istringstream input(text);
+    std::ostringstream output;
+    convertLog(input, LogFormat::TEXT, output, LogFormat::BINARY);
+    return output.str();
+}
+
+/**
+ * @brief Writes a file in the test's temporary directory.
+ *
+ * @return The path of the file.
+ */
+inline std::string writeTempFile(const std::string& name, const std::string& contents) {
+    std::string path = ::testing::TempDir() + name;
+    std::ofstream file(path, std::ios_base::out | std::ios_base::binary);
+    file << contents;
+    return path;
+}
+
+/**
+ * @brief Reads the whole of a file.
+ */
+inline std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios_base::in | std::ios_base::binary);
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+
+}
+
+#endif